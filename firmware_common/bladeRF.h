@@ -51,6 +51,20 @@
 #define BLADE_OTP               _IOR(BLADERF_IOCTL_BASE, 52, unsigned int)
 #define BLADE_DEVICE_RESET      _IOR(BLADERF_IOCTL_BASE, 53, unsigned int)
 
+/* Pass-through requests, used by the libbladeRF "linux" backend */
+#define BLADE_SET_INTERFACE     _IO(BLADERF_IOCTL_BASE, 60)     /* arg: alt setting */
+#define BLADE_CONTROL_TRANSFER  _IOWR(BLADERF_IOCTL_BASE, 61, struct bladerf_ctrl_transfer)
+#define BLADE_BULK_TRANSFER     _IOWR(BLADERF_IOCTL_BASE, 62, struct bladerf_bulk_transfer)
+
+/* Sample ring control. See struct bladerf_ring_ctrl. */
+#define BLADE_RING_START        _IO(BLADERF_IOCTL_BASE, 63)     /* arg: BLADE_RING_{RX,TX} */
+#define BLADE_RING_STOP         _IO(BLADERF_IOCTL_BASE, 64)     /* arg: BLADE_RING_{RX,TX} */
+#define BLADE_RING_KICK         _IO(BLADERF_IOCTL_BASE, 65)     /* arg: BLADE_RING_{RX,TX} */
+#define BLADE_RING_SET_EVENTFD  _IOW(BLADERF_IOCTL_BASE, 66, struct bladerf_ring_eventfd)
+#define BLADE_RING_CONFIGURE    _IOWR(BLADERF_IOCTL_BASE, 67, struct bladerf_ring_config)
+#define BLADE_RING_GET_CONFIG   _IOWR(BLADERF_IOCTL_BASE, 68, struct bladerf_ring_config)
+#define BLADE_RING_GET_STATS    _IOWR(BLADERF_IOCTL_BASE, 69, struct bladerf_ring_stats)
+
 #define BLADE_USB_CMD_QUERY_VERSION             0
 #define BLADE_USB_CMD_QUERY_FPGA_STATUS         1
 #define BLADE_USB_CMD_BEGIN_PROG                2
@@ -73,6 +87,33 @@
 #define BLADE_USB_CMD_REFRESH_CAL_CACHE       112
 #define BLADE_USB_CMD_SET_LOOPBACK            113
 #define BLADE_USB_CMD_GET_LOOPBACK            114
+#define BLADE_USB_CMD_FLASH_READ_BULK         115
+#define BLADE_USB_CMD_FLASH_WRITE_BULK        116
+#define BLADE_USB_CMD_FLASH_BULK_STATUS       117
+#define BLADE_USB_CMD_FLASH_HASH              118
+#define BLADE_USB_CMD_FLASH_HASH_RESULT       119
+
+/* Bulk flash streaming (firmware >= v1.9.0, USB_IF_SPI_FLASH)
+ *
+ * BLADE_USB_CMD_FLASH_{READ,WRITE}_BULK take the number of pages in wValue
+ * and the first page in wIndex, and return a 32-bit status that is 0 if the
+ * operation was started. The page data is then streamed over the flash IN
+ * (read) or OUT (write) bulk endpoint. The firmware moves data through two
+ * FLASH_BULK_BUF_SIZE DMA buffers, so SPI accesses to one overlap with the
+ * USB transfer of the other.
+ *
+ * BLADE_USB_CMD_FLASH_HASH takes the same arguments and starts computing
+ * the SHA-256 of the specified pages on the device. Once the operation is
+ * done, BLADE_USB_CMD_FLASH_HASH_RESULT returns the FLASH_HASH_SIZE byte
+ * digest.
+ *
+ * BLADE_USB_CMD_FLASH_BULK_STATUS returns one of the FLASH_BULK_STATUS_*
+ * values for the most recent operation. */
+#define FLASH_BULK_BUF_SIZE                   4096
+#define FLASH_BULK_STATUS_DONE                0
+#define FLASH_BULK_STATUS_BUSY                1
+#define FLASH_BULK_STATUS_ERROR               2
+#define FLASH_HASH_SIZE                       32
 
 /* String descriptor indices */
 #define BLADE_USB_STR_INDEX_MFR     1   /* Manufacturer */
@@ -115,6 +156,124 @@ struct bladeRF_sector {
     unsigned char *ptr;
 };
 
+/* Control transfer, as issued by BLADE_CONTROL_TRANSFER. Standard requests
+ * that change the device's state are not permitted. Returns the number of
+ * bytes transferred. */
+struct bladerf_ctrl_transfer {
+    unsigned char  request_type;
+    unsigned char  request;
+    unsigned short value;
+    unsigned short index;
+    unsigned short length;
+    unsigned int   timeout_ms;
+    unsigned int   reserved;
+    unsigned long long data;    /* Address of the data buffer */
+};
+
+/* Bulk transfer on a control-path endpoint, as issued by BLADE_BULK_TRANSFER.
+ * The sample endpoints are reserved for the sample ring. Returns the number
+ * of bytes transferred. */
+struct bladerf_bulk_transfer {
+    unsigned int   endpoint;
+    unsigned int   length;
+    unsigned int   timeout_ms;
+    unsigned int   reserved;
+    unsigned long long data;    /* Address of the data buffer */
+};
+
+#define BLADE_RING_RX   0
+#define BLADE_RING_TX   1
+
+/* Sample ring shared by the Linux driver and userspace
+ *
+ * The driver's RX and TX sample buffers are mapped with mmap() from
+ * BLADE_RING_RX_OFFSET and BLADE_RING_TX_OFFSET. Each mapping is
+ * num_buffers * buffer_size bytes, as reported by BLADE_RING_GET_CONFIG.
+ * This structure occupies the page mapped from BLADE_RING_CTRL_OFFSET.
+ *
+ * Indices are free-running buffer counts; count n refers to the buffer at
+ * (n % num_buffers) * buffer_size. For RX, the driver advances rx_head as
+ * buffers are received and userspace advances rx_tail as it consumes them.
+ * For TX, userspace advances tx_head as it fills buffers and the driver
+ * advances tx_tail as they are sent.
+ *
+ * When the RX ring is full or the TX ring is empty, the driver cannot keep
+ * num_concurrent transfers in flight and sets {rx,tx}_wakeup. After
+ * advancing its index, userspace must issue a full memory barrier and, if the flag is set,
+ * BLADE_RING_KICK. Completions are signalled via poll() and, optionally, an
+ * eventfd registered with BLADE_RING_SET_EVENTFD.
+ *
+ * {rx,tx}_status holds the (negative) errno of a failed transfer, which also
+ * stops the ring. BLADE_RING_START resets all of a direction's fields.
+ */
+struct bladerf_ring_ctrl {
+    unsigned int rx_head;
+    unsigned int rx_tail;
+    unsigned int rx_wakeup;
+    int          rx_status;
+    unsigned int rx_reserved[12];
+
+    unsigned int tx_head;
+    unsigned int tx_tail;
+    unsigned int tx_wakeup;
+    int          tx_status;
+    unsigned int tx_reserved[12];
+};
+
+/* Limits of the sample ring's geometry. See struct bladerf_ring_config. */
+#define BLADE_RING_MAX_SIZE     (64 * 1024 * 1024)
+#define BLADE_RING_MAX_BUF_SZ   (1024 * 1024)
+
+#define BLADE_RING_CTRL_OFFSET  0
+#define BLADE_RING_RX_OFFSET    0x10000
+#define BLADE_RING_TX_OFFSET    (BLADE_RING_RX_OFFSET + BLADE_RING_MAX_SIZE)
+
+/* Geometry of one direction of the sample ring, as set by
+ * BLADE_RING_CONFIGURE and reported by BLADE_RING_GET_CONFIG.
+ *
+ * num_buffers and buffer_size must be powers of two, with buffer_size from
+ * 1 KiB to BLADE_RING_MAX_BUF_SZ. The ring must span at least one page and
+ * no more than BLADE_RING_MAX_SIZE. num_concurrent, the number of transfers
+ * kept in flight, may not exceed num_buffers. Fields left 0 keep their
+ * current value, and the applied configuration is written back.
+ *
+ * A ring may only be reconfigured while it is stopped and not mapped. The
+ * configuration belongs to the file that owns the ring, and reverts to the
+ * defaults (NUM_DATA_URB, DATA_BUF_SZ, NUM_CONCURRENT) when it is closed.
+ */
+struct bladerf_ring_config {
+    unsigned int dir;           /* BLADE_RING_RX or BLADE_RING_TX */
+    unsigned int num_buffers;
+    unsigned int buffer_size;
+    unsigned int num_concurrent;
+};
+
+/* Transfer statistics of one direction of the sample ring, since it was
+ * last started. These are also available via sysfs, as
+ * /sys/class/usbmisc/bladerf<n>/device/{rx,tx}_<field>.
+ *
+ * A stall is a period in which the driver had no transfers in flight
+ * because userspace had not consumed RX buffers or filled TX buffers.
+ * The device drops RX samples (or runs out of TX samples) while stalled.
+ */
+struct bladerf_ring_stats {
+    unsigned int dir;           /* BLADE_RING_RX or BLADE_RING_TX */
+    unsigned int reserved;
+    unsigned long long transfers;       /* Completed transfers */
+    unsigned long long bytes;           /* Bytes transferred */
+    unsigned long long short_transfers; /* Transfers shorter than requested */
+    unsigned long long stalls;          /* # of stalls */
+    unsigned long long stall_ns;        /* Total duration of stalls */
+    unsigned long long throttled;       /* # of times fewer than
+                                         * num_concurrent transfers could be
+                                         * kept in flight */
+};
+
+struct bladerf_ring_eventfd {
+    unsigned int dir;           /* BLADE_RING_RX or BLADE_RING_TX */
+    int          fd;            /* eventfd, or -1 to remove */
+};
+
 #define USB_CYPRESS_VENDOR_ID   0x04b4
 #define USB_FX3_PRODUCT_ID      0x00f3
 
@@ -160,6 +319,28 @@ struct uart_pkt {
 #define UART_PKT_MODE_DIR_WRITE  (1<<UART_PKT_MODE_DIR_SHIFT)
 };
 
+// Maximum number of { addr, data } commands carried by a single packet
+#define UART_PKT_MAX_CMDS       7
+
+// LMS6002D DC calibration loop, run on the NIOS (UART_PKT_DEV_LMS only,
+// FPGA >= v0.1.3). A DC_CAL request is a struct uart_pkt with
+// mode = UART_PKT_MODE_DIR_DC_CAL | UART_PKT_DEV_LMS | 2, followed by two
+// struct uart_cmd entries:
+//
+//   cmd[0] = { addr: DC cal block base address, data: calibration address }
+//   cmd[1] = { addr: DC_CNTVAL,                 data: 0 }
+//
+// The response has the same layout, with:
+//
+//   cmd[0].data = DC_REG_VAL of the calibrated address
+//   cmd[1].data = one of the UART_PKT_DC_CAL_* status values
+//
+// Older FPGAs echo a zero status. In that case, or on
+// UART_PKT_DC_CAL_TIMEOUT, the host runs the loop itself.
+#define UART_PKT_MODE_DIR_DC_CAL (3<<UART_PKT_MODE_DIR_SHIFT)
+#define UART_PKT_DC_CAL_DONE     1
+#define UART_PKT_DC_CAL_TIMEOUT  2
+
 struct uart_cmd {
     union {
         struct {
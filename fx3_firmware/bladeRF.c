@@ -523,6 +523,40 @@ CyBool_t NuandHandleVendorRequest(
         CyU3PUsbSendRetCode(apiRetStatus);
     break;
 
+    case BLADE_USB_CMD_FLASH_READ_BULK:
+    case BLADE_USB_CMD_FLASH_WRITE_BULK:
+        if (glUsbAltInterface != USB_IF_SPI_FLASH) {
+            apiRetStatus = CyU3PUsbStall(0x80, CyTrue, CyFalse);
+        } else {
+            CyU3PUsbSendRetCode(NuandFlashBulkBegin(
+                        bRequest == BLADE_USB_CMD_FLASH_READ_BULK,
+                        wIndex, wValue));
+        }
+    break;
+
+    case BLADE_USB_CMD_FLASH_BULK_STATUS:
+        CyU3PUsbSendRetCode(NuandFlashBulkStatus());
+    break;
+
+    case BLADE_USB_CMD_FLASH_HASH:
+        if (glUsbAltInterface != USB_IF_SPI_FLASH) {
+            apiRetStatus = CyU3PUsbStall(0x80, CyTrue, CyFalse);
+        } else {
+            CyU3PUsbSendRetCode(NuandFlashHashBegin(wIndex, wValue));
+        }
+    break;
+
+    case BLADE_USB_CMD_FLASH_HASH_RESULT: {
+        const uint8_t *hash = NuandFlashHashResult();
+
+        if (hash == NULL || wLength != FLASH_HASH_SIZE) {
+            apiRetStatus = CyU3PUsbStall(0x80, CyTrue, CyFalse);
+        } else {
+            apiRetStatus = CyU3PUsbSendEP0Data(wLength, (uint8_t *) hash);
+        }
+    }
+    break;
+
     case BLADE_USB_CMD_FLASH_ERASE:
         if (glUsbAltInterface != USB_IF_SPI_FLASH) {
            apiRetStatus = CyU3PUsbStall(0x80, CyTrue, CyFalse);
@@ -724,7 +758,10 @@ void CyFxbladeRFApplnUSBEventCB (CyU3PUsbEventType_t evtype, uint16_t evdata)
             switch(glUsbAltInterface) {
                 case USB_IF_CONFIG: NuandFpgaConfig.stop() ; break ;
                 case USB_IF_RF_LINK: NuandRFLink.stop(); break ;
-                case USB_IF_SPI_FLASH: NuandFlashDeinit(); break ;
+                case USB_IF_SPI_FLASH:
+                    NuandFlashBulkStop();
+                    NuandFlashDeinit();
+                    break ;
                 default: break ;
             }
 
@@ -735,6 +772,7 @@ void CyFxbladeRFApplnUSBEventCB (CyU3PUsbEventType_t evtype, uint16_t evdata)
                 NuandRFLink.start();
             } else if (alt_interface == USB_IF_SPI_FLASH) {
                 NuandFlashInit();
+                NuandFlashBulkStart();
             }
             glUsbAltInterface = alt_interface;
         break;
@@ -964,8 +1002,9 @@ void bladeRFAppThread_Entry( uint32_t input)
     glDeviceReady = CyTrue;
 
     while ( 1 ) {
-        /* Additional application-specific code can go here */
-        CyU3PThreadSleep(1000);
+        /* Service bulk flash transfers, which are set up by vendor
+         * requests. This returns after 1s if there are none. */
+        NuandFlashBulkService(1000);
     }
 }
 
@@ -975,6 +1014,8 @@ void CyFxApplicationDefine(void)
     void *ptr = NULL;
     uint32_t retThrdCreate = CY_U3P_SUCCESS;
 
+    NuandFlashSwInit();
+
     /* Allocate the memory for the threads */
     ptr = CyU3PMemAlloc(BLADE_THREAD_STACK);
 
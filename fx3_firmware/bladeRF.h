@@ -34,7 +34,7 @@
 #define BLADE_DMA_BUF_COUNT      (2)
 #define BLADE_DMA_TX_SIZE        (0)
 #define BLADE_DMA_RX_SIZE        (0)
-#define BLADE_THREAD_STACK       (0x0400)
+#define BLADE_THREAD_STACK       (0x0800)
 #define BLADE_THREAD_PRIORITY    (8)
 
 // interface #3
@@ -53,7 +53,10 @@
 #define BLADE_UART_EP_CONSUMER_USB_SOCKET CY_U3P_UIB_SOCKET_CONS_2
 
 // interface #2
-// doesn't actually use BULK, EP exists for debugging purposes
+#define BLADE_FLASH_EP_PRODUCER         0x02
+#define BLADE_FLASH_EP_PRODUCER_USB_SOCKET CY_U3P_UIB_SOCKET_PROD_2
+#define BLADE_FLASH_EP_CONSUMER         0x82
+#define BLADE_FLASH_EP_CONSUMER_USB_SOCKET CY_U3P_UIB_SOCKET_CONS_2
 
 /* Extern definitions for the USB Descriptors */
 extern const uint8_t CyFxUSB20DeviceDscr[];
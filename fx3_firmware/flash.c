@@ -20,11 +20,15 @@
  * THE SOFTWARE.
  */
 #include <string.h>
+#include "cyu3os.h"
+#include "cyu3dma.h"
+#include "cyu3usb.h"
 #include "cyu3spi.h"
 #include "cyu3error.h"
 #include "bladeRF.h"
 #include "spi_flash_lib.h"
 #include "flash.h"
+#include "sha256.h"
 
 static CyU3PReturnStatus_t FlashReadStatus(uint8_t *val)
 {
@@ -129,6 +133,330 @@ void NuandFlashDeinit() {
     CyFxSpiDeInit();
 }
 
+/* Bulk flash streaming. See BLADE_USB_CMD_FLASH_READ_BULK in bladeRF.h.
+ *
+ * Vendor requests only set up an operation; the application thread moves
+ * the data between the SPI flash and the DMA buffers, so that control
+ * requests (e.g., status queries) continue to be serviced meanwhile. */
+#define FLASH_EVENT_BULK        (1 << 0)
+#define FLASH_BULK_TIMEOUT_MS   1000
+
+static CyU3PDmaChannel glChHandleFlashIn;   /* Flash to host */
+static CyU3PDmaChannel glChHandleFlashOut;  /* Host to flash */
+static CyBool_t glFlashBulkReady = CyFalse;
+static CyU3PEvent glFlashEvent;
+
+typedef enum {
+    FLASH_OP_READ,
+    FLASH_OP_WRITE,
+    FLASH_OP_HASH,
+} FlashOp_t;
+
+static struct {
+    FlashOp_t op;
+    uint16_t page;
+    uint16_t count;
+    volatile int32_t status;
+} glFlashBulk = { FLASH_OP_READ, 0, 0, FLASH_BULK_STATUS_DONE };
+
+/* SHA-256 digest computed by the last FLASH_OP_HASH, and the page buffer
+ * used to compute it */
+static uint8_t glFlashHash[SHA256_DIGEST_SIZE];
+static CyBool_t glFlashHashValid = CyFalse;
+static uint8_t glFlashHashBuf[FLASH_PAGE_SIZE * 4];
+
+void NuandFlashSwInit(void)
+{
+    CyU3PEventCreate(&glFlashEvent);
+}
+
+static CyU3PReturnStatus_t FlashBulkEpConfig(uint8_t ep, CyBool_t enable,
+                                             uint16_t size)
+{
+    CyU3PEpConfig_t epCfg;
+
+    CyU3PMemSet((uint8_t *)&epCfg, 0, sizeof(epCfg));
+    epCfg.enable = enable;
+    epCfg.epType = CY_U3P_USB_EP_BULK;
+    epCfg.burstLen = 1;
+    epCfg.streams = 0;
+    epCfg.pcktSize = size;
+
+    return CyU3PSetEpConfig(ep, &epCfg);
+}
+
+void NuandFlashBulkStart(void)
+{
+    uint16_t size;
+    CyU3PDmaChannelConfig_t dmaCfg;
+    CyU3PReturnStatus_t status;
+
+    switch (CyU3PUsbGetSpeed()) {
+        case CY_U3P_SUPER_SPEED:
+            size = 1024;
+            break;
+
+        case CY_U3P_HIGH_SPEED:
+            size = 512;
+            break;
+
+        default:
+            size = 64;
+            break;
+    }
+
+    status = FlashBulkEpConfig(BLADE_FLASH_EP_PRODUCER, CyTrue, size);
+    if (status == CY_U3P_SUCCESS) {
+        status = FlashBulkEpConfig(BLADE_FLASH_EP_CONSUMER, CyTrue, size);
+    }
+
+    if (status != CY_U3P_SUCCESS) {
+        CyU3PDebugPrint(4, "Failed to configure flash endpoints, "
+                           "Error code = %d\n", status);
+        return;
+    }
+
+    /* Two buffers per direction, so that the SPI flash accesses for one
+     * overlap with the USB transfer of the other */
+    CyU3PMemSet((uint8_t *)&dmaCfg, 0, sizeof(dmaCfg));
+    dmaCfg.size = FLASH_BULK_BUF_SIZE;
+    dmaCfg.count = 2;
+    dmaCfg.dmaMode = CY_U3P_DMA_MODE_BYTE;
+    dmaCfg.notification = 0;
+    dmaCfg.cb = NULL;
+
+    dmaCfg.prodSckId = CY_U3P_CPU_SOCKET_PROD;
+    dmaCfg.consSckId = BLADE_FLASH_EP_CONSUMER_USB_SOCKET;
+    status = CyU3PDmaChannelCreate(&glChHandleFlashIn,
+                                   CY_U3P_DMA_TYPE_MANUAL_OUT, &dmaCfg);
+    if (status != CY_U3P_SUCCESS) {
+        CyU3PDebugPrint(4, "Failed to create flash IN channel, "
+                           "Error code = %d\n", status);
+        return;
+    }
+
+    dmaCfg.prodSckId = BLADE_FLASH_EP_PRODUCER_USB_SOCKET;
+    dmaCfg.consSckId = CY_U3P_CPU_SOCKET_CONS;
+    status = CyU3PDmaChannelCreate(&glChHandleFlashOut,
+                                   CY_U3P_DMA_TYPE_MANUAL_IN, &dmaCfg);
+    if (status != CY_U3P_SUCCESS) {
+        CyU3PDebugPrint(4, "Failed to create flash OUT channel, "
+                           "Error code = %d\n", status);
+        CyU3PDmaChannelDestroy(&glChHandleFlashIn);
+        return;
+    }
+
+    CyU3PUsbFlushEp(BLADE_FLASH_EP_PRODUCER);
+    CyU3PUsbFlushEp(BLADE_FLASH_EP_CONSUMER);
+
+    glFlashBulk.status = FLASH_BULK_STATUS_DONE;
+    glFlashBulkReady = CyTrue;
+}
+
+void NuandFlashBulkStop(void)
+{
+    int i;
+
+    if (!glFlashBulkReady) {
+        return;
+    }
+
+    glFlashBulkReady = CyFalse;
+
+    /* Aborting the channels fails any DMA buffer wait in progress, so an
+     * operation that the host abandoned winds down quickly */
+    CyU3PDmaChannelReset(&glChHandleFlashIn);
+    CyU3PDmaChannelReset(&glChHandleFlashOut);
+
+    for (i = 0; i < 20 && glFlashBulk.status == FLASH_BULK_STATUS_BUSY; i++) {
+        CyU3PThreadSleep(10);
+    }
+
+    CyU3PDmaChannelDestroy(&glChHandleFlashIn);
+    CyU3PDmaChannelDestroy(&glChHandleFlashOut);
+
+    CyU3PUsbFlushEp(BLADE_FLASH_EP_PRODUCER);
+    CyU3PUsbFlushEp(BLADE_FLASH_EP_CONSUMER);
+
+    FlashBulkEpConfig(BLADE_FLASH_EP_PRODUCER, CyFalse, 0);
+    FlashBulkEpConfig(BLADE_FLASH_EP_CONSUMER, CyFalse, 0);
+}
+
+int32_t NuandFlashBulkBegin(CyBool_t isRead, uint16_t page, uint16_t count)
+{
+    CyU3PDmaChannel *ch = isRead ? &glChHandleFlashIn : &glChHandleFlashOut;
+    const uint32_t len = (uint32_t) count * FLASH_PAGE_SIZE;
+
+    if (!glFlashBulkReady || count == 0 ||
+        glFlashBulk.status == FLASH_BULK_STATUS_BUSY) {
+        return -1;
+    }
+
+    /* A finite transfer size causes the final, partial buffer of a write to
+     * be handed to us once the last byte arrives */
+    CyU3PDmaChannelReset(ch);
+    if (CyU3PDmaChannelSetXfer(ch, len) != CY_U3P_SUCCESS) {
+        return -1;
+    }
+
+    glFlashBulk.op = isRead ? FLASH_OP_READ : FLASH_OP_WRITE;
+    glFlashBulk.page = page;
+    glFlashBulk.count = count;
+    glFlashBulk.status = FLASH_BULK_STATUS_BUSY;
+
+    CyU3PEventSet(&glFlashEvent, FLASH_EVENT_BULK, CYU3P_EVENT_OR);
+    return 0;
+}
+
+int32_t NuandFlashHashBegin(uint16_t page, uint16_t count)
+{
+    if (!glFlashBulkReady || count == 0 ||
+        glFlashBulk.status == FLASH_BULK_STATUS_BUSY) {
+        return -1;
+    }
+
+    glFlashHashValid = CyFalse;
+
+    glFlashBulk.op = FLASH_OP_HASH;
+    glFlashBulk.page = page;
+    glFlashBulk.count = count;
+    glFlashBulk.status = FLASH_BULK_STATUS_BUSY;
+
+    CyU3PEventSet(&glFlashEvent, FLASH_EVENT_BULK, CYU3P_EVENT_OR);
+    return 0;
+}
+
+const uint8_t *NuandFlashHashResult(void)
+{
+    if (glFlashBulk.status != FLASH_BULK_STATUS_DONE || !glFlashHashValid) {
+        return NULL;
+    }
+
+    return glFlashHash;
+}
+
+int32_t NuandFlashBulkStatus(void)
+{
+    return glFlashBulk.status;
+}
+
+static CyU3PReturnStatus_t FlashHash(void)
+{
+    SHA256_CTX ctx;
+    CyU3PReturnStatus_t status;
+    uint16_t page = glFlashBulk.page;
+    uint32_t remaining = (uint32_t) glFlashBulk.count * FLASH_PAGE_SIZE;
+    uint16_t len;
+
+    /* Don't read while a previous page program is still in progress */
+    status = CyFxSpiWaitForStatus();
+
+    SHA256_Init(&ctx);
+
+    while (remaining != 0 && status == CY_U3P_SUCCESS) {
+        len = remaining < sizeof(glFlashHashBuf) ?
+                    (uint16_t) remaining : sizeof(glFlashHashBuf);
+
+        status = CyFxSpiTransfer(page, len, glFlashHashBuf, CyTrue);
+        if (status == CY_U3P_SUCCESS) {
+            SHA256_Update(&ctx, glFlashHashBuf, len);
+        }
+
+        page += len / FLASH_PAGE_SIZE;
+        remaining -= len;
+    }
+
+    if (status == CY_U3P_SUCCESS) {
+        SHA256_Final(glFlashHash, &ctx);
+        glFlashHashValid = CyTrue;
+    }
+
+    return status;
+}
+
+static CyU3PReturnStatus_t FlashBulkTransfer(void)
+{
+    CyU3PDmaBuffer_t buf;
+    CyU3PReturnStatus_t status = CY_U3P_SUCCESS;
+    uint16_t page = glFlashBulk.page;
+    uint32_t remaining = (uint32_t) glFlashBulk.count * FLASH_PAGE_SIZE;
+    uint16_t len;
+
+    /* Page program completion is polled prior to each write, so the
+     * per-page delay may be skipped */
+    CyFxSpiFastRead(CyTrue);
+
+    if (glFlashBulk.op == FLASH_OP_HASH) {
+        status = FlashHash();
+        CyFxSpiFastRead(CyFalse);
+        return status;
+    } else if (glFlashBulk.op == FLASH_OP_READ) {
+        /* Don't read while a previous page program is still in progress */
+        status = CyFxSpiWaitForStatus();
+    }
+
+    while (remaining != 0 && status == CY_U3P_SUCCESS) {
+        if (glFlashBulk.op == FLASH_OP_READ) {
+            status = CyU3PDmaChannelGetBuffer(&glChHandleFlashIn, &buf,
+                                              FLASH_BULK_TIMEOUT_MS);
+            if (status != CY_U3P_SUCCESS) {
+                break;
+            }
+
+            len = remaining < FLASH_BULK_BUF_SIZE ?
+                        (uint16_t) remaining : FLASH_BULK_BUF_SIZE;
+
+            status = CyFxSpiTransfer(page, len, buf.buffer, CyTrue);
+            if (status == CY_U3P_SUCCESS) {
+                status = CyU3PDmaChannelCommitBuffer(&glChHandleFlashIn,
+                                                     len, 0);
+            }
+        } else {
+            status = CyU3PDmaChannelGetBuffer(&glChHandleFlashOut, &buf,
+                                              FLASH_BULK_TIMEOUT_MS);
+            if (status != CY_U3P_SUCCESS) {
+                break;
+            }
+
+            len = buf.count;
+            if (len == 0 || len > remaining || (len % FLASH_PAGE_SIZE) != 0) {
+                status = CY_U3P_ERROR_BAD_ARGUMENT;
+            } else {
+                status = CyFxSpiTransfer(page, len, buf.buffer, CyFalse);
+            }
+
+            CyU3PDmaChannelDiscardBuffer(&glChHandleFlashOut);
+        }
+
+        page += len / FLASH_PAGE_SIZE;
+        remaining -= len;
+    }
+
+    /* A write is complete once the last page program has finished */
+    if (status == CY_U3P_SUCCESS && glFlashBulk.op == FLASH_OP_WRITE) {
+        status = CyFxSpiWaitForStatus();
+    }
+
+    CyFxSpiFastRead(CyFalse);
+    return status;
+}
+
+void NuandFlashBulkService(uint32_t timeout_ms)
+{
+    uint32_t flags;
+    CyU3PReturnStatus_t status;
+
+    status = CyU3PEventGet(&glFlashEvent, FLASH_EVENT_BULK,
+                           CYU3P_EVENT_OR_CLEAR, &flags, timeout_ms);
+
+    if (status == CY_U3P_SUCCESS) {
+        status = FlashBulkTransfer();
+        glFlashBulk.status = (status == CY_U3P_SUCCESS) ?
+                                FLASH_BULK_STATUS_DONE :
+                                FLASH_BULK_STATUS_ERROR;
+    }
+}
+
 static inline size_t min_sz(size_t x, size_t y)
 {
     return x < y ? x : y;
@@ -32,6 +32,19 @@ CyU3PReturnStatus_t NuandLockOtp();
 void NuandFlashInit();
 void NuandFlashDeinit();
 
+/* Bulk flash streaming over the SPI flash interface's endpoints */
+void NuandFlashSwInit(void);
+void NuandFlashBulkStart(void);
+void NuandFlashBulkStop(void);
+int32_t NuandFlashBulkBegin(CyBool_t isRead, uint16_t page, uint16_t count);
+int32_t NuandFlashBulkStatus(void);
+
+/* SHA-256 of a page range, computed by NuandFlashBulkService(). The result
+ * is NULL until the operation has completed successfully. */
+int32_t NuandFlashHashBegin(uint16_t page, uint16_t count);
+const uint8_t *NuandFlashHashResult(void);
+void NuandFlashBulkService(uint32_t timeout_ms);
+
 int NuandExtractField(char *ptr, int len, char *field,
                             char *val, size_t  maxlen);
 
@@ -27,6 +27,7 @@
 void CyFxSpiFastRead(CyBool_t v);
 CyU3PReturnStatus_t CyFxSpiInit();
 CyU3PReturnStatus_t CyFxSpiDeInit();
+CyU3PReturnStatus_t CyFxSpiWaitForStatus(void);
 CyU3PReturnStatus_t CyFxSpiTransfer(
         uint16_t pageAddress, uint16_t byteCount,
         uint8_t *buffer, CyBool_t isRead);
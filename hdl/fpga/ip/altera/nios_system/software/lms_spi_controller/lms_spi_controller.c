@@ -47,7 +47,7 @@
 #define FPGA_VERSION_ID         0x7777
 #define FPGA_VERSION_MAJOR      0
 #define FPGA_VERSION_MINOR      1
-#define FPGA_VERSION_PATCH      2
+#define FPGA_VERSION_PATCH      3
 #define FPGA_VERSION            (FPGA_VERSION_MAJOR | (FPGA_VERSION_MINOR << 8) | (FPGA_VERSION_PATCH << 16))
 
 #define TIME_TAMER              TIME_TAMER_0_BASE
@@ -196,6 +196,54 @@ void lms_spi_write( uint8_t address, uint8_t val )
     return ;
 }
 
+// DC_CLBR_DONE poll interval and count. A host polling over USB spends on the
+// order of a millisecond per poll, so back-to-back SPI reads here would give
+// up far sooner than the host's 25 polls. Bound the wait by time instead.
+#define DC_CAL_POLL_US      100
+#define DC_CAL_MAX_POLLS    250
+
+// Run a DC calibration loop on an LMS6002D DC calibration block.
+// Reference LMS6002D calibration guide, section 4.1 flow chart. Returns 1 with
+// DC_REG_VAL in *dc_regval once the calibration completes, or 2 if it has not
+// completed within DC_CAL_MAX_POLLS * DC_CAL_POLL_US microseconds.
+uint8_t lms_dc_cal_loop( uint8_t base, uint8_t cal_address, uint8_t dc_cntval, uint8_t *dc_regval )
+{
+    uint16_t i ;
+    uint8_t val ;
+
+    // Set the calibration address for the block
+    lms_spi_read( base + 0x03, &val ) ;
+    val &= ~(0x07) ;
+    val |= cal_address & 0x07 ;
+    lms_spi_write( base + 0x03, val ) ;
+
+    // Set and latch the DC_CNTVAL
+    lms_spi_write( base + 0x02, dc_cntval ) ;
+    lms_spi_write( base + 0x03, val | (1 << 4) ) ;
+    lms_spi_write( base + 0x03, val ) ;
+
+    // Start the calibration by toggling DC_START_CLBR
+    lms_spi_write( base + 0x03, val | (1 << 5) ) ;
+    lms_spi_write( base + 0x03, val ) ;
+
+    // Wait for the active low DC_CLBR_DONE
+    for( i = 0 ; i < DC_CAL_MAX_POLLS ; i++ )
+    {
+        usleep( DC_CAL_POLL_US ) ;
+        lms_spi_read( base + 0x01, &val ) ;
+        if( ((val >> 1) & 1) == 0 )
+        {
+            // Per LMS FAQ item 4.7, check DC_REG_VAL as DC_LOCK is not reliable
+            lms_spi_read( base, dc_regval ) ;
+            *dc_regval &= 0x3f ;
+            return 1 ;
+        }
+    }
+
+    *dc_regval = 0 ;
+    return 2 ;
+}
+
 // Entry point
 int main()
 {
@@ -220,6 +268,7 @@ int main()
 #define UART_PKT_MODE_DIR_SHIFT  6
 #define UART_PKT_MODE_DIR_READ   (2<<UART_PKT_MODE_DIR_SHIFT)
 #define UART_PKT_MODE_DIR_WRITE  (1<<UART_PKT_MODE_DIR_SHIFT)
+#define UART_PKT_MODE_DIR_DC_CAL (3<<UART_PKT_MODE_DIR_SHIFT)
   };
 
   struct uart_cmd {
@@ -264,6 +313,7 @@ int main()
               uint8_t val ;
               int isRead;
               int isWrite;
+              int isDcCal;
 
               val = IORD_ALTERA_AVALON_UART_RXDATA(UART_0_BASE) ;
 
@@ -299,6 +349,7 @@ int main()
 
               isRead = (mode & UART_PKT_MODE_DIR_MASK) == UART_PKT_MODE_DIR_READ;
               isWrite = (mode & UART_PKT_MODE_DIR_MASK) == UART_PKT_MODE_DIR_WRITE;
+              isDcCal = (mode & UART_PKT_MODE_DIR_MASK) == UART_PKT_MODE_DIR_DC_CAL;
 
               if (state == EXECUTE_CMDS) {
                   write_uart(UART_PKT_MAGIC);
@@ -307,7 +358,14 @@ int main()
                   cnt = (mode & UART_PKT_MODE_CNT_MASK);
                   cmd_ptr = (struct uart_cmd *)buf;
 
-                  if ((mode & UART_PKT_MODE_DEV_MASK) == UART_PKT_DEV_LMS) {
+                  if ((mode & UART_PKT_MODE_DEV_MASK) == UART_PKT_DEV_LMS && isDcCal) {
+                      // cmd[0] = { base, cal address }, cmd[1] = { DC_CNTVAL, - }
+                      // Reply with DC_REG_VAL in cmd[0] and the status in cmd[1]
+                      if (cnt >= 2) {
+                          cmd_ptr[1].data = lms_dc_cal_loop(cmd_ptr[0].addr, cmd_ptr[0].data,
+                                                            cmd_ptr[1].addr, &cmd_ptr[0].data);
+                      }
+                  } else if ((mode & UART_PKT_MODE_DEV_MASK) == UART_PKT_DEV_LMS) {
                       for (i = 0; i < cnt; i++) {
                           if (isRead) {
                               lms_spi_read(cmd_ptr->addr, &cmd_ptr->data);
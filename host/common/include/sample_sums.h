@@ -0,0 +1,56 @@
+/**
+ * @file sample_sums.h
+ *
+ * @brief Sums of SC16 Q11 sample values, squares and products
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (c) 2015 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef SAMPLE_SUMS_H_
+#define SAMPLE_SUMS_H_
+
+#include <stdint.h>
+
+struct sample_sums {
+    int64_t i, q;           /* Sums of I and Q */
+    uint64_t ii, qq;        /* Sums of I^2 and Q^2 */
+    int64_t iq;             /* Sum of I*Q */
+    unsigned int peak;      /* Largest magnitude of I or Q */
+};
+
+/**
+ * Compute the sums of a block of interleaved I/Q samples
+ *
+ * Values are accumulated in runs, using 32-bit partial sums that the
+ * compiler can vectorize. Runs containing values beyond the 12-bit range
+ * of SC16 Q11 samples are summed again using 64-bit arithmetic, so any
+ * int16_t values are handled correctly.
+ *
+ * @param[in]   samples     Samples, as interleaved I/Q pairs
+ * @param[in]   n           Number of samples (I/Q pairs)
+ * @param[out]  sums        Computed sums
+ */
+void sample_sums(const int16_t *samples, unsigned int n,
+                 struct sample_sums *sums);
+
+#endif
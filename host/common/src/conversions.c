@@ -547,6 +547,12 @@ const char *backend_description(bladerf_backend b)
         case BLADERF_BACKEND_DUMMY:
             return "Dummy";
 
+        case BLADERF_BACKEND_SIM:
+            return "Simulated device";
+
+        case BLADERF_BACKEND_REPLAY:
+            return "Trace replay";
+
         default:
             return "Unknown";
     }
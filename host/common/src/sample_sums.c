@@ -0,0 +1,98 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (c) 2015 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <string.h>
+#include "sample_sums.h"
+
+/* Number of samples accumulated into 32-bit partial sums before these are
+ * added to the 64-bit totals. Products of 12-bit samples occupy at most 22
+ * bits (plus sign), so neither the partial sums of squares nor that of I*Q
+ * can overflow over a run of this length. */
+#define SUMS_RUN_LEN    256
+
+/* Largest magnitude of a 12-bit sample */
+#define SUMS_MAX_12BIT  2048
+
+/* Sum a run using 64-bit arithmetic, for values beyond the 12-bit range */
+static void sums_run_wide(const int16_t *block, unsigned int run,
+                          struct sample_sums *sums)
+{
+    unsigned int j;
+
+    for (j = 0; j < run; j++) {
+        const int64_t si = block[2 * j];
+        const int64_t sq = block[2 * j + 1];
+
+        sums->i  += si;
+        sums->q  += sq;
+        sums->ii += (uint64_t) (si * si);
+        sums->qq += (uint64_t) (sq * sq);
+        sums->iq += si * sq;
+    }
+}
+
+void sample_sums(const int16_t *samples, unsigned int n,
+                 struct sample_sums *sums)
+{
+    unsigned int i, j, run;
+
+    memset(sums, 0, sizeof(*sums));
+
+    for (i = 0; i < n; i += run) {
+        const int16_t *block = &samples[2 * i];
+        int32_t sum_i = 0, sum_q = 0, sum_iq = 0;
+        uint32_t sum_ii = 0, sum_qq = 0;
+        uint32_t max_run = 0;
+
+        run = (n - i) < SUMS_RUN_LEN ? (n - i) : SUMS_RUN_LEN;
+
+        /* No loop-carried dependencies other than the reductions */
+        for (j = 0; j < run; j++) {
+            const int32_t si = block[2 * j];
+            const int32_t sq = block[2 * j + 1];
+            const uint32_t ai = (uint32_t) (si < 0 ? -si : si);
+            const uint32_t aq = (uint32_t) (sq < 0 ? -sq : sq);
+
+            sum_i  += si;
+            sum_q  += sq;
+            sum_ii += (uint32_t) (si * si);
+            sum_qq += (uint32_t) (sq * sq);
+            sum_iq += si * sq;
+            max_run = ai > max_run ? ai : max_run;
+            max_run = aq > max_run ? aq : max_run;
+        }
+
+        if (max_run > SUMS_MAX_12BIT) {
+            sums_run_wide(block, run, sums);
+        } else {
+            sums->i  += sum_i;
+            sums->q  += sum_q;
+            sums->ii += sum_ii;
+            sums->qq += sum_qq;
+            sums->iq += sum_iq;
+        }
+
+        sums->peak = max_run > sums->peak ? max_run : sums->peak;
+    }
+}
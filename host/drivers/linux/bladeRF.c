@@ -28,65 +28,102 @@
 #include <linux/mutex.h>
 #include <linux/wait.h>
 #include <linux/uaccess.h>
+#include <linux/fs.h>
+#include <linux/uio.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
+#include <linux/eventfd.h>
+#include <linux/version.h>
+#include <linux/kref.h>
+#include <linux/rwsem.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
 #include "../../../firmware_common/bladeRF.h"
 
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 16, 0)
+typedef unsigned int __poll_t;
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 8, 0)
+#   define ring_eventfd_signal(ctx) eventfd_signal(ctx)
+#else
+#   define ring_eventfd_signal(ctx) eventfd_signal(ctx, 1)
+#endif
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 18, 0)
+#   define kvcalloc(n, size, flags) kcalloc(n, size, flags)
+#endif
+
+// Bulk pass-through transfers are split into chunks of this size
+#define BULK_CHUNK_SZ   (16 * 1024)
+
 struct data_buffer {
     struct urb  *urb;
     void        *addr;
-    dma_addr_t   dma;
-    int          valid;
+};
+
+// One direction of the sample ring shared with userspace. Buffers are
+// submitted in order, and at most num_concurrent of them are in flight.
+//
+//      done                  submitted
+//        v                       v
+//  |   | S | S | S | S | S | S |   |   |   |
+//
+// For RX, userspace owns the buffers from rx_tail to done, and those from
+// submitted to rx_tail + num_buffers are free. For TX, the buffers from
+// submitted to tx_head have been filled and are waiting to be sent.
+// See struct bladerf_ring_ctrl in bladeRF.h.
+struct data_ring {
+    // Geometry, see struct bladerf_ring_config
+    unsigned int          num_buffers;
+    unsigned int          buffer_size;
+    unsigned int          num_concurrent;
+
+    // Allocated upon first use, and freed when the owner closes the device.
+    // Sample buffers are carved out of pages that are allocated in blocks of
+    // at least one buffer, so that they may be mapped into userspace.
+    struct page         **pages;
+    unsigned int          num_pages;
+    struct data_buffer   *bufs;
+
+    // Serializes (re)configuration with use of the buffers
+    struct mutex          mutex;
+    atomic_t              mapped;       // # of VMAs mapping the buffers
+
+    spinlock_t            lock;
+    int                   enabled;
+    unsigned int          submitted;    // # of buffers given to the USB core
+    unsigned int          done;         // # of those that have completed
+    struct usb_anchor     anchor;
+    wait_queue_head_t     wait;
+    struct eventfd_ctx   *eventfd;
+
+    struct bladerf_ring_stats stats;
+    int                   stalled;
+    ktime_t               stall_start;
+
+    // allow only one reader and writer
+    struct file          *owner;
 };
 
 typedef struct {
     struct usb_device    *udev;
     struct usb_interface *interface;
+    struct kref           kref;
 
     int                   intnum;
-    int                   disconnecting;
-
-    //    0   1   2   3   4   5   6   7   8   9   10  11  12  13  14  15
-    //  |   |   |   | X | X | X | X | X | S | S | S | S |   |   |   |   |
-    //                ^                   ^               ^ producer index
-    //                consumer index      receive index
-    //  Key: S=submitted  X=unsubmitted, queued buffers
-
-    int                   rx_en;
-    spinlock_t            data_in_lock;
-
-    unsigned int          data_in_consumer_idx;
-    unsigned int          data_in_receiver_idx;
-    unsigned int          data_in_producer_idx;
-
-    atomic_t              data_in_queued;       // number of buffers with data unread by the usermode application [transmit index - transmit index]
-    atomic_t              data_in_used;         // number of buffers that may be inflight or have unread data [transmit index - consumer index]
-    atomic_t              data_in_inflight;     // number of buffers currently in the USB stack [transmit index - consumer index]
-    struct data_buffer    data_in_bufs[NUM_DATA_URB];
-    struct usb_anchor     data_in_anchor;
-    wait_queue_head_t     data_in_wait;
-
-
-    //    0   1   2   3   4   5   6   7   8   9   10  11  12  13  14  15
-    //  |   |   |   | S | S | S | S | X | X | X | X | X |   |   |   |   |
-    //                ^               ^ consumer index    ^ producer index
-    //                | transmit index
-    //  Key: S=submitted  X=unsubmitted, queued buffers
 
-    int                   tx_en;
-    spinlock_t            data_out_lock;
-
-    unsigned int          data_out_consumer_idx;
-    unsigned int          data_out_tranmit_idx;
-    unsigned int          data_out_producer_idx;
+    // Set by bladerf_disconnect() with disconnect_sem held for writing.
+    // File operations that perform device I/O hold it for reading.
+    // See bladerf_io_begin().
+    struct rw_semaphore   disconnect_sem;
+    int                   disconnecting;
 
-    atomic_t              data_out_queued;
-    atomic_t              data_out_used;
-    atomic_t              data_out_inflight;
-    struct data_buffer    data_out_bufs[NUM_DATA_URB];
-    struct usb_anchor     data_out_anchor;
-    wait_queue_head_t     data_out_wait;
+    // Ring indices shared with userspace
+    struct bladerf_ring_ctrl *ctrl;
 
-    // allow only one reader and writer
-    struct file           *reader, *writer;
+    struct data_ring      rx;
+    struct data_ring      tx;
 
     int bytes;
     int debug;
@@ -101,146 +138,574 @@ static struct usb_device_id bladerf_table[] = {
 };
 MODULE_DEVICE_TABLE(usb, bladerf_table);
 
-static int __submit_rx_urb(bladerf_device_t *dev, unsigned int flags) {
-    struct urb *urb;
-    unsigned long irq_flags;
-    int ret = 0;
+static inline struct data_ring *ring(bladerf_device_t *dev, unsigned int dir) {
+    return dir == BLADE_RING_TX ? &dev->tx : &dev->rx;
+}
 
-    do {
-        spin_lock_irqsave(&dev->data_in_lock, irq_flags);
-        if (atomic_read(&dev->data_in_inflight) < NUM_CONCURRENT && atomic_read(&dev->data_in_used) < NUM_DATA_URB) {
-            urb = dev->data_in_bufs[dev->data_in_producer_idx].urb;
+static int ring_claim(struct data_ring *r, struct file *file) {
+    struct file *prev = cmpxchg(&r->owner, NULL, file);
+    return (prev == NULL || prev == file) ? 0 : -EPERM;
+}
 
-            if (!dev->data_in_bufs[dev->data_in_producer_idx].valid) {
-                printk("data_in error\n");
-                break;
-            }
+static void ring_set_defaults(struct data_ring *r) {
+    r->num_buffers = NUM_DATA_URB;
+    r->buffer_size = DATA_BUF_SZ;
+    r->num_concurrent = NUM_CONCURRENT;
+}
 
-            dev->data_in_bufs[dev->data_in_producer_idx].valid = 0; // mark this RX packet as being in use
+static void ring_init(struct data_ring *r, unsigned int dir) {
+    ring_set_defaults(r);
+    mutex_init(&r->mutex);
+    atomic_set(&r->mapped, 0);
+    spin_lock_init(&r->lock);
+    init_usb_anchor(&r->anchor);
+    init_waitqueue_head(&r->wait);
+    r->stats.dir = dir;
+}
 
-            atomic_inc(&dev->data_in_used);
+static void ring_fail(bladerf_device_t *dev, struct data_ring *r, int status) {
+    dev_err(&dev->interface->dev, "%s transfer failed, error=%d\n",
+            r == &dev->rx ? "RX" : "TX", status);
 
-            usb_anchor_urb(urb, &dev->data_in_anchor);
-            spin_unlock_irqrestore(&dev->data_in_lock, irq_flags);
-            atomic_inc(&dev->data_in_inflight);
-            ret = usb_submit_urb(urb, GFP_ATOMIC);
-            if (ret) {
-                atomic_dec(&dev->data_in_inflight);
-                goto leave_rx;
-            }
+    if (r == &dev->rx)
+        WRITE_ONCE(dev->ctrl->rx_status, status);
+    else
+        WRITE_ONCE(dev->ctrl->tx_status, status);
+
+    r->enabled = 0;
+}
+
+// Account for the end of a stall, if any. Called with the ring's lock held.
+static void __ring_unstall(struct data_ring *r) {
+    if (r->stalled) {
+        r->stats.stall_ns += ktime_to_ns(ktime_sub(ktime_get(), r->stall_start));
+        r->stalled = 0;
+    }
+}
+
+// Note that fewer than num_concurrent transfers are in flight, as userspace
+// has not kept up. Called with the ring's lock held.
+static void __ring_throttle(struct data_ring *r, unsigned int *wakeup) {
+    if (!READ_ONCE(*wakeup)) {
+        r->stats.throttled++;
+        WRITE_ONCE(*wakeup, 1);
+    }
+
+    // Nothing is in flight, so the device is dropping samples (RX) or has
+    // run out of them (TX). A TX ring is idle until it is first filled.
+    if (r->submitted == r->done && r->done != 0 && !r->stalled) {
+        r->stats.stalls++;
+        r->stall_start = ktime_get();
+        r->stalled = 1;
+    }
+}
+
+// Submit the next buffer's URB. Called with the ring's lock held.
+static int __ring_submit(bladerf_device_t *dev, struct data_ring *r) {
+    struct urb *urb = r->bufs[r->submitted % r->num_buffers].urb;
+    int ret;
+
+    usb_anchor_urb(urb, &r->anchor);
+    ret = usb_submit_urb(urb, GFP_ATOMIC);
+    if (ret) {
+        usb_unanchor_urb(urb);
+        ring_fail(dev, r, ret);
+        return ret;
+    }
+
+    __ring_unstall(r);
+    r->submitted++;
+    return 0;
+}
+
+// Submit transfers for free RX buffers. Called with rx.lock held.
+static void __submit_rx_urbs(bladerf_device_t *dev) {
+    struct data_ring *r = &dev->rx;
+    unsigned int tail;
+
+    while (r->enabled) {
+        tail = smp_load_acquire(&dev->ctrl->rx_tail);
+
+        while (r->submitted - r->done < r->num_concurrent &&
+               r->submitted - tail < r->num_buffers) {
+            if (__ring_submit(dev, r))
+                return;
         }
-    } while(1);
-    spin_unlock_irqrestore(&dev->data_in_lock, irq_flags);
-leave_rx:
 
-    return ret;
+        if (r->submitted - r->done == r->num_concurrent)
+            break;
+
+        // The ring is full. Ask to be kicked as soon as userspace frees a
+        // buffer, rather than once the transfers in flight have completed,
+        // unless it already has.
+        __ring_throttle(r, &dev->ctrl->rx_wakeup);
+        smp_mb();
+        if (READ_ONCE(dev->ctrl->rx_tail) == tail)
+            break;
+
+        WRITE_ONCE(dev->ctrl->rx_wakeup, 0);
+    }
+}
+
+// Submit transfers for filled TX buffers. Called with tx.lock held.
+static void __submit_tx_urbs(bladerf_device_t *dev) {
+    struct data_ring *r = &dev->tx;
+    unsigned int head;
+
+    while (r->enabled) {
+        head = smp_load_acquire(&dev->ctrl->tx_head);
+
+        while (r->submitted - r->done < r->num_concurrent &&
+               r->submitted != head && head - r->done <= r->num_buffers) {
+            if (__ring_submit(dev, r))
+                return;
+        }
+
+        if (r->submitted - r->done == r->num_concurrent)
+            break;
+
+        // Everything filled has been submitted. Ask to be kicked once
+        // userspace fills another buffer, unless it already has.
+        __ring_throttle(r, &dev->ctrl->tx_wakeup);
+        smp_mb();
+        if (READ_ONCE(dev->ctrl->tx_head) == head)
+            break;
+
+        WRITE_ONCE(dev->ctrl->tx_wakeup, 0);
+    }
+}
+
+static void ring_notify(struct data_ring *r) {
+    wake_up_interruptible(&r->wait);
+    if (r->eventfd)
+        ring_eventfd_signal(r->eventfd);
+}
+
+// Account for a completed transfer. Called with the ring's lock held.
+static void __ring_complete(bladerf_device_t *dev, struct data_ring *r,
+                            struct urb *urb) {
+    // Bulk transfers complete in the order they were submitted
+    r->done++;
+    r->stats.transfers++;
+    r->stats.bytes += urb->actual_length;
+    if (urb->actual_length < urb->transfer_buffer_length)
+        r->stats.short_transfers++;
+
+    dev->bytes += urb->actual_length;
 }
 
-static void __bladeRF_write_cb(struct urb *urb);
 static void __bladeRF_read_cb(struct urb *urb) {
-    bladerf_device_t *dev;
-    unsigned char *buf;
+    bladerf_device_t *dev = (bladerf_device_t *)urb->context;
+    struct data_ring *r = &dev->rx;
     unsigned long flags;
 
-    usb_unanchor_urb(urb);
+    spin_lock_irqsave(&r->lock, flags);
 
-    spin_lock_irqsave(&dev->data_in_lock, flags);
-    buf = (unsigned char *)urb->transfer_buffer;
-    dev = (bladerf_device_t *)urb->context;
-    atomic_dec(&dev->data_in_inflight);
-    dev->bytes += DATA_BUF_SZ;
-    atomic_inc(&dev->data_in_queued);
-    spin_unlock_irqrestore(&dev->data_in_lock, flags);
+    if (r->enabled) {
+        if (urb->status == 0) {
+            __ring_complete(dev, r, urb);
+            smp_store_release(&dev->ctrl->rx_head, r->done);
+            __submit_rx_urbs(dev);
+        } else {
+            ring_fail(dev, r, urb->status);
+        }
+
+        ring_notify(r);
+    }
 
-    if (dev->rx_en)
-        __submit_rx_urb(dev, GFP_ATOMIC);
-    wake_up_interruptible(&dev->data_in_wait);
+    spin_unlock_irqrestore(&r->lock, flags);
 }
 
-static int bladerf_start(bladerf_device_t *dev) {
-    int i;
-    void *buf;
-    struct urb *urb;
+static void __bladeRF_write_cb(struct urb *urb) {
+    bladerf_device_t *dev = (bladerf_device_t *)urb->context;
+    struct data_ring *r = &dev->tx;
+    unsigned long flags;
 
-    dev->rx_en = 0;
-    atomic_set(&dev->data_in_queued, 0);
-    atomic_set(&dev->data_in_used, 0);
-    dev->data_in_consumer_idx = 0;
-    dev->data_in_producer_idx = 0;
-
-    for (i = 0; i < NUM_DATA_URB; i++) {
-        buf = usb_alloc_coherent(dev->udev, DATA_BUF_SZ,
-                GFP_KERNEL, &dev->data_in_bufs[i].dma);
-        memset(buf, 0, DATA_BUF_SZ);
-        if (!buf) {
-            dev_err(&dev->interface->dev, "Could not allocate data IN buffer\n");
-            return -1;
+    spin_lock_irqsave(&r->lock, flags);
+
+    if (r->enabled) {
+        if (urb->status == 0) {
+            __ring_complete(dev, r, urb);
+            smp_store_release(&dev->ctrl->tx_tail, r->done);
+            __submit_tx_urbs(dev);
+        } else {
+            ring_fail(dev, r, urb->status);
         }
 
-        dev->data_in_bufs[i].addr = buf;
+        ring_notify(r);
+    }
 
-        urb = usb_alloc_urb(0, GFP_KERNEL);
-        if (!buf) {
-            dev_err(&dev->interface->dev, "Could not allocate data IN URB\n");
-            return -1;
-        }
+    spin_unlock_irqrestore(&r->lock, flags);
+}
 
-        dev->data_in_bufs[i].urb = urb;
-        dev->data_in_bufs[i].valid = 1;
+static void ring_free(struct data_ring *r) {
+    unsigned int i;
 
-        usb_fill_bulk_urb(urb, dev->udev, usb_rcvbulkpipe(dev->udev, 1),
-                dev->data_in_bufs[i].addr, DATA_BUF_SZ, __bladeRF_read_cb, dev);
+    // in case the ring is still being stopped
+    usb_kill_anchored_urbs(&r->anchor);
 
-        urb->transfer_flags |= URB_NO_TRANSFER_DMA_MAP;
-        urb->transfer_dma = dev->data_in_bufs[i].dma;
+    if (r->bufs) {
+        for (i = 0; i < r->num_buffers; i++)
+            usb_free_urb(r->bufs[i].urb);
+
+        kvfree(r->bufs);
+        r->bufs = NULL;
     }
 
-    dev->tx_en = 0;
-    atomic_set(&dev->data_out_queued, 0);
-    atomic_set(&dev->data_out_used, 0);
+    if (r->pages) {
+        for (i = 0; i < r->num_pages; i++) {
+            if (r->pages[i])
+                __free_page(r->pages[i]);
+        }
 
-    dev->data_out_consumer_idx = 0;
-    dev->data_out_producer_idx = 0;
+        kvfree(r->pages);
+        r->pages = NULL;
+    }
+}
 
-    for (i = 0; i < NUM_DATA_URB; i++) {
-        buf = usb_alloc_coherent(dev->udev, DATA_BUF_SZ,
-                GFP_KERNEL, &dev->data_out_bufs[i].dma);
-        memset(buf, 0, DATA_BUF_SZ);
-        if (!buf) {
-            dev_err(&dev->interface->dev, "Could not allocate data OUT buffer\n");
-            return -1;
-        }
+// Allocate the ring's buffers, if they have not been already. Called with
+// the ring's mutex held.
+static int ring_alloc(bladerf_device_t *dev, struct data_ring *r) {
+    const int is_tx = r == &dev->tx;
+    const size_t size = (size_t)r->num_buffers * r->buffer_size;
+    const unsigned int order = get_order(max_t(size_t, r->buffer_size, PAGE_SIZE));
+    const unsigned int pipe = is_tx ? usb_sndbulkpipe(dev->udev, 1)
+                                    : usb_rcvbulkpipe(dev->udev, 1);
+    struct page *page;
+    struct urb *urb;
+    unsigned int i, j;
+    size_t offset;
+
+    if (r->bufs)
+        return 0;
+
+    r->num_pages = size >> PAGE_SHIFT;
+    r->pages = kvcalloc(r->num_pages, sizeof(r->pages[0]), GFP_KERNEL);
+    r->bufs = kvcalloc(r->num_buffers, sizeof(r->bufs[0]), GFP_KERNEL);
+    if (!r->pages || !r->bufs)
+        goto error_oom;
+
+    // Buffers larger than a page must be physically contiguous. Blocks are
+    // split so that their pages may be mapped individually.
+    for (i = 0; i < r->num_pages; i += 1 << order) {
+        page = alloc_pages(GFP_KERNEL | __GFP_ZERO | __GFP_NOWARN, order);
+        if (!page)
+            goto error_oom;
 
-        dev->data_out_bufs[i].addr = buf;
+        if (order)
+            split_page(page, order);
+
+        for (j = 0; j < (1 << order); j++)
+            r->pages[i + j] = page + j;
+    }
+
+    for (i = 0; i < r->num_buffers; i++) {
+        offset = (size_t)i * r->buffer_size;
+        r->bufs[i].addr = page_address(r->pages[offset >> PAGE_SHIFT]) +
+                          (offset & ~PAGE_MASK);
 
         urb = usb_alloc_urb(0, GFP_KERNEL);
-        if (!buf) {
-            dev_err(&dev->interface->dev, "Could not allocate data OUT URB\n");
-            return -1;
+        if (!urb)
+            goto error_oom;
+
+        r->bufs[i].urb = urb;
+
+        // The USB core maps each buffer for DMA when it is submitted, so
+        // transfers are made directly to and from the pages userspace maps
+        usb_fill_bulk_urb(urb, dev->udev, pipe, r->bufs[i].addr, r->buffer_size,
+                          is_tx ? __bladeRF_write_cb : __bladeRF_read_cb, dev);
+    }
+
+    return 0;
+
+error_oom:
+    dev_err(&dev->interface->dev, "Could not allocate %u data %s buffers of %u bytes\n",
+            r->num_buffers, is_tx ? "OUT" : "IN", r->buffer_size);
+    ring_free(r);
+    return -ENOMEM;
+}
+
+static int bladerf_start(bladerf_device_t *dev) {
+    ring_init(&dev->rx, BLADE_RING_RX);
+    ring_init(&dev->tx, BLADE_RING_TX);
+
+    dev->ctrl = (struct bladerf_ring_ctrl *)get_zeroed_page(GFP_KERNEL);
+    if (!dev->ctrl)
+        return -ENOMEM;
+
+    return 0;
+}
+
+static void bladerf_stop(bladerf_device_t *dev) {
+    if (dev->rx.eventfd)
+        eventfd_ctx_put(dev->rx.eventfd);
+
+    if (dev->tx.eventfd)
+        eventfd_ctx_put(dev->tx.eventfd);
+
+    ring_free(&dev->rx);
+    ring_free(&dev->tx);
+    free_page((unsigned long)dev->ctrl);
+}
+
+static void bladerf_delete(struct kref *kref) {
+    bladerf_device_t *dev = container_of(kref, bladerf_device_t, kref);
+
+    bladerf_stop(dev);
+    usb_put_intf(dev->interface);
+    usb_put_dev(dev->udev);
+    kfree(dev);
+}
+
+// Start device I/O from a file operation, which must be paired with
+// bladerf_io_end(). Returns -ENODEV once the device has been disconnected,
+// after which the USB core forbids further I/O. This must not be held while
+// waiting on a ring, as disconnect only wakes waiters after taking it.
+static int bladerf_io_begin(bladerf_device_t *dev) {
+    down_read(&dev->disconnect_sem);
+
+    if (dev->disconnecting) {
+        up_read(&dev->disconnect_sem);
+        return -ENODEV;
+    }
+
+    return 0;
+}
+
+static void bladerf_io_end(bladerf_device_t *dev) {
+    up_read(&dev->disconnect_sem);
+}
+
+// Reset a ring and start submitting transfers. The RF path is enabled
+// separately, via BLADE_USB_CMD_RF_RX/TX. Called with the ring's mutex held.
+static int ring_start(bladerf_device_t *dev, unsigned int dir) {
+    struct data_ring *r = ring(dev, dir);
+    struct bladerf_ring_ctrl *ctrl = dev->ctrl;
+    unsigned long flags;
+    int ret = 0;
+
+    if (dev->intnum != USB_IF_RF_LINK)
+        return -EINVAL;
+
+    if (dev->disconnecting)
+        return -ENODEV;
+
+    ret = ring_alloc(dev, r);
+    if (ret)
+        return ret;
+
+    spin_lock_irqsave(&r->lock, flags);
+
+    if (r->enabled) {
+        ret = -EBUSY;
+    } else {
+        r->submitted = 0;
+        r->done = 0;
+        r->stalled = 0;
+
+        memset(&r->stats, 0, sizeof(r->stats));
+        r->stats.dir = dir;
+
+        if (dir == BLADE_RING_RX) {
+            ctrl->rx_head = ctrl->rx_tail = 0;
+            ctrl->rx_wakeup = 0;
+            ctrl->rx_status = 0;
+        } else {
+            ctrl->tx_head = ctrl->tx_tail = 0;
+            ctrl->tx_wakeup = 0;
+            ctrl->tx_status = 0;
         }
 
-        dev->data_out_bufs[i].urb = urb;
-        dev->data_out_bufs[i].valid = 0;
+        r->enabled = 1;
 
-        usb_fill_bulk_urb(urb, dev->udev, usb_sndbulkpipe(dev->udev, 1),
-                dev->data_out_bufs[i].addr, DATA_BUF_SZ, __bladeRF_write_cb, dev);
+        if (dir == BLADE_RING_RX)
+            __submit_rx_urbs(dev);
+        else
+            __submit_tx_urbs(dev);
 
-        urb->transfer_flags |= URB_NO_TRANSFER_DMA_MAP;
-        urb->transfer_dma = dev->data_out_bufs[i].dma;
+        if (!r->enabled)
+            ret = dir == BLADE_RING_RX ? ctrl->rx_status : ctrl->tx_status;
     }
 
+    spin_unlock_irqrestore(&r->lock, flags);
+
+    return ret;
+}
+
+static void ring_stop(bladerf_device_t *dev, unsigned int dir) {
+    struct data_ring *r = ring(dev, dir);
+    unsigned long flags;
+
+    spin_lock_irqsave(&r->lock, flags);
+    r->enabled = 0;
+    __ring_unstall(r);
+    spin_unlock_irqrestore(&r->lock, flags);
+
+    usb_kill_anchored_urbs(&r->anchor);
+    wake_up_interruptible_all(&r->wait);
+}
+
+// Resume submitting transfers after userspace has advanced its index
+static void ring_kick(bladerf_device_t *dev, unsigned int dir) {
+    struct data_ring *r = ring(dev, dir);
+    unsigned long flags;
+
+    spin_lock_irqsave(&r->lock, flags);
+
+    if (dir == BLADE_RING_RX) {
+        WRITE_ONCE(dev->ctrl->rx_wakeup, 0);
+        __submit_rx_urbs(dev);
+    } else {
+        WRITE_ONCE(dev->ctrl->tx_wakeup, 0);
+        __submit_tx_urbs(dev);
+    }
+
+    spin_unlock_irqrestore(&r->lock, flags);
+}
+
+static int ring_set_eventfd(bladerf_device_t *dev, struct file *file,
+                            void __user *arg) {
+    struct bladerf_ring_eventfd req;
+    struct eventfd_ctx *ctx = NULL, *prev;
+    struct data_ring *r;
+    unsigned long flags;
+    int ret;
+
+    if (copy_from_user(&req, arg, sizeof(req)))
+        return -EFAULT;
+
+    if (req.dir != BLADE_RING_RX && req.dir != BLADE_RING_TX)
+        return -EINVAL;
+
+    r = ring(dev, req.dir);
+    ret = ring_claim(r, file);
+    if (ret)
+        return ret;
+
+    if (req.fd >= 0) {
+        ctx = eventfd_ctx_fdget(req.fd);
+        if (IS_ERR(ctx))
+            return PTR_ERR(ctx);
+    }
+
+    spin_lock_irqsave(&r->lock, flags);
+    prev = r->eventfd;
+    r->eventfd = ctx;
+    spin_unlock_irqrestore(&r->lock, flags);
+
+    if (prev)
+        eventfd_ctx_put(prev);
 
     return 0;
 }
 
-static void bladerf_stop(bladerf_device_t *dev) {
-    int i;
-    for (i = 0; i < NUM_DATA_URB; i++) {
-        usb_free_coherent(dev->udev, DATA_BUF_SZ, dev->data_in_bufs[i].addr, dev->data_in_bufs[i].dma);
-        usb_free_urb(dev->data_in_bufs[i].urb);
-        usb_free_coherent(dev->udev, DATA_BUF_SZ, dev->data_out_bufs[i].addr, dev->data_out_bufs[i].dma);
-        usb_free_urb(dev->data_out_bufs[i].urb);
+static int ring_configure(bladerf_device_t *dev, struct file *file,
+                          void __user *arg) {
+    struct bladerf_ring_config cfg;
+    struct data_ring *r;
+    int ret;
+
+    if (copy_from_user(&cfg, arg, sizeof(cfg)))
+        return -EFAULT;
+
+    if (cfg.dir != BLADE_RING_RX && cfg.dir != BLADE_RING_TX)
+        return -EINVAL;
+
+    r = ring(dev, cfg.dir);
+    ret = ring_claim(r, file);
+    if (ret)
+        return ret;
+
+    mutex_lock(&r->mutex);
+
+    if (r->enabled || atomic_read(&r->mapped)) {
+        ret = -EBUSY;
+        goto out;
     }
+
+    if (!cfg.num_buffers)
+        cfg.num_buffers = r->num_buffers;
+    if (!cfg.buffer_size)
+        cfg.buffer_size = r->buffer_size;
+    if (!cfg.num_concurrent)
+        cfg.num_concurrent = r->num_concurrent;
+
+    if (!is_power_of_2(cfg.num_buffers) || !is_power_of_2(cfg.buffer_size) ||
+        cfg.buffer_size < 1024 || cfg.buffer_size > BLADE_RING_MAX_BUF_SZ ||
+        cfg.num_buffers > BLADE_RING_MAX_SIZE / cfg.buffer_size ||
+        (size_t)cfg.num_buffers * cfg.buffer_size < PAGE_SIZE ||
+        cfg.num_concurrent > cfg.num_buffers) {
+        ret = -EINVAL;
+        goto out;
+    }
+
+    // The buffers are reallocated upon next use
+    if (cfg.num_buffers != r->num_buffers || cfg.buffer_size != r->buffer_size)
+        ring_free(r);
+
+    r->num_buffers = cfg.num_buffers;
+    r->buffer_size = cfg.buffer_size;
+    r->num_concurrent = cfg.num_concurrent;
+
+out:
+    mutex_unlock(&r->mutex);
+
+    if (!ret && copy_to_user(arg, &cfg, sizeof(cfg)))
+        ret = -EFAULT;
+
+    return ret;
+}
+
+static int ring_get_config(bladerf_device_t *dev, void __user *arg) {
+    struct bladerf_ring_config cfg;
+    struct data_ring *r;
+
+    if (copy_from_user(&cfg, arg, sizeof(cfg)))
+        return -EFAULT;
+
+    if (cfg.dir != BLADE_RING_RX && cfg.dir != BLADE_RING_TX)
+        return -EINVAL;
+
+    r = ring(dev, cfg.dir);
+
+    mutex_lock(&r->mutex);
+    cfg.num_buffers = r->num_buffers;
+    cfg.buffer_size = r->buffer_size;
+    cfg.num_concurrent = r->num_concurrent;
+    mutex_unlock(&r->mutex);
+
+    return copy_to_user(arg, &cfg, sizeof(cfg)) ? -EFAULT : 0;
+}
+
+static void ring_get_stats(bladerf_device_t *dev, unsigned int dir,
+                           struct bladerf_ring_stats *stats) {
+    struct data_ring *r = ring(dev, dir);
+    unsigned long flags;
+
+    spin_lock_irqsave(&r->lock, flags);
+
+    *stats = r->stats;
+
+    // Include the stall in progress
+    if (r->stalled)
+        stats->stall_ns += ktime_to_ns(ktime_sub(ktime_get(), r->stall_start));
+
+    spin_unlock_irqrestore(&r->lock, flags);
+}
+
+static int ring_copy_stats(bladerf_device_t *dev, void __user *arg) {
+    struct bladerf_ring_stats stats;
+    unsigned int dir;
+
+    if (get_user(dir, (unsigned int __user *)arg))
+        return -EFAULT;
+
+    if (dir != BLADE_RING_RX && dir != BLADE_RING_TX)
+        return -EINVAL;
+
+    ring_get_stats(dev, dir, &stats);
+
+    return copy_to_user(arg, &stats, sizeof(stats)) ? -EFAULT : 0;
 }
 
 int __bladerf_snd_cmd(bladerf_device_t *dev, int cmd, void *ptr, __u16 len);
@@ -252,9 +717,7 @@ static int disable_tx(bladerf_device_t *dev) {
     if (dev->intnum != 1)
         return -1;
 
-    dev->tx_en = 0;
-
-    usb_kill_anchored_urbs(&dev->data_out_anchor);
+    ring_stop(dev, BLADE_RING_TX);
 
     ret = __bladerf_snd_cmd(dev, BLADE_USB_CMD_RF_TX, &val, sizeof(val));
     if (ret < 0)
@@ -278,8 +741,7 @@ static int enable_tx(bladerf_device_t *dev) {
     if (ret < 0)
         goto err_out;
 
-    ret = 0;
-    dev->tx_en = 1;
+    ret = ring_start(dev, BLADE_RING_TX);
 
 err_out:
     return ret;
@@ -293,19 +755,13 @@ static int disable_rx(bladerf_device_t *dev) {
     if (dev->intnum != 1)
         return -1;
 
-    dev->rx_en = 0;
-
-    usb_kill_anchored_urbs(&dev->data_in_anchor);
+    ring_stop(dev, BLADE_RING_RX);
 
     ret = __bladerf_snd_cmd(dev, BLADE_USB_CMD_RF_RX, &val, sizeof(val));
     if (ret < 0)
         goto err_out;
 
     ret = 0;
-    atomic_set(&dev->data_in_queued, 0);
-    atomic_set(&dev->data_in_used, 0);
-    dev->data_in_consumer_idx = 0;
-    dev->data_in_producer_idx = 0;
 
 err_out:
     return ret;
@@ -313,7 +769,6 @@ err_out:
 
 static int enable_rx(bladerf_device_t *dev) {
     int ret;
-    int i;
     unsigned int val;
     val = 1;
 
@@ -323,190 +778,210 @@ static int enable_rx(bladerf_device_t *dev) {
     if (dev->disconnecting)
         return -ENODEV;
 
-    for (i = 0; i < NUM_DATA_URB; i++)
-        dev->data_in_bufs[i].valid = 1;
-
     ret = __bladerf_snd_cmd(dev, BLADE_USB_CMD_RF_RX, &val, sizeof(val));
     if (ret < 0)
         goto err_out;
 
-    ret = 0;
-    dev->rx_en = 1;
-
-    for (i = 0; i < NUM_CONCURRENT; i++) {
-        if ((ret = __submit_rx_urb(dev, 0)) < 0) {
-            dev_err(&dev->interface->dev, "Error submitting initial RX URBs (%d/%d), error=%d\n", i, NUM_CONCURRENT, ret);
-            break;
-        }
+    ret = ring_start(dev, BLADE_RING_RX);
+    if (ret) {
+        dev_err(&dev->interface->dev, "Error submitting initial RX URBs, error=%d\n", ret);
     }
 
 err_out:
     return ret;
 }
 
-static ssize_t bladerf_read(struct file *file, char __user *buf, size_t count, loff_t *ppos)
-{
-    ssize_t ret = 0;
-    bladerf_device_t *dev;
-    unsigned long flags;
+// read() and write() copy as many whole buffers as fit in the request, and
+// accept vectors, through the ring. Applications that map the ring with mmap()
+// access the buffers directly.
+//
+// Once any buffers have been transferred, or if the file is non-blocking,
+// they return rather than wait for more. A direction that is not yet enabled
+// is enabled on the first blocking call, which issues control transfers.
+// Non-blocking callers (O_NONBLOCK or IOCB_NOWAIT) get -EAGAIN instead, and
+// must enable it with BLADE_RF_RX/TX and BLADE_RING_START, or retry without
+// IOCB_NOWAIT, as io_uring does.
+
+static int ring_nowait(struct kiocb *iocb) {
+#ifdef IOCB_NOWAIT
+    if (iocb->ki_flags & IOCB_NOWAIT)
+        return 1;
+#endif
+    return iocb->ki_filp->f_flags & O_NONBLOCK;
+}
 
-    dev = (bladerf_device_t *)file->private_data;
-    if (dev->intnum != 1) {
-        return -1;
-    }
+// Acquire the ring's mutex for read() or write()
+static int ring_lock_io(struct data_ring *r, struct kiocb *iocb) {
+#ifdef IOCB_NOWAIT
+    if (iocb->ki_flags & IOCB_NOWAIT)
+        return mutex_trylock(&r->mutex) ? 0 : -EAGAIN;
+#endif
+    return mutex_lock_interruptible(&r->mutex) ? -ERESTARTSYS : 0;
+}
 
-    if (dev->reader) {
-        if (file != dev->reader) {
-            return -EPERM;
-        }
-    } else
-        dev->reader = file;
+// Status of a non-blocking read() or write() on a direction that is not
+// enabled: the error that stopped it, if any, or -EAGAIN
+static int ring_nowait_status(bladerf_device_t *dev, unsigned int dir) {
+    int status;
 
     if (dev->disconnecting)
         return -ENODEV;
 
-    if (!dev->rx_en) {
-        if (enable_rx(dev)) {
-            return -EINVAL;
-        }
-    }
+    if (dir == BLADE_RING_RX)
+        status = READ_ONCE(dev->ctrl->rx_status);
+    else
+        status = READ_ONCE(dev->ctrl->tx_status);
 
-    do {
-        spin_lock_irqsave(&dev->data_in_lock, flags);
-        if (atomic_read(&dev->data_in_queued)) {
-            unsigned int idx;
+    return status ? status : -EAGAIN;
+}
 
-            atomic_dec(&dev->data_in_queued);
-            atomic_dec(&dev->data_in_used);
-            idx = dev->data_in_consumer_idx++;
-            dev->data_in_consumer_idx &= (NUM_DATA_URB - 1);
+// Enable a direction for read() or write(), if it is not already enabled
+static int ring_enable_io(bladerf_device_t *dev, unsigned int dir) {
+    struct data_ring *r = ring(dev, dir);
+    int ret;
 
-            spin_unlock_irqrestore(&dev->data_in_lock, flags);
+    ret = bladerf_io_begin(dev);
+    if (ret)
+        return ret;
 
-            if (copy_to_user(buf, dev->data_in_bufs[idx].addr, DATA_BUF_SZ)) {
-                ret = -EFAULT;
-            } else {
-                ret = 0;
-            }
+    if (mutex_lock_interruptible(&r->mutex)) {
+        ret = -ERESTARTSYS;
+    } else {
+        if (!r->enabled)
+            ret = dir == BLADE_RING_RX ? enable_rx(dev) : enable_tx(dev);
+        mutex_unlock(&r->mutex);
+    }
 
-            dev->data_in_bufs[idx].valid = 1; // mark this RX packet as free
+    bladerf_io_end(dev);
+    return ret;
+}
 
-            // in case all of the buffers were full, rx needs to be restarted
-            // samples may have also been dropped if this happens because the user-mode
-            // application is not reading samples fast enough
+static ssize_t bladerf_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+    struct file *file = iocb->ki_filp;
+    bladerf_device_t *dev = (bladerf_device_t *)file->private_data;
+    struct data_ring *r = &dev->rx;
+    unsigned int head, tail, n, i;
+    size_t len;
+    ssize_t copied = 0;
+    int ret;
 
-            if (atomic_read(&dev->data_in_inflight) == 0)
-                __submit_rx_urb(dev, 0);
+    if (dev->intnum != 1) {
+        return -1;
+    }
 
-            if (!ret)
-                ret = DATA_BUF_SZ;
+    ret = ring_claim(r, file);
+    if (ret)
+        return ret;
 
-            break;
+    if (!READ_ONCE(r->enabled)) {
+        if (ring_nowait(iocb))
+            return ring_nowait_status(dev, BLADE_RING_RX);
 
-        } else {
-            spin_unlock_irqrestore(&dev->data_in_lock, flags);
-            ret = wait_event_interruptible(dev->data_in_wait, atomic_read(&dev->data_in_queued));
-            spin_lock_irqsave(&dev->data_in_lock, flags);
-            if (ret < 0) {
-                break;
-            } else if (ret == 0) {
-                ret = -ETIMEDOUT;
-                break;
-            } else {
-                ret = 0;
-            }
-        }
-    } while (1);
-    spin_unlock_irqrestore(&dev->data_in_lock, flags);
+        ret = ring_enable_io(dev, BLADE_RING_RX);
+        if (ret)
+            return ret;
+    }
 
-    return ret;
-}
+    ret = ring_lock_io(r, iocb);
+    if (ret)
+        return ret;
 
-static int __submit_tx_urb(bladerf_device_t *dev) {
-    struct urb *urb;
-    struct data_buffer *db;
-    unsigned long flags;
+    if (iov_iter_count(to) < r->buffer_size) {
+        ret = -EINVAL;
+        goto out;
+    }
 
-    int ret = 0;
+    if (dev->disconnecting) {
+        ret = -ENODEV;
+        goto out;
+    }
 
-    do {
-        spin_lock_irqsave(&dev->data_out_lock, flags);
-        if (atomic_read(&dev->data_out_inflight) < NUM_CONCURRENT && atomic_read(&dev->data_out_queued)) {
-            db = &dev->data_out_bufs[dev->data_out_consumer_idx];
-            urb = db->urb;
+    while (iov_iter_count(to) >= r->buffer_size) {
+        tail = dev->ctrl->rx_tail;
+        head = smp_load_acquire(&dev->ctrl->rx_head);
 
-            if (!db->valid) {
-                // if it is not yet valid, it will be when bladerf_write calls __submit_tx_urb
+        if (head == tail) {
+            if (copied)
                 break;
-            }
-
-            // clear this packet's valid flag so it is not submitted until the next time it
-            // is used and copy_from_user() has copied data into the buffer
-            db->valid = 0;
-            dev->data_out_consumer_idx++;
-            dev->data_out_consumer_idx &= (NUM_DATA_URB - 1);
-
-            atomic_dec(&dev->data_out_queued);
 
-            usb_anchor_urb(urb, &dev->data_out_anchor);
-            atomic_inc(&dev->data_out_inflight);
-            spin_unlock_irqrestore(&dev->data_out_lock, flags);
+            if (!r->enabled || dev->disconnecting) {
+                if (dev->disconnecting)
+                    ret = -ENODEV;
+                else
+                    ret = READ_ONCE(dev->ctrl->rx_status) ? : -EIO;
+                goto out;
+            }
 
-            ret = usb_submit_urb(urb, GFP_ATOMIC);
-            if (ret) {
-                atomic_dec(&dev->data_out_inflight);
-                goto leave_tx;
+            if (ring_nowait(iocb)) {
+                ret = -EAGAIN;
+                goto out;
             }
-        } else break;
-    } while (1);
-    spin_unlock_irqrestore(&dev->data_out_lock, flags);
-leave_tx:
 
-    return ret;
-}
+            ret = wait_event_interruptible(r->wait,
+                    smp_load_acquire(&dev->ctrl->rx_head) != tail ||
+                    !r->enabled || dev->disconnecting);
+            if (ret < 0)
+                goto out;
 
-static void __bladeRF_write_cb(struct urb *urb)
-{
-    bladerf_device_t *dev;
-    unsigned long flags;
+            continue;
+        }
 
-    dev = (bladerf_device_t *)urb->context;
+        n = min_t(size_t, head - tail, iov_iter_count(to) / r->buffer_size);
 
-    usb_unanchor_urb(urb);
+        for (i = 0; i < n; i++) {
+            len = copy_to_iter(r->bufs[(tail + i) % r->num_buffers].addr,
+                               r->buffer_size, to);
+            copied += len;
+            if (len != r->buffer_size)
+                break;
+        }
 
-    spin_lock_irqsave(&dev->data_out_lock, flags);
+        // Return only whole buffers. A partially copied buffer is
+        // delivered again by the next read.
+        if (i < n) {
+            copied -= len;
+            if (!copied)
+                ret = -EFAULT;
+        }
 
-    atomic_dec(&dev->data_out_inflight);
-    atomic_dec(&dev->data_out_used);
+        smp_store_release(&dev->ctrl->rx_tail, tail + i);
+        smp_mb();
+        if (READ_ONCE(dev->ctrl->rx_wakeup))
+            ring_kick(dev, BLADE_RING_RX);
 
-    spin_unlock_irqrestore(&dev->data_out_lock, flags);
+        if (i < n)
+            break;
+    }
 
-    if (dev->tx_en)
-        __submit_tx_urb(dev);
-    dev->bytes += DATA_BUF_SZ;
-    wake_up_interruptible(&dev->data_out_wait);
+out:
+    mutex_unlock(&r->mutex);
+    return copied ? copied : ret;
 }
 
-static ssize_t bladerf_write(struct file *file, const char *user_buf, size_t count, loff_t *ppos)
+static ssize_t bladerf_write_iter(struct kiocb *iocb, struct iov_iter *from)
 {
-    bladerf_device_t *dev;
-    unsigned long flags;
+    struct file *file = iocb->ki_filp;
+    bladerf_device_t *dev = (bladerf_device_t *)file->private_data;
+    struct data_ring *r = &dev->tx;
+    const size_t count = iov_iter_count(from);
+    unsigned int head, tail, n, i;
+    size_t len;
+    ssize_t written = 0;
     char *buf = NULL;
-    struct data_buffer *db = NULL;
-    unsigned int idx;
-    int reread;
     int status = 0;
 
-    /* TODO truncate count to be within range of ssize_t here? */
-
-    dev = (bladerf_device_t *)file->private_data;
-
     // special exception for loading FPGA
     if (dev->intnum == 0) {
         int llen;
+
+        status = bladerf_io_begin(dev);
+        if (status)
+            return status;
+
         buf = (char *)kmalloc(count, GFP_KERNEL);
         if (buf) {
-            if (copy_from_user(buf, user_buf, count)) {
+            if (copy_from_iter(buf, count, from) != count) {
                 status = -EFAULT;
             } else {
                 status = usb_bulk_msg(dev->udev, usb_sndbulkpipe(dev->udev, 2), buf, count, &llen, BLADE_USB_TIMEOUT_MS);
@@ -517,51 +992,299 @@ static ssize_t bladerf_write(struct file *file, const char *user_buf, size_t cou
             status = -ENOMEM;
         }
 
+        bladerf_io_end(dev);
+
         if (status < 0)
             return status;
         else
             return llen;
     }
 
-    if (dev->writer) {
-        if (file != dev->writer) {
-            return -EPERM;
-        }
-    } else
-        dev->writer = file;
+    status = ring_claim(r, file);
+    if (status)
+        return status;
 
-    reread = atomic_read(&dev->data_out_used);
-    if (reread >= NUM_DATA_URB) {
-        status = wait_event_interruptible(dev->data_out_wait, atomic_read(&dev->data_out_used) < NUM_DATA_URB);
+    if (!READ_ONCE(r->enabled)) {
+        if (ring_nowait(iocb))
+            return ring_nowait_status(dev, BLADE_RING_TX);
 
-        if (status < 0) {
+        status = ring_enable_io(dev, BLADE_RING_TX);
+        if (status)
             return status;
-        } else if (status == 0) {
-            return -ETIMEDOUT;
+    }
+
+    status = ring_lock_io(r, iocb);
+    if (status)
+        return status;
+
+    if (count == 0 || count % r->buffer_size) {
+        status = -EINVAL;
+        goto out;
+    }
+
+    if (dev->disconnecting) {
+        status = -ENODEV;
+        goto out;
+    }
+
+    while (iov_iter_count(from) != 0) {
+        head = dev->ctrl->tx_head;
+        tail = smp_load_acquire(&dev->ctrl->tx_tail);
+
+        if (dev->disconnecting) {
+            status = -ENODEV;
+            goto out;
+        }
+
+        if (!r->enabled) {
+            status = READ_ONCE(dev->ctrl->tx_status) ? : -EIO;
+            goto out;
+        }
+
+        if (head - tail == r->num_buffers) {
+            if (written)
+                break;
+
+            if (ring_nowait(iocb)) {
+                status = -EAGAIN;
+                goto out;
+            }
+
+            status = wait_event_interruptible(r->wait,
+                    head - smp_load_acquire(&dev->ctrl->tx_tail) < r->num_buffers ||
+                    !r->enabled || dev->disconnecting);
+            if (status < 0)
+                goto out;
+
+            continue;
+        }
+
+        n = min_t(size_t, r->num_buffers - (head - tail),
+                  iov_iter_count(from) / r->buffer_size);
+
+        for (i = 0; i < n; i++) {
+            len = copy_from_iter(r->bufs[(head + i) % r->num_buffers].addr,
+                                 r->buffer_size, from);
+            written += len;
+            if (len != r->buffer_size)
+                break;
         }
+
+        // Send only whole buffers
+        if (i < n) {
+            written -= len;
+            if (!written)
+                status = -EFAULT;
+        }
+
+        smp_store_release(&dev->ctrl->tx_head, head + i);
+        smp_mb();
+        if (READ_ONCE(dev->ctrl->tx_wakeup))
+            ring_kick(dev, BLADE_RING_TX);
+
+        if (i < n)
+            break;
+    }
+
+out:
+    mutex_unlock(&r->mutex);
+    return written ? written : status;
+}
+
+static __poll_t bladerf_poll(struct file *file, poll_table *wait)
+{
+    bladerf_device_t *dev = (bladerf_device_t *)file->private_data;
+    struct bladerf_ring_ctrl *ctrl = dev->ctrl;
+    __poll_t mask = 0;
+
+    poll_wait(file, &dev->rx.wait, wait);
+    poll_wait(file, &dev->tx.wait, wait);
+
+    if (dev->disconnecting)
+        return POLLERR | POLLHUP;
+
+    if (smp_load_acquire(&ctrl->rx_head) != READ_ONCE(ctrl->rx_tail))
+        mask |= POLLIN | POLLRDNORM;
+
+    if (READ_ONCE(ctrl->tx_head) - smp_load_acquire(&ctrl->tx_tail) < READ_ONCE(dev->tx.num_buffers))
+        mask |= POLLOUT | POLLWRNORM;
+
+    if (READ_ONCE(ctrl->rx_status) || READ_ONCE(ctrl->tx_status))
+        mask |= POLLERR;
+
+    return mask;
+}
+
+// Track mappings of a ring's buffers, which may not be reallocated while
+// they are mapped. The file, and hence the device, outlives its mappings.
+static void ring_vm_open(struct vm_area_struct *vma)
+{
+    struct data_ring *r = vma->vm_private_data;
+    atomic_inc(&r->mapped);
+}
+
+static void ring_vm_close(struct vm_area_struct *vma)
+{
+    struct data_ring *r = vma->vm_private_data;
+    atomic_dec(&r->mapped);
+}
+
+static const struct vm_operations_struct ring_vm_ops = {
+    .open   = ring_vm_open,
+    .close  = ring_vm_close,
+};
+
+// Map the ring's control page or one direction's sample buffers, selected by
+// the offset. See struct bladerf_ring_ctrl.
+static int bladerf_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    bladerf_device_t *dev = (bladerf_device_t *)file->private_data;
+    const unsigned long offset = vma->vm_pgoff << PAGE_SHIFT;
+    const unsigned long size = vma->vm_end - vma->vm_start;
+    struct data_ring *r;
+    unsigned int i;
+    int ret;
+
+    if (dev->disconnecting)
+        return -ENODEV;
+
+    if (offset == BLADE_RING_CTRL_OFFSET) {
+        if (size != PAGE_SIZE)
+            return -EINVAL;
+
+        return vm_insert_page(vma, vma->vm_start, virt_to_page(dev->ctrl));
+    } else if (offset == BLADE_RING_RX_OFFSET) {
+        r = &dev->rx;
+    } else if (offset == BLADE_RING_TX_OFFSET) {
+        r = &dev->tx;
+    } else {
+        return -EINVAL;
+    }
+
+    ret = ring_claim(r, file);
+    if (ret)
+        return ret;
+
+    mutex_lock(&r->mutex);
+
+    ret = ring_alloc(dev, r);
+    if (ret)
+        goto out;
+
+    if (size != (unsigned long)r->num_pages << PAGE_SHIFT) {
+        ret = -EINVAL;
+        goto out;
+    }
+
+    for (i = 0; i < r->num_pages; i++) {
+        ret = vm_insert_page(vma, vma->vm_start + ((unsigned long)i << PAGE_SHIFT), r->pages[i]);
+        if (ret)
+            goto out;
     }
 
-    spin_lock_irqsave(&dev->data_out_lock, flags);
+    vma->vm_private_data = r;
+    vma->vm_ops = &ring_vm_ops;
+    ring_vm_open(vma);
 
-    idx = dev->data_out_producer_idx++;
-    dev->data_out_producer_idx &= (NUM_DATA_URB - 1);
-    db = &dev->data_out_bufs[idx];
-    atomic_inc(&dev->data_out_queued);
-    atomic_inc(&dev->data_out_used);
+out:
+    mutex_unlock(&r->mutex);
+    return ret;
+}
 
-    spin_unlock_irqrestore(&dev->data_out_lock, flags);
+static int bladerf_ctrl_transfer(bladerf_device_t *dev, void __user *arg)
+{
+    struct bladerf_ctrl_transfer xfer;
+    void __user *data;
+    void *buf = NULL;
+    unsigned int pipe;
+    int dir_in;
+    int ret;
 
-    if (copy_from_user(db->addr, user_buf, count)) {
+    if (copy_from_user(&xfer, arg, sizeof(xfer)))
         return -EFAULT;
+
+    data = (void __user *)(uintptr_t)xfer.data;
+    dir_in = xfer.request_type & USB_DIR_IN;
+
+    // Requests such as SET_INTERFACE must go through the USB core
+    if ((xfer.request_type & USB_TYPE_MASK) == USB_TYPE_STANDARD && !dir_in)
+        return -EINVAL;
+
+    if (xfer.length) {
+        buf = kmalloc(xfer.length, GFP_KERNEL);
+        if (!buf)
+            return -ENOMEM;
+
+        if (!dir_in && copy_from_user(buf, data, xfer.length)) {
+            ret = -EFAULT;
+            goto out;
+        }
     }
 
-    db->valid = 1; // mark this TX packet as having valid data
+    pipe = dir_in ? usb_rcvctrlpipe(dev->udev, 0) : usb_sndctrlpipe(dev->udev, 0);
+    ret = usb_control_msg(dev->udev, pipe, xfer.request, xfer.request_type,
+            xfer.value, xfer.index, buf, xfer.length, xfer.timeout_ms);
 
-    __submit_tx_urb(dev);
-    if (!dev->tx_en)
-        enable_tx(dev);
+    if (ret > 0 && dir_in && copy_to_user(data, buf, ret))
+        ret = -EFAULT;
 
-    return count;
+out:
+    kfree(buf);
+    return ret;
+}
+
+static int bladerf_bulk_transfer(bladerf_device_t *dev, void __user *arg)
+{
+    struct bladerf_bulk_transfer xfer;
+    void __user *data;
+    unsigned int pipe, len, done = 0;
+    int dir_in, actual;
+    void *buf;
+    int ret = 0;
+
+    if (copy_from_user(&xfer, arg, sizeof(xfer)))
+        return -EFAULT;
+
+    // The sample endpoints belong to the rings
+    if ((xfer.endpoint & USB_ENDPOINT_NUMBER_MASK) == 1)
+        return -EINVAL;
+
+    if (xfer.length == 0)
+        return 0;
+
+    data = (void __user *)(uintptr_t)xfer.data;
+    dir_in = xfer.endpoint & USB_DIR_IN;
+    pipe = dir_in ? usb_rcvbulkpipe(dev->udev, xfer.endpoint & USB_ENDPOINT_NUMBER_MASK)
+                  : usb_sndbulkpipe(dev->udev, xfer.endpoint & USB_ENDPOINT_NUMBER_MASK);
+
+    buf = kmalloc(min_t(unsigned int, xfer.length, BULK_CHUNK_SZ), GFP_KERNEL);
+    if (!buf)
+        return -ENOMEM;
+
+    while (done < xfer.length) {
+        len = min_t(unsigned int, xfer.length - done, BULK_CHUNK_SZ);
+
+        if (!dir_in && copy_from_user(buf, data + done, len)) {
+            ret = -EFAULT;
+            break;
+        }
+
+        ret = usb_bulk_msg(dev->udev, pipe, buf, len, &actual, xfer.timeout_ms);
+        if (ret)
+            break;
+
+        if (dir_in && copy_to_user(data + done, buf, actual)) {
+            ret = -EFAULT;
+            break;
+        }
+
+        done += actual;
+        if (actual < len)
+            break;
+    }
+
+    kfree(buf);
+    return ret ? ret : done;
 }
 
 
@@ -673,6 +1396,9 @@ long bladerf_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
     dev = file->private_data;
     data = (void __user *)arg;
 
+    ret = bladerf_io_begin(dev);
+    if (ret)
+        return ret;
 
     switch (cmd) {
         case BLADE_QUERY_VERSION:
@@ -1142,8 +1868,67 @@ leave_fw:
             }
             break;
 
+        case BLADE_SET_INTERFACE:
+            if ((dev->rx.enabled || dev->tx.enabled) && arg != USB_IF_RF_LINK) {
+                retval = -EBUSY;
+                break;
+            }
+
+            retval = usb_set_interface(dev->udev, 0, arg);
+            if (!retval)
+                dev->intnum = arg;
+            break;
+
+        case BLADE_CONTROL_TRANSFER:
+            retval = bladerf_ctrl_transfer(dev, data);
+            break;
+
+        case BLADE_BULK_TRANSFER:
+            retval = bladerf_bulk_transfer(dev, data);
+            break;
+
+        case BLADE_RING_START:
+        case BLADE_RING_STOP:
+        case BLADE_RING_KICK:
+            if (arg != BLADE_RING_RX && arg != BLADE_RING_TX) {
+                retval = -EINVAL;
+                break;
+            }
+
+            retval = ring_claim(ring(dev, arg), file);
+            if (retval)
+                break;
+
+            if (cmd == BLADE_RING_START) {
+                mutex_lock(&ring(dev, arg)->mutex);
+                retval = ring_start(dev, arg);
+                mutex_unlock(&ring(dev, arg)->mutex);
+            } else if (cmd == BLADE_RING_STOP) {
+                ring_stop(dev, arg);
+            } else {
+                ring_kick(dev, arg);
+            }
+            break;
+
+        case BLADE_RING_SET_EVENTFD:
+            retval = ring_set_eventfd(dev, file, data);
+            break;
+
+        case BLADE_RING_CONFIGURE:
+            retval = ring_configure(dev, file, data);
+            break;
+
+        case BLADE_RING_GET_CONFIG:
+            retval = ring_get_config(dev, data);
+            break;
+
+        case BLADE_RING_GET_STATS:
+            retval = ring_copy_stats(dev, data);
+            break;
     }
 
+    bladerf_io_end(dev);
+
     return retval;
 }
 
@@ -1166,39 +1951,80 @@ static int bladerf_open(struct inode *inode, struct file *file)
         return -ENODEV;
     }
 
+    // released in bladerf_release(), which may follow a disconnect
+    kref_get(&dev->kref);
+
     file->private_data = dev;
 
+#ifdef FMODE_NOWAIT
+    // read_iter() and write_iter() honor IOCB_NOWAIT, for io_uring
+    file->f_mode |= FMODE_NOWAIT;
+#endif
+
     return 0;
 }
 
-static int bladerf_release(struct inode *inode, struct file *file)
+static void ring_release(bladerf_device_t *dev, unsigned int dir, struct file *file)
 {
-    bladerf_device_t *dev;
+    struct data_ring *r = ring(dev, dir);
+    struct eventfd_ctx *ctx;
+    unsigned long flags;
 
-    dev = (bladerf_device_t *)file->private_data;
+    if (r->owner != file)
+        return;
 
-    if (dev->writer && dev->writer == file) {
-        if (dev->tx_en) {
+    if (r->enabled && !bladerf_io_begin(dev)) {
+        if (dir == BLADE_RING_TX) {
             disable_tx(dev);
-        }
-        dev->writer = NULL;
-    }
-
-    if (dev->reader && dev->reader == file) {
-        if (dev->rx_en) {
+        } else {
             disable_rx(dev);
         }
-        dev->reader = NULL;
+
+        bladerf_io_end(dev);
     }
 
+    // in case the RF link interface is no longer selected
+    ring_stop(dev, dir);
+
+    spin_lock_irqsave(&r->lock, flags);
+    ctx = r->eventfd;
+    r->eventfd = NULL;
+    spin_unlock_irqrestore(&r->lock, flags);
+
+    if (ctx)
+        eventfd_ctx_put(ctx);
+
+    // The configuration belongs to the owner. Nothing maps the buffers
+    // anymore, as mappings hold a reference to the file.
+    mutex_lock(&r->mutex);
+    ring_free(r);
+    ring_set_defaults(r);
+    mutex_unlock(&r->mutex);
+
+    r->owner = NULL;
+}
+
+static int bladerf_release(struct inode *inode, struct file *file)
+{
+    bladerf_device_t *dev;
+
+    dev = (bladerf_device_t *)file->private_data;
+
+    ring_release(dev, BLADE_RING_TX, file);
+    ring_release(dev, BLADE_RING_RX, file);
+
+    kref_put(&dev->kref, bladerf_delete);
+
     return 0;
 }
 
 static struct file_operations bladerf_fops = {
     .owner    =  THIS_MODULE,
-    .read     =  bladerf_read,
-    .write    =  bladerf_write,
+    .read_iter  =  bladerf_read_iter,
+    .write_iter =  bladerf_write_iter,
     .unlocked_ioctl = bladerf_ioctl,
+    .poll     =  bladerf_poll,
+    .mmap     =  bladerf_mmap,
     .open     =  bladerf_open,
     .release  =  bladerf_release,
 };
@@ -1209,6 +2035,64 @@ static struct usb_class_driver bladerf_class = {
     .minor_base = USB_NUAND_BLADERF_MINOR_BASE,
 };
 
+// Ring statistics, exported as {rx,tx}_<field> on the USB interface.
+// See struct bladerf_ring_stats.
+static ssize_t ring_stat_show(struct device *d, char *buf, unsigned int dir,
+                              size_t offset)
+{
+    bladerf_device_t *dev = usb_get_intfdata(to_usb_interface(d));
+    struct bladerf_ring_stats stats;
+
+    if (!dev)
+        return -ENODEV;
+
+    ring_get_stats(dev, dir, &stats);
+
+    return sprintf(buf, "%llu\n", *(unsigned long long *)((char *)&stats + offset));
+}
+
+#define RING_STAT_ATTR(prefix, dir, field) \
+    static ssize_t prefix##_##field##_show(struct device *d, \
+            struct device_attribute *attr, char *buf) \
+    { \
+        return ring_stat_show(d, buf, dir, \
+                              offsetof(struct bladerf_ring_stats, field)); \
+    } \
+    static DEVICE_ATTR_RO(prefix##_##field)
+
+RING_STAT_ATTR(rx, BLADE_RING_RX, transfers);
+RING_STAT_ATTR(rx, BLADE_RING_RX, bytes);
+RING_STAT_ATTR(rx, BLADE_RING_RX, short_transfers);
+RING_STAT_ATTR(rx, BLADE_RING_RX, stalls);
+RING_STAT_ATTR(rx, BLADE_RING_RX, stall_ns);
+RING_STAT_ATTR(rx, BLADE_RING_RX, throttled);
+RING_STAT_ATTR(tx, BLADE_RING_TX, transfers);
+RING_STAT_ATTR(tx, BLADE_RING_TX, bytes);
+RING_STAT_ATTR(tx, BLADE_RING_TX, short_transfers);
+RING_STAT_ATTR(tx, BLADE_RING_TX, stalls);
+RING_STAT_ATTR(tx, BLADE_RING_TX, stall_ns);
+RING_STAT_ATTR(tx, BLADE_RING_TX, throttled);
+
+static struct attribute *bladerf_attrs[] = {
+    &dev_attr_rx_transfers.attr,
+    &dev_attr_rx_bytes.attr,
+    &dev_attr_rx_short_transfers.attr,
+    &dev_attr_rx_stalls.attr,
+    &dev_attr_rx_stall_ns.attr,
+    &dev_attr_rx_throttled.attr,
+    &dev_attr_tx_transfers.attr,
+    &dev_attr_tx_bytes.attr,
+    &dev_attr_tx_short_transfers.attr,
+    &dev_attr_tx_stalls.attr,
+    &dev_attr_tx_stall_ns.attr,
+    &dev_attr_tx_throttled.attr,
+    NULL
+};
+
+static const struct attribute_group bladerf_attr_group = {
+    .attrs = bladerf_attrs,
+};
+
 static int bladerf_probe(struct usb_interface *interface,
         const struct usb_device_id *id)
 {
@@ -1224,38 +2108,45 @@ static int bladerf_probe(struct usb_interface *interface,
     }
 
 
-    spin_lock_init(&dev->data_in_lock);
-    spin_lock_init(&dev->data_out_lock);
     dev->udev = usb_get_dev(interface_to_usbdev(interface));
-    dev->interface = interface;
+    dev->interface = usb_get_intf(interface);
     dev->intnum = 0;
     dev->bytes = 0;
     dev->debug = 0;
     dev->disconnecting = 0;
+    init_rwsem(&dev->disconnect_sem);
+    kref_init(&dev->kref);
 
-    atomic_set(&dev->data_in_inflight, 0);
-    atomic_set(&dev->data_out_inflight, 0);
+    BUILD_BUG_ON(sizeof(struct bladerf_ring_ctrl) > PAGE_SIZE);
 
-    init_usb_anchor(&dev->data_in_anchor);
-    init_waitqueue_head(&dev->data_in_wait);
-
-    init_usb_anchor(&dev->data_out_anchor);
-    init_waitqueue_head(&dev->data_out_wait);
-
-    bladerf_start(dev);
+    retval = bladerf_start(dev);
+    if (retval)
+        goto error;
 
     usb_set_intfdata(interface, dev);
 
+    retval = sysfs_create_group(&interface->dev.kobj, &bladerf_attr_group);
+    if (retval) {
+        dev_err(&interface->dev, "Unable to create sysfs attributes\n");
+        goto error_intfdata;
+    }
+
     retval = usb_register_dev(interface, &bladerf_class);
     if (retval) {
         dev_err(&interface->dev, "Unable to get a minor device number for bladeRF device\n");
-        usb_set_intfdata(interface, NULL);
-        return retval;
+        sysfs_remove_group(&interface->dev.kobj, &bladerf_attr_group);
+        goto error_intfdata;
     }
 
     dev_info(&interface->dev, "Nuand bladeRF device is now attached\n");
     return 0;
 
+error_intfdata:
+    usb_set_intfdata(interface, NULL);
+error:
+    kref_put(&dev->kref, bladerf_delete);
+    return retval;
+
 error_oom:
     return -ENOMEM;
 }
@@ -1268,24 +2159,24 @@ static void bladerf_disconnect(struct usb_interface *interface)
 
     dev = usb_get_intfdata(interface);
 
-    dev->disconnecting = 1;
-    dev->tx_en = 0;
-    dev->rx_en = 0;
-
-    usb_kill_anchored_urbs(&dev->data_out_anchor);
-    usb_kill_anchored_urbs(&dev->data_in_anchor);
+    // prevent new opens and waits for pending sysfs reads
+    usb_deregister_dev(interface, &bladerf_class);
+    sysfs_remove_group(&interface->dev.kobj, &bladerf_attr_group);
 
-    bladerf_stop(dev);
+    // wait for device I/O in progress, and prevent any more
+    down_write(&dev->disconnect_sem);
+    dev->disconnecting = 1;
+    up_write(&dev->disconnect_sem);
 
-    usb_deregister_dev(interface, &bladerf_class);
+    ring_stop(dev, BLADE_RING_TX);
+    ring_stop(dev, BLADE_RING_RX);
 
     usb_set_intfdata(interface, NULL);
 
-    usb_put_dev(dev->udev);
-
     dev_info(&interface->dev, "Nuand bladeRF device has been disconnected\n");
 
-    kfree(dev);
+    // Files that remain open hold their own references
+    kref_put(&dev->kref, bladerf_delete);
 }
 
 static struct usb_driver bladerf_driver = {
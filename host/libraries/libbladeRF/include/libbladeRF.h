@@ -114,6 +114,9 @@ typedef enum {
     BLADERF_BACKEND_LIBUSB, /**< libusb */
     BLADERF_BACKEND_CYPRESS, /**< CyAPI */
     BLADERF_BACKEND_DUMMY = 100, /**< Dummy used for development purposes */
+    BLADERF_BACKEND_SIM = 101,   /**< Software-simulated device, for testing
+                                  *   and benchmarking without hardware */
+    BLADERF_BACKEND_REPLAY = 102, /**< Replay of a recorded device trace */
 } bladerf_backend;
 
 
@@ -207,6 +210,15 @@ int CALL_CONV bladerf_open_with_devinfo(struct bladerf **device,
  *   - libusb:  libusb (See libusb changelog notes for required version, given
  *   your OS and controller)
  *   - cypress: Cypress CyUSB/CyAPI backend (Windows only)
+ *   - sim:     Software-simulated device, if libbladeRF was built with
+ *              ENABLE_BACKEND_SIM. This backend is never selected by "*".
+ *              See the BLADERF_SIM_* environment variables described in
+ *              the libbladeRF README for the simulation's configuration.
+ *   - replay:  Replay of a trace recorded from a device session, if
+ *              libbladeRF was built with ENABLE_BACKEND_REPLAY. This backend
+ *              is never selected by "*". The trace is specified via the
+ *              BLADERF_REPLAY environment variable. See the libbladeRF README
+ *              for details on recording and replaying traces.
  *
  * If no arguments are provided after the backend, the first encountered
  * device on the specified backend will be opened. Note that a backend is
@@ -236,6 +248,31 @@ API_EXPORT
 int CALL_CONV bladerf_open(struct bladerf **device,
                            const char *device_identifier);
 
+/**
+ * Open multiple devices concurrently.
+ *
+ * Each device is opened as if by bladerf_open_with_devinfo(), from its own
+ * thread, so that the control transfers required to initialize each device
+ * overlap. This is substantially faster than opening the devices one after
+ * another. Combine this with bladerf_set_lazy_open() to further reduce the
+ * time taken to open each device.
+ *
+ * @param[out]  devices     Array of `n` device handles. Each is updated with
+ *                          a device handle on success, or NULL on failure.
+ * @param[in]   devinfo     Array of `n` device specifications
+ * @param[out]  status      Optional array of `n` values, updated with the
+ *                          result of opening each device. May be NULL.
+ * @param[in]   n           Number of devices to open
+ *
+ * @return 0 if all devices were opened. Otherwise, the first failure
+ *         encountered, as a value from \ref RETCODES list. Devices that
+ *         were successfully opened must still be closed.
+ */
+API_EXPORT
+int CALL_CONV bladerf_open_multiple(struct bladerf **devices,
+                                    struct bladerf_devinfo *devinfo,
+                                    int *status, unsigned int n);
+
 /**
  * Close device
  *
@@ -265,6 +302,28 @@ void CALL_CONV bladerf_close(struct bladerf *device);
 API_EXPORT
 void bladerf_set_usb_reset_on_open(bool enabled);
 
+/**
+ * Enable or disable lazy initialization for future bladerf_open(),
+ * bladerf_open_with_devinfo() and bladerf_open_multiple() calls.
+ *
+ * When enabled, data that is not required to open a device is not read
+ * until it is first needed:
+ *  - The VCTCXO trim and FPGA size are read from the flash calibration
+ *    region when bladerf_get_vctcxo_trim() or bladerf_get_fpga_size() is
+ *    called, or when they are needed to initialize the device or load an
+ *    FPGA.
+ *  - DC calibration tables in the configuration search path are loaded, and
+ *    their LMS6002D settings applied, when a module is first enabled or
+ *    tuned, or a DC calibration table is first accessed.
+ *
+ * This is disabled by default.
+ *
+ * @param   enabled     Set true to defer these operations, and false to
+ *                      perform them while opening a device.
+ */
+API_EXPORT
+void CALL_CONV bladerf_set_lazy_open(bool enabled);
+
 /** @} (End FN_INIT) */
 
 /**
@@ -832,6 +891,63 @@ API_EXPORT
 int CALL_CONV bladerf_get_correction(struct bladerf *dev, bladerf_module module,
                                      bladerf_correction corr, int16_t *value);
 
+/**
+ * Methods of interpolating between the entries of a DC offset calibration
+ * table
+ */
+typedef enum {
+    /** Linear interpolation between the two surrounding entries (default) */
+    BLADERF_DC_CAL_INTERP_LINEAR,
+
+    /**
+     * Cubic Hermite spline through the surrounding entries. This better
+     * follows the curvature of the DC offset between widely spaced entries,
+     * allowing coarser tables to be used.
+     */
+    BLADERF_DC_CAL_INTERP_CUBIC,
+} bladerf_dc_cal_interp;
+
+/**
+ * Select how the LMS DC offset corrections applied when tuning are
+ * interpolated between the entries of a loaded DC offset calibration table
+ *
+ * @param   dev         Device handle
+ * @param   module      Module whose calibration table to configure
+ * @param   interp      Interpolation method
+ *
+ * @return 0 on success, BLADERF_ERR_UNSUPPORTED if no DC offset calibration
+ *         table is loaded for the module, or another value from the
+ *         \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_dc_cal_interp(struct bladerf *dev,
+                                        bladerf_module module,
+                                        bladerf_dc_cal_interp interp);
+
+/**
+ * Precompute the LMS DC offset corrections for a list of frequencies that
+ * will be tuned to frequently (e.g., a frequency hopping pattern). Tuning to
+ * one of these frequencies then applies the precomputed corrections, rather
+ * than interpolating them from the DC offset calibration table.
+ *
+ * This replaces any previously provided list.
+ *
+ * @param   dev         Device handle
+ * @param   module      Module whose calibration table to configure
+ * @param   freqs       Frequencies, in Hz. May be NULL if `n` is 0.
+ * @param   n           Number of frequencies. Provide 0 to discard the
+ *                      precomputed corrections.
+ *
+ * @return 0 on success, BLADERF_ERR_UNSUPPORTED if no DC offset calibration
+ *         table is loaded for the module, or another value from the
+ *         \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_dc_cal_freqs(struct bladerf *dev,
+                                       bladerf_module module,
+                                       const unsigned int *freqs,
+                                       unsigned int n);
+
 /**
  * Set the PA gain in dB
  *
@@ -970,6 +1086,79 @@ int CALL_CONV bladerf_get_rxvga2(struct bladerf *dev, int *gain);
 API_EXPORT
 int CALL_CONV bladerf_set_gain(struct bladerf *dev, bladerf_module mod, int gain);
 
+/**
+ * Calibrated gain offset for a frequency band, used by bladerf_set_gain()
+ * and bladerf_schedule_gain()
+ */
+struct bladerf_gain_offset {
+    unsigned int freq_min;  /**< Lowest frequency of the band, in Hz */
+    unsigned int freq_max;  /**< Highest frequency of the band, in Hz */
+    int offset;             /**< Measured gain, in dB, in excess of the
+                             *   nominal gain. This is subtracted from
+                             *   requested gains. */
+};
+
+/**
+ * Load calibrated gain offsets for a module. The offset of the band
+ * containing the module's frequency is taken into account by subsequent
+ * bladerf_set_gain() and bladerf_schedule_gain() calls. It is updated by
+ * bladerf_set_frequency(), but the gain is not re-applied when it changes.
+ *
+ * @param       dev         Device handle
+ * @param       mod         Module
+ * @param       offsets     Gain offsets, in any order. If bands overlap, the
+ *                          first matching entry is used. NULL clears
+ *                          previously loaded offsets.
+ * @param       count       Number of entries in `offsets`
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_gain_offsets(struct bladerf *dev, bladerf_module mod,
+                                       const struct bladerf_gain_offset *offsets,
+                                       unsigned int count);
+
+/**
+ * Schedule a combined gain change, as per bladerf_set_gain(), at the
+ * specified timestamp.
+ *
+ * All gain stages of the change are applied in a single batched register
+ * transaction. Scheduled changes are applied by bladerf_sync_rx() (for RX)
+ * or bladerf_sync_tx() (for TX) once the stream has reached the timestamp;
+ * if several changes are due at once, only the latest is applied. The
+ * timing of a change is therefore determined by these calls, not by the
+ * sample clock:
+ *
+ *  - For RX, the stream's timestamp is that of the samples being returned
+ *    to the caller. By then, the samples in the synchronous interface's
+ *    buffers have already been captured. A change therefore takes effect
+ *    at least `num_buffers * buffer_size` samples (as passed to
+ *    bladerf_sync_config()) after the scheduled timestamp, plus up to one
+ *    bladerf_sync_rx() call's worth of samples.
+ *
+ *  - For TX, the stream's timestamp is that of the samples being submitted
+ *    by the caller. Samples submitted earlier may still be buffered, so a
+ *    change may take effect up to `num_buffers * buffer_size` samples
+ *    before the scheduled timestamp is transmitted.
+ *
+ * This requires that the module's synchronous interface be configured with
+ * the ::BLADERF_FORMAT_SC16_Q11_META format. Pending changes are discarded
+ * by bladerf_sync_config().
+ *
+ * @param       dev         Device handle
+ * @param       mod         Module
+ * @param       timestamp   Timestamp at which to apply the gain
+ * @param       gain        Desired gain
+ *
+ * @return 0 on success, BLADERF_ERR_UNSUPPORTED if the synchronous interface
+ *         is not configured for metadata, BLADERF_ERR_MEM if too many
+ *         changes are pending, or a value from \ref RETCODES list on other
+ *         failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_schedule_gain(struct bladerf *dev, bladerf_module mod,
+                                    uint64_t timestamp, int gain);
+
 /**
  * Set the bandwidth of the LMS LPF to specified value in Hz
  *
@@ -1086,6 +1275,79 @@ int CALL_CONV bladerf_get_frequency(struct bladerf *dev,
                                     bladerf_module module,
                                     unsigned int *frequency);
 
+/**
+ * @defgroup BLADERF_CONFIG_FIELDS Module configuration fields
+ *
+ * These values select the fields of a bladerf_module_config that are
+ * applied by bladerf_set_module_config()
+ *
+ * @{
+ */
+
+/** Apply bladerf_module_config.samplerate */
+#define BLADERF_CONFIG_SAMPLERATE   (1 << 0)
+
+/** Apply bladerf_module_config.frequency */
+#define BLADERF_CONFIG_FREQUENCY    (1 << 1)
+
+/** Apply bladerf_module_config.bandwidth */
+#define BLADERF_CONFIG_BANDWIDTH    (1 << 2)
+
+/** Apply bladerf_module_config.gain */
+#define BLADERF_CONFIG_GAIN         (1 << 3)
+
+/** @} (End of BLADERF_CONFIG_FIELDS) */
+
+/**
+ * A set of module settings to be changed together
+ */
+struct bladerf_module_config {
+    unsigned int fields;        /**< Settings to apply, as a bitmask of
+                                 *   \ref BLADERF_CONFIG_FIELDS values */
+
+    struct bladerf_rational_rate samplerate;    /**< Sample rate */
+    unsigned int frequency;     /**< Frequency, in Hz */
+    unsigned int bandwidth;     /**< LPF bandwidth, in Hz */
+    int gain;                   /**< Overall gain, in dB. See
+                                 *   bladerf_set_gain(). */
+};
+
+/**
+ * Change a module's sample rate, frequency, bandwidth, and gain as a single
+ * operation.
+ *
+ * All of the selected settings are validated, and the associated register
+ * values are computed, before the device is modified. An invalid setting
+ * therefore leaves the device unchanged. The LMS6002D bandwidth and gain
+ * registers are written in the same batch as the PLL configuration. The
+ * Si5338 registers that are unchanged are not written.
+ *
+ * Once all changes have been made, the module's timestamp counter is read.
+ * Samples with timestamps greater than or equal to this value were
+ * received, or will be transmitted, with the new configuration. Note that
+ * this does not account for the settling time of the LMS6002D PLL and
+ * filters, and that a sample rate change alters the rate at which the
+ * timestamp counter advances.
+ *
+ * @param[in]       dev         Device handle
+ * @param[in]       module      Module to configure
+ * @param[inout]    config      Settings to apply. On success, the sample
+ *                              rate and bandwidth are updated with the
+ *                              actual values, and the gain is updated with
+ *                              the value after clamping.
+ * @param[out]      timestamp   If non-NULL, updated with the timestamp at
+ *                              which the configuration took effect. This
+ *                              requires an FPGA that supports timestamps.
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL for an invalid setting, or a
+ *         value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_module_config(struct bladerf *dev,
+                                        bladerf_module module,
+                                        struct bladerf_module_config *config,
+                                        uint64_t *timestamp);
+
 /**
  * Attach and enable an expansion board's features
  *
@@ -1392,11 +1654,26 @@ struct bladerf_metadata {
      */
     unsigned int actual_count;
 
+    /**
+     * When the RX AGC is enabled (see bladerf_set_agc()), bladerf_sync_rx()
+     * sets this to the gain, in dB, that the AGC had applied prior to
+     * returning the samples. Samples buffered before a gain change may have
+     * been received with the previous gain. Otherwise, this is not modified.
+     */
+    int32_t gain;
+
+    /**
+     * When the RX AGC is enabled, bladerf_sync_rx() sets this to the average
+     * power of the returned samples, in dBFS. Otherwise, this is not
+     * modified.
+     */
+    float power;
+
     /**
      * Reserved for future use. This is not used by any functions.
      * It is recommended that users zero out this field.
      */
-    uint8_t reserved[32];
+    uint8_t reserved[24];
 };
 
 
@@ -1878,6 +2155,219 @@ int CALL_CONV bladerf_sync_rx(struct bladerf *dev,
 
 /** @} (End of FN_DATA_SYNC) */
 
+/**
+ * @defgroup FN_GROUP Device groups
+ *
+ * A device group receives from multiple devices with a common timebase. The
+ * group's bladerf_group_rx() returns a block of samples from each device,
+ * each starting at the same instant.
+ *
+ * Each device's RX timestamp counter starts counting at a different time.
+ * When RX is started, the offset of each device's counter from that of the
+ * group's first device (the "reference device") is estimated by reading
+ * the counters. Requests for samples are translated to each device's
+ * timebase using these offsets.
+ *
+ * The accuracy of the estimated offsets is limited by the latency of
+ * reading the counters, typically a few hundred microseconds. Applications
+ * requiring sample-accurate alignment should measure the residual offsets
+ * (e.g., by cross-correlating a common signal) and apply corrections via
+ * bladerf_group_set_offset().
+ *
+ * The devices' sample clocks must be derived from a common reference for
+ * the alignment to be maintained. See bladerf_group_share_clock().
+ *
+ * @{
+ */
+
+/**
+ * Role of a device's Si5338 clock generator with respect to the MIMO
+ * connector
+ */
+typedef enum {
+    BLADERF_MIMO_MASTER,    /**< Drive the MIMO connector's clock output */
+    BLADERF_MIMO_SLAVE,     /**< Use the MIMO connector's clock input as the
+                             *   Si5338 reference */
+} bladerf_mimo_mode;
+
+/**
+ * Configure a device's role in sharing its sample clock reference via the
+ * MIMO connector.
+ *
+ * Sample rates should be (re)configured after making this change.
+ *
+ * @param   dev     Device handle
+ * @param   mode    MIMO clock mode
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL for an invalid mode, or a value
+ *         from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_mimo_mode(struct bladerf *dev,
+                                    bladerf_mimo_mode mode);
+
+/** Device group handle */
+struct bladerf_group;
+
+/**
+ * Open a group of devices.
+ *
+ * The devices are opened concurrently, via bladerf_open_multiple(). The
+ * first device is the group's reference device.
+ *
+ * @param[out]  group       Updated with the group handle on success
+ * @param[in]   devinfo     Array of `n` device specifications
+ * @param[in]   n           Number of devices. This must be at least 1.
+ *
+ * @return 0 on success, or a value from \ref RETCODES list on failure. If
+ *         any device cannot be opened, no devices are left open.
+ */
+API_EXPORT
+int CALL_CONV bladerf_group_open(struct bladerf_group **group,
+                                 struct bladerf_devinfo *devinfo,
+                                 unsigned int n);
+
+/**
+ * Stop any RX streams and close all devices in a group
+ *
+ * @param   group   Group handle. This function does nothing if NULL.
+ */
+API_EXPORT
+void CALL_CONV bladerf_group_close(struct bladerf_group *group);
+
+/**
+ * Get the handle of a device in a group.
+ *
+ * The handle may be used to configure the device (e.g., its frequency,
+ * sample rate and gain). It must not be closed, nor used for RX sample
+ * transfers while the group's RX stream is running.
+ *
+ * @param   group   Group handle
+ * @param   index   Index of the device, in the order it was provided to
+ *                  bladerf_group_open()
+ *
+ * @return Device handle, or NULL if index is out of range
+ */
+API_EXPORT
+struct bladerf * CALL_CONV bladerf_group_get_device(struct bladerf_group *group,
+                                                    unsigned int index);
+
+/**
+ * Share the reference device's sample clock reference with all other
+ * devices in the group.
+ *
+ * The reference device is configured as the ::BLADERF_MIMO_MASTER and all
+ * others as a ::BLADERF_MIMO_SLAVE. This assumes the devices' MIMO
+ * connectors are cabled to distribute the reference device's clock.
+ *
+ * @param   group   Group handle
+ *
+ * @return 0 on success, or a value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_group_share_clock(struct bladerf_group *group);
+
+/**
+ * Configure and start receiving from all devices in a group, and estimate
+ * the offsets between their timestamp counters.
+ *
+ * Each device's synchronous RX interface is configured for the
+ * ::BLADERF_FORMAT_SC16_Q11_META format, with the provided parameters (see
+ * bladerf_sync_config()), and its RX module is enabled.
+ *
+ * Any offsets set via bladerf_group_set_offset() are replaced.
+ *
+ * @param   group           Group handle
+ * @param   num_buffers     Number of buffers per device
+ * @param   buffer_size     Samples per buffer
+ * @param   num_transfers   Number of active transfers per device
+ * @param   stream_timeout  Stream timeout, in milliseconds
+ *
+ * @return 0 on success, or a value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_group_start_rx(struct bladerf_group *group,
+                                     unsigned int num_buffers,
+                                     unsigned int buffer_size,
+                                     unsigned int num_transfers,
+                                     unsigned int stream_timeout);
+
+/**
+ * Stop receiving from all devices in a group
+ *
+ * @param   group   Group handle
+ *
+ * @return 0 on success, or the first failure encountered, as a value from
+ *         \ref RETCODES list
+ */
+API_EXPORT
+int CALL_CONV bladerf_group_stop_rx(struct bladerf_group *group);
+
+/**
+ * Receive time-aligned samples from all devices in a group.
+ *
+ * The samples from each device are returned in consecutive blocks of
+ * `num_samples` SC16 Q11 samples, in the order the devices were provided to
+ * bladerf_group_open(). The first sample of every block was taken at the
+ * same time.
+ *
+ * Consecutive calls return contiguous samples. If any device overruns, the
+ * samples from all devices resume at a common later time. The gap is
+ * reported by setting ::BLADERF_META_STATUS_OVERRUN in the metadata status
+ * field.
+ *
+ * @param[in]   group       Group handle
+ * @param[out]  samples     Buffer to store samples in. This must be large
+ *                          enough to hold `num_samples` samples for each
+ *                          device in the group.
+ * @param[in]   num_samples Number of samples to read from each device
+ * @param[out]  metadata    Updated with the reference device's timestamp
+ *                          of the first sample of each block, and the
+ *                          status of the transfer. Flags are not used.
+ * @param[in]   timeout_ms  Timeout (milliseconds) for each device's
+ *                          transfer. Zero implies "infinite."
+ *
+ * @pre bladerf_group_start_rx() has been called
+ *
+ * @return 0 on success, or a value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_group_rx(struct bladerf_group *group,
+                               int16_t *samples, unsigned int num_samples,
+                               struct bladerf_metadata *metadata,
+                               unsigned int timeout_ms);
+
+/**
+ * Get the offset of a device's RX timestamp counter from that of the
+ * group's reference device
+ *
+ * @param[in]   group   Group handle
+ * @param[in]   index   Device index
+ * @param[out]  offset  Offset, in samples
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if index is out of range
+ */
+API_EXPORT
+int CALL_CONV bladerf_group_get_offset(struct bladerf_group *group,
+                                       unsigned int index, int64_t *offset);
+
+/**
+ * Override the offset of a device's RX timestamp counter from that of the
+ * group's reference device. This takes effect at the next
+ * bladerf_group_rx() call.
+ *
+ * @param   group   Group handle
+ * @param   index   Device index
+ * @param   offset  Offset, in samples
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if index is out of range
+ */
+API_EXPORT
+int CALL_CONV bladerf_group_set_offset(struct bladerf_group *group,
+                                       unsigned int index, int64_t offset);
+
+/** @} (End of FN_GROUP) */
+
 /**
  * @defgroup FN_INFO    Device info
  *
@@ -2057,6 +2547,39 @@ int CALL_CONV bladerf_flash_fpga(struct bladerf *dev,
 API_EXPORT
 int CALL_CONV bladerf_erase_stored_fpga(struct bladerf *dev);
 
+/**
+ * Flash programming modes, used by bladerf_flash_firmware() and
+ * bladerf_flash_fpga()
+ */
+typedef enum {
+    /**
+     * Erase and write the entire flash region, then read back and verify
+     * everything that was written. This is the default.
+     */
+    BLADERF_FLASH_MODE_FULL,
+
+    /**
+     * Read back the flash region first, and only erase, write, and verify
+     * the erase blocks whose contents differ from the new image. This is
+     * substantially faster when an image is only partially changed, but
+     * slightly slower when the entire image differs.
+     */
+    BLADERF_FLASH_MODE_DELTA,
+} bladerf_flash_mode;
+
+/**
+ * Select how bladerf_flash_firmware() and bladerf_flash_fpga() program the
+ * SPI flash
+ *
+ * @param   dev         Device handle
+ * @param   mode        Flash programming mode
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL on an invalid mode
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_flash_mode(struct bladerf *dev,
+                                     bladerf_flash_mode mode);
+
 /**
  * Reset the device, causing it to reload its firmware from flash
  *
@@ -2080,6 +2603,313 @@ int CALL_CONV bladerf_jump_to_bootloader(struct bladerf *dev);
 /** @} (End of FN_PROG) */
 
 
+/**
+ * @defgroup FN_DC_SOLVER DC offset calibration search
+ *
+ * These routines search for the LMS6002D DC offset correction values
+ * (::BLADERF_CORR_LMS_DCOFF_I and ::BLADERF_CORR_LMS_DCOFF_Q) that best
+ * cancel the RX DC offset or TX LO leakage.
+ *
+ * The search itself does not access a device. Instead, the caller supplies a
+ * function that applies a pair of correction values and measures the result
+ * over a block of samples. This allows the caller to decide how samples are
+ * obtained (e.g., flushing a stream after each change, or requesting
+ * timestamped blocks from a running stream), and the search to be reused
+ * for each frequency of a calibration table.
+ *
+ * Rather than probing a fixed set of values, each search models how its
+ * measurement responds to the correction values, and moves directly to the
+ * predicted optimum. The search terminates once the residual error falls
+ * below a threshold, or once it cannot be improved upon at the resolution
+ * of the correction registers.
+ *
+ * @{
+ */
+
+/**
+ * Search parameters
+ */
+struct bladerf_dc_solver_config {
+    int16_t min;        /**< Minimum correction value to consider */
+    int16_t max;        /**< Maximum correction value to consider */
+
+    /**
+     * Resolution of the correction registers, in correction value units.
+     * Candidate values are rounded to multiples of this.
+     */
+    int16_t quantum;
+
+    /**
+     * Distance from 0 of the initial probes, in correction value units.
+     */
+    int16_t step;
+
+    /**
+     * Terminate once the residual error of both I and Q is at or below this
+     * value. See ::bladerf_dc_solution for the units of the residual.
+     *
+     * When 0, the search continues until no further improvement is possible
+     * at the resolution of the correction registers.
+     */
+    float threshold;
+
+    /**
+     * Maximum number of measurements to perform. If this is reached before
+     * the search converges, the best values found thus far are reported.
+     */
+    unsigned int max_measurements;
+};
+
+/**
+ * Result of a DC offset correction search
+ */
+struct bladerf_dc_solution {
+    int16_t dc_i;       /**< I correction value */
+    int16_t dc_q;       /**< Q correction value */
+
+    /**
+     * Residual error in I and Q, with `dc_i` and `dc_q` applied.
+     *
+     * For RX searches, this is the average I and Q sample value, in the
+     * units of the SC16 Q11 sample format.
+     *
+     * For TX searches, this is the estimated distance, in correction value
+     * units, from `dc_i` and `dc_q` to the values that minimize the LO
+     * leakage.
+     */
+    float residual_i;
+    float residual_q;
+
+    /**
+     * For TX searches, the measured magnitude with `dc_i` and `dc_q` applied.
+     * Unused for RX searches.
+     */
+    float magnitude;
+
+    unsigned int measurements;  /**< Number of measurements performed */
+    bool converged;             /**< Search terminated before reaching
+                                 *   `max_measurements` */
+};
+
+/**
+ * Measure the RX DC offset with the specified RX correction values applied
+ *
+ * @param       arg     User data provided to bladerf_dc_solve_rx()
+ * @param       dc_i    I correction value to apply
+ * @param       dc_q    Q correction value to apply
+ * @param[out]  mean_i  Average I sample value
+ * @param[out]  mean_q  Average Q sample value
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure. A failure
+ *         aborts the search and is returned by bladerf_dc_solve_rx().
+ */
+typedef int (*bladerf_dc_rx_measure)(void *arg, int16_t dc_i, int16_t dc_q,
+                                     float *mean_i, float *mean_q);
+
+/**
+ * Measure the TX LO leakage with the specified TX correction values applied
+ *
+ * Typically, this is the RMS magnitude (i.e., the square root of the sum of
+ * the I and Q variances) of RX samples received via an RF loopback, with the
+ * RX frequency offset from the TX frequency.
+ *
+ * @param       arg         User data provided to bladerf_dc_solve_tx()
+ * @param       dc_i        I correction value to apply
+ * @param       dc_q        Q correction value to apply
+ * @param[out]  magnitude   Measured magnitude
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure. A failure
+ *         aborts the search and is returned by bladerf_dc_solve_tx().
+ */
+typedef int (*bladerf_dc_tx_measure)(void *arg, int16_t dc_i, int16_t dc_q,
+                                     float *magnitude);
+
+/**
+ * Fill in the default search parameters for the specified module
+ *
+ * @param       module      Module whose correction values are searched for
+ * @param[out]  config      Default parameters
+ */
+API_EXPORT
+void CALL_CONV bladerf_dc_solver_defaults(bladerf_module module,
+                                          struct bladerf_dc_solver_config *config);
+
+/**
+ * Search for the RX DC offset correction values
+ *
+ * The average I and Q sample values are each treated as a linear function of
+ * the corresponding correction value, and searched for the root of this via
+ * the secant method. I and Q are searched for concurrently, such that each
+ * measurement serves both.
+ *
+ * @param       config      Search parameters. If NULL, the defaults for
+ *                          BLADERF_MODULE_RX are used.
+ * @param       measure     Measurement function
+ * @param       arg         User data passed to `measure`
+ * @param[out]  solution    Correction values yielding the smallest DC offset
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL for invalid parameters,
+ *         BLADERF_ERR_UNEXPECTED if the measurements do not respond to the
+ *         correction values, or the value returned by a failed `measure`
+ */
+API_EXPORT
+int CALL_CONV bladerf_dc_solve_rx(const struct bladerf_dc_solver_config *config,
+                                  bladerf_dc_rx_measure measure, void *arg,
+                                  struct bladerf_dc_solution *solution);
+
+/**
+ * Search for the TX DC offset correction values
+ *
+ * The leakage power (the square of the measured magnitude) is modeled as a
+ * paraboloid, separable in the I and Q correction values. This is fit, via
+ * least squares, to measurements about the current estimate of its minimum,
+ * with the probe spacing reduced when the fit proves to be inaccurate.
+ *
+ * @param       config      Search parameters. If NULL, the defaults for
+ *                          BLADERF_MODULE_TX are used.
+ * @param       measure     Measurement function
+ * @param       arg         User data passed to `measure`
+ * @param[out]  solution    Correction values yielding the least LO leakage
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL for invalid parameters,
+ *         BLADERF_ERR_UNEXPECTED if the measurements do not exhibit a
+ *         minimum, or the value returned by a failed `measure`
+ */
+API_EXPORT
+int CALL_CONV bladerf_dc_solve_tx(const struct bladerf_dc_solver_config *config,
+                                  bladerf_dc_tx_measure measure, void *arg,
+                                  struct bladerf_dc_solution *solution);
+
+/** @} (End of FN_DC_SOLVER) */
+
+/**
+ * @defgroup FN_IQ_CAL IQ imbalance estimation
+ *
+ * Gain and phase imbalance between the I and Q paths produces an image of
+ * the received signal, mirrored about the center frequency. The FPGA gain
+ * and phase corrections (::BLADERF_CORR_FPGA_GAIN and
+ * ::BLADERF_CORR_FPGA_PHASE) may be used to compensate for this.
+ *
+ * The estimate below is computed from the second-order statistics of a
+ * block of samples, and requires only that the signal being received
+ * (e.g., noise, or a tone offset from the center frequency, as obtained via
+ * a loopback mode) would be free of an image in the absence of imbalance.
+ *
+ * The residual gain and phase imbalance each respond approximately linearly
+ * to the corresponding FPGA correction value, such that
+ * bladerf_dc_solve_rx() may be used to search for the correction values
+ * that null them.
+ *
+ * @{
+ */
+
+/**
+ * Estimated IQ imbalance
+ */
+struct bladerf_iq_imbalance {
+    /**
+     * Ratio of the Q amplitude to the I amplitude, minus 1
+     */
+    float gain;
+
+    /**
+     * Deviation of Q from quadrature with I, in degrees. Positive values
+     * indicate that Q is correlated with I.
+     */
+    float phase;
+
+    /**
+     * Ratio of the signal power to that of its image, in dB. This is
+     * limited to 100 dB.
+     */
+    float image_rejection;
+};
+
+/**
+ * Estimate the IQ imbalance of a block of samples
+ *
+ * Any DC offset present in the samples is excluded from the estimate.
+ *
+ * @param[in]   samples     Samples in the ::BLADERF_FORMAT_SC16_Q11 format
+ * @param[in]   num_samples Number of samples
+ * @param[out]  imbalance   Estimated imbalance
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if fewer than 2 samples are
+ *         provided, or if either I or Q is constant
+ */
+API_EXPORT
+int CALL_CONV bladerf_estimate_iq_imbalance(const int16_t *samples,
+                                            unsigned int num_samples,
+                                            struct bladerf_iq_imbalance *imbalance);
+
+/** @} (End of FN_IQ_CAL) */
+
+
+/**
+ * @defgroup FN_AGC RX automatic gain control
+ *
+ * The AGC measures the average power and peak level of samples as they are
+ * returned by bladerf_sync_rx(), and adjusts the combined RX gain (see
+ * bladerf_set_gain()) to hold the average power near a target level.
+ *
+ * Updates are made once per measurement interval. If the measured power is
+ * within the hysteresis window of the target, the gain is held. Otherwise,
+ * it is stepped toward the target, limited to the attack (decrease) and
+ * decay (increase) rates. A peak exceeding the peak limit always results in
+ * a decrease of the attack rate.
+ *
+ * Following a gain change, the samples already buffered by the host and
+ * device are excluded from measurements.
+ *
+ * Applications should not call bladerf_set_gain() or bladerf_schedule_gain()
+ * for RX while the AGC is enabled.
+ *
+ * @{
+ */
+
+/**
+ * AGC configuration
+ */
+struct bladerf_agc_config {
+    float target;           /**< Target average power, in dBFS */
+    float hysteresis;       /**< Half-width of the window around the target
+                             *   within which the gain is held, in dB */
+    float attack;           /**< Maximum gain decrease per update, in dB */
+    float decay;            /**< Maximum gain increase per update, in dB */
+    float peak_limit;       /**< Peak level (of I or Q), in dBFS, beyond
+                             *   which the gain is decreased */
+    int min_gain;           /**< Minimum gain, in dB */
+    int max_gain;           /**< Maximum gain, in dB. The AGC starts midway
+                             *   between min_gain and max_gain. */
+    unsigned int interval;  /**< Number of samples measured per update. 0
+                             *   updates after every bladerf_sync_rx() call.
+                             */
+    unsigned int settle;    /**< Number of samples excluded from measurements
+                             *   after a gain change. 0 selects the number
+                             *   of samples buffered by the sync interface.
+                             */
+};
+
+/**
+ * Enable, reconfigure, or disable the RX AGC
+ *
+ * The AGC operates within bladerf_sync_rx(), in either sample format.
+ * Samples from the asynchronous interface are not measured.
+ *
+ * @param       dev         Device handle
+ * @param       config      AGC configuration, or NULL to disable the AGC.
+ *                          When disabled, the current gain is retained.
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL for an invalid configuration, or
+ *         a value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_agc(struct bladerf *dev,
+                              const struct bladerf_agc_config *config);
+
+/** @} (End of FN_AGC) */
+
+
 /**
  * @defgroup FN_MISC Miscellaneous
  * @{
@@ -2681,6 +3511,109 @@ API_EXPORT
 int CALL_CONV bladerf_calibrate_dc(struct bladerf *dev,
                                    bladerf_cal_module module);
 
+/**
+ * Counts of the control-path requests issued to a device, grouped by the
+ * peripheral they access. Each request requires a round trip between the
+ * host and the device. Sample stream transfers are not included.
+ */
+struct bladerf_round_trips {
+    uint64_t lms;       /**< LMS6002D register accesses */
+    uint64_t si5338;    /**< Si5338 register accesses */
+    uint64_t fpga;      /**< FPGA register accesses: configuration and
+                         *   expansion GPIO, IQ corrections, timestamps,
+                         *   VCTCXO DAC and expansion board SPI */
+    uint64_t other;     /**< Firmware requests */
+};
+
+/**
+ * Retrieve the number of control-path round trips performed with a device
+ * since it was opened. The round trips required by an operation may be
+ * determined by comparing the counts retrieved before and after it.
+ *
+ * The trace replay backend does not maintain these counts.
+ *
+ * @param   dev         Device handle
+ * @param   counts      Updated with the device's round trip counts
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_round_trips(struct bladerf *dev,
+                                      struct bladerf_round_trips *counts);
+
+/**
+ * USB transaction statistics for a single API function, as accumulated
+ * while USB tracing is enabled.
+ *
+ * Transactions performed outside of an API function call (e.g., while
+ * opening a device) are reported under the function name "(none)".
+ */
+struct bladerf_usb_stats {
+    const char *function;           /**< API function name */
+    uint64_t calls;                 /**< Calls that performed USB transfers */
+    uint64_t control_transfers;     /**< Control transfers */
+    uint64_t bulk_transfers;        /**< Control-path bulk transfers */
+    uint64_t peripheral_accesses;   /**< FPGA peripheral accesses. Each of
+                                     *   these consists of two bulk
+                                     *   transfers. */
+    uint64_t bytes;                 /**< Bytes transferred */
+    uint64_t time_ns;               /**< Total time spent in transfers */
+    uint64_t max_time_ns;           /**< Longest single transfer */
+};
+
+/**
+ * Enable or disable USB transaction tracing. When enabled, each control-path
+ * USB transfer is timed and attributed to the API function that performed
+ * it. Enabling tracing discards any previously collected data.
+ *
+ * Tracing may also be enabled for all devices opened with the USB backend by
+ * setting the BLADERF_USB_TRACE environment variable to the path of a trace
+ * file. This file is written in the Chrome trace event format, which may be
+ * viewed with chrome://tracing or Perfetto, when the device is closed.
+ *
+ * Streaming transfers are not traced.
+ *
+ * @param   dev         Device handle
+ * @param   enable      true to enable tracing, false to disable it
+ *
+ * @return 0 on success, BLADERF_ERR_UNSUPPORTED if the device's backend does
+ *         not support tracing, or a value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_enable_usb_trace(struct bladerf *dev, bool enable);
+
+/**
+ * Retrieve per-API-function USB transaction statistics
+ *
+ * @param   dev         Device handle
+ * @param   stats       Array to fill. May be NULL if `count` is 0.
+ * @param   count       Number of elements in `stats`
+ *
+ * @return On success, the number of API functions for which statistics are
+ *         available. This may exceed `count`, in which case only the first
+ *         `count` entries are provided. On failure, a value from
+ *         \ref RETCODES list is returned. BLADERF_ERR_UNSUPPORTED is
+ *         returned if tracing is not enabled.
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_usb_stats(struct bladerf *dev,
+                                    struct bladerf_usb_stats *stats,
+                                    unsigned int count);
+
+/**
+ * Write the USB transactions traced thus far to a file, in the Chrome trace
+ * event JSON format.
+ *
+ * @param   dev         Device handle
+ * @param   filename    Output file
+ *
+ * @return 0 on success, BLADERF_ERR_UNSUPPORTED if tracing is not enabled,
+ *         or a value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_write_usb_trace(struct bladerf *dev,
+                                      const char *filename);
+
 /** @} (End of LOW_LEVEL) */
 
 /**
@@ -2852,6 +3785,30 @@ API_EXPORT
 int CALL_CONV bladerf_write_flash(struct bladerf *dev, const uint8_t *buf,
                                   uint32_t page, uint32_t count);
 
+/**
+ * Verify that the contents of the bladeRF's SPI flash match the provided
+ * data
+ *
+ * With firmware v1.9.0 or later, a SHA-256 digest of the specified pages is
+ * computed on the device and compared against that of `buf`, such that the
+ * flash contents need not be read back. Otherwise, the pages are read back
+ * and compared.
+ *
+ * @param   dev   Device handle
+ * @param   buf   Expected flash contents. Must be
+ *                `count` * BLADERF_FLASH_PAGE_SIZE bytes or larger.
+ *
+ * @param   page  Page to begin verifying at
+ * @param   count Number of pages to verify
+ *
+ * @return 0 if the flash contents match, BLADERF_ERR_UNEXPECTED if they
+ *         do not, BLADERF_ERR_INVAL on an invalid `page` or `count` value,
+ *         or a value from \ref RETCODES list on other failures.
+ */
+API_EXPORT
+int CALL_CONV bladerf_verify_flash(struct bladerf *dev, const uint8_t *buf,
+                                   uint32_t page, uint32_t count);
+
 /** @} (End of FN_FLASH) */
 
 /**
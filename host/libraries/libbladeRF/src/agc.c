@@ -0,0 +1,147 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "agc.h"
+#include "log.h"
+#include "sample_sums.h"
+
+/* SC16 Q11 full scale */
+#define FULL_SCALE      2048.0
+
+/* Reported power of an all-zero block */
+#define POWER_MIN_DBFS  (-200.0f)
+
+static inline float power_dbfs(uint64_t sum, uint64_t count)
+{
+    if (count == 0 || sum == 0) {
+        return POWER_MIN_DBFS;
+    }
+
+    return (float) (10.0 * log10((double) sum / count /
+                                 (FULL_SCALE * FULL_SCALE)));
+}
+
+int agc_validate(const struct bladerf_agc_config *config)
+{
+    if (config->min_gain > config->max_gain ||
+        config->hysteresis < 0.0f ||
+        config->attack <= 0.0f || config->decay <= 0.0f) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    return 0;
+}
+
+void agc_init(struct agc *agc, const struct bladerf_agc_config *config)
+{
+    memset(agc, 0, sizeof(*agc));
+    agc->config = *config;
+    agc->gain = (config->min_gain + config->max_gain) / 2;
+}
+
+bool agc_update(struct agc *agc, const int16_t *samples, unsigned int n,
+                float *power, int *gain)
+{
+    const struct bladerf_agc_config *c = &agc->config;
+    struct sample_sums sums;
+    uint64_t sum;
+    unsigned int peak;
+    float avg, peak_db, step;
+    int new_gain;
+
+    sample_sums(samples, n, &sums);
+    sum = sums.ii + sums.qq;
+    peak = sums.peak;
+    *power = power_dbfs(sum, n);
+
+    /* Skip samples received prior to the last gain change taking effect */
+    if (agc->settle >= n) {
+        agc->settle -= n;
+        return false;
+    } else if (agc->settle != 0) {
+        const unsigned int skip = (unsigned int) agc->settle;
+
+        agc->settle = 0;
+        sample_sums(samples + 2 * skip, n - skip, &sums);
+        sum = sums.ii + sums.qq;
+        peak = sums.peak;
+        n -= skip;
+    }
+
+    agc->sum += sum;
+    agc->count += n;
+    agc->peak = peak > agc->peak ? peak : agc->peak;
+
+    if (agc->count == 0 || agc->count < c->interval) {
+        return false;
+    }
+
+    avg = power_dbfs(agc->sum, agc->count);
+    peak_db = (agc->peak == 0) ? POWER_MIN_DBFS :
+              (float) (20.0 * log10(agc->peak / FULL_SCALE));
+
+    agc->sum = 0;
+    agc->count = 0;
+    agc->peak = 0;
+
+    if (peak_db >= c->peak_limit) {
+        step = -c->attack;
+    } else if (fabsf(c->target - avg) <= c->hysteresis) {
+        step = 0.0f;
+    } else {
+        step = c->target - avg;
+        if (step < -c->attack) {
+            step = -c->attack;
+        } else if (step > c->decay) {
+            step = c->decay;
+        }
+    }
+
+    new_gain = agc->gain + (int) floorf(step + 0.5f);
+    if (new_gain < c->min_gain) {
+        new_gain = c->min_gain;
+    } else if (new_gain > c->max_gain) {
+        new_gain = c->max_gain;
+    }
+
+    if (new_gain == agc->gain) {
+        return false;
+    }
+
+    log_verbose("AGC: power=%.1f dBFS, peak=%.1f dBFS, gain %d -> %d dB\n",
+                avg, peak_db, agc->gain, new_gain);
+
+    *gain = new_gain;
+    return true;
+}
+
+void agc_gain_applied(struct agc *agc, int gain, unsigned int buffered)
+{
+    agc->gain = gain;
+    agc->settle = (agc->config.settle != 0) ? agc->config.settle : buffered;
+
+    agc->sum = 0;
+    agc->count = 0;
+    agc->peak = 0;
+}
@@ -0,0 +1,86 @@
+/**
+ * @file agc.h
+ *
+ * @brief Host-side RX automatic gain control
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef BLADERF_AGC_H_
+#define BLADERF_AGC_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "libbladeRF.h"
+
+struct agc {
+    struct bladerf_agc_config config;
+
+    int gain;                   /* Gain currently applied, in dB */
+    uint64_t settle;            /* Samples left to exclude from measurements */
+
+    /* Statistics of the current measurement interval */
+    uint64_t sum;               /* Sum of I^2 + Q^2 */
+    uint64_t count;             /* Number of samples */
+    unsigned int peak;          /* Peak magnitude of I or Q */
+};
+
+/**
+ * Check an AGC configuration
+ *
+ * @param   config      Configuration to check
+ *
+ * @return 0 if valid, BLADERF_ERR_INVAL otherwise
+ */
+int agc_validate(const struct bladerf_agc_config *config);
+
+/**
+ * Initialize AGC state. The initial gain is stored in agc->gain, and should
+ * be applied by the caller.
+ *
+ * @param   agc         AGC state to initialize
+ * @param   config      Validated configuration
+ */
+void agc_init(struct agc *agc, const struct bladerf_agc_config *config);
+
+/**
+ * Measure a block of samples returned to the user
+ *
+ * @param[in]   agc         AGC state
+ * @param[in]   samples     SC16 Q11 samples
+ * @param[in]   n           Number of samples
+ * @param[out]  power       Average power of the samples, in dBFS
+ * @param[out]  gain        New gain, when a change is required
+ *
+ * @return true if the gain should be changed to `*gain`, false otherwise
+ */
+bool agc_update(struct agc *agc, const int16_t *samples, unsigned int n,
+                float *power, int *gain);
+
+/**
+ * Record that a new gain has been applied
+ *
+ * @param   agc         AGC state
+ * @param   gain        Applied gain
+ * @param   buffered    Number of samples buffered by the sync interface,
+ *                      used when no settling period is configured
+ */
+void agc_gain_applied(struct agc *agc, int gain, unsigned int buffered);
+
+#endif
@@ -24,6 +24,10 @@
 #include "backend/backend_config.h"
 #include "log.h"
 
+#ifdef ENABLE_BACKEND_REPLAY
+#   include "backend/replay/replay.h"
+#endif
+
 static const struct backend_fns *backend_list[] = BLADERF_BACKEND_LIST;
 
 int open_with_any_backend(struct bladerf *device,
@@ -57,6 +61,12 @@ int backend_open(struct bladerf *device, struct bladerf_devinfo *info) {
         }
     }
 
+#ifdef ENABLE_BACKEND_REPLAY
+    if (status == 0) {
+        record_attach(device);
+    }
+#endif
+
     return status;
 }
 
@@ -128,6 +138,13 @@ int backend_load_fw_from_bootloader(bladerf_backend backend,
     return status;
 }
 
+void backend_fini(void)
+{
+#ifdef ENABLE_BACKEND_USB
+    usb_fini();
+#endif
+}
+
 const char * backend2str(bladerf_backend backend)
 {
     switch (backend) {
@@ -140,6 +157,12 @@ const char * backend2str(bladerf_backend backend)
         case BLADERF_BACKEND_CYPRESS:
             return BACKEND_STR_CYPRESS;
 
+        case BLADERF_BACKEND_SIM:
+            return BACKEND_STR_SIM;
+
+        case BLADERF_BACKEND_REPLAY:
+            return BACKEND_STR_REPLAY;
+
         default:
             return BACKEND_STR_ANY;
     }
@@ -155,6 +178,10 @@ int str2backend(const char *str, bladerf_backend *backend)
         *backend = BLADERF_BACKEND_LINUX;
     } else if (!strcasecmp(BACKEND_STR_CYPRESS, str)) {
         *backend = BLADERF_BACKEND_CYPRESS;
+    } else if (!strcasecmp(BACKEND_STR_SIM, str)) {
+        *backend = BLADERF_BACKEND_SIM;
+    } else if (!strcasecmp(BACKEND_STR_REPLAY, str)) {
+        *backend = BLADERF_BACKEND_REPLAY;
     } else if (!strcasecmp(BACKEND_STR_ANY, str)) {
         *backend = BLADERF_BACKEND_ANY;
     } else {
@@ -32,6 +32,8 @@
 #define BACKEND_STR_LIBUSB "libusb"
 #define BACKEND_STR_LINUX  "linux"
 #define BACKEND_STR_CYPRESS "cypress"
+#define BACKEND_STR_SIM    "sim"
+#define BACKEND_STR_REPLAY "replay"
 
 /**
  * Specifies what to probe for
@@ -138,6 +140,57 @@ struct backend_fns {
     int (*load_fw_from_bootloader)(bladerf_backend backend,
                                    uint8_t bus, uint8_t addr,
                                    struct fx3_firmware *fw);
+
+    /* USB transaction tracing. These are optional, and may be NULL for
+     * backends that do not support tracing. */
+    int (*enable_trace)(struct bladerf *dev, bool enable);
+    int (*get_trace_stats)(struct bladerf *dev,
+                           struct bladerf_usb_stats *stats,
+                           unsigned int count);
+    int (*write_trace)(struct bladerf *dev, const char *filename);
+
+    /* Batched LMS6002D accessors, which access n registers, in order, with
+     * as few device round trips as possible. These are optional, and may be
+     * NULL or return BLADERF_ERR_UNSUPPORTED, in which case callers fall
+     * back to lms_write() and lms_read(). */
+    int (*lms_write_regs)(struct bladerf *dev, const uint8_t *addr,
+                          const uint8_t *data, unsigned int n);
+    int (*lms_read_regs)(struct bladerf *dev, const uint8_t *addr,
+                         uint8_t *data, unsigned int n);
+
+    /* Run a single LMS6002D DC calibration loop (select the calibration
+     * address, latch DC_CNTVAL, start the calibration and poll for
+     * DC_CLBR_DONE) on the device, returning DC_REG_VAL. Optional; may be
+     * NULL or return BLADERF_ERR_UNSUPPORTED. Returns BLADERF_ERR_UNEXPECTED
+     * if the calibration did not complete. */
+    int (*lms_dc_cal_loop)(struct bladerf *dev, uint8_t base,
+                           uint8_t cal_addr, uint8_t dc_cntval,
+                           uint8_t *dc_regval);
+
+    /* Batched Si5338 accessors, which access n registers, in order, with as
+     * few device round trips as possible. These are optional, and may be
+     * NULL or return BLADERF_ERR_UNSUPPORTED, in which case callers fall
+     * back to si5338_write() and si5338_read(). */
+    int (*si5338_write_regs)(struct bladerf *dev, const uint8_t *addr,
+                             const uint8_t *data, unsigned int n);
+    int (*si5338_read_regs)(struct bladerf *dev, const uint8_t *addr,
+                            uint8_t *data, unsigned int n);
+
+    /* Chunked FPGA loading, used to stream a bitstream to the device while
+     * it is still being read from disk. load_fpga_begin() is passed the
+     * total image size, load_fpga_write() is then called with consecutive
+     * chunks of the image, and load_fpga_end() waits for configuration to
+     * complete. All chunks but the last are multiples of 64 KiB. These are
+     * optional, and may be NULL, in which case callers use load_fpga(). */
+    int (*load_fpga_begin)(struct bladerf *dev, size_t image_size);
+    int (*load_fpga_write)(struct bladerf *dev, const uint8_t *buf, size_t len);
+    int (*load_fpga_end)(struct bladerf *dev);
+
+    /* Compute the SHA-256 digest of the specified flash pages on the
+     * device. This is optional, and may be NULL or return
+     * BLADERF_ERR_UNSUPPORTED, in which case callers read back the pages. */
+    int (*flash_hash)(struct bladerf *dev, uint32_t page, uint32_t count,
+                      uint8_t *digest);
 };
 
 /**
@@ -179,6 +232,12 @@ int backend_load_fw_from_bootloader(bladerf_backend backend,
                                     struct fx3_firmware *fw);
 
 
+/**
+ * Release process-wide state held by the backends, such as device
+ * registries. This is called when the library is unloaded.
+ */
+void backend_fini(void);
+
 /**
  * Convert a backend enumeration value to a string
  *
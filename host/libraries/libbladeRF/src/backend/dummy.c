@@ -282,4 +282,20 @@ const struct backend_fns backend_fns_dummy = {
     FIELD_INIT(.deinit_stream, dummy_deinit_stream),
 
     FIELD_INIT(.load_fw_from_bootloader, dummy_load_fw_from_bootloader),
+
+    FIELD_INIT(.enable_trace, NULL),
+    FIELD_INIT(.get_trace_stats, NULL),
+    FIELD_INIT(.write_trace, NULL),
+
+    FIELD_INIT(.lms_write_regs, NULL),
+    FIELD_INIT(.lms_read_regs, NULL),
+    FIELD_INIT(.lms_dc_cal_loop, NULL),
+
+    FIELD_INIT(.si5338_write_regs, NULL),
+    FIELD_INIT(.si5338_read_regs, NULL),
+
+    FIELD_INIT(.load_fpga_begin, NULL),
+    FIELD_INIT(.load_fpga_write, NULL),
+    FIELD_INIT(.load_fpga_end, NULL),
+    FIELD_INIT(.flash_hash, NULL),
 };
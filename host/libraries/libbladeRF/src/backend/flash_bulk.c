@@ -0,0 +1,198 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include "bladerf_priv.h"
+#include "backend/flash_bulk.h"
+#include "bladeRF.h"    /* Firmware interface */
+#include "log.h"
+#include "minmax.h"
+
+/* Amount of page data moved per bulk transfer. Larger transfers keep the
+ * device's DMA buffers full, but we report progress after each. */
+#define FLASH_BULK_XFER_SIZE    (64 * 1024)
+
+/* Time allotted for the device to complete an operation after the last of
+ * its data has been transferred. Hashing reads all of its pages from the SPI
+ * flash while we wait, so it is allotted an additional amount per page. */
+#define FLASH_BULK_DONE_TIMEOUT_MS  5000
+#define FLASH_HASH_PAGE_TIMEOUT_MS  2
+#define FLASH_BULK_POLL_US          1000
+
+static const char *cmd2str(uint8_t cmd)
+{
+    switch (cmd) {
+        case BLADE_USB_CMD_FLASH_READ_BULK:
+            return "read";
+
+        case BLADE_USB_CMD_FLASH_WRITE_BULK:
+            return "write";
+
+        default:
+            return "hash";
+    }
+}
+
+static int begin(struct bladerf *dev, const struct flash_bulk_ops *ops,
+                 uint8_t cmd, uint16_t page, uint16_t count)
+{
+    int status;
+    int32_t ret;
+
+    status = ops->begin(dev, cmd, page, count, &ret);
+    if (status != 0) {
+        log_debug("Failed to start bulk flash %s: %s\n",
+                  cmd2str(cmd), bladerf_strerror(status));
+        return status;
+    } else if (ret != 0) {
+        log_debug("Device rejected bulk flash %s of %u pages at page %u: "
+                  "%d\n", cmd2str(cmd), count, page, ret);
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    return 0;
+}
+
+/* Wait for the device to report that the current operation is no longer
+ * in progress */
+static int wait_done(struct bladerf *dev, const struct flash_bulk_ops *ops,
+                     unsigned int timeout_ms)
+{
+    int status;
+    int32_t op_status;
+    unsigned int waited_us = 0;
+
+    do {
+        status = ops->status(dev, &op_status);
+        if (status != 0) {
+            return status;
+        }
+
+        switch (op_status) {
+            case FLASH_BULK_STATUS_DONE:
+                return 0;
+
+            case FLASH_BULK_STATUS_BUSY:
+                break;
+
+            default:
+                log_debug("Device reported bulk flash failure: %d\n",
+                          op_status);
+                return BLADERF_ERR_UNEXPECTED;
+        }
+
+        usleep(FLASH_BULK_POLL_US);
+        waited_us += FLASH_BULK_POLL_US;
+    } while (waited_us < (timeout_ms * 1000));
+
+    log_debug("Timed out waiting for bulk flash operation to complete.\n");
+    return BLADERF_ERR_TIMEOUT;
+}
+
+int flash_bulk_read(struct bladerf *dev, const struct flash_bulk_ops *ops,
+                    uint8_t *buf, uint16_t page, uint16_t count)
+{
+    int status;
+    size_t len;
+    size_t offset = 0;
+    const size_t total = (size_t) count * BLADERF_FLASH_PAGE_SIZE;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    status = begin(dev, ops, BLADE_USB_CMD_FLASH_READ_BULK, page, count);
+    if (status != 0) {
+        return status;
+    }
+
+    while (offset < total) {
+        len = min_sz(total - offset, FLASH_BULK_XFER_SIZE);
+
+        status = ops->read(dev, buf + offset, len);
+        if (status != 0) {
+            log_debug("Bulk flash read failed at page %u: %s\n",
+                      page + (unsigned int) (offset / BLADERF_FLASH_PAGE_SIZE),
+                      bladerf_strerror(status));
+            return status;
+        }
+
+        offset += len;
+        log_verbose("Read %u of %u pages\n",
+                    (unsigned int) (offset / BLADERF_FLASH_PAGE_SIZE), count);
+    }
+
+    return wait_done(dev, ops, FLASH_BULK_DONE_TIMEOUT_MS);
+}
+
+int flash_bulk_write(struct bladerf *dev, const struct flash_bulk_ops *ops,
+                     const uint8_t *buf, uint16_t page, uint16_t count)
+{
+    int status;
+    size_t len;
+    size_t offset = 0;
+    const size_t total = (size_t) count * BLADERF_FLASH_PAGE_SIZE;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    status = begin(dev, ops, BLADE_USB_CMD_FLASH_WRITE_BULK, page, count);
+    if (status != 0) {
+        return status;
+    }
+
+    while (offset < total) {
+        len = min_sz(total - offset, FLASH_BULK_XFER_SIZE);
+
+        status = ops->write(dev, buf + offset, len);
+        if (status != 0) {
+            log_debug("Bulk flash write failed at page %u: %s\n",
+                      page + (unsigned int) (offset / BLADERF_FLASH_PAGE_SIZE),
+                      bladerf_strerror(status));
+            return status;
+        }
+
+        offset += len;
+        log_verbose("Wrote %u of %u pages\n",
+                    (unsigned int) (offset / BLADERF_FLASH_PAGE_SIZE), count);
+    }
+
+    return wait_done(dev, ops, FLASH_BULK_DONE_TIMEOUT_MS);
+}
+
+int flash_bulk_hash(struct bladerf *dev, const struct flash_bulk_ops *ops,
+                    uint16_t page, uint16_t count, uint8_t *digest)
+{
+    int status;
+    const unsigned int timeout_ms =
+        FLASH_BULK_DONE_TIMEOUT_MS + count * FLASH_HASH_PAGE_TIMEOUT_MS;
+
+    status = begin(dev, ops, BLADE_USB_CMD_FLASH_HASH, page, count);
+    if (status != 0) {
+        return status;
+    }
+
+    status = wait_done(dev, ops, timeout_ms);
+    if (status != 0) {
+        return status;
+    }
+
+    return ops->hash_result(dev, digest);
+}
@@ -0,0 +1,109 @@
+/**
+ * @file flash_bulk.h
+ *
+ * @brief Bulk flash streaming protocol
+ *
+ * Firmware v1.9.0 and later can stream flash pages over the SPI flash
+ * interface's bulk endpoints, rather than moving one page per set of control
+ * transfers. See BLADE_USB_CMD_FLASH_READ_BULK in firmware_common/bladeRF.h.
+ *
+ * The host side of the protocol is implemented here, in terms of a small set
+ * of transport operations, so that it may be shared by the USB backend and
+ * the simulated device.
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef BACKEND_FLASH_BULK_H_
+#define BACKEND_FLASH_BULK_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct bladerf;
+
+/**
+ * Transport operations used to carry out the protocol. All return 0 on
+ * success and BLADERF_ERR_* on failure.
+ */
+struct flash_bulk_ops {
+    /* Issue BLADE_USB_CMD_FLASH_READ_BULK, BLADE_USB_CMD_FLASH_WRITE_BULK
+     * or BLADE_USB_CMD_FLASH_HASH and return the int32_t the device
+     * responds with in `ret` */
+    int (*begin)(struct bladerf *dev, uint8_t cmd,
+                 uint16_t page, uint16_t count, int32_t *ret);
+
+    /* Transfer page data on the flash IN and OUT bulk endpoints */
+    int (*read)(struct bladerf *dev, uint8_t *buf, size_t len);
+    int (*write)(struct bladerf *dev, const uint8_t *buf, size_t len);
+
+    /* Issue BLADE_USB_CMD_FLASH_BULK_STATUS */
+    int (*status)(struct bladerf *dev, int32_t *status);
+
+    /* Issue BLADE_USB_CMD_FLASH_HASH_RESULT, retrieving FLASH_HASH_SIZE
+     * bytes */
+    int (*hash_result)(struct bladerf *dev, uint8_t *digest);
+};
+
+/**
+ * Read the specified number of flash pages
+ *
+ * @param       dev     Device handle
+ * @param       ops     Transport operations
+ * @param[out]  buf     Buffer to read into. Must be at least
+ *                      count * BLADERF_FLASH_PAGE_SIZE bytes.
+ * @param       page    Page to start reading at
+ * @param       count   Number of pages to read
+ *
+ * @return 0 on success, BLADERF_ERR_* on failure
+ */
+int flash_bulk_read(struct bladerf *dev, const struct flash_bulk_ops *ops,
+                    uint8_t *buf, uint16_t page, uint16_t count);
+
+/**
+ * Write the specified number of flash pages, and wait for the device to
+ * finish programming them
+ *
+ * @param       dev     Device handle
+ * @param       ops     Transport operations
+ * @param[in]   buf     Data to write. Must be at least
+ *                      count * BLADERF_FLASH_PAGE_SIZE bytes.
+ * @param       page    Page to start writing at
+ * @param       count   Number of pages to write
+ *
+ * @return 0 on success, BLADERF_ERR_* on failure
+ */
+int flash_bulk_write(struct bladerf *dev, const struct flash_bulk_ops *ops,
+                     const uint8_t *buf, uint16_t page, uint16_t count);
+
+/**
+ * Compute the SHA-256 digest of the specified flash pages on the device
+ *
+ * @param       dev     Device handle
+ * @param       ops     Transport operations
+ * @param       page    First page to include in the digest
+ * @param       count   Number of pages to include in the digest
+ * @param[out]  digest  Digest of the pages. Must be FLASH_HASH_SIZE bytes.
+ *
+ * @return 0 on success, BLADERF_ERR_* on failure
+ */
+int flash_bulk_hash(struct bladerf *dev, const struct flash_bulk_ops *ops,
+                    uint16_t page, uint16_t count, uint8_t *digest);
+
+#endif
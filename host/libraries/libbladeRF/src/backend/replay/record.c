@@ -0,0 +1,728 @@
+/*
+ * Recorder that wraps a device's backend and logs its traffic to a trace
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "bladerf_priv.h"
+#include "async.h"
+#include "metadata.h"
+#include "flash_fields.h"
+#include "backend/backend.h"
+#include "backend/replay/replay.h"
+#include "backend/replay/trace.h"
+#include "log.h"
+
+struct trace_recorder {
+    struct trace_writer *writer;
+
+    /* Backend being recorded */
+    const struct backend_fns *fn;
+};
+
+/* Per-stream recorder state. The stream's callback is routed through the
+ * recorder so that completed transfers may be logged. */
+struct record_stream {
+    bladerf_stream_cb cb;
+    void *user_data;
+
+    /* Scratch space for a transfer's metadata headers, used when samples
+     * are not being recorded */
+    uint8_t *headers;
+    size_t headers_len;
+};
+
+/* Number of devices recorded thus far, used to name subsequent traces */
+static MUTEX record_count_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int record_count = 0;
+
+extern const struct backend_fns backend_fns_record;
+
+static inline const struct backend_fns *inner(struct bladerf *dev)
+{
+    return dev->recorder->fn;
+}
+
+static inline uint64_t record_now(struct bladerf *dev)
+{
+    return trace_writer_now(dev->recorder->writer);
+}
+
+static void record(struct bladerf *dev, trace_op op, uint8_t module,
+                   int status, uint64_t t_start, uint32_t arg0, uint32_t arg1,
+                   const void *payload, size_t len)
+{
+    struct trace_writer *writer = dev->recorder->writer;
+    struct trace_record rec;
+    const uint64_t duration = trace_writer_now(writer) - t_start;
+
+    rec.op = op;
+    rec.module = module;
+    rec.flags = 0;
+    rec.status = status;
+    rec.time_ns = t_start;
+    rec.duration_ns = duration > UINT32_MAX ? UINT32_MAX : (uint32_t) duration;
+    rec.arg0 = arg0;
+    rec.arg1 = arg1;
+    rec.len = (uint32_t) len;
+
+    trace_write(writer, &rec, payload);
+}
+
+/* Record an operation that has no inputs or outputs beyond its status */
+#define RECORD_STATUS(dev, op, call) do { \
+        const uint64_t t_start_ = record_now(dev); \
+        status = (call); \
+        record(dev, op, TRACE_MODULE_NONE, status, t_start_, 0, 0, NULL, 0); \
+    } while (0)
+
+static bool record_matches(bladerf_backend backend)
+{
+    return false;
+}
+
+static int record_probe(backend_probe_target probe_target,
+                        struct bladerf_devinfo_list *info_list)
+{
+    return 0;
+}
+
+static int record_open(struct bladerf *device, struct bladerf_devinfo *info)
+{
+    return BLADERF_ERR_NODEV;
+}
+
+static void record_close(struct bladerf *dev)
+{
+    struct trace_recorder *recorder = dev->recorder;
+    const uint64_t t_start = record_now(dev);
+
+    recorder->fn->close(dev);
+    record(dev, TRACE_OP_CLOSE, TRACE_MODULE_NONE, 0, t_start, 0, 0, NULL, 0);
+
+    trace_writer_close(recorder->writer);
+    free(recorder);
+    dev->recorder = NULL;
+}
+
+static int record_load_fpga(struct bladerf *dev, uint8_t *image,
+                            size_t image_size)
+{
+    int status;
+    uint8_t version[TRACE_VERSION_SIZE];
+    const uint64_t t_start = record_now(dev);
+
+    status = inner(dev)->load_fpga(dev, image, image_size);
+
+    trace_pack_version(&dev->fpga_version, version);
+    record(dev, TRACE_OP_LOAD_FPGA, TRACE_MODULE_NONE, status, t_start,
+           (uint32_t) image_size, 0, version, sizeof(version));
+
+    return status;
+}
+
+static int record_is_fpga_configured(struct bladerf *dev)
+{
+    int status;
+    uint8_t version[TRACE_VERSION_SIZE];
+    const uint64_t t_start = record_now(dev);
+
+    status = inner(dev)->is_fpga_configured(dev);
+
+    trace_pack_version(&dev->fpga_version, version);
+    record(dev, TRACE_OP_IS_FPGA_CONFIGURED, TRACE_MODULE_NONE, status,
+           t_start, 0, 0, version, sizeof(version));
+
+    return status;
+}
+
+static int record_erase_flash_blocks(struct bladerf *dev,
+                                     uint32_t eb, uint16_t count)
+{
+    int status;
+    const uint64_t t_start = record_now(dev);
+
+    status = inner(dev)->erase_flash_blocks(dev, eb, count);
+    record(dev, TRACE_OP_ERASE_FLASH_BLOCKS, TRACE_MODULE_NONE, status,
+           t_start, eb, count, NULL, 0);
+
+    return status;
+}
+
+static int record_read_flash_pages(struct bladerf *dev, uint8_t *buf,
+                                   uint32_t page, uint32_t count)
+{
+    int status;
+    const uint64_t t_start = record_now(dev);
+
+    status = inner(dev)->read_flash_pages(dev, buf, page, count);
+    record(dev, TRACE_OP_READ_FLASH_PAGES, TRACE_MODULE_NONE, status,
+           t_start, page, count,
+           buf, status == 0 ? count * BLADERF_FLASH_PAGE_SIZE : 0);
+
+    return status;
+}
+
+static int record_write_flash_pages(struct bladerf *dev, const uint8_t *buf,
+                                    uint32_t page, uint32_t count)
+{
+    int status;
+    const uint64_t t_start = record_now(dev);
+
+    status = inner(dev)->write_flash_pages(dev, buf, page, count);
+    record(dev, TRACE_OP_WRITE_FLASH_PAGES, TRACE_MODULE_NONE, status,
+           t_start, page, count, NULL, 0);
+
+    return status;
+}
+
+static int record_device_reset(struct bladerf *dev)
+{
+    int status;
+    RECORD_STATUS(dev, TRACE_OP_DEVICE_RESET, inner(dev)->device_reset(dev));
+    return status;
+}
+
+static int record_jump_to_bootloader(struct bladerf *dev)
+{
+    int status;
+
+    if (inner(dev)->jump_to_bootloader == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    RECORD_STATUS(dev, TRACE_OP_JUMP_TO_BOOTLOADER,
+                  inner(dev)->jump_to_bootloader(dev));
+    return status;
+}
+
+static int record_get_cal(struct bladerf *dev, char *cal)
+{
+    int status;
+    const uint64_t t_start = record_now(dev);
+
+    status = inner(dev)->get_cal(dev, cal);
+    record(dev, TRACE_OP_GET_CAL, TRACE_MODULE_NONE, status, t_start, 0, 0,
+           cal, status == 0 ? CAL_BUFFER_SIZE : 0);
+
+    return status;
+}
+
+static int record_get_otp(struct bladerf *dev, char *otp)
+{
+    int status;
+    const uint64_t t_start = record_now(dev);
+
+    status = inner(dev)->get_otp(dev, otp);
+    record(dev, TRACE_OP_GET_OTP, TRACE_MODULE_NONE, status, t_start, 0, 0,
+           otp, status == 0 ? OTP_BUFFER_SIZE : 0);
+
+    return status;
+}
+
+static int record_get_device_speed(struct bladerf *dev,
+                                   bladerf_dev_speed *speed)
+{
+    int status;
+    const uint64_t t_start = record_now(dev);
+
+    status = inner(dev)->get_device_speed(dev, speed);
+    record(dev, TRACE_OP_GET_DEVICE_SPEED, TRACE_MODULE_NONE, status,
+           t_start, 0, status == 0 ? (uint32_t) *speed : 0, NULL, 0);
+
+    return status;
+}
+
+/* Wrappers for accessors of a single 32-bit value */
+#define RECORD_U32_WRITE(name_, op_) \
+    static int record_##name_(struct bladerf *dev, uint32_t val) \
+    { \
+        int status; \
+        const uint64_t t_start = record_now(dev); \
+        status = inner(dev)->name_(dev, val); \
+        record(dev, op_, TRACE_MODULE_NONE, status, t_start, 0, val, \
+               NULL, 0); \
+        return status; \
+    }
+
+#define RECORD_U32_READ(name_, op_) \
+    static int record_##name_(struct bladerf *dev, uint32_t *val) \
+    { \
+        int status; \
+        const uint64_t t_start = record_now(dev); \
+        status = inner(dev)->name_(dev, val); \
+        record(dev, op_, TRACE_MODULE_NONE, status, t_start, 0, \
+               status == 0 ? *val : 0, NULL, 0); \
+        return status; \
+    }
+
+RECORD_U32_WRITE(config_gpio_write, TRACE_OP_CONFIG_GPIO_WRITE)
+RECORD_U32_READ(config_gpio_read, TRACE_OP_CONFIG_GPIO_READ)
+RECORD_U32_WRITE(expansion_gpio_write, TRACE_OP_EXPANSION_GPIO_WRITE)
+RECORD_U32_READ(expansion_gpio_read, TRACE_OP_EXPANSION_GPIO_READ)
+RECORD_U32_WRITE(expansion_gpio_dir_write, TRACE_OP_EXPANSION_GPIO_DIR_WRITE)
+RECORD_U32_READ(expansion_gpio_dir_read, TRACE_OP_EXPANSION_GPIO_DIR_READ)
+RECORD_U32_WRITE(xb_spi, TRACE_OP_XB_SPI)
+
+static int record_set_correction(struct bladerf *dev, bladerf_module module,
+                                 bladerf_correction corr, int16_t value)
+{
+    int status;
+    const uint64_t t_start = record_now(dev);
+
+    status = inner(dev)->set_correction(dev, module, corr, value);
+    record(dev, TRACE_OP_SET_CORRECTION, module, status, t_start,
+           corr, (uint16_t) value, NULL, 0);
+
+    return status;
+}
+
+static int record_get_correction(struct bladerf *dev, bladerf_module module,
+                                 bladerf_correction corr, int16_t *value)
+{
+    int status;
+    const uint64_t t_start = record_now(dev);
+
+    status = inner(dev)->get_correction(dev, module, corr, value);
+    record(dev, TRACE_OP_GET_CORRECTION, module, status, t_start,
+           corr, status == 0 ? (uint16_t) *value : 0, NULL, 0);
+
+    return status;
+}
+
+static int record_get_timestamp(struct bladerf *dev, bladerf_module module,
+                                uint64_t *value)
+{
+    int status;
+    uint64_t ts;
+    const uint64_t t_start = record_now(dev);
+
+    status = inner(dev)->get_timestamp(dev, module, value);
+    ts = status == 0 ? *value : 0;
+    record(dev, TRACE_OP_GET_TIMESTAMP, module, status, t_start,
+           ts & 0xffffffff, ts >> 32, NULL, 0);
+
+    return status;
+}
+
+/* Wrappers for 8-bit register accessors */
+#define RECORD_REG_WRITE(name_, op_) \
+    static int record_##name_(struct bladerf *dev, uint8_t addr, \
+                              uint8_t data) \
+    { \
+        int status; \
+        const uint64_t t_start = record_now(dev); \
+        status = inner(dev)->name_(dev, addr, data); \
+        record(dev, op_, TRACE_MODULE_NONE, status, t_start, addr, data, \
+               NULL, 0); \
+        return status; \
+    }
+
+#define RECORD_REG_READ(name_, op_) \
+    static int record_##name_(struct bladerf *dev, uint8_t addr, \
+                              uint8_t *data) \
+    { \
+        int status; \
+        const uint64_t t_start = record_now(dev); \
+        status = inner(dev)->name_(dev, addr, data); \
+        record(dev, op_, TRACE_MODULE_NONE, status, t_start, addr, \
+               status == 0 ? *data : 0, NULL, 0); \
+        return status; \
+    }
+
+RECORD_REG_WRITE(si5338_write, TRACE_OP_SI5338_WRITE)
+RECORD_REG_READ(si5338_read, TRACE_OP_SI5338_READ)
+RECORD_REG_WRITE(lms_write, TRACE_OP_LMS_WRITE)
+RECORD_REG_READ(lms_read, TRACE_OP_LMS_READ)
+
+static int record_dac_write(struct bladerf *dev, uint16_t value)
+{
+    int status;
+    const uint64_t t_start = record_now(dev);
+
+    status = inner(dev)->dac_write(dev, value);
+    record(dev, TRACE_OP_DAC_WRITE, TRACE_MODULE_NONE, status, t_start,
+           0, value, NULL, 0);
+
+    return status;
+}
+
+static int record_set_firmware_loopback(struct bladerf *dev, bool enable)
+{
+    int status;
+    const uint64_t t_start = record_now(dev);
+
+    status = inner(dev)->set_firmware_loopback(dev, enable);
+    record(dev, TRACE_OP_SET_FIRMWARE_LOOPBACK, TRACE_MODULE_NONE, status,
+           t_start, 0, enable, NULL, 0);
+
+    return status;
+}
+
+static int record_get_firmware_loopback(struct bladerf *dev, bool *is_enabled)
+{
+    int status;
+    const uint64_t t_start = record_now(dev);
+
+    status = inner(dev)->get_firmware_loopback(dev, is_enabled);
+    record(dev, TRACE_OP_GET_FIRMWARE_LOOPBACK, TRACE_MODULE_NONE, status,
+           t_start, 0, status == 0 ? *is_enabled : 0, NULL, 0);
+
+    return status;
+}
+
+static int record_enable_module(struct bladerf *dev, bladerf_module m,
+                                bool enable)
+{
+    int status;
+    const uint64_t t_start = record_now(dev);
+
+    status = inner(dev)->enable_module(dev, m, enable);
+    record(dev, TRACE_OP_ENABLE_MODULE, m, status, t_start, 0, enable,
+           NULL, 0);
+
+    return status;
+}
+
+/* Log a completed transfer.
+ *
+ * @pre stream->lock is held */
+static void record_transfer(struct bladerf_stream *stream,
+                            struct record_stream *rs,
+                            void *samples, size_t num_samples)
+{
+    struct bladerf *dev = stream->dev;
+    struct trace_writer *writer = dev->recorder->writer;
+    const size_t len = samples_to_bytes(stream->format, num_samples);
+    struct trace_record rec;
+    const void *payload = NULL;
+    size_t i;
+
+    rec.op = stream->module == BLADERF_MODULE_RX ?
+                TRACE_OP_STREAM_RX : TRACE_OP_STREAM_TX;
+    rec.module = stream->module;
+    rec.flags = 0;
+    rec.status = 0;
+    rec.time_ns = trace_writer_now(writer);
+    rec.duration_ns = 0;
+    rec.arg0 = (uint32_t) num_samples;
+    rec.arg1 = 0;
+    rec.len = 0;
+
+    if (writer->samples) {
+        rec.flags |= TRACE_REC_F_SAMPLES;
+        payload = samples;
+        rec.len = (uint32_t) len;
+    } else if (stream->format == BLADERF_FORMAT_SC16_Q11_META) {
+        for (i = 0; (i + 1) * dev->msg_size <= len &&
+                    (i + 1) * METADATA_HEADER_SIZE <= rs->headers_len; i++) {
+            memcpy(&rs->headers[i * METADATA_HEADER_SIZE],
+                   (uint8_t *) samples + i * dev->msg_size,
+                   METADATA_HEADER_SIZE);
+        }
+
+        payload = rs->headers;
+        rec.len = (uint32_t) (i * METADATA_HEADER_SIZE);
+    }
+
+    trace_write(writer, &rec, payload);
+}
+
+static void *record_stream_cb(struct bladerf *dev,
+                              struct bladerf_stream *stream,
+                              struct bladerf_metadata *meta,
+                              void *samples, size_t num_samples,
+                              void *user_data)
+{
+    struct record_stream *rs = user_data;
+
+    if (samples != NULL) {
+        record_transfer(stream, rs, samples, num_samples);
+    }
+
+    return rs->cb(dev, stream, meta, samples, num_samples, rs->user_data);
+}
+
+static int record_init_stream(struct bladerf_stream *stream,
+                              size_t num_transfers)
+{
+    int status;
+    struct bladerf *dev = stream->dev;
+    struct record_stream *rs;
+    struct trace_record rec;
+    const uint64_t t_start = record_now(dev);
+
+    status = inner(dev)->init_stream(stream, num_transfers);
+
+    memset(&rec, 0, sizeof(rec));
+    rec.op = TRACE_OP_STREAM_INIT;
+    rec.module = TRACE_MODULE_NONE;
+    rec.flags = (uint16_t) stream->format;
+    rec.status = status;
+    rec.time_ns = t_start;
+    rec.arg0 = (uint32_t) num_transfers;
+    rec.arg1 = (uint32_t) stream->samples_per_buffer;
+    trace_write(dev->recorder->writer, &rec, NULL);
+
+    if (status != 0) {
+        return status;
+    }
+
+    rs = calloc(1, sizeof(*rs));
+    if (rs == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    if (stream->format == BLADERF_FORMAT_SC16_Q11_META && dev->msg_size != 0) {
+        rs->headers_len = METADATA_HEADER_SIZE *
+            (async_stream_buf_bytes(stream) / dev->msg_size);
+
+        rs->headers = malloc(rs->headers_len);
+        if (rs->headers == NULL) {
+            free(rs);
+            return BLADERF_ERR_MEM;
+        }
+    }
+
+    rs->cb = stream->cb;
+    rs->user_data = stream->user_data;
+    stream->cb = record_stream_cb;
+    stream->user_data = rs;
+
+    return 0;
+}
+
+static int record_stream(struct bladerf_stream *stream, bladerf_module module)
+{
+    int status;
+    struct bladerf *dev = stream->dev;
+    const uint64_t t_start = record_now(dev);
+
+    record(dev, TRACE_OP_STREAM_START, module, 0, t_start, 0, 0, NULL, 0);
+
+    status = inner(dev)->stream(stream, module);
+
+    record(dev, TRACE_OP_STREAM_END, module, status, t_start,
+           (uint32_t) stream->error_code, 0, NULL, 0);
+
+    return status;
+}
+
+static int record_submit_stream_buffer(struct bladerf_stream *stream,
+                                       void *buffer, unsigned int timeout_ms)
+{
+    return inner(stream->dev)->submit_stream_buffer(stream, buffer,
+                                                    timeout_ms);
+}
+
+static void record_deinit_stream(struct bladerf_stream *stream)
+{
+    struct record_stream *rs;
+
+    if (stream->cb == record_stream_cb) {
+        rs = stream->user_data;
+        stream->cb = rs->cb;
+        stream->user_data = rs->user_data;
+        free(rs->headers);
+        free(rs);
+    }
+
+    inner(stream->dev)->deinit_stream(stream);
+}
+
+static int record_load_fw_from_bootloader(bladerf_backend backend,
+                                          uint8_t bus, uint8_t addr,
+                                          struct fx3_firmware *fw)
+{
+    return BLADERF_ERR_UNSUPPORTED;
+}
+
+/* USB tracing is passed through to the wrapped backend, without recording */
+static int record_enable_trace(struct bladerf *dev, bool enable)
+{
+    if (inner(dev)->enable_trace == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    return inner(dev)->enable_trace(dev, enable);
+}
+
+static int record_get_trace_stats(struct bladerf *dev,
+                                  struct bladerf_usb_stats *stats,
+                                  unsigned int count)
+{
+    if (inner(dev)->get_trace_stats == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    return inner(dev)->get_trace_stats(dev, stats, count);
+}
+
+static int record_write_trace(struct bladerf *dev, const char *filename)
+{
+    if (inner(dev)->write_trace == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    return inner(dev)->write_trace(dev, filename);
+}
+
+void record_attach(struct bladerf *dev)
+{
+    int status;
+    const char *env;
+    char *path;
+    bool samples;
+    unsigned int count;
+    struct trace_recorder *recorder;
+    uint8_t devstate[TRACE_DEVSTATE_SIZE];
+
+    env = getenv(REPLAY_ENV_RECORD);
+    if (env == NULL || env[0] == '\0') {
+        return;
+    }
+
+    if (dev->ident.backend == BLADERF_BACKEND_REPLAY) {
+        log_debug("Not recording a replayed trace.\n");
+        return;
+    }
+
+    MUTEX_LOCK(&record_count_lock);
+    count = record_count++;
+    MUTEX_UNLOCK(&record_count_lock);
+
+    path = malloc(strlen(env) + 12);
+    if (path == NULL) {
+        log_warning("Failed to allocate trace path. Not recording.\n");
+        return;
+    }
+
+    if (count == 0) {
+        strcpy(path, env);
+    } else {
+        sprintf(path, "%s.%u", env, count);
+    }
+
+    recorder = calloc(1, sizeof(*recorder));
+    if (recorder == NULL) {
+        log_warning("Failed to allocate recorder. Not recording.\n");
+        free(path);
+        return;
+    }
+
+    env = getenv(REPLAY_ENV_RECORD_SAMPLES);
+    samples = (env == NULL || strcmp(env, "0") != 0);
+
+    status = trace_writer_open(&recorder->writer, path, samples);
+    if (status != 0) {
+        log_warning("Failed to create trace %s: %s. Not recording.\n",
+                    path, bladerf_strerror(status));
+        free(recorder);
+        free(path);
+        return;
+    }
+
+    recorder->fn = dev->fn;
+    dev->recorder = recorder;
+    dev->fn = &backend_fns_record;
+
+    trace_pack_devstate(dev, devstate);
+    record(dev, TRACE_OP_OPEN, TRACE_MODULE_NONE, 0, 0, 0, 0,
+           devstate, sizeof(devstate));
+
+    log_info("Recording device traffic to %s\n", path);
+    free(path);
+}
+
+const struct backend_fns backend_fns_record = {
+    FIELD_INIT(.matches, record_matches),
+
+    FIELD_INIT(.probe, record_probe),
+
+    FIELD_INIT(.open, record_open),
+    FIELD_INIT(.close, record_close),
+
+    FIELD_INIT(.load_fpga, record_load_fpga),
+    FIELD_INIT(.is_fpga_configured, record_is_fpga_configured),
+
+    FIELD_INIT(.erase_flash_blocks, record_erase_flash_blocks),
+    FIELD_INIT(.read_flash_pages, record_read_flash_pages),
+    FIELD_INIT(.write_flash_pages, record_write_flash_pages),
+
+    FIELD_INIT(.device_reset, record_device_reset),
+    FIELD_INIT(.jump_to_bootloader, record_jump_to_bootloader),
+
+    FIELD_INIT(.get_cal, record_get_cal),
+    FIELD_INIT(.get_otp, record_get_otp),
+    FIELD_INIT(.get_device_speed, record_get_device_speed),
+
+    FIELD_INIT(.config_gpio_write, record_config_gpio_write),
+    FIELD_INIT(.config_gpio_read, record_config_gpio_read),
+
+    FIELD_INIT(.expansion_gpio_write, record_expansion_gpio_write),
+    FIELD_INIT(.expansion_gpio_read, record_expansion_gpio_read),
+    FIELD_INIT(.expansion_gpio_dir_write, record_expansion_gpio_dir_write),
+    FIELD_INIT(.expansion_gpio_dir_read, record_expansion_gpio_dir_read),
+
+    FIELD_INIT(.set_correction, record_set_correction),
+    FIELD_INIT(.get_correction, record_get_correction),
+
+    FIELD_INIT(.get_timestamp, record_get_timestamp),
+
+    FIELD_INIT(.si5338_write, record_si5338_write),
+    FIELD_INIT(.si5338_read, record_si5338_read),
+
+    FIELD_INIT(.lms_write, record_lms_write),
+    FIELD_INIT(.lms_read, record_lms_read),
+
+    FIELD_INIT(.dac_write, record_dac_write),
+
+    FIELD_INIT(.xb_spi, record_xb_spi),
+
+    FIELD_INIT(.set_firmware_loopback, record_set_firmware_loopback),
+    FIELD_INIT(.get_firmware_loopback, record_get_firmware_loopback),
+
+    FIELD_INIT(.enable_module, record_enable_module),
+
+    FIELD_INIT(.init_stream, record_init_stream),
+    FIELD_INIT(.stream, record_stream),
+    FIELD_INIT(.submit_stream_buffer, record_submit_stream_buffer),
+    FIELD_INIT(.deinit_stream, record_deinit_stream),
+
+    FIELD_INIT(.load_fw_from_bootloader, record_load_fw_from_bootloader),
+
+    FIELD_INIT(.enable_trace, record_enable_trace),
+    FIELD_INIT(.get_trace_stats, record_get_trace_stats),
+    FIELD_INIT(.write_trace, record_write_trace),
+
+    FIELD_INIT(.lms_write_regs, NULL),
+    FIELD_INIT(.lms_read_regs, NULL),
+    FIELD_INIT(.lms_dc_cal_loop, NULL),
+
+    FIELD_INIT(.si5338_write_regs, NULL),
+    FIELD_INIT(.si5338_read_regs, NULL),
+
+    FIELD_INIT(.load_fpga_begin, NULL),
+    FIELD_INIT(.load_fpga_write, NULL),
+    FIELD_INIT(.load_fpga_end, NULL),
+    FIELD_INIT(.flash_hash, NULL),
+};
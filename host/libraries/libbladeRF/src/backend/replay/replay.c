@@ -0,0 +1,1265 @@
+/*
+ * Backend that replays a recorded device trace
+ *
+ * Backend operations are matched, in order, against the operations in the
+ * trace, and the recorded results are returned. If the host code being
+ * exercised has changed since the trace was recorded, calls may no longer
+ * line up with the trace exactly. Records that are skipped over are
+ * tolerated, up to REPLAY_RESYNC_WINDOW records. Calls that cannot be
+ * matched at all are served from device state tracked while replaying
+ * (e.g., the last value written to or read from a register). The number of
+ * such divergences is reported when the device is closed.
+ *
+ * Stream transfers are replayed independently of the control operations:
+ * RX transfers are filled from the trace's RX records, in order, and TX
+ * transfers are consumed and discarded.
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "bladerf_priv.h"
+#include "async.h"
+#include "metadata.h"
+#include "flash_fields.h"
+#include "backend/backend.h"
+#include "backend/replay/replay.h"
+#include "backend/replay/trace.h"
+#include "log.h"
+
+/* Maximum number of recorded operations that may be skipped when searching
+ * for the one matching a call */
+#define REPLAY_RESYNC_WINDOW    64
+
+/* Interval at which an idle stream re-checks its state */
+#define REPLAY_IDLE_WAIT_MS     100
+
+#define REPLAY_NUM_CORRECTIONS  (BLADERF_CORR_FPGA_GAIN + 1)
+
+extern const struct backend_fns backend_fns_replay;
+
+typedef enum {
+    REPLAY_TIMING_NONE,     /* Replay everything as quickly as possible */
+    REPLAY_TIMING_STREAM,   /* Reproduce stream transfer arrival times */
+    REPLAY_TIMING_ALL,      /* ...and the durations of control operations */
+} replay_timing;
+
+struct replay_op {
+    struct trace_record rec;
+    uint8_t *payload;
+};
+
+struct bladerf_replay {
+    MUTEX lock;
+
+    replay_timing timing;
+
+    /* Recorded control operations, and the index of the next one expected */
+    struct replay_op *ops;
+    size_t num_ops;
+    size_t cursor;
+
+    /* Per-module readers of the trace's stream records */
+    FILE *stream_file[NUM_MODULES];
+
+    /* Device state tracked from replayed operations, used to serve calls
+     * that do not match the trace */
+    uint8_t lms[128];
+    uint8_t si5338[256];
+    uint32_t config_gpio;
+    uint32_t xb_gpio;
+    uint32_t xb_gpio_dir;
+    int16_t corr[NUM_MODULES][REPLAY_NUM_CORRECTIONS];
+    bool fw_loopback;
+    bladerf_dev_speed speed;
+    uint64_t timestamp[NUM_MODULES];
+
+    /* Replay statistics */
+    unsigned int matched;
+    unsigned int skipped;
+    unsigned int diverged;
+};
+
+struct replay_stream_data {
+    /* Submitted transfers, in the order they will complete */
+    void **queue;
+    size_t num_transfers;
+    size_t num_avail;
+    size_t head;
+
+    /* Signaled when a transfer is submitted */
+    pthread_cond_t submitted;
+
+    /* Trace and wall-clock times of the first replayed transfer, used to
+     * reproduce the recorded transfer timing */
+    bool t_valid;
+    uint64_t trace_t0;
+    struct timespec wall_t0;
+};
+
+static inline struct bladerf_replay *replay_backend(struct bladerf *dev)
+{
+    return (struct bladerf_replay *) dev->backend;
+}
+
+static inline bool is_stream_op(uint8_t op)
+{
+    return op >= TRACE_OP_STREAM_INIT && op <= TRACE_OP_STREAM_END;
+}
+
+static void sleep_ns(uint64_t ns)
+{
+    if (ns >= 1000) {
+        usleep((unsigned int) (ns / 1000));
+    }
+}
+
+/* Find the recorded operation corresponding to a call. Returns NULL if no
+ * match is found within REPLAY_RESYNC_WINDOW records.
+ *
+ * @pre r->lock is held */
+static const struct trace_record *match(struct bladerf_replay *r,
+                                        trace_op op, uint8_t module,
+                                        uint32_t arg0, bool match_arg0)
+{
+    size_t i;
+    const struct trace_record *rec;
+
+    for (i = r->cursor;
+         i < r->num_ops && i < r->cursor + REPLAY_RESYNC_WINDOW; i++) {
+
+        rec = &r->ops[i].rec;
+
+        if (rec->op == op && rec->module == module &&
+            (!match_arg0 || rec->arg0 == arg0)) {
+
+            if (i != r->cursor) {
+                log_verbose("Replay: skipped %u recorded operations\n",
+                            (unsigned int) (i - r->cursor));
+                r->skipped += (unsigned int) (i - r->cursor);
+            }
+
+            r->cursor = i + 1;
+            r->matched++;
+            return rec;
+        }
+    }
+
+    log_verbose("Replay: no recorded operation matches call (op=%u, "
+                "arg0=0x%x)\n", (unsigned int) op, arg0);
+    r->diverged++;
+    return NULL;
+}
+
+/* Get the payload of a record returned by match() */
+static inline const uint8_t *payload_of(const struct trace_record *rec)
+{
+    return ((const struct replay_op *) rec)->payload;
+}
+
+/* Reproduce the recorded duration of an operation, if requested */
+static inline void delay(struct bladerf_replay *r,
+                         const struct trace_record *rec)
+{
+    if (r->timing == REPLAY_TIMING_ALL && rec != NULL) {
+        sleep_ns(rec->duration_ns);
+    }
+}
+
+static int load_trace(struct bladerf_replay *r, FILE *file,
+                      uint8_t *devstate)
+{
+    int status;
+    size_t capacity = 0;
+    struct trace_record rec;
+    struct replay_op *tmp;
+    uint8_t *payload;
+    bool opened = false;
+
+    while ((status = trace_read_record(file, &rec)) == 0) {
+
+        if (!opened) {
+            if (rec.op != TRACE_OP_OPEN || rec.len != TRACE_DEVSTATE_SIZE) {
+                log_error("Trace does not begin with a device open.\n");
+                return BLADERF_ERR_INVAL;
+            }
+
+            if (fread(devstate, TRACE_DEVSTATE_SIZE, 1, file) != 1) {
+                return BLADERF_ERR_IO;
+            }
+
+            opened = true;
+            continue;
+        }
+
+        if (is_stream_op(rec.op) || rec.op == TRACE_OP_CLOSE) {
+            if (rec.len != 0 && fseek(file, rec.len, SEEK_CUR) != 0) {
+                return BLADERF_ERR_IO;
+            }
+            continue;
+        }
+
+        payload = NULL;
+        if (rec.len != 0) {
+            payload = malloc(rec.len);
+            if (payload == NULL) {
+                return BLADERF_ERR_MEM;
+            }
+
+            if (fread(payload, rec.len, 1, file) != 1) {
+                free(payload);
+                return BLADERF_ERR_IO;
+            }
+        }
+
+        if (r->num_ops == capacity) {
+            capacity = capacity == 0 ? 1024 : 2 * capacity;
+            tmp = realloc(r->ops, capacity * sizeof(r->ops[0]));
+            if (tmp == NULL) {
+                free(payload);
+                return BLADERF_ERR_MEM;
+            }
+            r->ops = tmp;
+        }
+
+        r->ops[r->num_ops].rec = rec;
+        r->ops[r->num_ops].payload = payload;
+        r->num_ops++;
+    }
+
+    if (status < 0) {
+        return status;
+    } else if (!opened) {
+        log_error("Trace contains no records.\n");
+        return BLADERF_ERR_INVAL;
+    }
+
+    return 0;
+}
+
+static void replay_free(struct bladerf_replay *r)
+{
+    size_t i;
+
+    for (i = 0; i < r->num_ops; i++) {
+        free(r->ops[i].payload);
+    }
+    free(r->ops);
+
+    for (i = 0; i < NUM_MODULES; i++) {
+        if (r->stream_file[i] != NULL) {
+            fclose(r->stream_file[i]);
+        }
+    }
+
+    free(r);
+}
+
+static bool replay_matches(bladerf_backend backend)
+{
+    return backend == BLADERF_BACKEND_REPLAY;
+}
+
+/* Traces are only replayed when explicitly requested, so nothing is ever
+ * reported when probing */
+static int replay_probe(backend_probe_target probe_target,
+                        struct bladerf_devinfo_list *info_list)
+{
+    return 0;
+}
+
+static int replay_open(struct bladerf *dev, struct bladerf_devinfo *info)
+{
+    int status;
+    size_t i;
+    const char *path;
+    const char *env;
+    FILE *file = NULL;
+    uint32_t flags;
+    struct bladerf_replay *r;
+    uint8_t devstate[TRACE_DEVSTATE_SIZE];
+
+    if (info->backend != BLADERF_BACKEND_REPLAY) {
+        return BLADERF_ERR_NODEV;
+    }
+
+    path = getenv(REPLAY_ENV_TRACE);
+    if (path == NULL || path[0] == '\0') {
+        log_error("%s must specify the trace to replay.\n", REPLAY_ENV_TRACE);
+        return BLADERF_ERR_INVAL;
+    }
+
+    r = calloc(1, sizeof(*r));
+    if (r == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    MUTEX_INIT(&r->lock);
+    r->speed = BLADERF_DEVICE_SPEED_SUPER;
+
+    env = getenv(REPLAY_ENV_TIMING);
+    if (env == NULL || !strcasecmp(env, "stream")) {
+        r->timing = REPLAY_TIMING_STREAM;
+    } else if (!strcasecmp(env, "all")) {
+        r->timing = REPLAY_TIMING_ALL;
+    } else if (!strcasecmp(env, "none")) {
+        r->timing = REPLAY_TIMING_NONE;
+    } else {
+        log_error("Invalid %s value: %s\n", REPLAY_ENV_TIMING, env);
+        status = BLADERF_ERR_INVAL;
+        goto error;
+    }
+
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        log_error("Failed to open trace %s: %s\n", path, strerror(errno));
+        status = BLADERF_ERR_IO;
+        goto error;
+    }
+
+    status = trace_read_header(file, &flags);
+    if (status != 0) {
+        log_error("%s is not a valid trace.\n", path);
+        goto error;
+    }
+
+    status = load_trace(r, file, devstate);
+    if (status != 0) {
+        log_error("Failed to load trace %s: %s\n",
+                  path, bladerf_strerror(status));
+        goto error;
+    }
+
+    for (i = 0; i < NUM_MODULES; i++) {
+        r->stream_file[i] = fopen(path, "rb");
+        if (r->stream_file[i] == NULL) {
+            status = BLADERF_ERR_IO;
+            goto error;
+        }
+
+        status = trace_read_header(r->stream_file[i], &flags);
+        if (status != 0) {
+            goto error;
+        }
+    }
+
+    trace_unpack_devstate(dev, devstate);
+    dev->ident.backend = BLADERF_BACKEND_REPLAY;
+
+    if (!bladerf_instance_matches(info, &dev->ident) ||
+        !bladerf_serial_matches(info, &dev->ident)) {
+        status = BLADERF_ERR_NODEV;
+        goto error;
+    }
+
+    fclose(file);
+
+    dev->fn = &backend_fns_replay;
+    dev->backend = r;
+
+    log_debug("Replaying %u operations from %s%s\n",
+              (unsigned int) r->num_ops, path,
+              (flags & TRACE_FILE_F_SAMPLES) ? "" : " (no samples)");
+
+    return 0;
+
+error:
+    if (file != NULL) {
+        fclose(file);
+    }
+
+    replay_free(r);
+    return status;
+}
+
+static void replay_close(struct bladerf *dev)
+{
+    struct bladerf_replay *r = replay_backend(dev);
+
+    if (r != NULL) {
+        if (r->diverged != 0 || r->skipped != 0) {
+            log_warning("Replay diverged from trace: %u calls matched, "
+                        "%u unmatched, %u recorded operations skipped.\n",
+                        r->matched, r->diverged, r->skipped);
+        } else {
+            log_debug("Replay: all %u calls matched the trace.\n",
+                      r->matched);
+        }
+
+        replay_free(r);
+        dev->backend = NULL;
+    }
+}
+
+static int replay_load_fpga(struct bladerf *dev, uint8_t *image,
+                            size_t image_size)
+{
+    struct bladerf_replay *r = replay_backend(dev);
+    const struct trace_record *rec;
+    int status = 0;
+
+    MUTEX_LOCK(&r->lock);
+    rec = match(r, TRACE_OP_LOAD_FPGA, TRACE_MODULE_NONE, 0, false);
+    if (rec != NULL) {
+        status = rec->status;
+        if (rec->len == TRACE_VERSION_SIZE) {
+            trace_unpack_version(&dev->fpga_version, payload_of(rec));
+        }
+    }
+    MUTEX_UNLOCK(&r->lock);
+
+    delay(r, rec);
+    return status;
+}
+
+static int replay_is_fpga_configured(struct bladerf *dev)
+{
+    struct bladerf_replay *r = replay_backend(dev);
+    const struct trace_record *rec;
+    int status = 1;
+
+    MUTEX_LOCK(&r->lock);
+    rec = match(r, TRACE_OP_IS_FPGA_CONFIGURED, TRACE_MODULE_NONE, 0, false);
+    if (rec != NULL) {
+        status = rec->status;
+        if (rec->len == TRACE_VERSION_SIZE) {
+            trace_unpack_version(&dev->fpga_version, payload_of(rec));
+        }
+    }
+    MUTEX_UNLOCK(&r->lock);
+
+    delay(r, rec);
+    return status;
+}
+
+/* Replay an operation that has no outputs beyond its status */
+static int replay_status(struct bladerf *dev, trace_op op, uint8_t module,
+                         uint32_t arg0, bool match_arg0)
+{
+    struct bladerf_replay *r = replay_backend(dev);
+    const struct trace_record *rec;
+    int status = 0;
+
+    MUTEX_LOCK(&r->lock);
+    rec = match(r, op, module, arg0, match_arg0);
+    if (rec != NULL) {
+        status = rec->status;
+    }
+    MUTEX_UNLOCK(&r->lock);
+
+    delay(r, rec);
+    return status;
+}
+
+/* Replay an operation that reads a block of data. Unmatched reads return
+ * erased (0xff) data. */
+static int replay_data(struct bladerf *dev, trace_op op,
+                       uint32_t arg0, bool match_arg0,
+                       void *buf, size_t len)
+{
+    struct bladerf_replay *r = replay_backend(dev);
+    const struct trace_record *rec;
+    int status = 0;
+
+    MUTEX_LOCK(&r->lock);
+    rec = match(r, op, TRACE_MODULE_NONE, arg0, match_arg0);
+    if (rec != NULL) {
+        status = rec->status;
+    }
+
+    if (rec != NULL && rec->len == len) {
+        memcpy(buf, payload_of(rec), len);
+    } else if (status == 0) {
+        memset(buf, 0xff, len);
+    }
+    MUTEX_UNLOCK(&r->lock);
+
+    delay(r, rec);
+    return status;
+}
+
+static int replay_erase_flash_blocks(struct bladerf *dev,
+                                     uint32_t eb, uint16_t count)
+{
+    return replay_status(dev, TRACE_OP_ERASE_FLASH_BLOCKS,
+                         TRACE_MODULE_NONE, eb, true);
+}
+
+static int replay_read_flash_pages(struct bladerf *dev, uint8_t *buf,
+                                   uint32_t page, uint32_t count)
+{
+    return replay_data(dev, TRACE_OP_READ_FLASH_PAGES, page, true,
+                       buf, count * BLADERF_FLASH_PAGE_SIZE);
+}
+
+static int replay_write_flash_pages(struct bladerf *dev, const uint8_t *buf,
+                                    uint32_t page, uint32_t count)
+{
+    return replay_status(dev, TRACE_OP_WRITE_FLASH_PAGES,
+                         TRACE_MODULE_NONE, page, true);
+}
+
+static int replay_device_reset(struct bladerf *dev)
+{
+    return replay_status(dev, TRACE_OP_DEVICE_RESET,
+                         TRACE_MODULE_NONE, 0, false);
+}
+
+static int replay_jump_to_bootloader(struct bladerf *dev)
+{
+    return replay_status(dev, TRACE_OP_JUMP_TO_BOOTLOADER,
+                         TRACE_MODULE_NONE, 0, false);
+}
+
+static int replay_get_cal(struct bladerf *dev, char *cal)
+{
+    return replay_data(dev, TRACE_OP_GET_CAL, 0, false, cal, CAL_BUFFER_SIZE);
+}
+
+static int replay_get_otp(struct bladerf *dev, char *otp)
+{
+    return replay_data(dev, TRACE_OP_GET_OTP, 0, false, otp, OTP_BUFFER_SIZE);
+}
+
+static int replay_get_device_speed(struct bladerf *dev,
+                                   bladerf_dev_speed *speed)
+{
+    struct bladerf_replay *r = replay_backend(dev);
+    const struct trace_record *rec;
+    int status = 0;
+
+    MUTEX_LOCK(&r->lock);
+    rec = match(r, TRACE_OP_GET_DEVICE_SPEED, TRACE_MODULE_NONE, 0, false);
+    if (rec != NULL) {
+        status = rec->status;
+        if (status == 0) {
+            r->speed = (bladerf_dev_speed) rec->arg1;
+        }
+    }
+    *speed = r->speed;
+    MUTEX_UNLOCK(&r->lock);
+
+    delay(r, rec);
+    return status;
+}
+
+/* Replay a write of a 32-bit value, tracking the written value in *shadow */
+static int replay_u32_write(struct bladerf *dev, trace_op op,
+                            uint32_t *shadow, uint32_t val)
+{
+    struct bladerf_replay *r = replay_backend(dev);
+    const struct trace_record *rec;
+    int status = 0;
+
+    MUTEX_LOCK(&r->lock);
+    rec = match(r, op, TRACE_MODULE_NONE, 0, false);
+    if (rec != NULL) {
+        status = rec->status;
+    }
+
+    if (status == 0 && shadow != NULL) {
+        *shadow = val;
+    }
+    MUTEX_UNLOCK(&r->lock);
+
+    delay(r, rec);
+    return status;
+}
+
+/* Replay a read of a 32-bit value, tracked in *shadow */
+static int replay_u32_read(struct bladerf *dev, trace_op op,
+                           uint32_t *shadow, uint32_t *val)
+{
+    struct bladerf_replay *r = replay_backend(dev);
+    const struct trace_record *rec;
+    int status = 0;
+
+    MUTEX_LOCK(&r->lock);
+    rec = match(r, op, TRACE_MODULE_NONE, 0, false);
+    if (rec != NULL) {
+        status = rec->status;
+        if (status == 0) {
+            *shadow = rec->arg1;
+        }
+    }
+    *val = *shadow;
+    MUTEX_UNLOCK(&r->lock);
+
+    delay(r, rec);
+    return status;
+}
+
+static int replay_config_gpio_write(struct bladerf *dev, uint32_t val)
+{
+    return replay_u32_write(dev, TRACE_OP_CONFIG_GPIO_WRITE,
+                            &replay_backend(dev)->config_gpio, val);
+}
+
+static int replay_config_gpio_read(struct bladerf *dev, uint32_t *val)
+{
+    return replay_u32_read(dev, TRACE_OP_CONFIG_GPIO_READ,
+                           &replay_backend(dev)->config_gpio, val);
+}
+
+static int replay_expansion_gpio_write(struct bladerf *dev, uint32_t val)
+{
+    return replay_u32_write(dev, TRACE_OP_EXPANSION_GPIO_WRITE,
+                            &replay_backend(dev)->xb_gpio, val);
+}
+
+static int replay_expansion_gpio_read(struct bladerf *dev, uint32_t *val)
+{
+    return replay_u32_read(dev, TRACE_OP_EXPANSION_GPIO_READ,
+                           &replay_backend(dev)->xb_gpio, val);
+}
+
+static int replay_expansion_gpio_dir_write(struct bladerf *dev, uint32_t val)
+{
+    return replay_u32_write(dev, TRACE_OP_EXPANSION_GPIO_DIR_WRITE,
+                            &replay_backend(dev)->xb_gpio_dir, val);
+}
+
+static int replay_expansion_gpio_dir_read(struct bladerf *dev, uint32_t *val)
+{
+    return replay_u32_read(dev, TRACE_OP_EXPANSION_GPIO_DIR_READ,
+                           &replay_backend(dev)->xb_gpio_dir, val);
+}
+
+static int replay_set_correction(struct bladerf *dev, bladerf_module module,
+                                 bladerf_correction corr, int16_t value)
+{
+    struct bladerf_replay *r = replay_backend(dev);
+    const struct trace_record *rec;
+    int status = 0;
+
+    if (module >= NUM_MODULES || corr >= REPLAY_NUM_CORRECTIONS) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    MUTEX_LOCK(&r->lock);
+    rec = match(r, TRACE_OP_SET_CORRECTION, module, corr, true);
+    if (rec != NULL) {
+        status = rec->status;
+    }
+
+    if (status == 0) {
+        r->corr[module][corr] = value;
+    }
+    MUTEX_UNLOCK(&r->lock);
+
+    delay(r, rec);
+    return status;
+}
+
+static int replay_get_correction(struct bladerf *dev, bladerf_module module,
+                                 bladerf_correction corr, int16_t *value)
+{
+    struct bladerf_replay *r = replay_backend(dev);
+    const struct trace_record *rec;
+    int status = 0;
+
+    if (module >= NUM_MODULES || corr >= REPLAY_NUM_CORRECTIONS) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    MUTEX_LOCK(&r->lock);
+    rec = match(r, TRACE_OP_GET_CORRECTION, module, corr, true);
+    if (rec != NULL) {
+        status = rec->status;
+        if (status == 0) {
+            r->corr[module][corr] = (int16_t) rec->arg1;
+        }
+    }
+    *value = r->corr[module][corr];
+    MUTEX_UNLOCK(&r->lock);
+
+    delay(r, rec);
+    return status;
+}
+
+static int replay_get_timestamp(struct bladerf *dev, bladerf_module module,
+                                uint64_t *value)
+{
+    struct bladerf_replay *r = replay_backend(dev);
+    const struct trace_record *rec;
+    int status = 0;
+
+    if (module >= NUM_MODULES) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    MUTEX_LOCK(&r->lock);
+    rec = match(r, TRACE_OP_GET_TIMESTAMP, module, 0, false);
+    if (rec != NULL) {
+        status = rec->status;
+        if (status == 0) {
+            r->timestamp[module] = ((uint64_t) rec->arg1 << 32) | rec->arg0;
+        }
+    }
+    *value = r->timestamp[module];
+    MUTEX_UNLOCK(&r->lock);
+
+    delay(r, rec);
+    return status;
+}
+
+/* Replay a write to an 8-bit register, tracked in regs[addr] */
+static int replay_reg_write(struct bladerf *dev, trace_op op, uint8_t *regs,
+                            uint8_t addr, uint8_t data)
+{
+    struct bladerf_replay *r = replay_backend(dev);
+    const struct trace_record *rec;
+    int status = 0;
+
+    MUTEX_LOCK(&r->lock);
+    rec = match(r, op, TRACE_MODULE_NONE, addr, true);
+    if (rec != NULL) {
+        status = rec->status;
+    }
+
+    if (status == 0) {
+        regs[addr] = data;
+    }
+    MUTEX_UNLOCK(&r->lock);
+
+    delay(r, rec);
+    return status;
+}
+
+/* Replay a read of an 8-bit register, tracked in regs[addr] */
+static int replay_reg_read(struct bladerf *dev, trace_op op, uint8_t *regs,
+                           uint8_t addr, uint8_t *data)
+{
+    struct bladerf_replay *r = replay_backend(dev);
+    const struct trace_record *rec;
+    int status = 0;
+
+    MUTEX_LOCK(&r->lock);
+    rec = match(r, op, TRACE_MODULE_NONE, addr, true);
+    if (rec != NULL) {
+        status = rec->status;
+        if (status == 0) {
+            regs[addr] = (uint8_t) rec->arg1;
+        }
+    }
+    *data = regs[addr];
+    MUTEX_UNLOCK(&r->lock);
+
+    delay(r, rec);
+    return status;
+}
+
+static int replay_si5338_write(struct bladerf *dev, uint8_t addr, uint8_t data)
+{
+    return replay_reg_write(dev, TRACE_OP_SI5338_WRITE,
+                            replay_backend(dev)->si5338, addr, data);
+}
+
+static int replay_si5338_read(struct bladerf *dev, uint8_t addr, uint8_t *data)
+{
+    return replay_reg_read(dev, TRACE_OP_SI5338_READ,
+                           replay_backend(dev)->si5338, addr, data);
+}
+
+static int replay_lms_write(struct bladerf *dev, uint8_t addr, uint8_t data)
+{
+    return replay_reg_write(dev, TRACE_OP_LMS_WRITE,
+                            replay_backend(dev)->lms, addr & 0x7f, data);
+}
+
+static int replay_lms_read(struct bladerf *dev, uint8_t addr, uint8_t *data)
+{
+    return replay_reg_read(dev, TRACE_OP_LMS_READ,
+                           replay_backend(dev)->lms, addr & 0x7f, data);
+}
+
+static int replay_dac_write(struct bladerf *dev, uint16_t value)
+{
+    return replay_u32_write(dev, TRACE_OP_DAC_WRITE, NULL, value);
+}
+
+static int replay_xb_spi(struct bladerf *dev, uint32_t value)
+{
+    return replay_u32_write(dev, TRACE_OP_XB_SPI, NULL, value);
+}
+
+static int replay_set_firmware_loopback(struct bladerf *dev, bool enable)
+{
+    struct bladerf_replay *r = replay_backend(dev);
+    const struct trace_record *rec;
+    int status = 0;
+
+    MUTEX_LOCK(&r->lock);
+    rec = match(r, TRACE_OP_SET_FIRMWARE_LOOPBACK, TRACE_MODULE_NONE,
+                0, false);
+    if (rec != NULL) {
+        status = rec->status;
+    }
+
+    if (status == 0) {
+        r->fw_loopback = enable;
+    }
+    MUTEX_UNLOCK(&r->lock);
+
+    delay(r, rec);
+    return status;
+}
+
+static int replay_get_firmware_loopback(struct bladerf *dev, bool *is_enabled)
+{
+    struct bladerf_replay *r = replay_backend(dev);
+    const struct trace_record *rec;
+    int status = 0;
+
+    MUTEX_LOCK(&r->lock);
+    rec = match(r, TRACE_OP_GET_FIRMWARE_LOOPBACK, TRACE_MODULE_NONE,
+                0, false);
+    if (rec != NULL) {
+        status = rec->status;
+        if (status == 0) {
+            r->fw_loopback = rec->arg1 != 0;
+        }
+    }
+    *is_enabled = r->fw_loopback;
+    MUTEX_UNLOCK(&r->lock);
+
+    delay(r, rec);
+    return status;
+}
+
+static int replay_enable_module(struct bladerf *dev, bladerf_module m,
+                                bool enable)
+{
+    return replay_status(dev, TRACE_OP_ENABLE_MODULE, m, 0, false);
+}
+
+/* Advance a module's stream reader to its next recorded transfer. On
+ * success, the reader is left positioned at the record's payload.
+ *
+ * @return 0 on success, 1 if the trace contains no further transfers,
+ *         BLADERF_ERR_* on failure */
+static int next_transfer(FILE *file, bladerf_module module,
+                         struct trace_record *rec)
+{
+    int status;
+    const uint8_t op = (module == BLADERF_MODULE_RX) ?
+                            TRACE_OP_STREAM_RX : TRACE_OP_STREAM_TX;
+
+    while ((status = trace_read_record(file, rec)) == 0) {
+        if (rec->op == op && rec->module == module) {
+            return 0;
+        }
+
+        if (rec->len != 0 && fseek(file, rec->len, SEEK_CUR) != 0) {
+            return BLADERF_ERR_IO;
+        }
+    }
+
+    return status;
+}
+
+/* Reproduce the recorded arrival time of a transfer, relative to the first
+ * transfer replayed by this stream */
+static void pace_transfer(struct bladerf_stream *stream,
+                          const struct trace_record *rec)
+{
+    struct replay_stream_data *sd = stream->backend_data;
+    struct timespec now;
+    uint64_t elapsed_ns, target_ns;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    if (!sd->t_valid) {
+        sd->t_valid = true;
+        sd->trace_t0 = rec->time_ns;
+        sd->wall_t0 = now;
+        return;
+    }
+
+    elapsed_ns = (uint64_t) (now.tv_sec - sd->wall_t0.tv_sec) * 1000000000ull
+                 + now.tv_nsec - sd->wall_t0.tv_nsec;
+
+    target_ns = rec->time_ns > sd->trace_t0 ? rec->time_ns - sd->trace_t0 : 0;
+
+    if (target_ns > elapsed_ns) {
+        sleep_ns(target_ns - elapsed_ns);
+    }
+}
+
+/* Fill an RX buffer from the current record's payload. Samples that are
+ * not present in the trace are zeroed. */
+static int fill_rx(struct bladerf_stream *stream, FILE *file,
+                   const struct trace_record *rec, uint8_t *buf)
+{
+    const size_t buf_len = async_stream_buf_bytes(stream);
+    const size_t msg_size = stream->dev->msg_size;
+    size_t remaining = rec->len;
+    size_t to_read, i;
+
+    if (rec->flags & TRACE_REC_F_SAMPLES) {
+        to_read = remaining < buf_len ? remaining : buf_len;
+
+        if (to_read != 0 && fread(buf, to_read, 1, file) != 1) {
+            return BLADERF_ERR_IO;
+        }
+
+        memset(buf + to_read, 0, buf_len - to_read);
+        remaining -= to_read;
+    } else {
+        memset(buf, 0, buf_len);
+
+        /* The payload consists of the transfer's metadata headers */
+        for (i = 0; remaining >= METADATA_HEADER_SIZE &&
+                    i * msg_size + METADATA_HEADER_SIZE <= buf_len; i++) {
+
+            if (fread(buf + i * msg_size, METADATA_HEADER_SIZE, 1, file) != 1) {
+                return BLADERF_ERR_IO;
+            }
+
+            remaining -= METADATA_HEADER_SIZE;
+        }
+    }
+
+    if (remaining != 0 && fseek(file, (long) remaining, SEEK_CUR) != 0) {
+        return BLADERF_ERR_IO;
+    }
+
+    return 0;
+}
+
+static int replay_transfer(struct bladerf_stream *stream, uint8_t *buf)
+{
+    struct bladerf_replay *r = replay_backend(stream->dev);
+    FILE *file = r->stream_file[stream->module];
+    struct trace_record rec;
+    int status;
+
+    status = next_transfer(file, stream->module, &rec);
+    if (status == 1) {
+        if (stream->module == BLADERF_MODULE_RX) {
+            log_debug("Replay: no further RX transfers in trace.\n");
+            return BLADERF_ERR_TIMEOUT;
+        } else {
+            /* Nothing remains to be compared against; TX samples are
+             * simply consumed */
+            return 0;
+        }
+    } else if (status != 0) {
+        return status;
+    }
+
+    if (r->timing != REPLAY_TIMING_NONE) {
+        pace_transfer(stream, &rec);
+    }
+
+    if (stream->module == BLADERF_MODULE_RX) {
+        status = fill_rx(stream, file, &rec, buf);
+    } else if (rec.len != 0 && fseek(file, rec.len, SEEK_CUR) != 0) {
+        status = BLADERF_ERR_IO;
+    }
+
+    return status;
+}
+
+/* Queue a transfer for completion.
+ *
+ * @pre stream->lock is held and a transfer is available */
+static void submit_transfer(struct bladerf_stream *stream, void *buffer)
+{
+    struct replay_stream_data *sd = stream->backend_data;
+    const size_t in_flight = sd->num_transfers - sd->num_avail;
+
+    assert(sd->num_avail != 0);
+
+    sd->queue[(sd->head + in_flight) % sd->num_transfers] = buffer;
+    sd->num_avail--;
+    pthread_cond_signal(&sd->submitted);
+}
+
+static int replay_init_stream(struct bladerf_stream *stream,
+                              size_t num_transfers)
+{
+    struct replay_stream_data *sd;
+
+    sd = calloc(1, sizeof(*sd));
+    if (sd == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    sd->queue = calloc(num_transfers, sizeof(sd->queue[0]));
+    if (sd->queue == NULL) {
+        free(sd);
+        return BLADERF_ERR_MEM;
+    }
+
+    if (pthread_cond_init(&sd->submitted, NULL) != 0) {
+        free(sd->queue);
+        free(sd);
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    sd->num_transfers = num_transfers;
+    sd->num_avail = num_transfers;
+
+    stream->backend_data = sd;
+    return 0;
+}
+
+static int replay_stream(struct bladerf_stream *stream, bladerf_module module)
+{
+    size_t i;
+    int status;
+    void *buffer;
+    struct timespec timeout_abs;
+    struct bladerf_metadata metadata;
+    struct bladerf *dev = stream->dev;
+    struct replay_stream_data *sd = stream->backend_data;
+
+    /* Currently unused, so zero it out for a sanity check when debugging */
+    memset(&metadata, 0, sizeof(metadata));
+
+    MUTEX_LOCK(&stream->lock);
+
+    sd->t_valid = false;
+
+    /* Set up initial set of buffers */
+    for (i = 0; i < sd->num_transfers; i++) {
+        if (module == BLADERF_MODULE_TX) {
+            buffer = stream->cb(dev,
+                                stream,
+                                &metadata,
+                                NULL,
+                                stream->samples_per_buffer,
+                                stream->user_data);
+
+            if (buffer == BLADERF_STREAM_SHUTDOWN) {
+                stream->state = STREAM_SHUTTING_DOWN;
+                break;
+            }
+        } else {
+            buffer = stream->buffers[i];
+        }
+
+        if (buffer != BLADERF_STREAM_NO_DATA) {
+            submit_transfer(stream, buffer);
+        }
+    }
+
+    while (stream->state != STREAM_DONE) {
+
+        if (stream->state == STREAM_SHUTTING_DOWN) {
+            /* Nothing is actually on the wire, so any transfers still in
+             * flight may be considered cancelled right away */
+            sd->num_avail = sd->num_transfers;
+            sd->head = 0;
+            stream->state = STREAM_DONE;
+            pthread_cond_broadcast(&stream->can_submit_buffer);
+            break;
+        }
+
+        if (sd->num_avail == sd->num_transfers) {
+            status = populate_abs_timeout(&timeout_abs, REPLAY_IDLE_WAIT_MS);
+            if (status == 0) {
+                pthread_cond_timedwait(&sd->submitted, &stream->lock,
+                                       &timeout_abs);
+            }
+            continue;
+        }
+
+        buffer = sd->queue[sd->head];
+
+        MUTEX_UNLOCK(&stream->lock);
+        status = replay_transfer(stream, buffer);
+        MUTEX_LOCK(&stream->lock);
+
+        sd->head = (sd->head + 1) % sd->num_transfers;
+        sd->num_avail++;
+        pthread_cond_signal(&stream->can_submit_buffer);
+
+        if (status != 0) {
+            stream->error_code = status;
+            stream->state = STREAM_SHUTTING_DOWN;
+        } else if (stream->state == STREAM_RUNNING) {
+            buffer = stream->cb(dev,
+                                stream,
+                                &metadata,
+                                buffer,
+                                stream->samples_per_buffer,
+                                stream->user_data);
+
+            if (buffer == BLADERF_STREAM_SHUTDOWN) {
+                stream->state = STREAM_SHUTTING_DOWN;
+            } else if (buffer != BLADERF_STREAM_NO_DATA) {
+                submit_transfer(stream, buffer);
+            }
+        }
+    }
+
+    MUTEX_UNLOCK(&stream->lock);
+    return 0;
+}
+
+/* The caller is expected to hold stream->lock */
+static int replay_submit_stream_buffer(struct bladerf_stream *stream,
+                                       void *buffer, unsigned int timeout_ms)
+{
+    int status = 0;
+    struct timespec timeout_abs;
+    struct replay_stream_data *sd = stream->backend_data;
+
+    if (buffer == BLADERF_STREAM_SHUTDOWN) {
+        if (sd->num_avail == sd->num_transfers) {
+            stream->state = STREAM_DONE;
+        } else {
+            stream->state = STREAM_SHUTTING_DOWN;
+        }
+
+        pthread_cond_signal(&sd->submitted);
+        return 0;
+    }
+
+    if (timeout_ms != 0) {
+        status = populate_abs_timeout(&timeout_abs, timeout_ms);
+        if (status != 0) {
+            return BLADERF_ERR_UNEXPECTED;
+        }
+
+        while (sd->num_avail == 0 && status == 0 &&
+               stream->state == STREAM_RUNNING) {
+            status = pthread_cond_timedwait(&stream->can_submit_buffer,
+                                            &stream->lock,
+                                            &timeout_abs);
+        }
+    } else {
+        while (sd->num_avail == 0 && status == 0 &&
+               stream->state == STREAM_RUNNING) {
+            status = pthread_cond_wait(&stream->can_submit_buffer,
+                                       &stream->lock);
+        }
+    }
+
+    if (status == ETIMEDOUT) {
+        log_debug("%s: Timed out waiting for a transfer to become availble.\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_TIMEOUT;
+    } else if (status != 0) {
+        return BLADERF_ERR_UNEXPECTED;
+    } else if (stream->state != STREAM_RUNNING) {
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    submit_transfer(stream, buffer);
+    return 0;
+}
+
+static void replay_deinit_stream(struct bladerf_stream *stream)
+{
+    struct replay_stream_data *sd = stream->backend_data;
+
+    if (sd != NULL) {
+        pthread_cond_destroy(&sd->submitted);
+        free(sd->queue);
+        free(sd);
+        stream->backend_data = NULL;
+    }
+}
+
+static int replay_load_fw_from_bootloader(bladerf_backend backend,
+                                          uint8_t bus, uint8_t addr,
+                                          struct fx3_firmware *fw)
+{
+    return BLADERF_ERR_UNSUPPORTED;
+}
+
+const struct backend_fns backend_fns_replay = {
+    FIELD_INIT(.matches, replay_matches),
+
+    FIELD_INIT(.probe, replay_probe),
+
+    FIELD_INIT(.open, replay_open),
+    FIELD_INIT(.close, replay_close),
+
+    FIELD_INIT(.load_fpga, replay_load_fpga),
+    FIELD_INIT(.is_fpga_configured, replay_is_fpga_configured),
+
+    FIELD_INIT(.erase_flash_blocks, replay_erase_flash_blocks),
+    FIELD_INIT(.read_flash_pages, replay_read_flash_pages),
+    FIELD_INIT(.write_flash_pages, replay_write_flash_pages),
+
+    FIELD_INIT(.device_reset, replay_device_reset),
+    FIELD_INIT(.jump_to_bootloader, replay_jump_to_bootloader),
+
+    FIELD_INIT(.get_cal, replay_get_cal),
+    FIELD_INIT(.get_otp, replay_get_otp),
+    FIELD_INIT(.get_device_speed, replay_get_device_speed),
+
+    FIELD_INIT(.config_gpio_write, replay_config_gpio_write),
+    FIELD_INIT(.config_gpio_read, replay_config_gpio_read),
+
+    FIELD_INIT(.expansion_gpio_write, replay_expansion_gpio_write),
+    FIELD_INIT(.expansion_gpio_read, replay_expansion_gpio_read),
+    FIELD_INIT(.expansion_gpio_dir_write, replay_expansion_gpio_dir_write),
+    FIELD_INIT(.expansion_gpio_dir_read, replay_expansion_gpio_dir_read),
+
+    FIELD_INIT(.set_correction, replay_set_correction),
+    FIELD_INIT(.get_correction, replay_get_correction),
+
+    FIELD_INIT(.get_timestamp, replay_get_timestamp),
+
+    FIELD_INIT(.si5338_write, replay_si5338_write),
+    FIELD_INIT(.si5338_read, replay_si5338_read),
+
+    FIELD_INIT(.lms_write, replay_lms_write),
+    FIELD_INIT(.lms_read, replay_lms_read),
+
+    FIELD_INIT(.dac_write, replay_dac_write),
+
+    FIELD_INIT(.xb_spi, replay_xb_spi),
+
+    FIELD_INIT(.set_firmware_loopback, replay_set_firmware_loopback),
+    FIELD_INIT(.get_firmware_loopback, replay_get_firmware_loopback),
+
+    FIELD_INIT(.enable_module, replay_enable_module),
+
+    FIELD_INIT(.init_stream, replay_init_stream),
+    FIELD_INIT(.stream, replay_stream),
+    FIELD_INIT(.submit_stream_buffer, replay_submit_stream_buffer),
+    FIELD_INIT(.deinit_stream, replay_deinit_stream),
+
+    FIELD_INIT(.load_fw_from_bootloader, replay_load_fw_from_bootloader),
+
+    FIELD_INIT(.enable_trace, NULL),
+    FIELD_INIT(.get_trace_stats, NULL),
+    FIELD_INIT(.write_trace, NULL),
+
+    FIELD_INIT(.lms_write_regs, NULL),
+    FIELD_INIT(.lms_read_regs, NULL),
+    FIELD_INIT(.lms_dc_cal_loop, NULL),
+
+    FIELD_INIT(.si5338_write_regs, NULL),
+    FIELD_INIT(.si5338_read_regs, NULL),
+
+    FIELD_INIT(.load_fpga_begin, NULL),
+    FIELD_INIT(.load_fpga_write, NULL),
+    FIELD_INIT(.load_fpga_end, NULL),
+    FIELD_INIT(.flash_hash, NULL),
+};
@@ -0,0 +1,71 @@
+/*
+ * Recording and replay of device traffic
+ *
+ * When the BLADERF_RECORD environment variable is set, each device opened
+ * with a hardware backend has its backend wrapped by a recorder that logs
+ * every backend operation, its result, and its timing to a trace file (see
+ * trace.h). The "replay" backend later plays such a trace back to libbladeRF
+ * with no device attached.
+ *
+ *  BLADERF_RECORD          Path of the trace file to create. If multiple
+ *                          devices are opened, later ones are recorded to
+ *                          "<path>.<n>".
+ *
+ *  BLADERF_RECORD_SAMPLES  Set to 0 to omit samples from stream records,
+ *                          retaining only their metadata and timing. This
+ *                          results in significantly smaller traces.
+ *
+ *  BLADERF_REPLAY          Path of the trace file to replay.
+ *
+ *  BLADERF_REPLAY_TIMING   Timing to reproduce when replaying. One of:
+ *                              stream  Stream transfers complete at their
+ *                                      recorded times, relative to the start
+ *                                      of the stream. Control operations
+ *                                      complete immediately. (Default)
+ *                              all     Additionally, control operations take
+ *                                      as long as they did when recorded.
+ *                              none    Everything completes immediately.
+ *                                      Note that the host is then likely to
+ *                                      overrun when receiving.
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef BACKEND_REPLAY_H_
+#define BACKEND_REPLAY_H_
+
+#include "bladerf_priv.h"
+
+#define REPLAY_ENV_RECORD           "BLADERF_RECORD"
+#define REPLAY_ENV_RECORD_SAMPLES   "BLADERF_RECORD_SAMPLES"
+#define REPLAY_ENV_TRACE            "BLADERF_REPLAY"
+#define REPLAY_ENV_TIMING           "BLADERF_REPLAY_TIMING"
+
+/**
+ * If recording has been requested via the environment, wrap the backend of
+ * a newly opened device with a recorder.
+ *
+ * Failing to start recording is logged, but is not treated as an error; the
+ * device remains usable without recording.
+ *
+ * @param   dev     Device whose backend has just been opened
+ */
+void record_attach(struct bladerf *dev);
+
+#endif
@@ -0,0 +1,275 @@
+/*
+ * Device traffic trace file reader/writer
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "bladerf_priv.h"
+#include "backend/replay/trace.h"
+#include "log.h"
+
+static inline void put_le16(uint8_t *buf, uint16_t value)
+{
+    buf[0] = value & 0xff;
+    buf[1] = (value >> 8) & 0xff;
+}
+
+static inline void put_le32(uint8_t *buf, uint32_t value)
+{
+    put_le16(buf, value & 0xffff);
+    put_le16(buf + 2, value >> 16);
+}
+
+static inline void put_le64(uint8_t *buf, uint64_t value)
+{
+    put_le32(buf, value & 0xffffffff);
+    put_le32(buf + 4, value >> 32);
+}
+
+static inline uint16_t get_le16(const uint8_t *buf)
+{
+    return buf[0] | (buf[1] << 8);
+}
+
+static inline uint32_t get_le32(const uint8_t *buf)
+{
+    return get_le16(buf) | ((uint32_t) get_le16(buf + 2) << 16);
+}
+
+static inline uint64_t get_le64(const uint8_t *buf)
+{
+    return get_le32(buf) | ((uint64_t) get_le32(buf + 4) << 32);
+}
+
+static inline uint64_t timespec_ns(const struct timespec *t)
+{
+    return (uint64_t) t->tv_sec * 1000000000ull + t->tv_nsec;
+}
+
+int trace_writer_open(struct trace_writer **writer, const char *path,
+                      bool samples)
+{
+    struct trace_writer *w;
+    uint8_t hdr[TRACE_FILE_HDR_SIZE];
+
+    w = calloc(1, sizeof(*w));
+    if (w == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    w->file = fopen(path, "wb");
+    if (w->file == NULL) {
+        log_error("Failed to create trace file %s: %s\n",
+                  path, strerror(errno));
+        free(w);
+        return BLADERF_ERR_IO;
+    }
+
+    MUTEX_INIT(&w->lock);
+    w->samples = samples;
+    clock_gettime(CLOCK_REALTIME, &w->t_start);
+
+    memcpy(hdr, TRACE_MAGIC, TRACE_MAGIC_LEN);
+    put_le32(&hdr[8], TRACE_VERSION);
+    put_le32(&hdr[12], samples ? TRACE_FILE_F_SAMPLES : 0);
+    put_le64(&hdr[16], timespec_ns(&w->t_start));
+
+    if (fwrite(hdr, sizeof(hdr), 1, w->file) != 1) {
+        log_error("Failed to write trace file header: %s\n", strerror(errno));
+        fclose(w->file);
+        free(w);
+        return BLADERF_ERR_IO;
+    }
+
+    *writer = w;
+    return 0;
+}
+
+void trace_writer_close(struct trace_writer *writer)
+{
+    if (writer != NULL) {
+        if (fclose(writer->file) != 0 && !writer->failed) {
+            log_error("Failed to close trace file: %s\n", strerror(errno));
+        }
+
+        free(writer);
+    }
+}
+
+uint64_t trace_writer_now(struct trace_writer *writer)
+{
+    struct timespec now;
+    uint64_t now_ns, start_ns;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    now_ns = timespec_ns(&now);
+    start_ns = timespec_ns(&writer->t_start);
+
+    return now_ns > start_ns ? now_ns - start_ns : 0;
+}
+
+void trace_write(struct trace_writer *writer,
+                 const struct trace_record *rec, const void *payload)
+{
+    uint8_t hdr[TRACE_RECORD_HDR_SIZE];
+    bool ok;
+
+    hdr[0] = rec->op;
+    hdr[1] = rec->module;
+    put_le16(&hdr[2], rec->flags);
+    put_le32(&hdr[4], (uint32_t) rec->status);
+    put_le64(&hdr[8], rec->time_ns);
+    put_le32(&hdr[16], rec->duration_ns);
+    put_le32(&hdr[20], rec->arg0);
+    put_le32(&hdr[24], rec->arg1);
+    put_le32(&hdr[28], rec->len);
+
+    MUTEX_LOCK(&writer->lock);
+
+    if (!writer->failed) {
+        ok = fwrite(hdr, sizeof(hdr), 1, writer->file) == 1;
+
+        if (ok && rec->len != 0) {
+            ok = fwrite(payload, rec->len, 1, writer->file) == 1;
+        }
+
+        if (!ok) {
+            log_error("Failed to write to trace file (%s). "
+                      "Recording has been stopped.\n", strerror(errno));
+            writer->failed = true;
+        }
+    }
+
+    MUTEX_UNLOCK(&writer->lock);
+}
+
+int trace_read_header(FILE *file, uint32_t *flags)
+{
+    uint8_t hdr[TRACE_FILE_HDR_SIZE];
+    uint32_t version;
+
+    if (fread(hdr, sizeof(hdr), 1, file) != 1) {
+        return ferror(file) ? BLADERF_ERR_IO : BLADERF_ERR_INVAL;
+    }
+
+    if (memcmp(hdr, TRACE_MAGIC, TRACE_MAGIC_LEN) != 0) {
+        log_debug("Invalid trace file magic value\n");
+        return BLADERF_ERR_INVAL;
+    }
+
+    version = get_le32(&hdr[8]);
+    if (version != TRACE_VERSION) {
+        log_debug("Unsupported trace file version: %u\n", version);
+        return BLADERF_ERR_INVAL;
+    }
+
+    *flags = get_le32(&hdr[12]);
+    return 0;
+}
+
+int trace_read_record(FILE *file, struct trace_record *rec)
+{
+    uint8_t hdr[TRACE_RECORD_HDR_SIZE];
+    size_t n;
+
+    n = fread(hdr, 1, sizeof(hdr), file);
+    if (n == 0 && feof(file)) {
+        return 1;
+    } else if (n != sizeof(hdr)) {
+        log_debug("Truncated trace record\n");
+        return BLADERF_ERR_IO;
+    }
+
+    rec->op = hdr[0];
+    rec->module = hdr[1];
+    rec->flags = get_le16(&hdr[2]);
+    rec->status = (int32_t) get_le32(&hdr[4]);
+    rec->time_ns = get_le64(&hdr[8]);
+    rec->duration_ns = get_le32(&hdr[16]);
+    rec->arg0 = get_le32(&hdr[20]);
+    rec->arg1 = get_le32(&hdr[24]);
+    rec->len = get_le32(&hdr[28]);
+
+    return 0;
+}
+
+void trace_pack_version(const struct bladerf_version *version, uint8_t *buf)
+{
+    put_le16(&buf[0], version->major);
+    put_le16(&buf[2], version->minor);
+    put_le16(&buf[4], version->patch);
+
+    memset(&buf[6], 0, BLADERF_VERSION_STR_MAX + 1);
+    if (version->describe != NULL) {
+        strncpy((char *) &buf[6], version->describe, BLADERF_VERSION_STR_MAX);
+    }
+}
+
+void trace_unpack_version(struct bladerf_version *version, const uint8_t *buf)
+{
+    version->major = get_le16(&buf[0]);
+    version->minor = get_le16(&buf[2]);
+    version->patch = get_le16(&buf[4]);
+
+    memcpy((char *) version->describe, &buf[6], BLADERF_VERSION_STR_MAX);
+    ((char *) version->describe)[BLADERF_VERSION_STR_MAX] = '\0';
+}
+
+void trace_pack_devstate(const struct bladerf *dev, uint8_t *buf)
+{
+    put_le32(&buf[0], dev->ident.backend);
+    buf[4] = dev->ident.usb_bus;
+    buf[5] = dev->ident.usb_addr;
+    put_le32(&buf[6], dev->ident.instance);
+    memcpy(&buf[10], dev->ident.serial, BLADERF_SERIAL_LENGTH);
+    buf += 10 + BLADERF_SERIAL_LENGTH;
+
+    trace_pack_version(&dev->fw_version, buf);
+    buf += TRACE_VERSION_SIZE;
+
+    trace_pack_version(&dev->fpga_version, buf);
+    buf += TRACE_VERSION_SIZE;
+
+    put_le32(&buf[0], dev->transfer_timeout[BLADERF_MODULE_RX]);
+    put_le32(&buf[4], dev->transfer_timeout[BLADERF_MODULE_TX]);
+}
+
+void trace_unpack_devstate(struct bladerf *dev, const uint8_t *buf)
+{
+    dev->ident.backend = (bladerf_backend) get_le32(&buf[0]);
+    dev->ident.usb_bus = buf[4];
+    dev->ident.usb_addr = buf[5];
+    dev->ident.instance = get_le32(&buf[6]);
+    memcpy(dev->ident.serial, &buf[10], BLADERF_SERIAL_LENGTH);
+    dev->ident.serial[BLADERF_SERIAL_LENGTH - 1] = '\0';
+    buf += 10 + BLADERF_SERIAL_LENGTH;
+
+    trace_unpack_version(&dev->fw_version, buf);
+    buf += TRACE_VERSION_SIZE;
+
+    trace_unpack_version(&dev->fpga_version, buf);
+    buf += TRACE_VERSION_SIZE;
+
+    dev->transfer_timeout[BLADERF_MODULE_RX] = (int) get_le32(&buf[0]);
+    dev->transfer_timeout[BLADERF_MODULE_TX] = (int) get_le32(&buf[4]);
+}
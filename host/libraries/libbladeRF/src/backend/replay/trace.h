@@ -0,0 +1,214 @@
+/*
+ * Device traffic trace file format
+ *
+ * A trace begins with a fixed header, followed by a sequence of records.
+ * Each record describes one backend operation (or one completed stream
+ * transfer), its result, and when it occurred. All fields are little-endian.
+ *
+ *  File header (TRACE_FILE_HDR_SIZE bytes):
+ *      [0:7]   Magic, TRACE_MAGIC
+ *      [8:11]  Format version, TRACE_VERSION
+ *      [12:15] Flags, TRACE_FILE_F_*
+ *      [16:23] Wall-clock time at which the trace was started, in ns since
+ *              the Unix epoch
+ *
+ *  Record header (TRACE_RECORD_HDR_SIZE bytes):
+ *      [0]     Operation, trace_op
+ *      [1]     Module, or TRACE_MODULE_NONE
+ *      [2:3]   Flags, TRACE_REC_F_*, or the sample format for
+ *              TRACE_OP_STREAM_INIT
+ *      [4:7]   Status returned by the operation
+ *      [8:15]  Time the operation started, in ns since the trace was started
+ *      [16:19] Duration of the operation, in ns (saturated)
+ *      [20:23] Operation-specific argument 0
+ *      [24:27] Operation-specific argument 1
+ *      [28:31] Length of the payload that follows, in bytes
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef BACKEND_TRACE_H_
+#define BACKEND_TRACE_H_
+
+#include <stdio.h>
+#include "bladerf_priv.h"
+
+#define TRACE_MAGIC             "BRFTRACE"
+#define TRACE_MAGIC_LEN         8
+#define TRACE_VERSION           1
+
+#define TRACE_FILE_HDR_SIZE     24
+#define TRACE_RECORD_HDR_SIZE   32
+
+/* Stream records carry sample payloads */
+#define TRACE_FILE_F_SAMPLES    (1 << 0)
+
+/* This stream record's payload contains the transfer's samples. Otherwise,
+ * it contains only the metadata headers, if the stream used metadata. */
+#define TRACE_REC_F_SAMPLES     (1 << 0)
+
+#define TRACE_MODULE_NONE       0xff
+
+/* Size of the serialized device state stored in TRACE_OP_OPEN records */
+#define TRACE_VERSION_SIZE      (3 * 2 + BLADERF_VERSION_STR_MAX + 1)
+#define TRACE_DEVSTATE_SIZE     (4 + 1 + 1 + 4 + BLADERF_SERIAL_LENGTH + \
+                                 2 * TRACE_VERSION_SIZE + 2 * 4)
+
+/* Operation codes. These values are part of the file format; only append. */
+typedef enum {
+    TRACE_OP_OPEN = 1,              /* payload: device state */
+    TRACE_OP_CLOSE,
+    TRACE_OP_LOAD_FPGA,             /* arg0: image size,
+                                     * payload: FPGA version */
+    TRACE_OP_IS_FPGA_CONFIGURED,    /* payload: FPGA version */
+    TRACE_OP_ERASE_FLASH_BLOCKS,    /* arg0: erase block, arg1: count */
+    TRACE_OP_READ_FLASH_PAGES,      /* arg0: page, arg1: count, payload: data */
+    TRACE_OP_WRITE_FLASH_PAGES,     /* arg0: page, arg1: count */
+    TRACE_OP_DEVICE_RESET,
+    TRACE_OP_JUMP_TO_BOOTLOADER,
+    TRACE_OP_GET_CAL,               /* payload: calibration data */
+    TRACE_OP_GET_OTP,               /* payload: OTP data */
+    TRACE_OP_GET_DEVICE_SPEED,      /* arg1: speed */
+    TRACE_OP_CONFIG_GPIO_WRITE,     /* arg1: value */
+    TRACE_OP_CONFIG_GPIO_READ,      /* arg1: value */
+    TRACE_OP_EXPANSION_GPIO_WRITE,  /* arg1: value */
+    TRACE_OP_EXPANSION_GPIO_READ,   /* arg1: value */
+    TRACE_OP_EXPANSION_GPIO_DIR_WRITE,  /* arg1: value */
+    TRACE_OP_EXPANSION_GPIO_DIR_READ,   /* arg1: value */
+    TRACE_OP_SET_CORRECTION,        /* arg0: correction, arg1: value */
+    TRACE_OP_GET_CORRECTION,        /* arg0: correction, arg1: value */
+    TRACE_OP_GET_TIMESTAMP,         /* arg0: value[31:0], arg1: value[63:32] */
+    TRACE_OP_SI5338_WRITE,          /* arg0: address, arg1: value */
+    TRACE_OP_SI5338_READ,           /* arg0: address, arg1: value */
+    TRACE_OP_LMS_WRITE,             /* arg0: address, arg1: value */
+    TRACE_OP_LMS_READ,              /* arg0: address, arg1: value */
+    TRACE_OP_DAC_WRITE,             /* arg1: value */
+    TRACE_OP_XB_SPI,                /* arg1: value */
+    TRACE_OP_SET_FIRMWARE_LOOPBACK, /* arg1: enabled */
+    TRACE_OP_GET_FIRMWARE_LOOPBACK, /* arg1: enabled */
+    TRACE_OP_ENABLE_MODULE,         /* arg1: enabled */
+    TRACE_OP_STREAM_INIT,           /* flags: format, arg0: # transfers,
+                                     * arg1: samples per buffer */
+    TRACE_OP_STREAM_START,
+    TRACE_OP_STREAM_RX,             /* arg0: # samples, payload: see
+                                     * TRACE_REC_F_SAMPLES */
+    TRACE_OP_STREAM_TX,             /* arg0: # samples, payload: see
+                                     * TRACE_REC_F_SAMPLES */
+    TRACE_OP_STREAM_END,
+} trace_op;
+
+struct trace_record {
+    uint8_t op;
+    uint8_t module;
+    uint16_t flags;
+    int32_t status;
+    uint64_t time_ns;
+    uint32_t duration_ns;
+    uint32_t arg0;
+    uint32_t arg1;
+    uint32_t len;
+};
+
+struct trace_writer {
+    MUTEX lock;
+    FILE *file;
+    struct timespec t_start;
+    bool samples;
+
+    /* Set upon the first write failure, after which records are dropped */
+    bool failed;
+};
+
+/**
+ * Create a trace file and write its header
+ *
+ * @param[out]  writer      Handle to the opened trace on success
+ * @param[in]   path        Path of the file to create
+ * @param[in]   samples     Record stream samples, rather than only stream
+ *                          metadata and timing
+ *
+ * @return 0 on success, BLADERF_ERR_* on failure
+ */
+int trace_writer_open(struct trace_writer **writer, const char *path,
+                      bool samples);
+
+/**
+ * Flush and close a trace file, and free the writer
+ */
+void trace_writer_close(struct trace_writer *writer);
+
+/**
+ * @return Nanoseconds elapsed since the trace was started
+ */
+uint64_t trace_writer_now(struct trace_writer *writer);
+
+/**
+ * Append a record to a trace. rec->len specifies the number of payload
+ * bytes. Failures are logged once and then ignored, as a failure to record
+ * should not disrupt the session being recorded.
+ *
+ * @note This is safe to call from multiple threads.
+ */
+void trace_write(struct trace_writer *writer,
+                 const struct trace_record *rec, const void *payload);
+
+/**
+ * Read and validate a trace file header
+ *
+ * @param[in]   file        Trace file, positioned at its start
+ * @param[out]  flags       TRACE_FILE_F_* flags of the trace
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if this is not a supported trace,
+ *         BLADERF_ERR_IO on read failure
+ */
+int trace_read_header(FILE *file, uint32_t *flags);
+
+/**
+ * Read the next record header. The file is left positioned at the start of
+ * the record's payload.
+ *
+ * @return 0 on success, 1 at the end of the trace, BLADERF_ERR_IO on
+ *         failure or a truncated record
+ */
+int trace_read_record(FILE *file, struct trace_record *rec);
+
+/**
+ * Serialize the device state populated by a backend's open() into
+ * TRACE_DEVSTATE_SIZE bytes
+ */
+void trace_pack_devstate(const struct bladerf *dev, uint8_t *buf);
+
+/**
+ * Restore device state serialized by trace_pack_devstate()
+ */
+void trace_unpack_devstate(struct bladerf *dev, const uint8_t *buf);
+
+/**
+ * Serialize a version structure into TRACE_VERSION_SIZE bytes
+ */
+void trace_pack_version(const struct bladerf_version *version, uint8_t *buf);
+
+/**
+ * Restore a version serialized by trace_pack_version(). The describe string
+ * is copied into version->describe, which must provide
+ * BLADERF_VERSION_STR_MAX + 1 bytes.
+ */
+void trace_unpack_version(struct bladerf_version *version, const uint8_t *buf);
+
+#endif
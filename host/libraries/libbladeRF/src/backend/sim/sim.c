@@ -0,0 +1,1563 @@
+/*
+ * Software-simulated bladeRF device
+ *
+ * This backend models enough of the bladeRF's control and data paths to
+ * allow libbladeRF, its utilities, and applications to be exercised without
+ * hardware. The LMS6002D and Si5338 are modeled as register files with the
+ * handful of behaviors libbladeRF depends upon (VTUNE feedback during VCOCAP
+ * tuning, DC calibration handshakes, and sample rate derivation). Samples
+ * are produced and consumed at the configured sample rate.
+ *
+ * The simulation is configured via the following environment variables:
+ *
+ *  BLADERF_SIM_REALTIME    Set to 0 to produce and consume samples as quickly
+ *                          as possible, rather than at the sample rate.
+ *
+ *  BLADERF_SIM_RX          RX sample source. One of:
+ *                              tone[:<offset Hz>]   (default, 100 kHz)
+ *                              noise
+ *                              zero
+ *                              file:<path>          (SC16 Q11, looped)
+ *
+ *  BLADERF_SIM_RX_DC       RX DC offset impairment, "<I>,<Q>", in SC16 Q11
+ *                          units. Corrected via the LMS DC offset controls.
+ *
+ *  BLADERF_SIM_RX_IQ       RX IQ imbalance, "<gain>,<phase>", where gain is
+ *                          a fractional error and phase is in degrees.
+ *                          Corrected via the FPGA IQ corrections.
+ *
+ *  BLADERF_SIM_FLASH       Path of a file used to back the simulated SPI
+ *                          flash. It is loaded on open and saved on close.
+ *
+ *  BLADERF_SIM_RX_GAIN    Set to 1 to scale RX samples by the LNA, RXVGA1
+ *                          and RXVGA2 gains, relative to the maximum RX
+ *                          gain. By default, samples are not scaled.
+ *
+ *  BLADERF_SIM_LMS_BATCH   Set to 0 to model an FPGA without batched LMS6002D
+ *                          register accesses and the on-device DC
+ *                          calibration loop, forcing libbladeRF to fall
+ *                          back to single register accesses.
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "bladerf_priv.h"
+#include "backend/backend.h"
+#include "backend/sim/sim.h"
+#include "backend/flash_bulk.h"
+#include "bladeRF.h"    /* Firmware interface */
+#include "flash_fields.h"
+#include "sha256.h"
+#include "log.h"
+
+/* Si5338 multisynth configuration */
+#define SI5338_F_VCO        (38400000ULL * 66ULL)
+#define SI5338_MS_RX        1
+#define SI5338_MS_TX        2
+#define SI5338_MS_BASE(i)   (53 + (i) * 11)
+#define SI5338_R_REG(i)     (31 + (i))
+
+/* Round trips the USB backend requires for a 32-bit and a 16-bit FPGA
+ * register access, which the firmware performs a byte at a time */
+#define FPGA_REG32_ROUND_TRIPS  4
+#define FPGA_REG16_ROUND_TRIPS  2
+
+/* LMS6002D PLL configuration */
+#define LMS_PLL_TX_BASE     0x10
+#define LMS_PLL_RX_BASE     0x20
+#define LMS_VCOCAP_WINDOW   6
+
+#define LMS_VTUNE_NORM      0x00
+#define LMS_VTUNE_LOW       0x01
+#define LMS_VTUNE_HIGH      0x02
+
+/* Base addresses of the LMS6002D DC calibration blocks */
+static const uint8_t lms_dc_bases[SIM_LMS_DC_BLOCKS] = {
+    0x00,   /* LPF tuning */
+    0x30,   /* TX LPF */
+    0x50,   /* RX LPF */
+    0x60,   /* RX VGA2 */
+};
+
+/* LMS6002D DC offset correction registers */
+#define LMS_RX_DCOFF_I      0x71
+#define LMS_RX_DCOFF_Q      0x72
+
+/* LMS6002D RX gain registers */
+#define LMS_RXVGA2_GAIN     0x65
+#define LMS_LNA_GAIN        0x75
+#define LMS_RXVGA1_GAIN     0x76
+#define LMS_RX_GAIN_MAX_DB  (6 + 30 + 30)
+
+/* Smallest RXVGA1 code yielding (index + 5) dB of gain */
+static const uint8_t lms_rxvga1_codes[] = {
+    14, 26, 37, 47, 56, 63, 70, 76, 82, 87, 91, 95, 99, 102, 104, 107, 109,
+    111, 113, 114, 116, 117, 118, 119, 120,
+};
+
+/* LMS6002D power-on register values that libbladeRF depends upon. All other
+ * registers reset to 0x00 in this model. */
+static const struct {
+    uint8_t addr;
+    uint8_t value;
+} lms_reset_values[] = {
+    { 0x04, 0x22 },     /* Chip version */
+    { 0x09, 0x40 },     /* Clock enables */
+    { 0x41, 0x15 },     /* TXVGA1 gain: -14 dB */
+    { 0x42, 0x80 },     /* TX DC offset, I */
+    { 0x43, 0x80 },     /* TX DC offset, Q */
+    { 0x65, 0x0a },     /* RXVGA2 gain: 30 dB */
+    { 0x71, 0x80 },     /* RX DC offset, I */
+    { 0x72, 0x80 },     /* RX DC offset, Q */
+    { 0x75, 0xd0 },     /* LNA gain: max */
+    { 0x76, 0x78 },     /* RXVGA1 gain: max */
+};
+
+const struct backend_fns backend_fns_sim;
+
+static inline double timespec_diff_sec(const struct timespec *a,
+                                       const struct timespec *b)
+{
+    return (double)(a->tv_sec - b->tv_sec) +
+           (double)(a->tv_nsec - b->tv_nsec) / 1e9;
+}
+
+uint64_t sim_get_timestamp(struct bladerf_sim *sim, bladerf_module module)
+{
+    struct sim_module *m = &sim->module[module];
+    struct timespec now;
+    double elapsed;
+
+    if (!sim->realtime || !m->enabled) {
+        return m->timestamp;
+    }
+
+    if (clock_gettime(CLOCK_REALTIME, &now) != 0) {
+        return m->timestamp;
+    }
+
+    elapsed = timespec_diff_sec(&now, &m->t_ref);
+    if (elapsed < 0) {
+        elapsed = 0;
+    }
+
+    return m->timestamp + (uint64_t)(elapsed * m->samplerate);
+}
+
+void sim_advance_timestamp(struct bladerf_sim *sim, bladerf_module module,
+                           uint64_t n)
+{
+    if (!sim->realtime) {
+        sim->module[module].timestamp += n;
+    }
+}
+
+/* Latch the current counter value so that the time base may be changed */
+static void rebase_timestamp(struct bladerf_sim *sim, bladerf_module module)
+{
+    struct sim_module *m = &sim->module[module];
+
+    m->timestamp = sim_get_timestamp(sim, module);
+    clock_gettime(CLOCK_REALTIME, &m->t_ref);
+}
+
+static inline int16_t lms_rx_dcoff(uint8_t regval)
+{
+    int16_t value = regval & 0x3f;
+
+    if (regval & (1 << 6)) {
+        value = -value;
+    }
+
+    return value << 5;
+}
+
+void sim_rx_dc_residual(struct bladerf_sim *sim, double *dc_i, double *dc_q)
+{
+    *dc_i = sim->rx.dc_i + lms_rx_dcoff(sim->lms[LMS_RX_DCOFF_I]);
+    *dc_q = sim->rx.dc_q + lms_rx_dcoff(sim->lms[LMS_RX_DCOFF_Q]);
+}
+
+double sim_rx_gain(struct bladerf_sim *sim)
+{
+    const uint8_t rxvga1 = sim->lms[LMS_RXVGA1_GAIN] & 0x7f;
+    int gain_db = 0;
+    int rxvga1_db = 5;
+    unsigned int i;
+
+    if (!sim->rx.gain_enabled) {
+        return 1.0;
+    }
+
+    switch ((sim->lms[LMS_LNA_GAIN] >> 6) & 0x3) {
+        case 2:
+            gain_db += 3;
+            break;
+        case 3:
+            gain_db += 6;
+            break;
+        default:
+            break;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(lms_rxvga1_codes); i++) {
+        if (rxvga1 >= lms_rxvga1_codes[i]) {
+            rxvga1_db = 6 + (int) i;
+        }
+    }
+
+    gain_db += rxvga1_db + 3 * (sim->lms[LMS_RXVGA2_GAIN] & 0x1f);
+
+    return pow(10.0, (gain_db - LMS_RX_GAIN_MAX_DB) / 20.0);
+}
+
+/******************************************************************************
+ * Si5338 model
+ ******************************************************************************/
+
+static unsigned int si5338_decode_rate(struct bladerf_sim *sim,
+                                       unsigned int ms_index)
+{
+    const uint8_t *regs = &sim->si5338[SI5338_MS_BASE(ms_index)];
+    const unsigned int r = 1 << ((sim->si5338[SI5338_R_REG(ms_index)] >> 2) & 7);
+    uint64_t p1, p2, p3, den;
+
+    p1 = ((regs[2] & 3) << 16) | (regs[1] << 8) | regs[0];
+    p2 = ((uint64_t)regs[5] << 22) | (regs[4] << 14) |
+         (regs[3] << 6) | ((regs[2] >> 2) & 0x3f);
+    p3 = ((uint64_t)(regs[9] & 0x3f) << 24) | (regs[8] << 16) |
+         (regs[7] << 8) | regs[6];
+
+    /* f_out = f_vco / (2 * r * (a + b/c)), where
+     * a + b/c = ((p1 + 512) * p3 + p2) / (128 * p3) */
+    den = 2 * r * ((p1 + 512) * p3 + p2);
+    if (p3 == 0 || den == 0) {
+        return SIM_DEFAULT_SAMPLERATE;
+    }
+
+    return (unsigned int)((SI5338_F_VCO * 128 * p3 + den / 2) / den);
+}
+
+static void si5338_update_rates(struct bladerf_sim *sim)
+{
+    unsigned int rate[NUM_MODULES];
+    bladerf_module m;
+
+    rate[BLADERF_MODULE_RX] = si5338_decode_rate(sim, SI5338_MS_RX);
+    rate[BLADERF_MODULE_TX] = si5338_decode_rate(sim, SI5338_MS_TX);
+
+    for (m = BLADERF_MODULE_RX; m <= BLADERF_MODULE_TX; m++) {
+        if (rate[m] != sim->module[m].samplerate) {
+            rebase_timestamp(sim, m);
+            sim->module[m].samplerate = rate[m];
+            log_verbose("%s: %s sample rate is now %u Hz\n", __FUNCTION__,
+                        m == BLADERF_MODULE_RX ? "RX" : "TX", rate[m]);
+        }
+    }
+}
+
+static int sim_si5338_write(struct bladerf *dev, uint8_t addr, uint8_t data)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+
+    dev->round_trips.si5338++;
+
+    MUTEX_LOCK(&sim->lock);
+    sim->si5338[addr] = data;
+    si5338_update_rates(sim);
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+static int sim_si5338_read(struct bladerf *dev, uint8_t addr, uint8_t *data)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+
+    dev->round_trips.si5338++;
+
+    MUTEX_LOCK(&sim->lock);
+    *data = sim->si5338[addr];
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+static int sim_si5338_write_regs(struct bladerf *dev, const uint8_t *addr,
+                                 const uint8_t *data, unsigned int n)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+    unsigned int i;
+
+    dev->round_trips.si5338 += (n + UART_PKT_MAX_CMDS - 1) / UART_PKT_MAX_CMDS;
+
+    MUTEX_LOCK(&sim->lock);
+    for (i = 0; i < n; i++) {
+        log_verbose("%s: 0x%2.2x 0x%2.2x\n", __FUNCTION__, addr[i], data[i]);
+        sim->si5338[addr[i]] = data[i];
+    }
+    si5338_update_rates(sim);
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+static int sim_si5338_read_regs(struct bladerf *dev, const uint8_t *addr,
+                                uint8_t *data, unsigned int n)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+    unsigned int i;
+
+    dev->round_trips.si5338 += (n + UART_PKT_MAX_CMDS - 1) / UART_PKT_MAX_CMDS;
+
+    MUTEX_LOCK(&sim->lock);
+    for (i = 0; i < n; i++) {
+        data[i] = sim->si5338[addr[i]];
+    }
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+/******************************************************************************
+ * LMS6002D model
+ ******************************************************************************/
+
+/* The VCOCAP value at which a PLL's VTUNE voltage is centered. This is an
+ * arbitrary, but deterministic, function of the PLL's integer divider so that
+ * VCOCAP tuning has something to search for. */
+static inline int lms_vcocap_center(struct bladerf_sim *sim, uint8_t base)
+{
+    const unsigned int nint =
+        (sim->lms[base] << 1) | (sim->lms[base + 1] >> 7);
+
+    return 20 + (nint % 24);
+}
+
+static uint8_t lms_read_vtune(struct bladerf_sim *sim, uint8_t base)
+{
+    const int vcocap = sim->lms[base + 9] & 0x3f;
+    const int center = lms_vcocap_center(sim, base);
+    uint8_t vtune;
+
+    if (vcocap < center - LMS_VCOCAP_WINDOW) {
+        vtune = LMS_VTUNE_HIGH;
+    } else if (vcocap > center + LMS_VCOCAP_WINDOW) {
+        vtune = LMS_VTUNE_LOW;
+    } else {
+        vtune = LMS_VTUNE_NORM;
+    }
+
+    return (sim->lms[base + 10] & 0x3f) | (vtune << 6);
+}
+
+static inline int lms_dc_block(uint8_t addr, uint8_t *base)
+{
+    int i;
+
+    for (i = 0; i < SIM_LMS_DC_BLOCKS; i++) {
+        if (addr >= lms_dc_bases[i] && addr <= (lms_dc_bases[i] + 3)) {
+            *base = lms_dc_bases[i];
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/* The value the DC calibration of a block "converges" to. This never
+ * yields the 0 or 31 values lms.c treats as calibration failures. */
+static inline uint8_t lms_dc_cal_result(int block, uint8_t cal_addr)
+{
+    return 23 + ((block * 7 + cal_addr * 5) % 7);
+}
+
+static void lms_dc_cal_write(struct bladerf_sim *sim, int block, uint8_t base,
+                             uint8_t prev, uint8_t data)
+{
+    const uint8_t cal_addr = data & 0x07;
+
+    /* Rising edge of DC_LOAD: latch DC_CNTVAL into the selected register */
+    if (!(prev & (1 << 4)) && (data & (1 << 4))) {
+        sim->lms_dc_regval[block][cal_addr] = sim->lms[base + 2] & 0x3f;
+    }
+
+    /* Rising edge of DC_START_CLBR: calibration completes immediately */
+    if (!(prev & (1 << 5)) && (data & (1 << 5))) {
+        sim->lms_dc_regval[block][cal_addr] =
+            lms_dc_cal_result(block, cal_addr);
+    }
+}
+
+static uint8_t lms_read_reg(struct bladerf_sim *sim, uint8_t addr)
+{
+    uint8_t base;
+    int block;
+
+    addr &= 0x7f;
+
+    if (addr == LMS_PLL_TX_BASE + 10 || addr == LMS_PLL_RX_BASE + 10) {
+        return lms_read_vtune(sim, addr - 10);
+    }
+
+    block = lms_dc_block(addr, &base);
+    if (block >= 0) {
+        const uint8_t cal_addr = sim->lms[base + 3] & 0x07;
+
+        if (addr == base) {
+            /* DC_REGVAL of the currently selected calibration address */
+            return sim->lms_dc_regval[block][cal_addr];
+        } else if (addr == base + 1) {
+            /* DC_CLBR_DONE (active low) is always deasserted; the
+             * calibration completes as soon as it is started */
+            return sim->lms[addr] & ~(1 << 1);
+        }
+    }
+
+    return sim->lms[addr];
+}
+
+static void lms_write_reg(struct bladerf_sim *sim, uint8_t addr, uint8_t data)
+{
+    const uint8_t prev = sim->lms[addr & 0x7f];
+    uint8_t base;
+    int block;
+
+    addr &= 0x7f;
+    sim->lms[addr] = data;
+
+    block = lms_dc_block(addr, &base);
+    if (block >= 0 && addr == base + 3) {
+        lms_dc_cal_write(sim, block, base, prev, data);
+    }
+}
+
+static int sim_lms_write(struct bladerf *dev, uint8_t addr, uint8_t data)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+
+    dev->round_trips.lms++;
+
+    log_verbose("%s: 0x%2.2x 0x%2.2x\n", __FUNCTION__, addr, data);
+
+    MUTEX_LOCK(&sim->lock);
+    lms_write_reg(sim, addr, data);
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+static int sim_lms_read(struct bladerf *dev, uint8_t addr, uint8_t *data)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+
+    dev->round_trips.lms++;
+
+    MUTEX_LOCK(&sim->lock);
+    *data = lms_read_reg(sim, addr);
+    MUTEX_UNLOCK(&sim->lock);
+
+    log_verbose("%s: 0x%2.2x 0x%2.2x\n", __FUNCTION__, addr, *data);
+    return 0;
+}
+
+/* Batched accessors model the multi-command UART packets the FPGA accepts,
+ * costing one round trip per UART_PKT_MAX_CMDS registers */
+static int sim_lms_write_regs(struct bladerf *dev, const uint8_t *addr,
+                              const uint8_t *data, unsigned int n)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+    unsigned int i;
+
+    if (!sim->lms_batch) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    dev->round_trips.lms += (n + UART_PKT_MAX_CMDS - 1) / UART_PKT_MAX_CMDS;
+
+    MUTEX_LOCK(&sim->lock);
+    for (i = 0; i < n; i++) {
+        log_verbose("%s: 0x%2.2x 0x%2.2x\n", __FUNCTION__, addr[i], data[i]);
+        lms_write_reg(sim, addr[i], data[i]);
+    }
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+static int sim_lms_read_regs(struct bladerf *dev, const uint8_t *addr,
+                             uint8_t *data, unsigned int n)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+    unsigned int i;
+
+    if (!sim->lms_batch) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    dev->round_trips.lms += (n + UART_PKT_MAX_CMDS - 1) / UART_PKT_MAX_CMDS;
+
+    MUTEX_LOCK(&sim->lock);
+    for (i = 0; i < n; i++) {
+        data[i] = lms_read_reg(sim, addr[i]);
+        log_verbose("%s: 0x%2.2x 0x%2.2x\n", __FUNCTION__, addr[i], data[i]);
+    }
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+/* Performs the same register sequence as the NIOS II firmware's DC
+ * calibration loop, in a single round trip */
+static int sim_lms_dc_cal_loop(struct bladerf *dev, uint8_t base,
+                               uint8_t cal_addr, uint8_t dc_cntval,
+                               uint8_t *dc_regval)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+    unsigned int i;
+    uint8_t val;
+    int status = BLADERF_ERR_UNEXPECTED;
+
+    if (!sim->lms_batch) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    dev->round_trips.lms++;
+
+    MUTEX_LOCK(&sim->lock);
+
+    val = (lms_read_reg(sim, base + 3) & ~0x07) | (cal_addr & 0x07);
+    lms_write_reg(sim, base + 3, val);
+
+    lms_write_reg(sim, base + 2, dc_cntval);
+    lms_write_reg(sim, base + 3, val | (1 << 4));
+    lms_write_reg(sim, base + 3, val);
+
+    lms_write_reg(sim, base + 3, val | (1 << 5));
+    lms_write_reg(sim, base + 3, val);
+
+    for (i = 0; i < 25 && status != 0; i++) {
+        if ((lms_read_reg(sim, base + 1) & (1 << 1)) == 0) {
+            *dc_regval = lms_read_reg(sim, base) & 0x3f;
+            status = 0;
+        }
+    }
+
+    MUTEX_UNLOCK(&sim->lock);
+
+    log_verbose("%s: 0x%2.2x:%u -> %d\n", __FUNCTION__, base, cal_addr,
+                status == 0 ? *dc_regval : -1);
+
+    return status;
+}
+
+/******************************************************************************
+ * Configuration
+ ******************************************************************************/
+
+static int parse_pair(const char *str, double *a, double *b)
+{
+    char *end;
+
+    *a = strtod(str, &end);
+    if (end == str || *end != ',') {
+        return BLADERF_ERR_INVAL;
+    }
+
+    str = end + 1;
+    *b = strtod(str, &end);
+    if (end == str || *end != '\0') {
+        return BLADERF_ERR_INVAL;
+    }
+
+    return 0;
+}
+
+static int load_config(struct bladerf_sim *sim)
+{
+    const char *env;
+    int status;
+
+    env = getenv(SIM_ENV_REALTIME);
+    sim->realtime = (env == NULL || strcmp(env, "0") != 0);
+
+    sim->rx.source = SIM_RX_TONE;
+    sim->rx.tone_hz = 100e3;
+    sim->rx.amplitude = 1024.0;
+    sim->rx.rng = 0x5eed5151;
+
+    env = getenv(SIM_ENV_RX);
+    if (env != NULL) {
+        if (!strcmp(env, "zero")) {
+            sim->rx.source = SIM_RX_ZERO;
+        } else if (!strcmp(env, "noise")) {
+            sim->rx.source = SIM_RX_NOISE;
+        } else if (!strcmp(env, "tone")) {
+            sim->rx.source = SIM_RX_TONE;
+        } else if (!strncmp(env, "tone:", 5)) {
+            sim->rx.source = SIM_RX_TONE;
+            sim->rx.tone_hz = strtod(env + 5, NULL);
+        } else if (!strncmp(env, "file:", 5) && env[5] != '\0') {
+            sim->rx.source = SIM_RX_FILE;
+            sim->rx.file_path = strdup(env + 5);
+            if (sim->rx.file_path == NULL) {
+                return BLADERF_ERR_MEM;
+            }
+        } else {
+            log_error("Invalid %s value: %s\n", SIM_ENV_RX, env);
+            return BLADERF_ERR_INVAL;
+        }
+    }
+
+    env = getenv(SIM_ENV_RX_DC);
+    if (env != NULL) {
+        status = parse_pair(env, &sim->rx.dc_i, &sim->rx.dc_q);
+        if (status != 0) {
+            log_error("Invalid %s value: %s\n", SIM_ENV_RX_DC, env);
+            return status;
+        }
+    }
+
+    env = getenv(SIM_ENV_RX_IQ);
+    if (env != NULL) {
+        status = parse_pair(env, &sim->rx.iq_gain, &sim->rx.iq_phase);
+        if (status != 0) {
+            log_error("Invalid %s value: %s\n", SIM_ENV_RX_IQ, env);
+            return status;
+        }
+    }
+
+    env = getenv(SIM_ENV_RX_GAIN);
+    sim->rx.gain_enabled = (env != NULL && strcmp(env, "1") == 0);
+
+    env = getenv(SIM_ENV_LMS_BATCH);
+    sim->lms_batch = (env == NULL || strcmp(env, "0") != 0);
+
+    env = getenv(SIM_ENV_FLASH);
+    if (env != NULL && env[0] != '\0') {
+        sim->flash_path = strdup(env);
+        if (sim->flash_path == NULL) {
+            return BLADERF_ERR_MEM;
+        }
+    }
+
+    return 0;
+}
+
+/* Populate the flash with a calibration region and the OTP with a serial
+ * number, or load a previously saved flash image */
+static int init_flash(struct bladerf_sim *sim)
+{
+    char *cal;
+    int idx;
+    int status;
+
+    sim->flash = malloc(BLADERF_FLASH_TOTAL_SIZE);
+    if (sim->flash == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    memset(sim->flash, 0xff, BLADERF_FLASH_TOTAL_SIZE);
+    memset(sim->otp, 0xff, sizeof(sim->otp));
+
+    idx = 0;
+    status = encode_field((char *) sim->otp, sizeof(sim->otp), &idx,
+                          "S", SIM_SERIAL);
+    if (status != 0) {
+        return status;
+    }
+
+    if (sim->flash_path != NULL) {
+        FILE *f = fopen(sim->flash_path, "rb");
+        if (f != NULL) {
+            size_t n = fread(sim->flash, 1, BLADERF_FLASH_TOTAL_SIZE, f);
+            fclose(f);
+
+            if (n == BLADERF_FLASH_TOTAL_SIZE) {
+                return 0;
+            }
+
+            log_warning("%s is not a valid flash image. Reinitializing.\n",
+                        sim->flash_path);
+            memset(sim->flash, 0xff, BLADERF_FLASH_TOTAL_SIZE);
+        }
+    }
+
+    cal = (char *) &sim->flash[BLADERF_FLASH_ADDR_CAL];
+    idx = 0;
+
+    status = encode_field(cal, CAL_BUFFER_SIZE, &idx, "B", "40");
+    if (status == 0) {
+        status = encode_field(cal, CAL_BUFFER_SIZE, &idx, "DAC", "33000");
+    }
+
+    return status;
+}
+
+static void save_flash(struct bladerf_sim *sim)
+{
+    FILE *f;
+
+    if (sim->flash_path == NULL) {
+        return;
+    }
+
+    f = fopen(sim->flash_path, "wb");
+    if (f == NULL) {
+        log_warning("Failed to open %s: %s\n", sim->flash_path,
+                    strerror(errno));
+        return;
+    }
+
+    if (fwrite(sim->flash, 1, BLADERF_FLASH_TOTAL_SIZE, f) !=
+            BLADERF_FLASH_TOTAL_SIZE) {
+        log_warning("Failed to save flash image to %s\n", sim->flash_path);
+    }
+
+    fclose(f);
+}
+
+/******************************************************************************
+ * Backend functions
+ ******************************************************************************/
+
+static bool sim_matches(bladerf_backend backend)
+{
+    return backend == BLADERF_BACKEND_SIM;
+}
+
+/* The simulated device is only opened when explicitly requested, so it is
+ * never reported when probing */
+static int sim_probe(backend_probe_target probe_target,
+                     struct bladerf_devinfo_list *info_list)
+{
+    return 0;
+}
+
+static void sim_free(struct bladerf_sim *sim)
+{
+    if (sim->rx.file != NULL) {
+        fclose(sim->rx.file);
+    }
+
+    free(sim->rx.file_path);
+    free(sim->flash_path);
+    free(sim->flash);
+    free(sim->loopback.samples);
+    free(sim);
+}
+
+static int sim_open(struct bladerf *dev, struct bladerf_devinfo *info)
+{
+    int status;
+    size_t i;
+    struct bladerf_sim *sim;
+    struct bladerf_devinfo ident;
+
+    /* This backend must be explicitly selected; we don't want an application
+     * opening "any" device to end up with a simulated one */
+    if (info->backend != BLADERF_BACKEND_SIM) {
+        return BLADERF_ERR_NODEV;
+    }
+
+    bladerf_init_devinfo(&ident);
+    ident.backend = BLADERF_BACKEND_SIM;
+    strncpy(ident.serial, SIM_SERIAL, BLADERF_SERIAL_LENGTH - 1);
+    ident.serial[BLADERF_SERIAL_LENGTH - 1] = '\0';
+    ident.usb_bus = 0;
+    ident.usb_addr = 0;
+    ident.instance = 0;
+
+    if (!bladerf_instance_matches(info, &ident) ||
+        !bladerf_serial_matches(info, &ident)) {
+        return BLADERF_ERR_NODEV;
+    }
+
+    sim = calloc(1, sizeof(*sim));
+    if (sim == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    MUTEX_INIT(&sim->lock);
+
+    status = load_config(sim);
+    if (status != 0) {
+        goto error;
+    }
+
+    status = init_flash(sim);
+    if (status != 0) {
+        goto error;
+    }
+
+    sim->loopback.samples = malloc(2 * sizeof(int16_t) * SIM_LOOPBACK_SAMPLES);
+    if (sim->loopback.samples == NULL) {
+        status = BLADERF_ERR_MEM;
+        goto error;
+    }
+
+    if (sim->rx.source == SIM_RX_FILE) {
+        sim->rx.file = fopen(sim->rx.file_path, "rb");
+        if (sim->rx.file == NULL) {
+            log_error("Failed to open RX sample file %s: %s\n",
+                      sim->rx.file_path, strerror(errno));
+            status = BLADERF_ERR_IO;
+            goto error;
+        }
+    }
+
+    for (i = 0; i < ARRAY_SIZE(lms_reset_values); i++) {
+        sim->lms[lms_reset_values[i].addr] = lms_reset_values[i].value;
+    }
+
+    sim->fpga_loaded = true;
+    sim->dac = 0x8000;
+    sim->module[BLADERF_MODULE_RX].samplerate = SIM_DEFAULT_SAMPLERATE;
+    sim->module[BLADERF_MODULE_TX].samplerate = SIM_DEFAULT_SAMPLERATE;
+    clock_gettime(CLOCK_REALTIME, &sim->module[BLADERF_MODULE_RX].t_ref);
+    clock_gettime(CLOCK_REALTIME, &sim->module[BLADERF_MODULE_TX].t_ref);
+
+    memcpy(&dev->ident, &ident, sizeof(ident));
+
+    dev->transfer_timeout[BLADERF_MODULE_TX] = 1000;
+    dev->transfer_timeout[BLADERF_MODULE_RX] = 1000;
+
+    strncpy((char *) dev->fw_version.describe, SIM_FW_VERSION,
+            BLADERF_VERSION_STR_MAX);
+    status = str2version(dev->fw_version.describe, &dev->fw_version);
+    if (status != 0) {
+        goto error;
+    }
+
+    dev->fpga_version.major = SIM_FPGA_MAJOR;
+    dev->fpga_version.minor = SIM_FPGA_MINOR;
+    dev->fpga_version.patch = SIM_FPGA_PATCH;
+    snprintf((char *) dev->fpga_version.describe, BLADERF_VERSION_STR_MAX,
+             "%d.%d.%d", SIM_FPGA_MAJOR, SIM_FPGA_MINOR, SIM_FPGA_PATCH);
+
+    dev->fn = &backend_fns_sim;
+    dev->backend = sim;
+
+    log_debug("Opened simulated device (%s mode)\n",
+              sim->realtime ? "realtime" : "fast");
+
+    return 0;
+
+error:
+    sim_free(sim);
+    return status;
+}
+
+static void sim_close(struct bladerf *dev)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+
+    if (sim != NULL) {
+        save_flash(sim);
+        sim_free(sim);
+        dev->backend = NULL;
+    }
+}
+
+static int sim_load_fpga(struct bladerf *dev, uint8_t *image, size_t image_size)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+
+    log_debug("Simulating load of %u-byte FPGA bitstream\n",
+              (unsigned int) image_size);
+
+    MUTEX_LOCK(&sim->lock);
+    sim->fpga_loaded = true;
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+static int sim_load_fpga_begin(struct bladerf *dev, size_t image_size)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+
+    log_debug("Simulating chunked load of %u-byte FPGA bitstream\n",
+              (unsigned int) image_size);
+
+    MUTEX_LOCK(&sim->lock);
+    sim->fpga_loaded = false;
+    sim->fpga_load_remaining = image_size;
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+static int sim_load_fpga_write(struct bladerf *dev,
+                               const uint8_t *buf, size_t len)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+    int status = 0;
+
+    MUTEX_LOCK(&sim->lock);
+    if (len > sim->fpga_load_remaining) {
+        log_debug("FPGA bitstream chunk exceeds the announced image size\n");
+        status = BLADERF_ERR_INVAL;
+    } else {
+        sim->fpga_load_remaining -= len;
+    }
+    MUTEX_UNLOCK(&sim->lock);
+
+    return status;
+}
+
+static int sim_load_fpga_end(struct bladerf *dev)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+    int status = 0;
+
+    MUTEX_LOCK(&sim->lock);
+    if (sim->fpga_load_remaining != 0) {
+        /* The FPGA never reports CONF_DONE for a truncated bitstream */
+        log_debug("FPGA bitstream is %u bytes short\n",
+                  (unsigned int) sim->fpga_load_remaining);
+        sim->fpga_load_remaining = 0;
+        status = BLADERF_ERR_TIMEOUT;
+    } else {
+        sim->fpga_loaded = true;
+    }
+    MUTEX_UNLOCK(&sim->lock);
+
+    return status;
+}
+
+static int sim_is_fpga_configured(struct bladerf *dev)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+    int ret;
+
+    MUTEX_LOCK(&sim->lock);
+    ret = sim->fpga_loaded ? 1 : 0;
+    MUTEX_UNLOCK(&sim->lock);
+
+    return ret;
+}
+
+static int sim_erase_flash_blocks(struct bladerf *dev,
+                                  uint32_t eb, uint16_t count)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+
+    if ((eb + count) > BLADERF_FLASH_NUM_EBS) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    MUTEX_LOCK(&sim->lock);
+    memset(&sim->flash[eb * BLADERF_FLASH_EB_SIZE], 0xff,
+           count * BLADERF_FLASH_EB_SIZE);
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+/* Model of the firmware's bulk flash streaming, so that flash accesses
+ * exercise the same host code as the USB backend */
+static int sim_flash_bulk_begin(struct bladerf *dev, uint8_t cmd,
+                                uint16_t page, uint16_t count, int32_t *ret)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+    struct sim_flash_bulk *op = &sim->flash_bulk;
+
+    MUTEX_LOCK(&sim->lock);
+
+    if (count == 0 || ((uint32_t) page + count) > BLADERF_FLASH_NUM_PAGES ||
+        op->status == FLASH_BULK_STATUS_BUSY) {
+        *ret = -1;
+    } else if (cmd == BLADE_USB_CMD_FLASH_HASH) {
+        SHA256_CTX ctx;
+
+        /* The firmware computes this in the background; we simply finish
+         * before the first status query */
+        SHA256_Init(&ctx);
+        SHA256_Update(&ctx, &sim->flash[page * BLADERF_FLASH_PAGE_SIZE],
+                      (size_t) count * BLADERF_FLASH_PAGE_SIZE);
+        SHA256_Final(op->digest, &ctx);
+
+        op->digest_valid = true;
+        op->remaining = 0;
+        op->status = FLASH_BULK_STATUS_DONE;
+        *ret = 0;
+    } else {
+        op->is_read = (cmd == BLADE_USB_CMD_FLASH_READ_BULK);
+        op->digest_valid = false;
+        op->offset = (size_t) page * BLADERF_FLASH_PAGE_SIZE;
+        op->remaining = (size_t) count * BLADERF_FLASH_PAGE_SIZE;
+        op->status = FLASH_BULK_STATUS_BUSY;
+        *ret = 0;
+    }
+
+    MUTEX_UNLOCK(&sim->lock);
+    return 0;
+}
+
+/* Transfer page data for the operation in progress */
+static int sim_flash_bulk_xfer(struct bladerf *dev, bool is_read,
+                               uint8_t *buf, const uint8_t *data, size_t len)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+    struct sim_flash_bulk *op = &sim->flash_bulk;
+    size_t i;
+    int status = 0;
+
+    MUTEX_LOCK(&sim->lock);
+
+    if (op->status != FLASH_BULK_STATUS_BUSY || op->is_read != is_read) {
+        /* Nothing is queued on the endpoint */
+        status = BLADERF_ERR_TIMEOUT;
+    } else if (len > op->remaining) {
+        op->status = FLASH_BULK_STATUS_ERROR;
+        status = BLADERF_ERR_IO;
+    } else {
+        if (is_read) {
+            memcpy(buf, &sim->flash[op->offset], len);
+        } else {
+            /* Like NOR flash, programming may only clear bits */
+            for (i = 0; i < len; i++) {
+                sim->flash[op->offset + i] &= data[i];
+            }
+        }
+
+        op->offset += len;
+        op->remaining -= len;
+
+        if (op->remaining == 0) {
+            op->status = FLASH_BULK_STATUS_DONE;
+        }
+    }
+
+    MUTEX_UNLOCK(&sim->lock);
+    return status;
+}
+
+static int sim_flash_bulk_read(struct bladerf *dev, uint8_t *buf, size_t len)
+{
+    return sim_flash_bulk_xfer(dev, true, buf, NULL, len);
+}
+
+static int sim_flash_bulk_write(struct bladerf *dev,
+                                const uint8_t *buf, size_t len)
+{
+    return sim_flash_bulk_xfer(dev, false, NULL, buf, len);
+}
+
+static int sim_flash_bulk_status(struct bladerf *dev, int32_t *status)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+
+    MUTEX_LOCK(&sim->lock);
+    *status = sim->flash_bulk.status;
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+static int sim_flash_bulk_hash_result(struct bladerf *dev, uint8_t *digest)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+    int status = 0;
+
+    MUTEX_LOCK(&sim->lock);
+
+    /* The firmware stalls the request if there is no result */
+    if (sim->flash_bulk.status == FLASH_BULK_STATUS_DONE &&
+        sim->flash_bulk.digest_valid) {
+        memcpy(digest, sim->flash_bulk.digest, FLASH_HASH_SIZE);
+    } else {
+        status = BLADERF_ERR_IO;
+    }
+
+    MUTEX_UNLOCK(&sim->lock);
+    return status;
+}
+
+static const struct flash_bulk_ops sim_flash_bulk_ops = {
+    FIELD_INIT(.begin, sim_flash_bulk_begin),
+    FIELD_INIT(.read, sim_flash_bulk_read),
+    FIELD_INIT(.write, sim_flash_bulk_write),
+    FIELD_INIT(.status, sim_flash_bulk_status),
+    FIELD_INIT(.hash_result, sim_flash_bulk_hash_result),
+};
+
+static int sim_read_flash_pages(struct bladerf *dev, uint8_t *buf,
+                                uint32_t page, uint32_t count)
+{
+    if ((page + count) > BLADERF_FLASH_NUM_PAGES) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    return flash_bulk_read(dev, &sim_flash_bulk_ops, buf,
+                           (uint16_t) page, (uint16_t) count);
+}
+
+static int sim_write_flash_pages(struct bladerf *dev, const uint8_t *buf,
+                                 uint32_t page, uint32_t count)
+{
+    if ((page + count) > BLADERF_FLASH_NUM_PAGES) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    return flash_bulk_write(dev, &sim_flash_bulk_ops, buf,
+                            (uint16_t) page, (uint16_t) count);
+}
+
+static int sim_flash_hash(struct bladerf *dev, uint32_t page,
+                          uint32_t count, uint8_t *digest)
+{
+    if ((page + count) > BLADERF_FLASH_NUM_PAGES) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    return flash_bulk_hash(dev, &sim_flash_bulk_ops,
+                           (uint16_t) page, (uint16_t) count, digest);
+}
+
+static int sim_device_reset(struct bladerf *dev)
+{
+    return 0;
+}
+
+static int sim_jump_to_bootloader(struct bladerf *dev)
+{
+    return BLADERF_ERR_UNSUPPORTED;
+}
+
+static int sim_get_cal(struct bladerf *dev, char *cal)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+
+    MUTEX_LOCK(&sim->lock);
+    memcpy(cal, &sim->flash[BLADERF_FLASH_ADDR_CAL], CAL_BUFFER_SIZE);
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+static int sim_get_otp(struct bladerf *dev, char *otp)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+
+    MUTEX_LOCK(&sim->lock);
+    memcpy(otp, sim->otp, OTP_BUFFER_SIZE);
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+static int sim_get_device_speed(struct bladerf *dev, bladerf_dev_speed *speed)
+{
+    *speed = BLADERF_DEVICE_SPEED_SUPER;
+    return 0;
+}
+
+static int sim_config_gpio_write(struct bladerf *dev, uint32_t val)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+
+    dev->round_trips.fpga += FPGA_REG32_ROUND_TRIPS;
+
+    log_verbose("config_gpio_write: 0x%8.8x\n", val);
+
+    MUTEX_LOCK(&sim->lock);
+    sim->config_gpio = val;
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+static int sim_config_gpio_read(struct bladerf *dev, uint32_t *val)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+
+    dev->round_trips.fpga += FPGA_REG32_ROUND_TRIPS;
+
+    MUTEX_LOCK(&sim->lock);
+    *val = sim->config_gpio;
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+static int sim_expansion_gpio_write(struct bladerf *dev, uint32_t val)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+
+    dev->round_trips.fpga += FPGA_REG32_ROUND_TRIPS;
+
+    MUTEX_LOCK(&sim->lock);
+    sim->xb_gpio = val;
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+static int sim_expansion_gpio_read(struct bladerf *dev, uint32_t *val)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+
+    dev->round_trips.fpga += FPGA_REG32_ROUND_TRIPS;
+
+    MUTEX_LOCK(&sim->lock);
+    *val = sim->xb_gpio;
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+static int sim_expansion_gpio_dir_write(struct bladerf *dev, uint32_t val)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+
+    dev->round_trips.fpga += FPGA_REG32_ROUND_TRIPS;
+
+    MUTEX_LOCK(&sim->lock);
+    sim->xb_gpio_dir = val;
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+static int sim_expansion_gpio_dir_read(struct bladerf *dev, uint32_t *val)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+
+    dev->round_trips.fpga += FPGA_REG32_ROUND_TRIPS;
+
+    MUTEX_LOCK(&sim->lock);
+    *val = sim->xb_gpio_dir;
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+/* LMS DC offset registers for each module, indexed by correction type */
+static inline uint8_t lms_dcoff_addr(bladerf_module module,
+                                     bladerf_correction corr)
+{
+    if (module == BLADERF_MODULE_RX) {
+        return corr == BLADERF_CORR_LMS_DCOFF_I ? 0x71 : 0x72;
+    } else {
+        return corr == BLADERF_CORR_LMS_DCOFF_I ? 0x42 : 0x43;
+    }
+}
+
+/* The LMS DC offset encodings match those used by the USB backend */
+static uint8_t lms_dcoff_encode(bladerf_module module, uint8_t prev,
+                                int16_t value)
+{
+    uint8_t ret;
+
+    if (module == BLADERF_MODULE_RX) {
+        value >>= 5;
+
+        if (value < 0) {
+            ret = (value <= -64) ? 0x3f : (abs(value) & 0x3f);
+            ret |= (1 << 6);
+        } else {
+            ret = (value >= 64) ? 0x3f : (value & 0x3f);
+        }
+
+        /* Bit 7 is unrelated to the DC offset */
+        ret |= prev & (1 << 7);
+    } else {
+        value >>= 4;
+
+        if (value >= 0) {
+            ret = (1 << 7) | ((value >= 128) ? 0x7f : (value & 0x7f));
+        } else {
+            ret = (value <= -128) ? 0x00 : (value & 0x7f);
+        }
+    }
+
+    return ret;
+}
+
+static int16_t lms_dcoff_decode(bladerf_module module, uint8_t regval)
+{
+    int16_t value;
+
+    if (module == BLADERF_MODULE_RX) {
+        value = lms_rx_dcoff(regval & 0x7f);
+    } else {
+        value = (int16_t) regval << 4;
+    }
+
+    return value;
+}
+
+static int sim_set_correction(struct bladerf *dev, bladerf_module module,
+                              bladerf_correction corr, int16_t value)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+    int status = 0;
+    uint8_t addr;
+
+    if (module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    MUTEX_LOCK(&sim->lock);
+
+    switch (corr) {
+        case BLADERF_CORR_LMS_DCOFF_I:
+        case BLADERF_CORR_LMS_DCOFF_Q:
+            /* Read-modify-write */
+            dev->round_trips.lms += 2;
+            addr = lms_dcoff_addr(module, corr);
+            sim->lms[addr] = lms_dcoff_encode(module, sim->lms[addr], value);
+            break;
+
+        case BLADERF_CORR_FPGA_PHASE:
+            dev->round_trips.fpga += FPGA_REG16_ROUND_TRIPS;
+            sim->fpga_phase[module] = value;
+            break;
+
+        case BLADERF_CORR_FPGA_GAIN:
+            dev->round_trips.fpga += FPGA_REG16_ROUND_TRIPS;
+            sim->fpga_gain[module] = value;
+            break;
+
+        default:
+            status = BLADERF_ERR_INVAL;
+    }
+
+    MUTEX_UNLOCK(&sim->lock);
+    return status;
+}
+
+static int sim_get_correction(struct bladerf *dev, bladerf_module module,
+                              bladerf_correction corr, int16_t *value)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+    int status = 0;
+
+    if (module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    MUTEX_LOCK(&sim->lock);
+
+    switch (corr) {
+        case BLADERF_CORR_LMS_DCOFF_I:
+        case BLADERF_CORR_LMS_DCOFF_Q:
+            dev->round_trips.lms++;
+            *value = lms_dcoff_decode(module,
+                                      sim->lms[lms_dcoff_addr(module, corr)]);
+            break;
+
+        case BLADERF_CORR_FPGA_PHASE:
+            dev->round_trips.fpga += FPGA_REG16_ROUND_TRIPS;
+            *value = sim->fpga_phase[module];
+            break;
+
+        case BLADERF_CORR_FPGA_GAIN:
+            dev->round_trips.fpga += FPGA_REG16_ROUND_TRIPS;
+            *value = sim->fpga_gain[module];
+            break;
+
+        default:
+            status = BLADERF_ERR_INVAL;
+    }
+
+    MUTEX_UNLOCK(&sim->lock);
+    return status;
+}
+
+static int sim_get_timestamp_fn(struct bladerf *dev, bladerf_module module,
+                                uint64_t *value)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+
+    if (module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    /* Read as two 4-byte peripheral accesses */
+    dev->round_trips.fpga += 2;
+
+    MUTEX_LOCK(&sim->lock);
+    *value = sim_get_timestamp(sim, module);
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+static int sim_dac_write(struct bladerf *dev, uint16_t value)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+
+    dev->round_trips.fpga += FPGA_REG16_ROUND_TRIPS;
+
+    MUTEX_LOCK(&sim->lock);
+    sim->dac = value;
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+static int sim_xb_spi(struct bladerf *dev, uint32_t value)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+
+    dev->round_trips.fpga += FPGA_REG32_ROUND_TRIPS;
+
+    MUTEX_LOCK(&sim->lock);
+    sim->xb_spi = value;
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+static int sim_set_firmware_loopback(struct bladerf *dev, bool enable)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+
+    dev->round_trips.other++;
+
+    MUTEX_LOCK(&sim->lock);
+    sim->fw_loopback = enable;
+    sim->loopback.head = 0;
+    sim->loopback.count = 0;
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+static int sim_get_firmware_loopback(struct bladerf *dev, bool *is_enabled)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+
+    dev->round_trips.other++;
+
+    MUTEX_LOCK(&sim->lock);
+    *is_enabled = sim->fw_loopback;
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+static int sim_enable_module(struct bladerf *dev, bladerf_module m, bool enable)
+{
+    struct bladerf_sim *sim = sim_backend(dev);
+
+    if (m != BLADERF_MODULE_RX && m != BLADERF_MODULE_TX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    dev->round_trips.other++;
+
+    MUTEX_LOCK(&sim->lock);
+    if (sim->module[m].enabled != enable) {
+        rebase_timestamp(sim, m);
+        sim->module[m].enabled = enable;
+    }
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+static int sim_load_fw_from_bootloader(bladerf_backend backend,
+                                       uint8_t bus, uint8_t addr,
+                                       struct fx3_firmware *fw)
+{
+    return BLADERF_ERR_UNSUPPORTED;
+}
+
+const struct backend_fns backend_fns_sim = {
+    FIELD_INIT(.matches, sim_matches),
+
+    FIELD_INIT(.probe, sim_probe),
+
+    FIELD_INIT(.open, sim_open),
+    FIELD_INIT(.close, sim_close),
+
+    FIELD_INIT(.load_fpga, sim_load_fpga),
+    FIELD_INIT(.is_fpga_configured, sim_is_fpga_configured),
+
+    FIELD_INIT(.erase_flash_blocks, sim_erase_flash_blocks),
+    FIELD_INIT(.read_flash_pages, sim_read_flash_pages),
+    FIELD_INIT(.write_flash_pages, sim_write_flash_pages),
+
+    FIELD_INIT(.device_reset, sim_device_reset),
+    FIELD_INIT(.jump_to_bootloader, sim_jump_to_bootloader),
+
+    FIELD_INIT(.get_cal, sim_get_cal),
+    FIELD_INIT(.get_otp, sim_get_otp),
+    FIELD_INIT(.get_device_speed, sim_get_device_speed),
+
+    FIELD_INIT(.config_gpio_write, sim_config_gpio_write),
+    FIELD_INIT(.config_gpio_read, sim_config_gpio_read),
+
+    FIELD_INIT(.expansion_gpio_write, sim_expansion_gpio_write),
+    FIELD_INIT(.expansion_gpio_read, sim_expansion_gpio_read),
+    FIELD_INIT(.expansion_gpio_dir_write, sim_expansion_gpio_dir_write),
+    FIELD_INIT(.expansion_gpio_dir_read, sim_expansion_gpio_dir_read),
+
+    FIELD_INIT(.set_correction, sim_set_correction),
+    FIELD_INIT(.get_correction, sim_get_correction),
+
+    FIELD_INIT(.get_timestamp, sim_get_timestamp_fn),
+
+    FIELD_INIT(.si5338_write, sim_si5338_write),
+    FIELD_INIT(.si5338_read, sim_si5338_read),
+
+    FIELD_INIT(.lms_write, sim_lms_write),
+    FIELD_INIT(.lms_read, sim_lms_read),
+
+    FIELD_INIT(.dac_write, sim_dac_write),
+
+    FIELD_INIT(.xb_spi, sim_xb_spi),
+
+    FIELD_INIT(.set_firmware_loopback, sim_set_firmware_loopback),
+    FIELD_INIT(.get_firmware_loopback, sim_get_firmware_loopback),
+
+    FIELD_INIT(.enable_module, sim_enable_module),
+
+    FIELD_INIT(.init_stream, sim_init_stream),
+    FIELD_INIT(.stream, sim_stream),
+    FIELD_INIT(.submit_stream_buffer, sim_submit_stream_buffer),
+    FIELD_INIT(.deinit_stream, sim_deinit_stream),
+
+    FIELD_INIT(.load_fw_from_bootloader, sim_load_fw_from_bootloader),
+
+    FIELD_INIT(.enable_trace, NULL),
+    FIELD_INIT(.get_trace_stats, NULL),
+    FIELD_INIT(.write_trace, NULL),
+
+    FIELD_INIT(.lms_write_regs, sim_lms_write_regs),
+    FIELD_INIT(.lms_read_regs, sim_lms_read_regs),
+    FIELD_INIT(.lms_dc_cal_loop, sim_lms_dc_cal_loop),
+
+    FIELD_INIT(.si5338_write_regs, sim_si5338_write_regs),
+    FIELD_INIT(.si5338_read_regs, sim_si5338_read_regs),
+
+    FIELD_INIT(.load_fpga_begin, sim_load_fpga_begin),
+    FIELD_INIT(.load_fpga_write, sim_load_fpga_write),
+    FIELD_INIT(.load_fpga_end, sim_load_fpga_end),
+    FIELD_INIT(.flash_hash, sim_flash_hash),
+};
@@ -0,0 +1,196 @@
+/*
+ * Software-simulated bladeRF device
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef BACKEND_SIM_H_
+#define BACKEND_SIM_H_
+
+#include <stdio.h>
+#include "bladerf_priv.h"
+
+/* Environment variables used to configure the simulated device */
+#define SIM_ENV_REALTIME    "BLADERF_SIM_REALTIME"
+#define SIM_ENV_RX          "BLADERF_SIM_RX"
+#define SIM_ENV_RX_DC       "BLADERF_SIM_RX_DC"
+#define SIM_ENV_RX_IQ       "BLADERF_SIM_RX_IQ"
+#define SIM_ENV_FLASH       "BLADERF_SIM_FLASH"
+#define SIM_ENV_LMS_BATCH   "BLADERF_SIM_LMS_BATCH"
+#define SIM_ENV_RX_GAIN     "BLADERF_SIM_RX_GAIN"
+
+#define SIM_SERIAL          "00000000000000000000000000005151"
+#define SIM_FW_VERSION      "1.8.0"
+
+#define SIM_FPGA_MAJOR      0
+#define SIM_FPGA_MINOR      1
+#define SIM_FPGA_PATCH      3
+
+/* Sample rate the Si5338 model reports until a valid multisynth
+ * configuration has been written */
+#define SIM_DEFAULT_SAMPLERATE  1000000
+
+/* Capacity, in samples, of the firmware loopback FIFO */
+#define SIM_LOOPBACK_SAMPLES    (1 << 20)
+
+/* Number of LMS6002D DC calibration blocks and per-block addresses */
+#define SIM_LMS_DC_BLOCKS   4
+#define SIM_LMS_DC_ADDRS    8
+
+typedef enum {
+    SIM_RX_ZERO,    /* All-zero samples */
+    SIM_RX_TONE,    /* Complex tone at a fixed offset from the carrier */
+    SIM_RX_NOISE,   /* Gaussian-ish noise */
+    SIM_RX_FILE,    /* Looped SC16 Q11 samples from a file */
+} sim_rx_source;
+
+/* Per-module sample clock and timestamp counter state */
+struct sim_module {
+    bool enabled;
+    unsigned int samplerate;
+
+    /* Counter value at the time t_ref was sampled. In realtime mode the
+     * counter advances with wall-clock time while the module is enabled. In
+     * "fast" mode, it only advances as samples are produced or consumed. */
+    uint64_t timestamp;
+    struct timespec t_ref;
+};
+
+/* RX sample generator configuration and state */
+struct sim_rx_gen {
+    sim_rx_source source;
+    double tone_hz;
+    double amplitude;
+    double phase;
+    uint32_t rng;
+    FILE *file;
+    char *file_path;
+
+    /* Impairments of the simulated RX front end, applied before the LMS
+     * DC offset controls and the FPGA IQ corrections */
+    double dc_i, dc_q;
+    double iq_gain;     /* Q channel gain error, as a fraction */
+    double iq_phase;    /* Q channel phase error, in degrees */
+
+    /* Scale samples by the LMS6002D RX gain settings */
+    bool gain_enabled;
+};
+
+/* Bulk flash operation in progress. See backend/flash_bulk.h */
+struct sim_flash_bulk {
+    bool is_read;
+    size_t offset;      /* Flash offset of the next byte to transfer */
+    size_t remaining;   /* Bytes left in the operation */
+    int32_t status;     /* FLASH_BULK_STATUS_* */
+
+    /* Result of the last BLADE_USB_CMD_FLASH_HASH */
+    uint8_t digest[FLASH_HASH_SIZE];
+    bool digest_valid;
+};
+
+/* Firmware loopback FIFO (TX -> RX), in SC16 Q11 samples */
+struct sim_loopback {
+    int16_t *samples;
+    size_t head;
+    size_t count;
+};
+
+struct bladerf_sim {
+    MUTEX lock;
+
+    bool realtime;
+    bool lms_batch;     /* Model batched LMS accesses and the DC cal loop */
+
+    uint8_t lms[128];
+    uint8_t lms_dc_regval[SIM_LMS_DC_BLOCKS][SIM_LMS_DC_ADDRS];
+    uint8_t si5338[256];
+
+    uint32_t config_gpio;
+    uint32_t xb_gpio;
+    uint32_t xb_gpio_dir;
+    uint32_t xb_spi;
+    uint16_t dac;
+
+    /* FPGA IQ corrections, indexed by module */
+    int16_t fpga_phase[NUM_MODULES];
+    int16_t fpga_gain[NUM_MODULES];
+
+    bool fw_loopback;
+    bool fpga_loaded;
+
+    /* Bytes still expected by a chunked FPGA load in progress */
+    size_t fpga_load_remaining;
+
+    struct sim_module module[NUM_MODULES];
+    struct sim_rx_gen rx;
+    struct sim_loopback loopback;
+
+    uint8_t *flash;
+    uint8_t otp[BLADERF_FLASH_PAGE_SIZE];
+    char *flash_path;
+    struct sim_flash_bulk flash_bulk;
+};
+
+static inline struct bladerf_sim *sim_backend(struct bladerf *dev)
+{
+    return (struct bladerf_sim *) dev->backend;
+}
+
+/**
+ * Get the current value of a module's timestamp counter
+ *
+ * @pre sim->lock is held
+ */
+uint64_t sim_get_timestamp(struct bladerf_sim *sim, bladerf_module module);
+
+/**
+ * Advance a module's timestamp counter by the specified number of samples.
+ * This is only meaningful in "fast" (non-realtime) mode.
+ *
+ * @pre sim->lock is held
+ */
+void sim_advance_timestamp(struct bladerf_sim *sim, bladerf_module module,
+                           uint64_t n);
+
+/**
+ * Get the RX DC offset, in SC16 Q11 units, that remains after the LMS6002D
+ * DC offset controls have been applied to the simulated impairment.
+ *
+ * @pre sim->lock is held
+ */
+void sim_rx_dc_residual(struct bladerf_sim *sim, double *dc_i, double *dc_q);
+
+/**
+ * Get the linear RX gain, relative to the maximum RX gain, implied by the
+ * LMS6002D LNA, RXVGA1, and RXVGA2 settings. This is 1.0 when RX gain
+ * modeling is disabled.
+ *
+ * @pre sim->lock is held
+ */
+double sim_rx_gain(struct bladerf_sim *sim);
+
+/* Stream operations, implemented in sim_stream.c */
+int sim_init_stream(struct bladerf_stream *stream, size_t num_transfers);
+int sim_stream(struct bladerf_stream *stream, bladerf_module module);
+int sim_submit_stream_buffer(struct bladerf_stream *stream, void *buffer,
+                             unsigned int timeout_ms);
+void sim_deinit_stream(struct bladerf_stream *stream);
+
+#endif
@@ -0,0 +1,672 @@
+/*
+ * Sample streaming for the software-simulated bladeRF device
+ *
+ * Transfers are "completed" in the order they were submitted. In realtime
+ * mode, an RX transfer completes once the simulated sample clock has reached
+ * the end of the samples it carries, and a TX transfer completes once the
+ * clock reaches its first sample; RX overruns and TX underruns occur when the
+ * host fails to keep enough transfers in flight.
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "bladerf_priv.h"
+#include "async.h"
+#include "metadata.h"
+#include "backend/sim/sim.h"
+#include "log.h"
+
+#ifndef M_PI
+#   define M_PI 3.14159265358979323846
+#endif
+
+/* Full-scale magnitude of an SC16 Q11 sample */
+#define SC16Q11_MAX 2047
+
+/* Interval at which an idle stream re-checks its state */
+#define SIM_IDLE_WAIT_MS 100
+
+struct sim_stream_data {
+    /* Submitted transfers, in the order they will complete */
+    void **queue;
+    size_t num_transfers;
+    size_t num_avail;
+    size_t head;
+
+    /* Signaled when a transfer is submitted */
+    pthread_cond_t submitted;
+
+    /* Timestamp of the first sample in the next transfer */
+    uint64_t timestamp;
+    bool timestamp_valid;
+};
+
+/* Snapshot of the RX path configuration, taken once per transfer */
+struct rx_path {
+    bool loopback;
+    bool impaired;
+    double gain;
+    double dc_i, dc_q;
+    double iq_gain, iq_sin, iq_cos;
+    double corr_gain, corr_sin, corr_cos;
+};
+
+static inline bool stream_uses_metadata(struct bladerf_stream *stream)
+{
+    return stream->format == BLADERF_FORMAT_SC16_Q11_META;
+}
+
+/* Number of samples (excluding metadata) carried by a stream buffer */
+static size_t buffer_payload_samples(struct bladerf_stream *stream)
+{
+    const size_t msg_size = stream->dev->msg_size;
+    size_t num_msgs;
+
+    if (!stream_uses_metadata(stream)) {
+        return stream->samples_per_buffer;
+    }
+
+    num_msgs = async_stream_buf_bytes(stream) / msg_size;
+    return num_msgs * (msg_size - METADATA_HEADER_SIZE) / (2 * sizeof(int16_t));
+}
+
+static inline int16_t clamp_sample(double value)
+{
+    if (value > SC16Q11_MAX) {
+        return SC16Q11_MAX;
+    } else if (value < -SC16Q11_MAX) {
+        return -SC16Q11_MAX;
+    } else {
+        return (int16_t) lrint(value);
+    }
+}
+
+static inline uint32_t xorshift32(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/* Approximately normal, zero-mean value with a standard deviation of ~1 */
+static inline double gaussian(uint32_t *state)
+{
+    double sum = 0;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        sum += (double) xorshift32(state) / UINT32_MAX;
+    }
+
+    /* The variance of a sum of 4 U(0,1) values is 1/3 */
+    return (sum - 2.0) * 1.7320508075688772;
+}
+
+static void rx_path_snapshot(struct bladerf_sim *sim, struct rx_path *p)
+{
+    const double phase_err = sim->rx.iq_phase * M_PI / 180.0;
+    const double phase_corr =
+        sim->fpga_phase[BLADERF_MODULE_RX] * 10.0 / 4096.0 * M_PI / 180.0;
+
+    p->loopback = sim->fw_loopback;
+
+    sim_rx_dc_residual(sim, &p->dc_i, &p->dc_q);
+    p->gain = sim_rx_gain(sim);
+
+    p->iq_gain = 1.0 + sim->rx.iq_gain;
+    p->iq_sin = sin(phase_err);
+    p->iq_cos = cos(phase_err);
+
+    p->corr_gain = 1.0 + sim->fpga_gain[BLADERF_MODULE_RX] / 4096.0;
+    p->corr_sin = sin(phase_corr);
+    p->corr_cos = cos(phase_corr);
+
+    p->impaired = p->dc_i != 0 || p->dc_q != 0 ||
+                  sim->rx.iq_gain != 0 || sim->rx.iq_phase != 0 ||
+                  sim->fpga_gain[BLADERF_MODULE_RX] != 0 ||
+                  sim->fpga_phase[BLADERF_MODULE_RX] != 0;
+}
+
+/* Generate n samples of the configured RX source, as doubles */
+static void rx_generate(struct bladerf_sim *sim, unsigned int samplerate,
+                        double *out, size_t n)
+{
+    struct sim_rx_gen *gen = &sim->rx;
+    size_t i;
+
+    switch (gen->source) {
+        case SIM_RX_TONE: {
+            const double delta = 2 * M_PI * gen->tone_hz / samplerate;
+            const double rot_c = cos(delta);
+            const double rot_s = sin(delta);
+            double c = cos(gen->phase);
+            double s = sin(gen->phase);
+            double tmp;
+
+            /* Rotate a phasor rather than evaluating sin/cos per sample.
+             * The phase is re-derived for each block to avoid drift. */
+            for (i = 0; i < n; i++) {
+                out[2 * i]     = gen->amplitude * c;
+                out[2 * i + 1] = gen->amplitude * s;
+
+                tmp = c * rot_c - s * rot_s;
+                s   = s * rot_c + c * rot_s;
+                c   = tmp;
+            }
+
+            gen->phase = fmod(gen->phase + delta * n, 2 * M_PI);
+            break;
+        }
+
+        case SIM_RX_NOISE:
+            for (i = 0; i < 2 * n; i++) {
+                out[i] = 128.0 * gaussian(&gen->rng);
+            }
+            break;
+
+        case SIM_RX_FILE: {
+            int16_t tmp[2];
+
+            for (i = 0; i < n; i++) {
+                if (fread(tmp, sizeof(tmp), 1, gen->file) != 1) {
+                    rewind(gen->file);
+                    if (fread(tmp, sizeof(tmp), 1, gen->file) != 1) {
+                        tmp[0] = tmp[1] = 0;
+                    }
+                }
+
+                out[2 * i]     = LE16_TO_HOST(tmp[0]);
+                out[2 * i + 1] = LE16_TO_HOST(tmp[1]);
+            }
+            break;
+        }
+
+        default:
+            memset(out, 0, 2 * n * sizeof(out[0]));
+            break;
+    }
+}
+
+/* Apply the front end impairments and the corrections that counteract them.
+ * This is a behavioral model, rather than a bit-accurate one:
+ *
+ *  i' = g * i + dc_i
+ *  q' = (1 + gain_err) * g * (q * cos(phase_err) + i * sin(phase_err)) + dc_q
+ *
+ * where g is the RX gain, relative to the maximum RX gain.
+ *
+ * The FPGA correction then computes:
+ *  q'' = ((1 + gain/4096) * q' + i' * sin(phase)) / cos(phase)
+ */
+static void rx_convert(const struct rx_path *p, const double *in,
+                       int16_t *out, size_t n)
+{
+    size_t i;
+    double si, sq;
+
+    for (i = 0; i < n; i++) {
+        si = p->gain * in[2 * i];
+        sq = p->gain * in[2 * i + 1];
+
+        if (p->impaired) {
+            const double ii = si + p->dc_i;
+            const double qq = p->iq_gain * (sq * p->iq_cos + si * p->iq_sin) +
+                              p->dc_q;
+
+            si = ii;
+            sq = (p->corr_gain * qq + ii * p->corr_sin) / p->corr_cos;
+        }
+
+        out[2 * i]     = HOST_TO_LE16(clamp_sample(si));
+        out[2 * i + 1] = HOST_TO_LE16(clamp_sample(sq));
+    }
+}
+
+/* Pop samples from the firmware loopback FIFO, zero-filling on underflow.
+ *
+ * @pre sim->lock is held */
+static void loopback_pop(struct sim_loopback *lb, int16_t *out, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n && lb->count > 0; i++) {
+        out[2 * i]     = lb->samples[2 * lb->head];
+        out[2 * i + 1] = lb->samples[2 * lb->head + 1];
+        lb->head = (lb->head + 1) % SIM_LOOPBACK_SAMPLES;
+        lb->count--;
+    }
+
+    memset(&out[2 * i], 0, 2 * (n - i) * sizeof(int16_t));
+}
+
+/* Push samples into the firmware loopback FIFO, dropping them on overflow.
+ *
+ * @pre sim->lock is held */
+static void loopback_push(struct sim_loopback *lb, const int16_t *in, size_t n)
+{
+    size_t i, tail;
+
+    for (i = 0; i < n && lb->count < SIM_LOOPBACK_SAMPLES; i++) {
+        tail = (lb->head + lb->count) % SIM_LOOPBACK_SAMPLES;
+        lb->samples[2 * tail]     = in[2 * i];
+        lb->samples[2 * tail + 1] = in[2 * i + 1];
+        lb->count++;
+    }
+}
+
+static void rx_fill_samples(struct bladerf_sim *sim, const struct rx_path *p,
+                            unsigned int samplerate, double *scratch,
+                            int16_t *out, size_t n)
+{
+    if (p->loopback) {
+        MUTEX_LOCK(&sim->lock);
+        loopback_pop(&sim->loopback, out, n);
+        MUTEX_UNLOCK(&sim->lock);
+    } else {
+        rx_generate(sim, samplerate, scratch, n);
+        rx_convert(p, scratch, out, n);
+    }
+}
+
+/* Block until the stream's module is enabled, as a transfer would on real
+ * hardware, or until the transfer timeout expires. */
+static int wait_for_module(struct bladerf_stream *stream,
+                           struct bladerf_sim *sim)
+{
+    const int timeout_ms = stream->dev->transfer_timeout[stream->module];
+    int waited_ms = 0;
+    bool enabled;
+    bladerf_stream_state state;
+
+    while (true) {
+        MUTEX_LOCK(&sim->lock);
+        enabled = sim->module[stream->module].enabled;
+        MUTEX_UNLOCK(&sim->lock);
+
+        if (enabled) {
+            return 0;
+        }
+
+        MUTEX_LOCK(&stream->lock);
+        state = stream->state;
+        MUTEX_UNLOCK(&stream->lock);
+
+        if (state != STREAM_RUNNING) {
+            return 0;
+        } else if (timeout_ms != 0 && waited_ms >= timeout_ms) {
+            return BLADERF_ERR_TIMEOUT;
+        }
+
+        usleep(1000);
+        waited_ms++;
+    }
+}
+
+/* Determine the timestamp of the next transfer and, in realtime mode, sleep
+ * until the sample clock reaches the point at which it completes */
+static uint64_t pace_transfer(struct bladerf_stream *stream,
+                              struct bladerf_sim *sim, size_t n)
+{
+    struct sim_stream_data *sd = stream->backend_data;
+    const bladerf_module module = stream->module;
+    uint64_t now, target, timestamp;
+    unsigned int samplerate;
+
+    MUTEX_LOCK(&sim->lock);
+    now = sim_get_timestamp(sim, module);
+    samplerate = sim->module[module].samplerate;
+
+    if (!sim->realtime) {
+        sd->timestamp = now;
+        sim_advance_timestamp(sim, module, n);
+    } else if (!sd->timestamp_valid) {
+        sd->timestamp = (module == BLADERF_MODULE_RX && now >= n) ? now - n : now;
+    } else if (module == BLADERF_MODULE_RX &&
+               now > sd->timestamp + n * (sd->num_transfers + 1)) {
+        /* The host did not keep up and the device FIFO overflowed. The
+         * samples in between are lost. */
+        log_debug("Simulated RX overrun: %llu samples dropped\n",
+                  (unsigned long long) (now - n - sd->timestamp));
+        sd->timestamp = now - n;
+    } else if (module == BLADERF_MODULE_TX && sd->timestamp < now) {
+        /* The DAC ran dry */
+        log_verbose("Simulated TX underrun\n");
+        sd->timestamp = now;
+    }
+
+    sd->timestamp_valid = true;
+    timestamp = sd->timestamp;
+    sd->timestamp += n;
+
+    /* RX transfers complete once their last sample has been captured. TX
+     * transfers complete once the DAC begins consuming them, which keeps a
+     * transfer's worth of samples queued ahead of it. */
+    target = (module == BLADERF_MODULE_RX) ? sd->timestamp : timestamp;
+    MUTEX_UNLOCK(&sim->lock);
+
+    if (sim->realtime && target > now && samplerate != 0) {
+        const double wait_s = (double) (target - now) / samplerate;
+        usleep((unsigned int) (wait_s * 1e6));
+    }
+
+    return timestamp;
+}
+
+static int rx_transfer(struct bladerf_stream *stream, uint8_t *buf)
+{
+    struct bladerf_sim *sim = sim_backend(stream->dev);
+    const size_t n = buffer_payload_samples(stream);
+    const size_t msg_size = stream->dev->msg_size;
+    const size_t samples_per_msg =
+        (msg_size - METADATA_HEADER_SIZE) / (2 * sizeof(int16_t));
+    struct rx_path path;
+    unsigned int samplerate;
+    uint64_t timestamp;
+    double *scratch;
+    size_t i;
+    int status;
+
+    status = wait_for_module(stream, sim);
+    if (status != 0) {
+        return status;
+    }
+
+    scratch = malloc(2 * n * sizeof(double));
+    if (scratch == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    timestamp = pace_transfer(stream, sim, n);
+
+    MUTEX_LOCK(&sim->lock);
+    rx_path_snapshot(sim, &path);
+    samplerate = sim->module[BLADERF_MODULE_RX].samplerate;
+    MUTEX_UNLOCK(&sim->lock);
+
+    if (stream_uses_metadata(stream)) {
+        for (i = 0; i < n / samples_per_msg; i++) {
+            uint8_t *msg = buf + i * msg_size;
+
+            memset(msg, 0, METADATA_HEADER_SIZE);
+            metadata_set(msg, timestamp, 0);
+
+            rx_fill_samples(sim, &path, samplerate, scratch,
+                            (int16_t *) (msg + METADATA_HEADER_SIZE),
+                            samples_per_msg);
+
+            timestamp += samples_per_msg;
+        }
+    } else {
+        rx_fill_samples(sim, &path, samplerate, scratch, (int16_t *) buf, n);
+    }
+
+    free(scratch);
+    return 0;
+}
+
+static int tx_transfer(struct bladerf_stream *stream, uint8_t *buf)
+{
+    struct bladerf_sim *sim = sim_backend(stream->dev);
+    const size_t n = buffer_payload_samples(stream);
+    const size_t msg_size = stream->dev->msg_size;
+    const size_t samples_per_msg =
+        (msg_size - METADATA_HEADER_SIZE) / (2 * sizeof(int16_t));
+    size_t i;
+    int status;
+
+    status = wait_for_module(stream, sim);
+    if (status != 0) {
+        return status;
+    }
+
+    pace_transfer(stream, sim, n);
+
+    MUTEX_LOCK(&sim->lock);
+    if (sim->fw_loopback) {
+        if (stream_uses_metadata(stream)) {
+            for (i = 0; i < n / samples_per_msg; i++) {
+                const uint8_t *msg = buf + i * msg_size;
+                loopback_push(&sim->loopback,
+                              (const int16_t *) (msg + METADATA_HEADER_SIZE),
+                              samples_per_msg);
+            }
+        } else {
+            loopback_push(&sim->loopback, (const int16_t *) buf, n);
+        }
+    }
+    MUTEX_UNLOCK(&sim->lock);
+
+    return 0;
+}
+
+/* Queue a transfer for completion.
+ *
+ * @pre stream->lock is held and a transfer is available */
+static void submit_transfer(struct bladerf_stream *stream, void *buffer)
+{
+    struct sim_stream_data *sd = stream->backend_data;
+    const size_t in_flight = sd->num_transfers - sd->num_avail;
+
+    assert(sd->num_avail != 0);
+
+    sd->queue[(sd->head + in_flight) % sd->num_transfers] = buffer;
+    sd->num_avail--;
+    pthread_cond_signal(&sd->submitted);
+}
+
+int sim_init_stream(struct bladerf_stream *stream, size_t num_transfers)
+{
+    struct sim_stream_data *sd;
+
+    sd = calloc(1, sizeof(*sd));
+    if (sd == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    sd->queue = calloc(num_transfers, sizeof(sd->queue[0]));
+    if (sd->queue == NULL) {
+        free(sd);
+        return BLADERF_ERR_MEM;
+    }
+
+    if (pthread_cond_init(&sd->submitted, NULL) != 0) {
+        free(sd->queue);
+        free(sd);
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    sd->num_transfers = num_transfers;
+    sd->num_avail = num_transfers;
+
+    stream->backend_data = sd;
+    return 0;
+}
+
+int sim_stream(struct bladerf_stream *stream, bladerf_module module)
+{
+    size_t i;
+    int status;
+    void *buffer;
+    struct timespec timeout_abs;
+    struct bladerf_metadata metadata;
+    struct bladerf *dev = stream->dev;
+    struct sim_stream_data *sd = stream->backend_data;
+
+    /* Currently unused, so zero it out for a sanity check when debugging */
+    memset(&metadata, 0, sizeof(metadata));
+
+    MUTEX_LOCK(&stream->lock);
+
+    sd->timestamp_valid = false;
+
+    /* Set up initial set of buffers */
+    for (i = 0; i < sd->num_transfers; i++) {
+        if (module == BLADERF_MODULE_TX) {
+            buffer = stream->cb(dev,
+                                stream,
+                                &metadata,
+                                NULL,
+                                stream->samples_per_buffer,
+                                stream->user_data);
+
+            if (buffer == BLADERF_STREAM_SHUTDOWN) {
+                stream->state = STREAM_SHUTTING_DOWN;
+                break;
+            }
+        } else {
+            buffer = stream->buffers[i];
+        }
+
+        if (buffer != BLADERF_STREAM_NO_DATA) {
+            submit_transfer(stream, buffer);
+        }
+    }
+
+    while (stream->state != STREAM_DONE) {
+
+        if (stream->state == STREAM_SHUTTING_DOWN) {
+            /* Nothing is actually on the wire, so any transfers still in
+             * flight may be considered cancelled right away */
+            sd->num_avail = sd->num_transfers;
+            sd->head = 0;
+            stream->state = STREAM_DONE;
+            pthread_cond_broadcast(&stream->can_submit_buffer);
+            break;
+        }
+
+        if (sd->num_avail == sd->num_transfers) {
+            status = populate_abs_timeout(&timeout_abs, SIM_IDLE_WAIT_MS);
+            if (status == 0) {
+                pthread_cond_timedwait(&sd->submitted, &stream->lock,
+                                       &timeout_abs);
+            }
+            continue;
+        }
+
+        buffer = sd->queue[sd->head];
+
+        MUTEX_UNLOCK(&stream->lock);
+
+        if (module == BLADERF_MODULE_RX) {
+            status = rx_transfer(stream, buffer);
+        } else {
+            status = tx_transfer(stream, buffer);
+        }
+
+        MUTEX_LOCK(&stream->lock);
+
+        sd->head = (sd->head + 1) % sd->num_transfers;
+        sd->num_avail++;
+        pthread_cond_signal(&stream->can_submit_buffer);
+
+        if (status != 0) {
+            stream->error_code = status;
+            stream->state = STREAM_SHUTTING_DOWN;
+        } else if (stream->state == STREAM_RUNNING) {
+            buffer = stream->cb(dev,
+                                stream,
+                                &metadata,
+                                buffer,
+                                stream->samples_per_buffer,
+                                stream->user_data);
+
+            if (buffer == BLADERF_STREAM_SHUTDOWN) {
+                stream->state = STREAM_SHUTTING_DOWN;
+            } else if (buffer != BLADERF_STREAM_NO_DATA) {
+                submit_transfer(stream, buffer);
+            }
+        }
+    }
+
+    MUTEX_UNLOCK(&stream->lock);
+    return 0;
+}
+
+/* The caller is expected to hold stream->lock */
+int sim_submit_stream_buffer(struct bladerf_stream *stream, void *buffer,
+                             unsigned int timeout_ms)
+{
+    int status = 0;
+    struct timespec timeout_abs;
+    struct sim_stream_data *sd = stream->backend_data;
+
+    if (buffer == BLADERF_STREAM_SHUTDOWN) {
+        if (sd->num_avail == sd->num_transfers) {
+            stream->state = STREAM_DONE;
+        } else {
+            stream->state = STREAM_SHUTTING_DOWN;
+        }
+
+        pthread_cond_signal(&sd->submitted);
+        return 0;
+    }
+
+    if (timeout_ms != 0) {
+        status = populate_abs_timeout(&timeout_abs, timeout_ms);
+        if (status != 0) {
+            return BLADERF_ERR_UNEXPECTED;
+        }
+
+        while (sd->num_avail == 0 && status == 0 &&
+               stream->state == STREAM_RUNNING) {
+            status = pthread_cond_timedwait(&stream->can_submit_buffer,
+                                            &stream->lock,
+                                            &timeout_abs);
+        }
+    } else {
+        while (sd->num_avail == 0 && status == 0 &&
+               stream->state == STREAM_RUNNING) {
+            status = pthread_cond_wait(&stream->can_submit_buffer,
+                                       &stream->lock);
+        }
+    }
+
+    if (status == ETIMEDOUT) {
+        log_debug("%s: Timed out waiting for a transfer to become availble.\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_TIMEOUT;
+    } else if (status != 0) {
+        return BLADERF_ERR_UNEXPECTED;
+    } else if (stream->state != STREAM_RUNNING) {
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    submit_transfer(stream, buffer);
+    return 0;
+}
+
+void sim_deinit_stream(struct bladerf_stream *stream)
+{
+    struct sim_stream_data *sd = stream->backend_data;
+
+    if (sd != NULL) {
+        pthread_cond_destroy(&sd->submitted);
+        free(sd->queue);
+        free(sd);
+        stream->backend_data = NULL;
+    }
+}
@@ -793,6 +793,7 @@ extern "C" {
         FIELD_INIT(.deinit_stream, cyapi_deinit_stream),
         FIELD_INIT(.open_bootloader, cyapi_open_bootloader),
         FIELD_INIT(.close_bootloader, cyapi_close),
+        FIELD_INIT(.fini, NULL),
     };
 
     struct usb_driver usb_driver_cypress = {
@@ -29,6 +29,11 @@
 #include "async.h"
 #include "log.h"
 
+/* Hotplug notifications are available as of libusb v1.0.16 */
+#if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000102)
+#   define HAVE_LIBUSB_HOTPLUG
+#endif
+
 #ifndef LIBUSB_HANDLE_EVENTS_TIMEOUT_NSEC
 #   define LIBUSB_HANDLE_EVENTS_TIMEOUT_NSEC    (15 * 1000)
 #endif
@@ -252,8 +257,10 @@ static bool device_is_probe_target(backend_probe_target probe_target,
     return is_probe_target;
 }
 
-static int lusb_probe(backend_probe_target probe_target,
-                      struct bladerf_devinfo_list *info_list)
+/* Probe by opening each target device. Used for targets the registry
+ * does not track. */
+static int probe_uncached(backend_probe_target probe_target,
+                          struct bladerf_devinfo_list *info_list)
 {
     int status, i, n;
     ssize_t count;
@@ -267,7 +274,7 @@ static int lusb_probe(backend_probe_target probe_target,
     if (status) {
         log_error("Could not initialize libusb: %s\n",
                   libusb_error_name(status));
-        goto lusb_probe_done;
+        goto probe_done;
     }
 
     count = libusb_get_device_list(context, &list);
@@ -301,7 +308,324 @@ static int lusb_probe(backend_probe_target probe_target,
     libusb_free_device_list(list, 1);
     libusb_exit(context);
 
-lusb_probe_done:
+probe_done:
+    return status;
+}
+
+/*
+ * Registry of attached bladeRF devices
+ *
+ * Reading a device's serial number requires opening it and issuing string
+ * descriptor requests, which is slow and contends with any streams running
+ * on that device. The registry caches the devinfo of each attached bladeRF,
+ * keyed by its libusb_device, in a process-wide context. Devices are only
+ * opened the first time they are seen.
+ *
+ * When libusb supports hotplug notifications, the device list is only
+ * rescanned after a bladeRF arrives or departs. Otherwise, it is rescanned
+ * on each lookup, which does not require opening any devices.
+ */
+struct lusb_registry_entry {
+    libusb_device *dev;
+    struct bladerf_devinfo info;
+    bool have_info;             /* info has been read from the device */
+};
+
+static struct {
+    libusb_context *context;
+    bool initialized;
+
+    /* Set by the hotplug callback. Always true if hotplug is unavailable. */
+    bool changed;
+    bool hotplug;
+#   ifdef HAVE_LIBUSB_HOTPLUG
+    libusb_hotplug_callback_handle hotplug_handle;
+#   endif
+
+    /* Attached bladeRFs, in device list order */
+    struct lusb_registry_entry *entries;
+    size_t n_entries;
+} lusb_registry;
+
+static MUTEX lusb_registry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#ifdef HAVE_LIBUSB_HOTPLUG
+static int LIBUSB_CALL registry_hotplug_cb(libusb_context *context,
+                                           libusb_device *dev,
+                                           libusb_hotplug_event event,
+                                           void *user_data)
+{
+    /* Called from registry_refresh() with the registry lock held. Devices
+     * must not be opened from here, so just note that a rescan is needed. */
+    lusb_registry.changed = true;
+    return 0;
+}
+#endif
+
+/* Must be called with the registry lock held */
+static int registry_init(void)
+{
+    int status;
+
+    if (lusb_registry.initialized) {
+        return 0;
+    }
+
+    status = libusb_init(&lusb_registry.context);
+    if (status != 0) {
+        log_debug("Could not initialize registry libusb context: %s\n",
+                  libusb_error_name(status));
+        return error_conv(status);
+    }
+
+#   ifdef HAVE_LIBUSB_HOTPLUG
+    if (libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
+        status = libusb_hotplug_register_callback(
+                        lusb_registry.context,
+                        LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED |
+                            LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+                        0, USB_NUAND_VENDOR_ID, USB_NUAND_BLADERF_PRODUCT_ID,
+                        LIBUSB_HOTPLUG_MATCH_ANY, registry_hotplug_cb, NULL,
+                        &lusb_registry.hotplug_handle);
+
+        if (status == 0) {
+            lusb_registry.hotplug = true;
+        } else {
+            log_debug("Hotplug registration failed: %s\n",
+                      libusb_error_name(status));
+        }
+    }
+#   endif
+
+    log_verbose("Device registry using %s.\n",
+                lusb_registry.hotplug ? "hotplug events" : "rescans");
+
+    lusb_registry.changed = true;
+    lusb_registry.initialized = true;
+    return 0;
+}
+
+/* Release the registry's device references, hotplug callback and libusb
+ * context. The registry is reinitialized if it is used again. */
+static void registry_fini(void)
+{
+    size_t i;
+
+    MUTEX_LOCK(&lusb_registry_lock);
+
+    if (lusb_registry.initialized) {
+        for (i = 0; i < lusb_registry.n_entries; i++) {
+            libusb_unref_device(lusb_registry.entries[i].dev);
+        }
+
+        free(lusb_registry.entries);
+        lusb_registry.entries = NULL;
+        lusb_registry.n_entries = 0;
+
+#       ifdef HAVE_LIBUSB_HOTPLUG
+        if (lusb_registry.hotplug) {
+            libusb_hotplug_deregister_callback(lusb_registry.context,
+                                               lusb_registry.hotplug_handle);
+            lusb_registry.hotplug = false;
+        }
+#       endif
+
+        libusb_exit(lusb_registry.context);
+        lusb_registry.context = NULL;
+        lusb_registry.initialized = false;
+    }
+
+    MUTEX_UNLOCK(&lusb_registry_lock);
+}
+
+/* Bring the registry up to date with the devices currently attached.
+ * Must be called with the registry lock held. */
+static int registry_refresh(void)
+{
+    int status;
+    ssize_t count, i;
+    size_t j, n;
+    libusb_device **list;
+    struct lusb_registry_entry *entries;
+
+    status = registry_init();
+    if (status != 0) {
+        return status;
+    }
+
+    if (lusb_registry.hotplug) {
+        struct timeval tv = { 0, 0 };
+
+        /* Deliver any pending hotplug notifications */
+        status = libusb_handle_events_timeout_completed(lusb_registry.context,
+                                                        &tv, NULL);
+        if (status != 0) {
+            log_debug("Failed to handle hotplug events: %s\n",
+                      libusb_error_name(status));
+            lusb_registry.changed = true;
+        }
+    }
+
+    if (!lusb_registry.changed) {
+        return 0;
+    }
+
+    count = libusb_get_device_list(lusb_registry.context, &list);
+    if (count < 0) {
+        return error_conv(count < INT_MIN ? LIBUSB_ERROR_OTHER : (int) count);
+    }
+
+    entries = calloc((size_t) count + 1, sizeof(entries[0]));
+    if (entries == NULL) {
+        libusb_free_device_list(list, 1);
+        return BLADERF_ERR_MEM;
+    }
+
+    for (i = 0, n = 0; i < count; i++) {
+        for (j = 0; j < lusb_registry.n_entries; j++) {
+            if (lusb_registry.entries[j].dev == list[i]) {
+                break;
+            }
+        }
+
+        if (j < lusb_registry.n_entries) {
+            /* Known device - the registry's reference carries over */
+            entries[n++] = lusb_registry.entries[j];
+            lusb_registry.entries[j].dev = NULL;
+        } else if (device_is_bladerf(list[i])) {
+            entries[n].dev = libusb_ref_device(list[i]);
+            entries[n].have_info = false;
+            n++;
+        }
+    }
+
+    /* Drop devices that are no longer attached */
+    for (j = 0; j < lusb_registry.n_entries; j++) {
+        if (lusb_registry.entries[j].dev != NULL) {
+            libusb_unref_device(lusb_registry.entries[j].dev);
+        }
+    }
+
+    free(lusb_registry.entries);
+    lusb_registry.entries = entries;
+    lusb_registry.n_entries = n;
+
+    /* Without hotplug notifications, we can't tell when to rescan */
+    lusb_registry.changed = !lusb_registry.hotplug;
+
+    libusb_free_device_list(list, 1);
+    return 0;
+}
+
+/* Refresh the registry and read the devinfo of any devices that have not
+ * yet been opened, assigning instance numbers in device list order.
+ * Must be called with the registry lock held. */
+static int registry_update(void)
+{
+    int status;
+    size_t i;
+    unsigned int n;
+
+    status = registry_refresh();
+    if (status != 0) {
+        return status;
+    }
+
+    for (i = 0, n = 0; i < lusb_registry.n_entries; i++) {
+        struct lusb_registry_entry *e = &lusb_registry.entries[i];
+
+        if (!e->have_info) {
+            /* We may not be able to open the device if another driver
+             * (e.g., CyUSB3) is associated with it. Try again next time. */
+            status = get_devinfo(e->dev, &e->info);
+            if (status != 0) {
+                log_debug("Could not open device: %s\n",
+                          libusb_error_name(status));
+                continue;
+            }
+
+            e->have_info = true;
+        }
+
+        e->info.instance = n++;
+    }
+
+    return 0;
+}
+
+/* Look up the devinfo of attached bladeRFs matching info_in. On success,
+ * the number of matches is returned and *matches must be freed by the
+ * caller. Otherwise, a BLADERF_ERR_* value is returned. */
+static int registry_lookup(const struct bladerf_devinfo *info_in,
+                           struct bladerf_devinfo **matches)
+{
+    int status;
+    size_t i, n = 0;
+
+    *matches = NULL;
+
+    MUTEX_LOCK(&lusb_registry_lock);
+
+    status = registry_update();
+    if (status == 0) {
+        *matches = calloc(lusb_registry.n_entries + 1, sizeof((*matches)[0]));
+        if (*matches == NULL) {
+            status = BLADERF_ERR_MEM;
+        }
+    }
+
+    if (status == 0) {
+        for (i = 0; i < lusb_registry.n_entries; i++) {
+            const struct lusb_registry_entry *e = &lusb_registry.entries[i];
+
+            if (e->have_info && bladerf_devinfo_matches(&e->info, info_in)) {
+                (*matches)[n++] = e->info;
+            }
+        }
+    }
+
+    MUTEX_UNLOCK(&lusb_registry_lock);
+
+    return status == 0 ? (int) n : status;
+}
+
+static int lusb_probe(backend_probe_target probe_target,
+                      struct bladerf_devinfo_list *info_list)
+{
+    int status;
+    size_t i;
+
+    if (probe_target != BACKEND_PROBE_BLADERF) {
+        return probe_uncached(probe_target, info_list);
+    }
+
+    MUTEX_LOCK(&lusb_registry_lock);
+
+    status = registry_update();
+    if (status != 0) {
+        log_error("Could not update device registry: %s\n",
+                  bladerf_strerror(status));
+    }
+
+    for (i = 0; i < lusb_registry.n_entries && status == 0; i++) {
+        struct lusb_registry_entry *e = &lusb_registry.entries[i];
+
+        if (e->have_info) {
+            log_verbose("Found a bladeRF\n");
+
+            status = bladerf_devinfo_list_add(info_list, &e->info);
+            if (status != 0) {
+                log_error("Could not add device to list: %s\n",
+                          bladerf_strerror(status));
+            } else {
+                log_verbose("Added instance %d to device list\n",
+                            e->info.instance);
+            }
+        }
+    }
+
+    MUTEX_UNLOCK(&lusb_registry_lock);
+
     return status;
 }
 
@@ -377,7 +701,8 @@ error:
     return status;
 }
 
-static int find_and_open_device(libusb_context *context,
+/* Open a device by opening each bladeRF to read its devinfo */
+static int scan_and_open_device(libusb_context *context,
                                 const struct bladerf_devinfo *info_in,
                                 struct bladerf_lusb **dev_out,
                                 struct bladerf_devinfo *info_out)
@@ -446,6 +771,73 @@ static int find_and_open_device(libusb_context *context,
     return status;
 }
 
+static int find_and_open_device(libusb_context *context,
+                                const struct bladerf_devinfo *info_in,
+                                struct bladerf_lusb **dev_out,
+                                struct bladerf_devinfo *info_out)
+{
+    int status;
+    int n_matches, m;
+    ssize_t count, i;
+    struct libusb_device **list;
+    struct bladerf_devinfo *matches;
+    bool stale = false;
+
+    *dev_out = NULL;
+
+    n_matches = registry_lookup(info_in, &matches);
+    if (n_matches < 0) {
+        log_debug("Device registry unavailable: %s\n",
+                  bladerf_strerror(n_matches));
+        return scan_and_open_device(context, info_in, dev_out, info_out);
+    }
+
+    count = libusb_get_device_list(context, &list);
+    if (count < 0) {
+        free(matches);
+        return error_conv(count < INT_MIN ? LIBUSB_ERROR_OTHER : (int) count);
+    }
+
+    status = BLADERF_ERR_NODEV;
+
+    /* Open the first matching device we can, via its cached bus/addr */
+    for (m = 0; m < n_matches && *dev_out == NULL; m++) {
+        for (i = 0; i < count; i++) {
+            if (libusb_get_bus_number(list[i]) == matches[m].usb_bus &&
+                libusb_get_device_address(list[i]) == matches[m].usb_addr &&
+                device_has_vid_pid(list[i], USB_NUAND_VENDOR_ID,
+                                   USB_NUAND_BLADERF_PRODUCT_ID)) {
+                break;
+            }
+        }
+
+        if (i == count) {
+            /* The device has left since the registry was last updated */
+            stale = true;
+            continue;
+        }
+
+        status = open_device(&matches[m], context, list[i], dev_out);
+        if (status == 0) {
+            memcpy(info_out, &matches[m], sizeof(info_out[0]));
+        } else {
+            status = BLADERF_ERR_NODEV;
+        }
+    }
+
+    libusb_free_device_list(list, 1);
+    free(matches);
+
+    /* A device that has re-enumerated (e.g., after a port reset) may not
+     * have been re-registered yet, so scan for it the slow way. */
+    if (*dev_out == NULL && stale) {
+        log_verbose("No registered device available - rescanning.\n");
+        status = scan_and_open_device(context, info_in, dev_out, info_out);
+    }
+
+    return status;
+}
+
 #if ENABLE_USB_DEV_RESET_ON_OPEN
 static int reset_and_reopen(libusb_context *context,
                             struct bladerf_lusb **dev,
@@ -1295,6 +1687,11 @@ static int lusb_deinit_stream(void *driver, struct bladerf_stream *stream)
     return 0;
 }
 
+static void lusb_fini(void)
+{
+    registry_fini();
+}
+
 static const struct usb_fns libusb_fns = {
     FIELD_INIT(.probe, lusb_probe),
     FIELD_INIT(.open, lusb_open),
@@ -1310,6 +1707,7 @@ static const struct usb_fns libusb_fns = {
     FIELD_INIT(.deinit_stream, lusb_deinit_stream),
     FIELD_INIT(.open_bootloader, lusb_open_bootloader),
     FIELD_INIT(.close_bootloader, lusb_close_bootloader),
+    FIELD_INIT(.fini, lusb_fini),
 };
 
 const struct usb_driver usb_driver_libusb = {
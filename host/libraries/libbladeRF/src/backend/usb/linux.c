@@ -0,0 +1,1104 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* This is a Linux-specific USB backend using the bladeRF kernel driver in
+ * host/drivers/linux.
+ *
+ * Samples are exchanged through the driver's sample ring, which is mapped
+ * into this process. The driver's URBs transfer samples directly to and from
+ * the mapped buffers, and completions are signalled via an eventfd, so no
+ * system calls are made per buffer while a stream is running. Samples are
+ * copied between the ring and the stream's buffers once, as stream buffers
+ * are owned by the caller.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include "bladeRF.h"    /* Firmware and kernel driver interface */
+
+#include "backend/backend.h"
+#include "backend/usb/usb.h"
+#include "async.h"
+#include "log.h"
+
+#define LINUX_DEV_DIR       "/dev"
+#define LINUX_DEV_PREFIX    "bladerf"
+
+/* Smallest ring buffer supported by the driver */
+#define RING_MIN_BUF_SZ     1024
+
+struct bladerf_linux {
+    int fd;
+    struct bladerf_ring_ctrl *ctrl;
+    size_t ctrl_size;
+};
+
+/* A stream buffer waiting to be filled (RX) or sent (TX) */
+struct linux_transfer {
+    void *buffer;
+    unsigned int end;           /* Ring index following the buffer (TX) */
+};
+
+struct linux_stream_data {
+    int efd;                    /* Signalled by the driver upon completions,
+                                 * and by linux_submit_stream_buffer() */
+
+    /* Ring geometry. See struct bladerf_ring_config. */
+    struct bladerf_ring_config cfg;
+    unsigned int slots;         /* Ring buffers per stream buffer */
+
+    uint8_t *ring;              /* Ring buffers, while streaming */
+    size_t ring_size;
+
+    struct linux_transfer *transfers;   /* FIFO of in-flight transfers */
+    size_t num_transfers;               /* Capacity of the FIFO */
+    size_t first;                       /* Index of the oldest transfer */
+    size_t count;                       /* # of in-flight transfers */
+};
+
+/* Convert errno values to libbladeRF error codes */
+static int errno_conv(int error)
+{
+    switch (error) {
+        case 0:
+            return 0;
+
+        case ENODEV:
+        case ENOENT:
+        case ESHUTDOWN:
+        case EPERM:
+        case EACCES:
+            return BLADERF_ERR_NODEV;
+
+        case ETIMEDOUT:
+            return BLADERF_ERR_TIMEOUT;
+
+        case ENOMEM:
+            return BLADERF_ERR_MEM;
+
+        case EINVAL:
+            return BLADERF_ERR_INVAL;
+
+        case EIO:
+        case EPIPE:
+        case EPROTO:
+        case EOVERFLOW:
+        case EILSEQ:
+            return BLADERF_ERR_IO;
+
+        default:
+            return BLADERF_ERR_UNEXPECTED;
+    }
+}
+
+static inline unsigned int ring_dir(bladerf_module module)
+{
+    return module == BLADERF_MODULE_TX ? BLADE_RING_TX : BLADE_RING_RX;
+}
+
+static int dev_ioctl(int fd, unsigned long request, void *arg)
+{
+    int status;
+
+    do {
+        status = ioctl(fd, request, arg);
+    } while (status < 0 && errno == EINTR);
+
+    return status < 0 ? -errno : status;
+}
+
+static int get_string_descriptor(int fd, uint8_t index,
+                                 char *buf, size_t buf_len)
+{
+    uint8_t desc[255];
+    struct bladerf_ctrl_transfer xfer;
+    int len, i, n;
+
+    memset(&xfer, 0, sizeof(xfer));
+    xfer.request_type = USB_DIR_DEVICE_TO_HOST;
+    xfer.request      = 0x06;                   /* GET_DESCRIPTOR */
+    xfer.value        = (0x03 << 8) | index;    /* String descriptor */
+    xfer.index        = 0x0409;                 /* English (US) */
+    xfer.length       = sizeof(desc);
+    xfer.timeout_ms   = CTRL_TIMEOUT_MS;
+    xfer.data         = (uintptr_t) desc;
+
+    len = dev_ioctl(fd, BLADE_CONTROL_TRANSFER, &xfer);
+    if (len < 0) {
+        return errno_conv(-len);
+    } else if (len < 2 || desc[1] != 0x03 || desc[0] > len) {
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    /* Convert from UTF-16LE, replacing non-ASCII characters */
+    for (i = 2, n = 0; i + 1 < desc[0] && (size_t) n + 1 < buf_len; i += 2) {
+        buf[n++] = (desc[i + 1] == 0 && desc[i] < 0x80) ? (char) desc[i] : '?';
+    }
+
+    buf[n] = '\0';
+    return 0;
+}
+
+/* Open a device node and read the device's information */
+static int open_node(const char *path, int *fd_out,
+                     struct bladerf_devinfo *info)
+{
+    int fd;
+    int bus, addr;
+    int status;
+
+    fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        log_debug("Failed to open %s: %s\n", path, strerror(errno));
+        return errno_conv(errno);
+    }
+
+    status = dev_ioctl(fd, BLADE_GET_BUS, &bus);
+    if (status == 0) {
+        status = dev_ioctl(fd, BLADE_GET_ADDR, &addr);
+    }
+
+    if (status < 0) {
+        log_debug("Failed to get bus/address of %s: %s\n",
+                  path, strerror(-status));
+        close(fd);
+        return errno_conv(-status);
+    }
+
+    info->backend = BLADERF_BACKEND_LINUX;
+    info->usb_bus = (uint8_t) bus;
+    info->usb_addr = (uint8_t) addr;
+
+    /* As with the libusb backend, consider this to be non-fatal */
+    status = get_string_descriptor(fd, BLADE_USB_STR_INDEX_SERIAL,
+                                   info->serial, BLADERF_SERIAL_LENGTH);
+    if (status != 0) {
+        log_debug("Failed to retrieve serial number of %s\n", path);
+        memset(info->serial, 0, BLADERF_SERIAL_LENGTH);
+    }
+
+    *fd_out = fd;
+    return 0;
+}
+
+static int compare_minor(const void *a, const void *b)
+{
+    const unsigned int *ua = (const unsigned int *) a;
+    const unsigned int *ub = (const unsigned int *) b;
+    return (*ua > *ub) - (*ua < *ub);
+}
+
+/* Get the numbers of the /dev/bladerf<n> device nodes, in ascending order.
+ * Returns the number of nodes, or a BLADERF_ERR_* value. The caller must
+ * free the list. */
+static int list_nodes(unsigned int **nodes_out)
+{
+    DIR *dir;
+    struct dirent *ent;
+    unsigned int *nodes = NULL, *tmp;
+    unsigned int n, count = 0, len = 0;
+    char c;
+
+    *nodes_out = NULL;
+
+    dir = opendir(LINUX_DEV_DIR);
+    if (dir == NULL) {
+        return BLADERF_ERR_NODEV;
+    }
+
+    while ((ent = readdir(dir)) != NULL) {
+        if (sscanf(ent->d_name, LINUX_DEV_PREFIX "%u%c", &n, &c) != 1) {
+            continue;
+        }
+
+        if (count == len) {
+            len = len ? 2 * len : 8;
+            tmp = (unsigned int *) realloc(nodes, len * sizeof(nodes[0]));
+            if (tmp == NULL) {
+                free(nodes);
+                closedir(dir);
+                return BLADERF_ERR_MEM;
+            }
+
+            nodes = tmp;
+        }
+
+        nodes[count++] = n;
+    }
+
+    closedir(dir);
+
+    qsort(nodes, count, sizeof(nodes[0]), compare_minor);
+    *nodes_out = nodes;
+    return (int) count;
+}
+
+/* Open the first device matching info_in, or just list devices if fd_out
+ * is NULL. Instances are assigned in order of the device nodes' numbers. */
+static int scan_nodes(struct bladerf_devinfo *info_in, int *fd_out,
+                      struct bladerf_devinfo *info_out,
+                      struct bladerf_devinfo_list *info_list)
+{
+    unsigned int *nodes;
+    int i, n, fd = -1;
+    int status = (fd_out == NULL) ? 0 : BLADERF_ERR_NODEV;
+    unsigned int instance = 0;
+    char path[sizeof(LINUX_DEV_DIR) + sizeof(LINUX_DEV_PREFIX) + 16];
+    struct bladerf_devinfo info;
+
+    n = list_nodes(&nodes);
+    if (n < 0) {
+        return (fd_out == NULL && n == BLADERF_ERR_NODEV) ? 0 : n;
+    }
+
+    for (i = 0; i < n; i++) {
+        snprintf(path, sizeof(path), LINUX_DEV_DIR "/" LINUX_DEV_PREFIX "%u",
+                 nodes[i]);
+
+        bladerf_init_devinfo(&info);
+        if (open_node(path, &fd, &info) != 0) {
+            continue;
+        }
+
+        info.instance = instance++;
+
+        if (fd_out == NULL) {
+            close(fd);
+
+            status = bladerf_devinfo_list_add(info_list, &info);
+            if (status != 0) {
+                log_debug("Could not add device to list: %s\n",
+                          bladerf_strerror(status));
+                break;
+            }
+
+        } else if (bladerf_devinfo_matches(&info, info_in)) {
+            log_verbose("Opening %s\n", path);
+            memcpy(info_out, &info, sizeof(info));
+            *fd_out = fd;
+            status = 0;
+            break;
+
+        } else {
+            close(fd);
+        }
+    }
+
+    free(nodes);
+    return status;
+}
+
+static int linux_probe(backend_probe_target probe_target,
+                       struct bladerf_devinfo_list *info_list)
+{
+    /* The driver does not bind to devices in FX3 bootloader mode */
+    if (probe_target != BACKEND_PROBE_BLADERF) {
+        return 0;
+    }
+
+    return scan_nodes(NULL, NULL, NULL, info_list);
+}
+
+static int map_ctrl(struct bladerf_linux *lnx)
+{
+    void *p;
+
+    lnx->ctrl_size = (size_t) sysconf(_SC_PAGESIZE);
+
+    p = mmap(NULL, lnx->ctrl_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+             lnx->fd, BLADE_RING_CTRL_OFFSET);
+    if (p == MAP_FAILED) {
+        log_debug("Failed to map sample ring control page: %s\n",
+                  strerror(errno));
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    lnx->ctrl = (struct bladerf_ring_ctrl *) p;
+    return 0;
+}
+
+static int linux_open(void **driver,
+                      struct bladerf_devinfo *info_in,
+                      struct bladerf_devinfo *info_out)
+{
+    int status;
+    struct bladerf_linux *lnx;
+
+    lnx = (struct bladerf_linux *) calloc(1, sizeof(lnx[0]));
+    if (lnx == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    status = scan_nodes(info_in, &lnx->fd, info_out, NULL);
+    if (status != 0) {
+        free(lnx);
+        return status;
+    }
+
+    status = map_ctrl(lnx);
+    if (status != 0) {
+        /* Likely an older driver; let another backend try the device */
+        log_warning("The bladeRF kernel driver does not support the sample "
+                    "ring. Please update it.\n");
+        close(lnx->fd);
+        free(lnx);
+        return BLADERF_ERR_NODEV;
+    }
+
+    *driver = lnx;
+    return 0;
+}
+
+static void linux_close(void *driver)
+{
+    struct bladerf_linux *lnx = (struct bladerf_linux *) driver;
+
+    munmap(lnx->ctrl, lnx->ctrl_size);
+    close(lnx->fd);
+    free(lnx);
+}
+
+static int linux_get_speed(void *driver, bladerf_dev_speed *speed)
+{
+    int status;
+    int is_super = 0;
+    struct bladerf_linux *lnx = (struct bladerf_linux *) driver;
+
+    status = dev_ioctl(lnx->fd, BLADE_GET_SPEED, &is_super);
+    if (status < 0) {
+        *speed = BLADERF_DEVICE_SPEED_UNKNOWN;
+        return errno_conv(-status);
+    }
+
+    *speed = is_super ? BLADERF_DEVICE_SPEED_SUPER : BLADERF_DEVICE_SPEED_HIGH;
+    return 0;
+}
+
+static int linux_change_setting(void *driver, uint8_t setting)
+{
+    int status;
+    struct bladerf_linux *lnx = (struct bladerf_linux *) driver;
+
+    status = dev_ioctl(lnx->fd, BLADE_SET_INTERFACE,
+                       (void *) (uintptr_t) setting);
+
+    return status < 0 ? errno_conv(-status) : 0;
+}
+
+static inline uint8_t bm_request_type(usb_target target_type,
+                                      usb_request req_type,
+                                      usb_direction direction)
+{
+    uint8_t ret = (uint8_t) direction;
+
+    switch (target_type) {
+        case USB_TARGET_DEVICE:
+            break;
+
+        case USB_TARGET_INTERFACE:
+            ret |= 0x01;
+            break;
+
+        case USB_TARGET_ENDPOINT:
+            ret |= 0x02;
+            break;
+
+        default:
+            ret |= 0x03;
+    }
+
+    switch (req_type) {
+        case USB_REQUEST_STANDARD:
+            break;
+
+        case USB_REQUEST_CLASS:
+            ret |= (0x01 << 5);
+            break;
+
+        case USB_REQUEST_VENDOR:
+            ret |= (0x02 << 5);
+            break;
+    }
+
+    return ret;
+}
+
+static int linux_control_transfer(void *driver,
+                                  usb_target target_type,
+                                  usb_request req_type,
+                                  usb_direction dir, uint8_t request,
+                                  uint16_t wvalue, uint16_t windex,
+                                  void *buffer, uint32_t buffer_len,
+                                  uint32_t timeout_ms)
+{
+    int status;
+    struct bladerf_ctrl_transfer xfer;
+    struct bladerf_linux *lnx = (struct bladerf_linux *) driver;
+
+    if (buffer_len > UINT16_MAX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    memset(&xfer, 0, sizeof(xfer));
+    xfer.request_type = bm_request_type(target_type, req_type, dir);
+    xfer.request      = request;
+    xfer.value        = wvalue;
+    xfer.index        = windex;
+    xfer.length       = (uint16_t) buffer_len;
+    xfer.timeout_ms   = timeout_ms;
+    xfer.data         = (uintptr_t) buffer;
+
+    status = dev_ioctl(lnx->fd, BLADE_CONTROL_TRANSFER, &xfer);
+    if (status >= 0 && (uint32_t) status == buffer_len) {
+        status = 0;
+    } else {
+        log_debug("%s failed: status = %d\n", __FUNCTION__, status);
+        status = status < 0 ? errno_conv(-status) : BLADERF_ERR_IO;
+    }
+
+    return status;
+}
+
+static int linux_bulk_transfer(void *driver, uint8_t endpoint, void *buffer,
+                               uint32_t buffer_len, uint32_t timeout_ms)
+{
+    int status;
+    struct bladerf_bulk_transfer xfer;
+    struct bladerf_linux *lnx = (struct bladerf_linux *) driver;
+
+    memset(&xfer, 0, sizeof(xfer));
+    xfer.endpoint   = endpoint;
+    xfer.length     = buffer_len;
+    xfer.timeout_ms = timeout_ms;
+    xfer.data       = (uintptr_t) buffer;
+
+    status = dev_ioctl(lnx->fd, BLADE_BULK_TRANSFER, &xfer);
+    if (status < 0) {
+        return errno_conv(-status);
+    } else if ((uint32_t) status != buffer_len) {
+        log_debug("Short bulk transfer: requested=%u, transferred=%d\n",
+                  buffer_len, status);
+        return BLADERF_ERR_IO;
+    }
+
+    return 0;
+}
+
+static int linux_get_string_descriptor(void *driver, uint8_t index,
+                                       void *buffer, uint32_t buffer_len)
+{
+    struct bladerf_linux *lnx = (struct bladerf_linux *) driver;
+    return get_string_descriptor(lnx->fd, index, (char *) buffer, buffer_len);
+}
+
+/* Wake the stream's thread, if it is waiting for a completion */
+static void stream_wake(struct linux_stream_data *data)
+{
+    const uint64_t one = 1;
+    ssize_t n;
+
+    n = write(data->efd, &one, sizeof(one));
+    if (n != (ssize_t) sizeof(one)) {
+        log_debug("Failed to signal stream eventfd: %s\n", strerror(errno));
+    }
+}
+
+/* Publish a new ring index to the driver, and kick the driver if it has
+ * stopped submitting transfers while waiting for it.
+ * See struct bladerf_ring_ctrl. */
+static void ring_publish(struct bladerf_linux *lnx, bladerf_module module,
+                         unsigned int index)
+{
+    unsigned int *idx, *wakeup;
+    int status;
+
+    if (module == BLADERF_MODULE_TX) {
+        idx = &lnx->ctrl->tx_head;
+        wakeup = &lnx->ctrl->tx_wakeup;
+    } else {
+        idx = &lnx->ctrl->rx_tail;
+        wakeup = &lnx->ctrl->rx_wakeup;
+    }
+
+    __atomic_store_n(idx, index, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(wakeup, __ATOMIC_RELAXED)) {
+        status = dev_ioctl(lnx->fd, BLADE_RING_KICK,
+                           (void *) (uintptr_t) ring_dir(module));
+        if (status < 0) {
+            log_debug("Failed to kick %s ring: %s\n",
+                      module == BLADERF_MODULE_TX ? "TX" : "RX",
+                      strerror(-status));
+        }
+    }
+}
+
+/* Copy a stream buffer to or from the ring, starting at ring index `index` */
+static void ring_copy(struct linux_stream_data *data, unsigned int index,
+                      uint8_t *buffer, bool to_ring)
+{
+    const unsigned int num_buffers = data->cfg.num_buffers;
+    const size_t buffer_size = data->cfg.buffer_size;
+    unsigned int i, n;
+    unsigned int slots = data->slots;
+    size_t len;
+
+    while (slots != 0) {
+        i = index % num_buffers;
+        n = (slots < num_buffers - i) ? slots : num_buffers - i;
+        len = n * buffer_size;
+
+        if (to_ring) {
+            memcpy(data->ring + i * buffer_size, buffer, len);
+        } else {
+            memcpy(buffer, data->ring + i * buffer_size, len);
+        }
+
+        buffer += len;
+        index += n;
+        slots -= n;
+    }
+}
+
+/* Add a buffer to the stream's FIFO. For TX, it is copied into the ring and
+ * handed to the driver. Precondition: the FIFO is not full. */
+static void enqueue(struct bladerf_linux *lnx, struct bladerf_stream *stream,
+                    void *buffer)
+{
+    struct linux_stream_data *data =
+        (struct linux_stream_data *) stream->backend_data;
+    struct linux_transfer *t;
+
+    assert(data->count < data->num_transfers);
+    t = &data->transfers[(data->first + data->count) % data->num_transfers];
+    t->buffer = buffer;
+    data->count++;
+
+    if (stream->module == BLADERF_MODULE_TX) {
+        const unsigned int head = lnx->ctrl->tx_head;
+
+        ring_copy(data, head, (uint8_t *) buffer, true);
+        t->end = head + data->slots;
+        ring_publish(lnx, BLADERF_MODULE_TX, t->end);
+    }
+}
+
+static void *dequeue(struct linux_stream_data *data)
+{
+    void *buffer = data->transfers[data->first].buffer;
+
+    data->first = (data->first + 1) % data->num_transfers;
+    data->count--;
+
+    return buffer;
+}
+
+/* Complete the oldest transfer, if possible, and hand its buffer to the
+ * stream callback. Returns true if a transfer was completed.
+ * Called with stream->lock held. */
+static bool complete_transfer(struct bladerf_linux *lnx,
+                              struct bladerf_stream *stream)
+{
+    struct linux_stream_data *data =
+        (struct linux_stream_data *) stream->backend_data;
+    struct bladerf_metadata metadata;
+    void *buffer, *next;
+
+    if (data->count == 0) {
+        return false;
+    }
+
+    if (stream->module == BLADERF_MODULE_TX) {
+        const unsigned int tail =
+            __atomic_load_n(&lnx->ctrl->tx_tail, __ATOMIC_ACQUIRE);
+        const struct linux_transfer *t = &data->transfers[data->first];
+
+        if ((int) (tail - t->end) < 0) {
+            return false;
+        }
+
+        buffer = dequeue(data);
+    } else {
+        const unsigned int head =
+            __atomic_load_n(&lnx->ctrl->rx_head, __ATOMIC_ACQUIRE);
+        const unsigned int tail = lnx->ctrl->rx_tail;
+
+        if (head - tail < data->slots) {
+            return false;
+        }
+
+        buffer = dequeue(data);
+        ring_copy(data, tail, (uint8_t *) buffer, false);
+        ring_publish(lnx, BLADERF_MODULE_RX, tail + data->slots);
+    }
+
+    pthread_cond_signal(&stream->can_submit_buffer);
+
+    /* Currently unused - zero out for our own debugging sanity... */
+    memset(&metadata, 0, sizeof(metadata));
+
+    next = stream->cb(stream->dev, stream, &metadata, buffer,
+                      stream->samples_per_buffer, stream->user_data);
+
+    if (next == BLADERF_STREAM_SHUTDOWN) {
+        stream->state = STREAM_SHUTTING_DOWN;
+    } else if (next != BLADERF_STREAM_NO_DATA) {
+        enqueue(lnx, stream, next);
+    }
+
+    return true;
+}
+
+/* Choose the geometry of the ring used by a stream.
+ *
+ * Each stream buffer is split into the fewest ring buffers that the driver
+ * supports. As with the other backends, num_transfers stream buffers are
+ * kept in flight, and the ring holds as many samples as the stream's
+ * buffers, so that the driver has somewhere to put samples while the
+ * application is busy. */
+static int ring_geometry(struct linux_stream_data *data,
+                         struct bladerf_stream *stream, size_t num_transfers)
+{
+    const size_t buf_bytes = async_stream_buf_bytes(stream);
+    const size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+    struct bladerf_ring_config *cfg = &data->cfg;
+    size_t num_buffers;
+
+    cfg->buffer_size = BLADE_RING_MAX_BUF_SZ;
+    while (cfg->buffer_size > RING_MIN_BUF_SZ &&
+           buf_bytes % cfg->buffer_size != 0) {
+        cfg->buffer_size /= 2;
+    }
+
+    if (buf_bytes == 0 || buf_bytes % cfg->buffer_size != 0 ||
+        buf_bytes > BLADE_RING_MAX_SIZE) {
+        log_debug("Buffer size must be a multiple of %u bytes, up to %u.\n",
+                  RING_MIN_BUF_SZ, BLADE_RING_MAX_SIZE);
+        return BLADERF_ERR_INVAL;
+    }
+
+    data->slots = (unsigned int) (buf_bytes / cfg->buffer_size);
+
+    num_buffers = 1;
+    while (num_buffers < stream->num_buffers * data->slots ||
+           num_buffers * cfg->buffer_size < page_size) {
+        num_buffers *= 2;
+    }
+
+    while (num_buffers * cfg->buffer_size > BLADE_RING_MAX_SIZE) {
+        num_buffers /= 2;
+    }
+
+    cfg->num_buffers = (unsigned int) num_buffers;
+
+    if (num_transfers * data->slots < num_buffers) {
+        cfg->num_concurrent = (unsigned int) (num_transfers * data->slots);
+    } else {
+        cfg->num_concurrent = cfg->num_buffers;
+    }
+
+    return 0;
+}
+
+static int linux_init_stream(void *driver, struct bladerf_stream *stream,
+                             size_t num_transfers)
+{
+    struct linux_stream_data *data;
+    size_t max_transfers;
+    int status;
+
+    data = (struct linux_stream_data *) calloc(1, sizeof(data[0]));
+    if (data == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    status = ring_geometry(data, stream, num_transfers);
+    if (status != 0) {
+        free(data);
+        return status;
+    }
+
+    /* TX transfers occupy the ring until they are sent */
+    max_transfers = data->cfg.num_buffers / data->slots;
+    if (num_transfers > max_transfers) {
+        log_debug("Limiting # of transfers to %u to fit the sample ring.\n",
+                  (unsigned int) max_transfers);
+        num_transfers = max_transfers;
+    }
+
+    data->num_transfers = num_transfers;
+    data->transfers = (struct linux_transfer *)
+                        calloc(num_transfers, sizeof(data->transfers[0]));
+
+    data->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (data->transfers == NULL || data->efd < 0) {
+        log_debug("Failed to allocate stream data.\n");
+
+        if (data->efd >= 0) {
+            close(data->efd);
+        }
+
+        free(data->transfers);
+        free(data);
+        return BLADERF_ERR_MEM;
+    }
+
+    stream->backend_data = data;
+    return 0;
+}
+
+/* Wait for the stream's eventfd to be signalled. Returns 0 on success,
+ * or a BLADERF_ERR_* value. */
+static int wait_for_event(struct linux_stream_data *data,
+                          unsigned int timeout_ms)
+{
+    struct pollfd pfd;
+    uint64_t count;
+    int status;
+
+    pfd.fd = data->efd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    status = poll(&pfd, 1, timeout_ms == 0 ? -1 : (int) timeout_ms);
+    if (status < 0) {
+        return errno == EINTR ? 0 : errno_conv(errno);
+    } else if (status == 0) {
+        return BLADERF_ERR_TIMEOUT;
+    }
+
+    /* Reset the eventfd. Completions are determined from the ring indices,
+     * so the count itself is of no interest. */
+    if (read(data->efd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        return errno_conv(errno);
+    }
+
+    return 0;
+}
+
+/* Apply the stream's ring geometry, and map the ring's buffers */
+static int map_ring(struct bladerf_linux *lnx, struct linux_stream_data *data,
+                    bladerf_module module)
+{
+    int status;
+    void *p;
+
+    data->cfg.dir = ring_dir(module);
+
+    status = dev_ioctl(lnx->fd, BLADE_RING_CONFIGURE, &data->cfg);
+    if (status < 0) {
+        log_debug("Failed to configure ring (%u x %u bytes): %s\n",
+                  data->cfg.num_buffers, data->cfg.buffer_size,
+                  strerror(-status));
+        return errno_conv(-status);
+    }
+
+    log_verbose("%s ring: %u x %u bytes, %u in flight\n",
+                module == BLADERF_MODULE_TX ? "TX" : "RX",
+                data->cfg.num_buffers, data->cfg.buffer_size,
+                data->cfg.num_concurrent);
+
+    data->ring_size = (size_t) data->cfg.num_buffers * data->cfg.buffer_size;
+
+    if (module == BLADERF_MODULE_TX) {
+        p = mmap(NULL, data->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                 lnx->fd, BLADE_RING_TX_OFFSET);
+    } else {
+        p = mmap(NULL, data->ring_size, PROT_READ, MAP_SHARED,
+                 lnx->fd, BLADE_RING_RX_OFFSET);
+    }
+
+    if (p == MAP_FAILED) {
+        log_debug("Failed to map ring: %s\n", strerror(errno));
+        return errno_conv(errno);
+    }
+
+    data->ring = (uint8_t *) p;
+    return 0;
+}
+
+static void unmap_ring(struct linux_stream_data *data)
+{
+    if (data->ring != NULL) {
+        munmap(data->ring, data->ring_size);
+        data->ring = NULL;
+    }
+}
+
+static int linux_stream(void *driver, struct bladerf_stream *stream,
+                        bladerf_module module)
+{
+    size_t i;
+    int status;
+    void *buffer;
+    bool progress;
+    struct bladerf_metadata metadata;
+    struct bladerf_ring_eventfd ring_efd;
+    struct bladerf_linux *lnx = (struct bladerf_linux *) driver;
+    struct linux_stream_data *data =
+        (struct linux_stream_data *) stream->backend_data;
+    const unsigned int timeout_ms = stream->dev->transfer_timeout[module];
+    const int *ring_status = (module == BLADERF_MODULE_TX) ?
+                                &lnx->ctrl->tx_status : &lnx->ctrl->rx_status;
+    void *dir = (void *) (uintptr_t) ring_dir(module);
+
+    /* Currently unused, so zero it out for a sanity check when debugging */
+    memset(&metadata, 0, sizeof(metadata));
+
+    ring_efd.dir = ring_dir(module);
+    ring_efd.fd = data->efd;
+
+    MUTEX_LOCK(&stream->lock);
+    status = map_ring(lnx, data, module);
+    MUTEX_UNLOCK(&stream->lock);
+
+    if (status == 0) {
+        status = dev_ioctl(lnx->fd, BLADE_RING_SET_EVENTFD, &ring_efd);
+        if (status == 0) {
+            status = dev_ioctl(lnx->fd, BLADE_RING_START, dir);
+        }
+
+        if (status < 0) {
+            log_debug("Failed to start %s ring: %s\n",
+                      module == BLADERF_MODULE_TX ? "TX" : "RX",
+                      strerror(-status));
+            status = errno_conv(-status);
+        }
+    }
+
+    if (status != 0) {
+        ring_efd.fd = -1;
+        dev_ioctl(lnx->fd, BLADE_RING_SET_EVENTFD, &ring_efd);
+
+        MUTEX_LOCK(&stream->lock);
+        unmap_ring(data);
+        stream->state = STREAM_DONE;
+        pthread_cond_broadcast(&stream->can_submit_buffer);
+        MUTEX_UNLOCK(&stream->lock);
+
+        return status;
+    }
+
+    data->first = 0;
+    data->count = 0;
+
+    MUTEX_LOCK(&stream->lock);
+
+    /* Buffers may now be submitted */
+    pthread_cond_broadcast(&stream->can_submit_buffer);
+
+    /* Set up initial set of buffers */
+    for (i = 0; i < data->num_transfers; i++) {
+        if (module == BLADERF_MODULE_TX) {
+            buffer = stream->cb(stream->dev,
+                                stream,
+                                &metadata,
+                                NULL,
+                                stream->samples_per_buffer,
+                                stream->user_data);
+
+            if (buffer == BLADERF_STREAM_SHUTDOWN) {
+                stream->state = STREAM_SHUTTING_DOWN;
+                break;
+            }
+        } else {
+            buffer = stream->buffers[i];
+        }
+
+        if (buffer != BLADERF_STREAM_NO_DATA) {
+            enqueue(lnx, stream, buffer);
+        }
+    }
+
+    while (stream->state == STREAM_RUNNING) {
+        progress = complete_transfer(lnx, stream);
+
+        if (__atomic_load_n(ring_status, __ATOMIC_RELAXED) != 0) {
+            const int err = __atomic_load_n(ring_status, __ATOMIC_RELAXED);
+            log_error("%s transfer failed: %s\n",
+                      module == BLADERF_MODULE_TX ? "TX" : "RX",
+                      strerror(-err));
+
+            stream->error_code = errno_conv(-err);
+            stream->state = STREAM_SHUTTING_DOWN;
+
+        } else if (!progress) {
+            /* Only expect a completion if a transfer is in flight */
+            const bool waiting = data->count != 0;
+
+            MUTEX_UNLOCK(&stream->lock);
+            status = wait_for_event(data, waiting ? timeout_ms : 0);
+            MUTEX_LOCK(&stream->lock);
+
+            if (status != 0 && stream->state == STREAM_RUNNING &&
+                (status != BLADERF_ERR_TIMEOUT ||
+                 !complete_transfer(lnx, stream))) {
+
+                if (status == BLADERF_ERR_TIMEOUT) {
+                    log_debug("%s transfer timed out.\n",
+                              module == BLADERF_MODULE_TX ? "TX" : "RX");
+                }
+
+                stream->error_code = status;
+                stream->state = STREAM_SHUTTING_DOWN;
+            }
+        }
+    }
+
+    MUTEX_UNLOCK(&stream->lock);
+
+    status = dev_ioctl(lnx->fd, BLADE_RING_STOP, dir);
+    if (status < 0) {
+        log_debug("Failed to stop ring: %s\n", strerror(-status));
+    }
+
+    ring_efd.fd = -1;
+    dev_ioctl(lnx->fd, BLADE_RING_SET_EVENTFD, &ring_efd);
+
+    MUTEX_LOCK(&stream->lock);
+    unmap_ring(data);
+    data->count = 0;
+    stream->state = STREAM_DONE;
+    pthread_cond_broadcast(&stream->can_submit_buffer);
+    MUTEX_UNLOCK(&stream->lock);
+
+    return 0;
+}
+
+/* The top-level code will have acquired the stream->lock for us */
+static int linux_submit_stream_buffer(void *driver,
+                                      struct bladerf_stream *stream,
+                                      void *buffer, unsigned int timeout_ms)
+{
+    int status = 0;
+    struct timespec timeout_abs;
+    struct bladerf_linux *lnx = (struct bladerf_linux *) driver;
+    struct linux_stream_data *data =
+        (struct linux_stream_data *) stream->backend_data;
+
+    if (buffer == BLADERF_STREAM_SHUTDOWN) {
+        if (stream->state == STREAM_RUNNING) {
+            stream->state = STREAM_SHUTTING_DOWN;
+            stream_wake(data);
+        }
+
+        return 0;
+    }
+
+    if (timeout_ms != 0) {
+        status = populate_abs_timeout(&timeout_abs, timeout_ms);
+        if (status != 0) {
+            return BLADERF_ERR_UNEXPECTED;
+        }
+
+        while ((data->count == data->num_transfers || data->ring == NULL) &&
+               stream->state == STREAM_RUNNING && status == 0) {
+            status = pthread_cond_timedwait(&stream->can_submit_buffer,
+                                            &stream->lock,
+                                            &timeout_abs);
+        }
+    } else {
+        while ((data->count == data->num_transfers || data->ring == NULL) &&
+               stream->state == STREAM_RUNNING && status == 0) {
+            status = pthread_cond_wait(&stream->can_submit_buffer,
+                                       &stream->lock);
+        }
+    }
+
+    if (status == ETIMEDOUT) {
+        log_debug("%s: Timed out waiting for a transfer to become available.\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_TIMEOUT;
+    } else if (status != 0) {
+        return BLADERF_ERR_UNEXPECTED;
+    } else if (stream->state != STREAM_RUNNING) {
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    enqueue(lnx, stream, buffer);
+
+    /* An RX buffer may allow the stream to consume samples already waiting
+     * in the ring */
+    if (stream->module == BLADERF_MODULE_RX) {
+        stream_wake(data);
+    }
+
+    return 0;
+}
+
+static int linux_deinit_stream(void *driver, struct bladerf_stream *stream)
+{
+    struct linux_stream_data *data =
+        (struct linux_stream_data *) stream->backend_data;
+
+    close(data->efd);
+    free(data->transfers);
+    free(data);
+
+    stream->backend_data = NULL;
+    return 0;
+}
+
+/* The driver does not bind to devices in FX3 bootloader mode */
+static int linux_open_bootloader(void **driver, uint8_t bus, uint8_t addr)
+{
+    return BLADERF_ERR_NODEV;
+}
+
+static void linux_close_bootloader(void *driver)
+{
+}
+
+static const struct usb_fns linux_fns = {
+    FIELD_INIT(.probe, linux_probe),
+    FIELD_INIT(.open, linux_open),
+    FIELD_INIT(.close, linux_close),
+    FIELD_INIT(.get_speed, linux_get_speed),
+    FIELD_INIT(.change_setting, linux_change_setting),
+    FIELD_INIT(.control_transfer, linux_control_transfer),
+    FIELD_INIT(.bulk_transfer, linux_bulk_transfer),
+    FIELD_INIT(.get_string_descriptor, linux_get_string_descriptor),
+    FIELD_INIT(.init_stream, linux_init_stream),
+    FIELD_INIT(.stream, linux_stream),
+    FIELD_INIT(.submit_stream_buffer, linux_submit_stream_buffer),
+    FIELD_INIT(.deinit_stream, linux_deinit_stream),
+    FIELD_INIT(.open_bootloader, linux_open_bootloader),
+    FIELD_INIT(.close_bootloader, linux_close_bootloader),
+    FIELD_INIT(.fini, NULL),
+};
+
+const struct usb_driver usb_driver_linux = {
+    FIELD_INIT(.id, BLADERF_BACKEND_LINUX),
+    FIELD_INIT(.fn, &linux_fns)
+};
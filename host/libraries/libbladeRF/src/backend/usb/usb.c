@@ -29,6 +29,8 @@
 #include "backend/backend.h"
 #include "backend/backend_config.h"
 #include "backend/usb/usb.h"
+#include "backend/usb/usb_trace.h"
+#include "backend/flash_bulk.h"
 #include "async.h"
 #include "bladeRF.h"    /* Firmware interface */
 #include "log.h"
@@ -82,20 +84,98 @@ static void print_buf(const char *msg, const uint8_t *buf, size_t len)
 #define print_buf(msg, data, len)
 #endif
 
-static int access_peripheral(struct bladerf *dev, uint8_t peripheral,
-                             usb_direction dir, struct uart_cmd *cmd,
-                             size_t len)
+/* Control transfer to the device, accounted for in the device's USB trace
+ * when tracing is enabled */
+static inline int control_transfer(struct bladerf *dev,
+                                   usb_target target_type,
+                                   usb_request req_type,
+                                   usb_direction dir,
+                                   uint8_t request,
+                                   uint16_t wvalue, uint16_t windex,
+                                   void *buffer, uint32_t buffer_len,
+                                   uint32_t timeout_ms)
+{
+    void *driver;
+    struct bladerf_usb *usb = usb_backend(dev, &driver);
+    uint64_t t_start;
+    int status;
+
+    if (usb->trace == NULL) {
+        return usb->fn->control_transfer(driver, target_type, req_type, dir,
+                                         request, wvalue, windex,
+                                         buffer, buffer_len, timeout_ms);
+    }
+
+    t_start = usb_trace_now();
+    status = usb->fn->control_transfer(driver, target_type, req_type, dir,
+                                       request, wvalue, windex,
+                                       buffer, buffer_len, timeout_ms);
+
+    usb_trace_add(usb->trace, dev->api_fn, dev->api_seq, USB_TRACE_CONTROL,
+                  request, buffer_len, t_start, usb_trace_now(), status);
+
+    return status;
+}
+
+/* Bulk transfer on a control-path endpoint, accounted for in the device's USB
+ * trace when tracing is enabled */
+static inline int bulk_transfer(struct bladerf *dev, uint8_t endpoint,
+                                void *buffer, uint32_t buffer_len,
+                                uint32_t timeout_ms)
 {
     void *driver;
     struct bladerf_usb *usb = usb_backend(dev, &driver);
+    uint64_t t_start;
+    int status;
+
+    if (usb->trace == NULL) {
+        return usb->fn->bulk_transfer(driver, endpoint,
+                                      buffer, buffer_len, timeout_ms);
+    }
+
+    t_start = usb_trace_now();
+    status = usb->fn->bulk_transfer(driver, endpoint,
+                                    buffer, buffer_len, timeout_ms);
+
+    usb_trace_add(usb->trace, dev->api_fn, dev->api_seq, USB_TRACE_BULK,
+                  endpoint, buffer_len, t_start, usb_trace_now(), status);
+
+    return status;
+}
+
+/* Account for a peripheral access in the device's round trip counts */
+static inline void count_peripheral_access(struct bladerf *dev,
+                                           uint8_t peripheral)
+{
+    switch (peripheral) {
+        case UART_PKT_DEV_LMS:
+            dev->round_trips.lms++;
+            break;
+
+        case UART_PKT_DEV_SI5338:
+            dev->round_trips.si5338++;
+            break;
+
+        default:
+            dev->round_trips.fpga++;
+    }
+}
+
+/* Issue a single peripheral packet with the specified UART_PKT_MODE_DIR_*
+ * value. The response's command data is copied back to cmd for anything
+ * other than a write. */
+static int access_peripheral_mode(struct bladerf *dev, uint8_t peripheral,
+                                  uint8_t pkt_mode_dir, struct uart_cmd *cmd,
+                                  size_t len)
+{
+    struct bladerf_usb *usb = usb_backend(dev, NULL);
+    const uint64_t t_start = (usb->trace == NULL) ? 0 : usb_trace_now();
 
     int status;
     size_t i;
     uint8_t buf[16] = { 0 };
-    const uint8_t pkt_mode_dir = (dir == USB_DIR_HOST_TO_DEVICE) ?
-                        UART_PKT_MODE_DIR_WRITE : UART_PKT_MODE_DIR_READ;
 
-    assert(len <= ((sizeof(buf) - 2) / 2));
+    assert(len <= UART_PKT_MAX_CMDS);
 
     /* Populate the buffer for transfer */
     buf[0] = UART_PKT_MAGIC;
@@ -108,23 +188,23 @@ static int access_peripheral(struct bladerf *dev, uint8_t peripheral,
 
     print_buf("Peripheral access request:", buf, 16);
 
+    count_peripheral_access(dev, peripheral);
+
     /* Send the command */
-    status = usb->fn->bulk_transfer(driver, PERIPHERAL_EP_OUT,
-                                     buf, sizeof(buf),
-                                     PERIPHERAL_TIMEOUT_MS);
+    status = bulk_transfer(dev, PERIPHERAL_EP_OUT, buf, sizeof(buf),
+                           PERIPHERAL_TIMEOUT_MS);
     if (status != 0) {
         log_debug("Failed to write perperial access command: %s\n",
                   bladerf_strerror(status));
         return status;
     }
 
-    /* Read back the ACK. The command data is only used for a read operation,
-     * and is thrown away otherwise */
-    status = usb->fn->bulk_transfer(driver, PERIPHERAL_EP_IN,
-                                    buf, sizeof(buf),
-                                    PERIPHERAL_TIMEOUT_MS);
+    /* Read back the ACK. The command data is thrown away for a write
+     * operation */
+    status = bulk_transfer(dev, PERIPHERAL_EP_IN, buf, sizeof(buf),
+                           PERIPHERAL_TIMEOUT_MS);
 
-    if (dir == UART_PKT_MODE_DIR_READ && status == 0) {
+    if (pkt_mode_dir != UART_PKT_MODE_DIR_WRITE && status == 0) {
         for (i = 0; i < len; i++) {
             cmd[i].data = buf[i * 2 + 3];
         }
@@ -132,9 +212,25 @@ static int access_peripheral(struct bladerf *dev, uint8_t peripheral,
 
     print_buf("Peripheral access response:", buf, 16);
 
+    if (usb->trace != NULL) {
+        usb_trace_add(usb->trace, dev->api_fn, dev->api_seq,
+                      USB_TRACE_PERIPHERAL, pkt_mode_dir | peripheral,
+                      (uint32_t) len, t_start, usb_trace_now(), status);
+    }
+
     return status;
 }
 
+static int access_peripheral(struct bladerf *dev, uint8_t peripheral,
+                             usb_direction dir, struct uart_cmd *cmd,
+                             size_t len)
+{
+    const uint8_t pkt_mode_dir = (dir == USB_DIR_HOST_TO_DEVICE) ?
+                        UART_PKT_MODE_DIR_WRITE : UART_PKT_MODE_DIR_READ;
+
+    return access_peripheral_mode(dev, peripheral, pkt_mode_dir, cmd, len);
+}
+
 static inline int gpio_read(struct bladerf *dev, uint8_t addr, uint32_t *data)
 {
     int status;
@@ -231,32 +327,30 @@ static int load_fpga_version(struct bladerf *dev)
 static inline int vendor_cmd_int_windex(struct bladerf *dev, uint8_t cmd,
                                         uint16_t windex, int32_t *val)
 {
-    void *driver;
-    struct bladerf_usb *usb = usb_backend(dev, &driver);
-
-    return usb->fn->control_transfer(driver,
-                                      USB_TARGET_DEVICE,
-                                      USB_REQUEST_VENDOR,
-                                      USB_DIR_DEVICE_TO_HOST,
-                                      cmd, 0, windex,
-                                      val, sizeof(uint32_t),
-                                      CTRL_TIMEOUT_MS);
+    dev->round_trips.other++;
+
+    return control_transfer(dev,
+                            USB_TARGET_DEVICE,
+                            USB_REQUEST_VENDOR,
+                            USB_DIR_DEVICE_TO_HOST,
+                            cmd, 0, windex,
+                            val, sizeof(uint32_t),
+                            CTRL_TIMEOUT_MS);
 }
 
 /* Vendor command wrapper to get a 32-bit integer and supplies wValue */
 static inline int vendor_cmd_int_wvalue(struct bladerf *dev, uint8_t cmd,
                                         uint16_t wvalue, int32_t *val)
 {
-    void *driver;
-    struct bladerf_usb *usb = usb_backend(dev, &driver);
-
-    return usb->fn->control_transfer(driver,
-                                      USB_TARGET_DEVICE,
-                                      USB_REQUEST_VENDOR,
-                                      USB_DIR_DEVICE_TO_HOST,
-                                      cmd, wvalue, 0,
-                                      val, sizeof(uint32_t),
-                                      CTRL_TIMEOUT_MS);
+    dev->round_trips.other++;
+
+    return control_transfer(dev,
+                            USB_TARGET_DEVICE,
+                            USB_REQUEST_VENDOR,
+                            USB_DIR_DEVICE_TO_HOST,
+                            cmd, wvalue, 0,
+                            val, sizeof(uint32_t),
+                            CTRL_TIMEOUT_MS);
 }
 
 
@@ -264,15 +358,14 @@ static inline int vendor_cmd_int_wvalue(struct bladerf *dev, uint8_t cmd,
 static inline int vendor_cmd_int(struct bladerf *dev, uint8_t cmd,
                                  usb_direction dir, int32_t *val)
 {
-    void *driver;
-    struct bladerf_usb *usb = usb_backend(dev, &driver);
-
-    return usb->fn->control_transfer(driver,
-                                      USB_TARGET_DEVICE,
-                                      USB_REQUEST_VENDOR,
-                                      dir, cmd, 0, 0,
-                                      val, sizeof(int32_t),
-                                      CTRL_TIMEOUT_MS);
+    dev->round_trips.other++;
+
+    return control_transfer(dev,
+                            USB_TARGET_DEVICE,
+                            USB_REQUEST_VENDOR,
+                            dir, cmd, 0, 0,
+                            val, sizeof(int32_t),
+                            CTRL_TIMEOUT_MS);
 }
 
 static inline int change_setting(struct bladerf *dev, uint8_t setting)
@@ -380,6 +473,17 @@ static int usb_probe(backend_probe_target probe_target,
     return status;
 }
 
+void usb_fini(void)
+{
+    size_t i;
+
+    for (i = 0; i < ARRAY_SIZE(usb_driver_list); i++) {
+        if (usb_driver_list[i]->fn->fini != NULL) {
+            usb_driver_list[i]->fn->fini();
+        }
+    }
+}
+
 static void usb_close(struct bladerf *dev)
 {
     int status;
@@ -397,6 +501,17 @@ static void usb_close(struct bladerf *dev)
         }
 
         usb->fn->close(driver);
+
+        if (usb->trace != NULL && usb->trace_file != NULL) {
+            status = usb_trace_write(usb->trace, usb->trace_file);
+            if (status != 0) {
+                log_warning("Failed to write USB trace to %s: %s\n",
+                            usb->trace_file, bladerf_strerror(status));
+            }
+        }
+
+        usb_trace_free(usb->trace);
+        free(usb->trace_file);
         free(usb);
         dev->backend = NULL;
     }
@@ -427,7 +542,8 @@ static int usb_open(struct bladerf *dev, struct bladerf_devinfo *info)
 {
     int status;
     size_t i;
-    struct bladerf_usb *usb = (struct bladerf_usb*) malloc(sizeof(*usb));
+    const char *trace_file;
+    struct bladerf_usb *usb = (struct bladerf_usb*) calloc(1, sizeof(*usb));
 
     if (usb == NULL) {
         return BLADERF_ERR_MEM;
@@ -456,6 +572,23 @@ static int usb_open(struct bladerf *dev, struct bladerf_devinfo *info)
     dev->transfer_timeout[BLADERF_MODULE_TX] = BULK_TIMEOUT_MS;
     dev->transfer_timeout[BLADERF_MODULE_RX] = BULK_TIMEOUT_MS;
 
+    /* Trace all transactions, including those made while opening the
+     * device, if requested via the environment */
+    trace_file = getenv(USB_TRACE_ENV_FILE);
+    if (trace_file != NULL && trace_file[0] != '\0') {
+        usb->trace = usb_trace_alloc();
+        usb->trace_file = strdup(trace_file);
+
+        if (usb->trace == NULL || usb->trace_file == NULL) {
+            log_warning("Failed to enable USB tracing\n");
+            usb_trace_free(usb->trace);
+            free(usb->trace_file);
+            usb->trace = NULL;
+            usb->trace_file = NULL;
+        } else {
+            log_verbose("Writing USB trace to %s on close\n", trace_file);
+        }
+    }
 
     /* The FPGA version is populated when rf link is established
      * (zeroize until then) */
@@ -543,15 +676,14 @@ static int begin_fpga_programming(struct bladerf *dev)
     }
 }
 
-static int usb_load_fpga(struct bladerf *dev, uint8_t *image, size_t image_size)
+static int usb_load_fpga_begin(struct bladerf *dev, size_t image_size)
 {
-    void *driver;
-    struct bladerf_usb *usb = usb_backend(dev, &driver);
-
-    unsigned int wait_count;
-    const unsigned int timeout_ms = (2 * CTRL_TIMEOUT_MS);
     int status;
 
+    if (image_size > UINT32_MAX) {
+        return BLADERF_ERR_INVAL;
+    }
+
     /* Switch to the FPGA configuration interface */
     status = change_setting(dev, USB_IF_CONFIG);
     if(status < 0) {
@@ -568,16 +700,33 @@ static int usb_load_fpga(struct bladerf *dev, uint8_t *image, size_t image_size)
         return status;
     }
 
-    /* Send the file down */
-    assert(image_size <= UINT32_MAX);
-    status = usb->fn->bulk_transfer(driver, PERIPHERAL_EP_OUT, image,
-                                    (uint32_t)image_size, timeout_ms);
+    return 0;
+}
+
+static int usb_load_fpga_write(struct bladerf *dev,
+                               const uint8_t *buf, size_t len)
+{
+    const unsigned int timeout_ms = (2 * CTRL_TIMEOUT_MS);
+    int status;
+
+    /* Send this portion of the file down */
+    assert(len <= UINT32_MAX);
+    status = bulk_transfer(dev, PERIPHERAL_EP_OUT, (void *) buf,
+                           (uint32_t) len, timeout_ms);
     if (status < 0) {
         log_debug("Failed to write FPGA bitstream to FPGA: %s\n",
                   bladerf_strerror(status));
         return status;
     }
 
+    return 0;
+}
+
+static int usb_load_fpga_end(struct bladerf *dev)
+{
+    unsigned int wait_count;
+    int status;
+
     /* Poll FPGA status to determine if programming was a success */
     wait_count = 10;
     status = 0;
@@ -605,20 +754,34 @@ static int usb_load_fpga(struct bladerf *dev, uint8_t *image, size_t image_size)
     return rflink_and_fpga_version_load(dev);
 }
 
+static int usb_load_fpga(struct bladerf *dev, uint8_t *image, size_t image_size)
+{
+    int status;
+
+    status = usb_load_fpga_begin(dev, image_size);
+    if (status != 0) {
+        return status;
+    }
+
+    status = usb_load_fpga_write(dev, image, image_size);
+    if (status != 0) {
+        return status;
+    }
+
+    return usb_load_fpga_end(dev);
+}
+
 static inline int perform_erase(struct bladerf *dev, uint16_t block)
 {
     int status, erase_ret;
-    void *driver;
-    struct bladerf_usb *usb = usb_backend(dev, &driver);
-
-    status = usb->fn->control_transfer(driver,
-                                        USB_TARGET_DEVICE,
-                                        USB_REQUEST_VENDOR,
-                                        USB_DIR_DEVICE_TO_HOST,
-                                        BLADE_USB_CMD_FLASH_ERASE,
-                                        0, block,
-                                        &erase_ret, sizeof(erase_ret),
-                                        CTRL_TIMEOUT_MS);
+    status = control_transfer(dev,
+                              USB_TARGET_DEVICE,
+                              USB_REQUEST_VENDOR,
+                              USB_DIR_DEVICE_TO_HOST,
+                              BLADE_USB_CMD_FLASH_ERASE,
+                              0, block,
+                              &erase_ret, sizeof(erase_ret),
+                              CTRL_TIMEOUT_MS);
 
 
     return status;
@@ -658,8 +821,6 @@ error:
 static inline int read_page(struct bladerf *dev, uint8_t read_operation,
                             uint16_t page, uint8_t *buf)
 {
-    void *driver;
-    struct bladerf_usb *usb = usb_backend(dev, &driver);
     int status;
     int32_t op_status;
     uint16_t read_size;
@@ -699,16 +860,16 @@ static inline int read_page(struct bladerf *dev, uint8_t read_operation,
 
     /* Retrieve data from the firmware page buffer */
     for (offset = 0; offset < BLADERF_FLASH_PAGE_SIZE; offset += read_size) {
-        status = usb->fn->control_transfer(driver,
-                                           USB_TARGET_DEVICE,
-                                           USB_REQUEST_VENDOR,
-                                           USB_DIR_DEVICE_TO_HOST,
-                                           request,
-                                           0,
-                                           offset, /* in bytes */
-                                           buf + offset,
-                                           read_size,
-                                           CTRL_TIMEOUT_MS);
+        status = control_transfer(dev,
+                                  USB_TARGET_DEVICE,
+                                  USB_REQUEST_VENDOR,
+                                  USB_DIR_DEVICE_TO_HOST,
+                                  request,
+                                  0,
+                                  offset, /* in bytes */
+                                  buf + offset,
+                                  read_size,
+                                  CTRL_TIMEOUT_MS);
 
         if(status < 0) {
             log_debug("Failed to read page buffer at offset 0x%02x: %s\n",
@@ -720,10 +881,73 @@ static inline int read_page(struct bladerf *dev, uint8_t read_operation,
     return 0;
 }
 
+/* Bulk flash streaming transport. See backend/flash_bulk.h */
+static int flash_bulk_begin(struct bladerf *dev, uint8_t cmd,
+                            uint16_t page, uint16_t count, int32_t *ret)
+{
+    dev->round_trips.other++;
+
+    return control_transfer(dev,
+                            USB_TARGET_DEVICE,
+                            USB_REQUEST_VENDOR,
+                            USB_DIR_DEVICE_TO_HOST,
+                            cmd, count, page,
+                            ret, sizeof(int32_t),
+                            CTRL_TIMEOUT_MS);
+}
+
+static int flash_bulk_data_read(struct bladerf *dev, uint8_t *buf, size_t len)
+{
+    assert(len <= UINT32_MAX);
+    return bulk_transfer(dev, PERIPHERAL_EP_IN, buf, (uint32_t) len,
+                         FLASH_BULK_TIMEOUT_MS);
+}
+
+static int flash_bulk_data_write(struct bladerf *dev,
+                                 const uint8_t *buf, size_t len)
+{
+    /* The buffer is not written to on an OUT transfer */
+    assert(len <= UINT32_MAX);
+    return bulk_transfer(dev, PERIPHERAL_EP_OUT, (uint8_t *) buf,
+                         (uint32_t) len, FLASH_BULK_TIMEOUT_MS);
+}
+
+static int flash_bulk_status(struct bladerf *dev, int32_t *status)
+{
+    return vendor_cmd_int(dev, BLADE_USB_CMD_FLASH_BULK_STATUS,
+                          USB_DIR_DEVICE_TO_HOST, status);
+}
+
+static int flash_bulk_hash_result(struct bladerf *dev, uint8_t *digest)
+{
+    dev->round_trips.other++;
+
+    return control_transfer(dev,
+                            USB_TARGET_DEVICE,
+                            USB_REQUEST_VENDOR,
+                            USB_DIR_DEVICE_TO_HOST,
+                            BLADE_USB_CMD_FLASH_HASH_RESULT, 0, 0,
+                            digest, FLASH_HASH_SIZE,
+                            CTRL_TIMEOUT_MS);
+}
+
+static const struct flash_bulk_ops usb_flash_bulk_ops = {
+    FIELD_INIT(.begin, flash_bulk_begin),
+    FIELD_INIT(.read, flash_bulk_data_read),
+    FIELD_INIT(.write, flash_bulk_data_write),
+    FIELD_INIT(.status, flash_bulk_status),
+    FIELD_INIT(.hash_result, flash_bulk_hash_result),
+};
+
+static inline bool have_flash_bulk(struct bladerf *dev)
+{
+    return version_greater_or_equal(&dev->fw_version, 1, 9, 0);
+}
+
 static int usb_read_flash_pages(struct bladerf *dev, uint8_t *buf,
                                 uint32_t page_u32, uint32_t count_u32)
 {
-    int status;
+    int status, restore_status;
     size_t n_read;
     uint16_t i;
 
@@ -742,6 +966,14 @@ static int usb_read_flash_pages(struct bladerf *dev, uint8_t *buf,
 
     log_info("Reading %u pages starting at page %u\n", count, page);
 
+    if (have_flash_bulk(dev)) {
+        status = flash_bulk_read(dev, &usb_flash_bulk_ops, buf, page, count);
+        if (status == 0) {
+            log_info("Done reading %u pages\n", count);
+        }
+        goto error;
+    }
+
     for (n_read = i = 0; i < count; i++) {
         log_info("Reading page %u%c", page + i, (i+1) == count ? '\n':'\r' );
 
@@ -757,8 +989,8 @@ static int usb_read_flash_pages(struct bladerf *dev, uint8_t *buf,
     log_info("Done reading %u pages\n", count);
 
 error:
-    status = restore_post_flash_setting(dev);
-    return status;
+    restore_status = restore_post_flash_setting(dev);
+    return status != 0 ? status : restore_status;
 }
 
 static int write_page(struct bladerf *dev, uint16_t page, const uint8_t *buf)
@@ -767,9 +999,6 @@ static int write_page(struct bladerf *dev, uint16_t page, const uint8_t *buf)
     int32_t commit_status;
     uint16_t offset;
     uint16_t write_size;
-    void *driver;
-    struct bladerf_usb *usb = usb_backend(dev, &driver);
-
     if (dev->usb_speed == BLADERF_DEVICE_SPEED_SUPER) {
         write_size = BLADERF_FLASH_PAGE_SIZE;
     } else if (dev->usb_speed == BLADERF_DEVICE_SPEED_HIGH) {
@@ -783,16 +1012,16 @@ static int write_page(struct bladerf *dev, uint16_t page, const uint8_t *buf)
      * Casting away the buffer's const-ness here is gross, but this buffer
      * will not be written to on an out transfer. */
     for (offset = 0; offset < BLADERF_FLASH_PAGE_SIZE; offset += write_size) {
-        status = usb->fn->control_transfer(driver,
-                                            USB_TARGET_DEVICE,
-                                            USB_REQUEST_VENDOR,
-                                            USB_DIR_HOST_TO_DEVICE,
-                                            BLADE_USB_CMD_WRITE_PAGE_BUFFER,
-                                            0,
-                                            offset,
-                                            (uint8_t*)&buf[offset],
-                                            write_size,
-                                            CTRL_TIMEOUT_MS);
+        status = control_transfer(dev,
+                                  USB_TARGET_DEVICE,
+                                  USB_REQUEST_VENDOR,
+                                  USB_DIR_HOST_TO_DEVICE,
+                                  BLADE_USB_CMD_WRITE_PAGE_BUFFER,
+                                  0,
+                                  offset,
+                                  (uint8_t*)&buf[offset],
+                                  write_size,
+                                  CTRL_TIMEOUT_MS);
 
         if(status < 0) {
             log_error("Failed to write page buffer at offset 0x%02x "
@@ -844,6 +1073,14 @@ static int usb_write_flash_pages(struct bladerf *dev, const uint8_t *buf,
 
     log_info("Writing %u pages starting at page %u\n", count, page);
 
+    if (have_flash_bulk(dev)) {
+        status = flash_bulk_write(dev, &usb_flash_bulk_ops, buf, page, count);
+        if (status == 0) {
+            log_info("Done writing %u pages\n", count);
+        }
+        goto error;
+    }
+
     n_written = 0;
     for (i = 0; i < count; i++) {
         log_info("Writing page %u%c", page + i, (i+1) == count ? '\n':'\r');
@@ -868,29 +1105,48 @@ error:
     }
 }
 
-static int usb_device_reset(struct bladerf *dev)
+static int usb_flash_hash(struct bladerf *dev, uint32_t page_u32,
+                          uint32_t count_u32, uint8_t *digest)
 {
-    void *driver;
-    struct bladerf_usb *usb = usb_backend(dev, &driver);
+    int status, restore_status;
+    const uint16_t page = (uint16_t) page_u32;
+    const uint16_t count = (uint16_t) count_u32;
+
+    assert(page == page_u32);
+    assert(count == count_u32);
 
-    return usb->fn->control_transfer(driver, USB_TARGET_DEVICE,
-                                      USB_REQUEST_VENDOR,
-                                      USB_DIR_HOST_TO_DEVICE,
-                                      BLADE_USB_CMD_RESET,
-                                      0, 0, 0, 0, CTRL_TIMEOUT_MS);
+    if (!have_flash_bulk(dev)) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    status = change_setting(dev, USB_IF_SPI_FLASH);
+    if (status != 0) {
+        return status;
+    }
 
+    status = flash_bulk_hash(dev, &usb_flash_bulk_ops, page, count, digest);
+
+    restore_status = restore_post_flash_setting(dev);
+    return status != 0 ? status : restore_status;
 }
 
-static int usb_jump_to_bootloader(struct bladerf *dev)
+static int usb_device_reset(struct bladerf *dev)
 {
-    void *driver;
-    struct bladerf_usb *usb = usb_backend(dev, &driver);
+    return control_transfer(dev, USB_TARGET_DEVICE,
+                            USB_REQUEST_VENDOR,
+                            USB_DIR_HOST_TO_DEVICE,
+                            BLADE_USB_CMD_RESET,
+                            0, 0, 0, 0, CTRL_TIMEOUT_MS);
+
+}
 
-    return usb->fn->control_transfer(driver, USB_TARGET_DEVICE,
-                                      USB_REQUEST_VENDOR,
-                                      USB_DIR_HOST_TO_DEVICE,
-                                      BLADE_USB_CMD_JUMP_TO_BOOTLOADER,
-                                      0, 0, 0, 0, CTRL_TIMEOUT_MS);
+static int usb_jump_to_bootloader(struct bladerf *dev)
+{
+    return control_transfer(dev, USB_TARGET_DEVICE,
+                            USB_REQUEST_VENDOR,
+                            USB_DIR_HOST_TO_DEVICE,
+                            BLADE_USB_CMD_JUMP_TO_BOOTLOADER,
+                            0, 0, 0, 0, CTRL_TIMEOUT_MS);
 }
 
 static int usb_get_cal(struct bladerf *dev, char *cal)
@@ -1066,6 +1322,113 @@ static int usb_lms_read(struct bladerf *dev, uint8_t addr, uint8_t *data)
     return status;
 }
 
+/* Write n registers of a peripheral, packing up to UART_PKT_MAX_CMDS
+ * accesses into each request */
+static int peripheral_write_regs(struct bladerf *dev, uint8_t peripheral,
+                                 const uint8_t *addr, const uint8_t *data,
+                                 unsigned int n)
+{
+    int status = 0;
+    unsigned int i, j, count;
+    struct uart_cmd cmd[UART_PKT_MAX_CMDS];
+
+    for (i = 0; i < n && status == 0; i += count) {
+        count = uint_min(n - i, UART_PKT_MAX_CMDS);
+
+        for (j = 0; j < count; j++) {
+            cmd[j].addr = addr[i + j];
+            cmd[j].data = data[i + j];
+            log_verbose("%s: 0x%2.2x 0x%2.2x\n", __FUNCTION__,
+                        cmd[j].addr, cmd[j].data);
+        }
+
+        status = access_peripheral(dev, peripheral,
+                                   USB_DIR_HOST_TO_DEVICE, cmd, count);
+    }
+
+    return status;
+}
+
+/* Read n registers of a peripheral, packing up to UART_PKT_MAX_CMDS
+ * accesses into each request */
+static int peripheral_read_regs(struct bladerf *dev, uint8_t peripheral,
+                                const uint8_t *addr, uint8_t *data,
+                                unsigned int n)
+{
+    int status = 0;
+    unsigned int i, j, count;
+    struct uart_cmd cmd[UART_PKT_MAX_CMDS];
+
+    for (i = 0; i < n && status == 0; i += count) {
+        count = uint_min(n - i, UART_PKT_MAX_CMDS);
+
+        for (j = 0; j < count; j++) {
+            cmd[j].addr = addr[i + j];
+            cmd[j].data = 0xff;
+        }
+
+        status = access_peripheral(dev, peripheral,
+                                   USB_DIR_DEVICE_TO_HOST, cmd, count);
+
+        for (j = 0; j < count && status == 0; j++) {
+            data[i + j] = cmd[j].data;
+            log_verbose("%s: 0x%2.2x 0x%2.2x\n", __FUNCTION__,
+                        cmd[j].addr, cmd[j].data);
+        }
+    }
+
+    return status;
+}
+
+static int usb_lms_write_regs(struct bladerf *dev, const uint8_t *addr,
+                              const uint8_t *data, unsigned int n)
+{
+    return peripheral_write_regs(dev, UART_PKT_DEV_LMS, addr, data, n);
+}
+
+static int usb_lms_read_regs(struct bladerf *dev, const uint8_t *addr,
+                             uint8_t *data, unsigned int n)
+{
+    return peripheral_read_regs(dev, UART_PKT_DEV_LMS, addr, data, n);
+}
+
+static int usb_lms_dc_cal_loop(struct bladerf *dev, uint8_t base,
+                               uint8_t cal_addr, uint8_t dc_cntval,
+                               uint8_t *dc_regval)
+{
+    int status;
+    struct uart_cmd cmd[2];
+
+    if (version_less_than(&dev->fpga_version, 0, 1, 3)) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    cmd[0].addr = base;
+    cmd[0].data = cal_addr;
+    cmd[1].addr = dc_cntval;
+    cmd[1].data = 0;
+
+    status = access_peripheral_mode(dev, UART_PKT_DEV_LMS,
+                                    UART_PKT_MODE_DIR_DC_CAL, cmd, 2);
+    if (status != 0) {
+        return status;
+    }
+
+    switch (cmd[1].data) {
+        case UART_PKT_DC_CAL_DONE:
+            *dc_regval = cmd[0].data;
+            return 0;
+
+        case UART_PKT_DC_CAL_TIMEOUT:
+            return BLADERF_ERR_UNEXPECTED;
+
+        default:
+            log_debug("FPGA did not run the DC cal loop (status=%u)\n",
+                      cmd[1].data);
+            return BLADERF_ERR_UNSUPPORTED;
+    }
+}
+
 static int set_lms_correction(struct bladerf *dev, bladerf_module module,
                               uint8_t addr, int16_t value)
 {
@@ -1304,6 +1667,18 @@ static int usb_si5338_read(struct bladerf *dev, uint8_t addr, uint8_t *data)
 }
 
 
+static int usb_si5338_write_regs(struct bladerf *dev, const uint8_t *addr,
+                                 const uint8_t *data, unsigned int n)
+{
+    return peripheral_write_regs(dev, UART_PKT_DEV_SI5338, addr, data, n);
+}
+
+static int usb_si5338_read_regs(struct bladerf *dev, const uint8_t *addr,
+                                uint8_t *data, unsigned int n)
+{
+    return peripheral_read_regs(dev, UART_PKT_DEV_SI5338, addr, data, n);
+}
+
 static int usb_dac_write(struct bladerf *dev, uint16_t value)
 {
     int status;
@@ -1437,6 +1812,48 @@ static void usb_deinit_stream(struct bladerf_stream *stream)
     usb->fn->deinit_stream(driver, stream);
 }
 
+static int usb_enable_trace(struct bladerf *dev, bool enable)
+{
+    struct bladerf_usb *usb = usb_backend(dev, NULL);
+
+    /* Tracing is restarted when enabled, discarding any previous data */
+    usb_trace_free(usb->trace);
+    usb->trace = NULL;
+
+    if (enable) {
+        usb->trace = usb_trace_alloc();
+        if (usb->trace == NULL) {
+            return BLADERF_ERR_MEM;
+        }
+    }
+
+    return 0;
+}
+
+static int usb_get_trace_stats(struct bladerf *dev,
+                               struct bladerf_usb_stats *stats,
+                               unsigned int count)
+{
+    struct bladerf_usb *usb = usb_backend(dev, NULL);
+
+    if (usb->trace == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    return usb_trace_get_stats(usb->trace, stats, count);
+}
+
+static int usb_write_trace(struct bladerf *dev, const char *filename)
+{
+    struct bladerf_usb *usb = usb_backend(dev, NULL);
+
+    if (usb->trace == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    return usb_trace_write(usb->trace, filename);
+}
+
 /*
  * Information about the boot image format and boot over USB caan be found in
  * Cypress AN76405: EZ-USB (R) FX3 (TM) Boot Options:
@@ -1657,4 +2074,20 @@ const struct backend_fns backend_fns_usb = {
     FIELD_INIT(.deinit_stream, usb_deinit_stream),
 
     FIELD_INIT(.load_fw_from_bootloader, usb_load_fw_from_bootloader),
+
+    FIELD_INIT(.enable_trace, usb_enable_trace),
+    FIELD_INIT(.get_trace_stats, usb_get_trace_stats),
+    FIELD_INIT(.write_trace, usb_write_trace),
+
+    FIELD_INIT(.lms_write_regs, usb_lms_write_regs),
+    FIELD_INIT(.lms_read_regs, usb_lms_read_regs),
+    FIELD_INIT(.lms_dc_cal_loop, usb_lms_dc_cal_loop),
+
+    FIELD_INIT(.si5338_write_regs, usb_si5338_write_regs),
+    FIELD_INIT(.si5338_read_regs, usb_si5338_read_regs),
+
+    FIELD_INIT(.load_fpga_begin, usb_load_fpga_begin),
+    FIELD_INIT(.load_fpga_write, usb_load_fpga_write),
+    FIELD_INIT(.load_fpga_end, usb_load_fpga_end),
+    FIELD_INIT(.flash_hash, usb_flash_hash),
 };
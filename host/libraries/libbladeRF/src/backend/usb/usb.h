@@ -49,6 +49,11 @@ extern bool bladerf_usb_reset_device_on_open;
 #   define PERIPHERAL_TIMEOUT_MS 250
 #endif
 
+/* Timeout for each bulk transfer of flash page data */
+#ifndef FLASH_BULK_TIMEOUT_MS
+#   define FLASH_BULK_TIMEOUT_MS 5000
+#endif
+
 /* Be careful when lowering this value. The control request for flash erase
  * operations take some time */
 #ifndef CTRL_TIMEOUT_MS
@@ -133,6 +138,10 @@ struct usb_fns {
 
     int (*open_bootloader)(void **driver, uint8_t bus, uint8_t addr);
     void (*close_bootloader)(void *driver);
+
+    /* Release any process-wide state held by the driver. This is optional,
+     * and may be NULL. */
+    void (*fini)(void);
 };
 
 struct usb_driver {
@@ -143,6 +152,17 @@ struct usb_driver {
 struct bladerf_usb {
     const struct usb_fns *fn;
     void *driver;
+
+    /* Transaction trace, or NULL when tracing is disabled. See usb_trace.h */
+    struct usb_trace *trace;
+
+    /* File to write the trace to when the device is closed, or NULL */
+    char *trace_file;
 };
 
+/**
+ * Release the process-wide state held by the USB backend drivers
+ */
+void usb_fini(void);
+
 #endif
@@ -0,0 +1,335 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "bladerf_priv.h"
+#include "backend/usb/usb_trace.h"
+#include "bladeRF.h"    /* Firmware interface */
+#include "log.h"
+
+/* Name reported for transactions made outside of an API function */
+#define NO_API_FN "(none)"
+
+/* clock_gettime() shims on some platforms only support CLOCK_REALTIME */
+#if BLADERF_OS_LINUX
+#   define TRACE_CLOCK CLOCK_MONOTONIC
+#else
+#   define TRACE_CLOCK CLOCK_REALTIME
+#endif
+
+struct usb_trace_event {
+    const char *api_fn;
+    unsigned int api_seq;
+    uint64_t t_start;
+    uint32_t duration;
+    uint32_t len;
+    int status;
+    uint8_t type;
+    uint8_t id;
+};
+
+struct usb_trace_fn {
+    struct bladerf_usb_stats stats;
+    unsigned int last_seq;
+};
+
+struct usb_trace {
+    MUTEX lock;
+    uint64_t t_start;
+
+    struct usb_trace_event *events;
+    size_t num_events;
+    size_t max_events;
+    uint64_t events_dropped;
+
+    struct usb_trace_fn *fns;
+    size_t num_fns;
+    size_t max_fns;
+};
+
+uint64_t usb_trace_now(void)
+{
+    struct timespec t;
+    clock_gettime(TRACE_CLOCK, &t);
+    return (uint64_t) t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+struct usb_trace *usb_trace_alloc(void)
+{
+    struct usb_trace *trace = calloc(1, sizeof(*trace));
+
+    if (trace == NULL) {
+        return NULL;
+    }
+
+    MUTEX_INIT(&trace->lock);
+    trace->t_start = usb_trace_now();
+    return trace;
+}
+
+void usb_trace_free(struct usb_trace *trace)
+{
+    if (trace != NULL) {
+        free(trace->events);
+        free(trace->fns);
+        free(trace);
+    }
+}
+
+/* Look up, or add, the statistics entry for an API function.
+ * Returns NULL on allocation failure. */
+static struct usb_trace_fn *lookup_fn(struct usb_trace *trace,
+                                      const char *api_fn)
+{
+    struct usb_trace_fn *tmp;
+    size_t i;
+
+    for (i = 0; i < trace->num_fns; i++) {
+        if (trace->fns[i].stats.function == api_fn ||
+            !strcmp(trace->fns[i].stats.function, api_fn)) {
+            return &trace->fns[i];
+        }
+    }
+
+    if (trace->num_fns == trace->max_fns) {
+        const size_t max_fns = trace->max_fns == 0 ? 32 : 2 * trace->max_fns;
+
+        tmp = realloc(trace->fns, max_fns * sizeof(trace->fns[0]));
+        if (tmp == NULL) {
+            return NULL;
+        }
+
+        trace->fns = tmp;
+        trace->max_fns = max_fns;
+    }
+
+    tmp = &trace->fns[trace->num_fns++];
+    memset(tmp, 0, sizeof(*tmp));
+    tmp->stats.function = api_fn;
+
+    return tmp;
+}
+
+static void log_event(struct usb_trace *trace,
+                      const struct usb_trace_event *event)
+{
+    struct usb_trace_event *tmp;
+
+    if (trace->num_events == trace->max_events) {
+        size_t max_events = trace->max_events == 0 ? 4096 :
+                                                     2 * trace->max_events;
+
+        if (max_events > USB_TRACE_MAX_EVENTS) {
+            max_events = USB_TRACE_MAX_EVENTS;
+        }
+
+        if (max_events == trace->max_events) {
+            trace->events_dropped++;
+            return;
+        }
+
+        tmp = realloc(trace->events, max_events * sizeof(trace->events[0]));
+        if (tmp == NULL) {
+            trace->events_dropped++;
+            return;
+        }
+
+        trace->events = tmp;
+        trace->max_events = max_events;
+    }
+
+    trace->events[trace->num_events++] = *event;
+}
+
+void usb_trace_add(struct usb_trace *trace, const char *api_fn,
+                   unsigned int api_seq, usb_trace_type type, uint8_t id,
+                   uint32_t len, uint64_t t_start, uint64_t t_end,
+                   int status)
+{
+    struct usb_trace_event event;
+    struct usb_trace_fn *fn;
+    const uint64_t duration = t_end > t_start ? t_end - t_start : 0;
+
+    if (api_fn == NULL) {
+        api_fn = NO_API_FN;
+    }
+
+    event.api_fn = api_fn;
+    event.api_seq = api_seq;
+    event.t_start = t_start > trace->t_start ? t_start - trace->t_start : 0;
+    event.duration = duration > UINT32_MAX ? UINT32_MAX : (uint32_t) duration;
+    event.len = len;
+    event.status = status;
+    event.type = (uint8_t) type;
+    event.id = id;
+
+    MUTEX_LOCK(&trace->lock);
+
+    fn = lookup_fn(trace, api_fn);
+    if (fn != NULL) {
+        if (fn->stats.calls == 0 || fn->last_seq != api_seq) {
+            fn->stats.calls++;
+            fn->last_seq = api_seq;
+        }
+
+        switch (type) {
+            case USB_TRACE_CONTROL:
+                fn->stats.control_transfers++;
+                break;
+
+            case USB_TRACE_BULK:
+                fn->stats.bulk_transfers++;
+                break;
+
+            case USB_TRACE_PERIPHERAL:
+                fn->stats.peripheral_accesses++;
+                break;
+        }
+
+        /* Peripheral accesses are made up of bulk transfers, which are
+         * accounted for individually */
+        if (type != USB_TRACE_PERIPHERAL) {
+            fn->stats.bytes += len;
+            fn->stats.time_ns += duration;
+
+            if (duration > fn->stats.max_time_ns) {
+                fn->stats.max_time_ns = duration;
+            }
+        }
+    }
+
+    log_event(trace, &event);
+
+    MUTEX_UNLOCK(&trace->lock);
+}
+
+int usb_trace_get_stats(struct usb_trace *trace,
+                        struct bladerf_usb_stats *stats, unsigned int count)
+{
+    size_t i;
+    int ret;
+
+    MUTEX_LOCK(&trace->lock);
+
+    for (i = 0; i < trace->num_fns && i < count; i++) {
+        stats[i] = trace->fns[i].stats;
+    }
+
+    ret = (int) trace->num_fns;
+
+    MUTEX_UNLOCK(&trace->lock);
+
+    return ret;
+}
+
+static const char *peripheral_name(uint8_t mode)
+{
+    switch (mode & UART_PKT_MODE_DEV_MASK) {
+        case UART_PKT_DEV_GPIO:
+            return "GPIO";
+        case UART_PKT_DEV_LMS:
+            return "LMS";
+        case UART_PKT_DEV_VCTCXO:
+            return "VCTCXO";
+        case UART_PKT_DEV_SI5338:
+            return "SI5338";
+        default:
+            return "unknown";
+    }
+}
+
+static void write_event(FILE *f, const struct usb_trace_event *e)
+{
+    char name[32];
+    const char *cat;
+
+    switch (e->type) {
+        case USB_TRACE_CONTROL:
+            cat = "control";
+            snprintf(name, sizeof(name), "control 0x%02x", e->id);
+            break;
+
+        case USB_TRACE_BULK:
+            cat = "bulk";
+            snprintf(name, sizeof(name), "bulk ep 0x%02x", e->id);
+            break;
+
+        default:
+            cat = "peripheral";
+            snprintf(name, sizeof(name), "%s %s", peripheral_name(e->id),
+                     (e->id & UART_PKT_MODE_DIR_MASK) ==
+                        UART_PKT_MODE_DIR_READ ? "read" : "write");
+            break;
+    }
+
+    /* Timestamps and durations are in microseconds */
+    fprintf(f, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+               "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1,"
+               "\"args\":{\"api\":\"%s\",\"call\":%u,\"len\":%u,"
+               "\"status\":%d}}",
+            name, cat, e->t_start / 1000.0, e->duration / 1000.0,
+            e->api_fn, e->api_seq, e->len, e->status);
+}
+
+int usb_trace_write(struct usb_trace *trace, const char *filename)
+{
+    FILE *f;
+    size_t i;
+    int status = 0;
+
+    f = fopen(filename, "w");
+    if (f == NULL) {
+        log_debug("Failed to open %s: %s\n", filename, strerror(errno));
+        return BLADERF_ERR_IO;
+    }
+
+    MUTEX_LOCK(&trace->lock);
+
+    if (trace->events_dropped != 0) {
+        log_warning("USB trace is missing %llu events beyond the first %u\n",
+                    (unsigned long long) trace->events_dropped,
+                    USB_TRACE_MAX_EVENTS);
+    }
+
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+    for (i = 0; i < trace->num_events; i++) {
+        write_event(f, &trace->events[i]);
+        fprintf(f, "%s\n", (i + 1) < trace->num_events ? "," : "");
+    }
+
+    fprintf(f, "]}\n");
+
+    MUTEX_UNLOCK(&trace->lock);
+
+    if (ferror(f)) {
+        status = BLADERF_ERR_IO;
+    }
+
+    if (fclose(f) != 0) {
+        status = BLADERF_ERR_IO;
+    }
+
+    return status;
+}
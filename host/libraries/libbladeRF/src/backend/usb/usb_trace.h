@@ -0,0 +1,114 @@
+/*
+ * USB transaction accounting and tracing
+ *
+ * When enabled on a device, the USB backend reports each control transfer,
+ * peripheral bulk transfer and FPGA peripheral access to a usb_trace. These
+ * are accumulated into per-API-function statistics, and logged as events
+ * that can be written out in the Chrome trace event format (viewable with
+ * chrome://tracing or Perfetto).
+ *
+ * When disabled, the only cost to the USB backend is a NULL check per
+ * transfer.
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef BACKEND_USB_TRACE_H_
+#define BACKEND_USB_TRACE_H_
+
+#include <stdint.h>
+#include <libbladeRF.h>
+
+/* Path of a Chrome trace file to write when a device is closed. Setting
+ * this enables tracing for each device opened with the USB backend. */
+#define USB_TRACE_ENV_FILE      "BLADERF_USB_TRACE"
+
+/* Maximum number of events retained for the trace file. Statistics continue
+ * to be accumulated once this is reached. */
+#define USB_TRACE_MAX_EVENTS    (256 * 1024)
+
+typedef enum {
+    USB_TRACE_CONTROL,      /* Control transfer; id is the bRequest */
+    USB_TRACE_BULK,         /* Bulk transfer; id is the endpoint */
+    USB_TRACE_PERIPHERAL,   /* FPGA peripheral access; id is the UART packet
+                             * mode byte, which encodes the peripheral and
+                             * direction. A peripheral access consists of a
+                             * pair of bulk transfers. */
+} usb_trace_type;
+
+struct usb_trace;
+
+/**
+ * Allocate and initialize a trace
+ *
+ * @return Trace on success, NULL on allocation failure
+ */
+struct usb_trace *usb_trace_alloc(void);
+
+/**
+ * Free a trace
+ */
+void usb_trace_free(struct usb_trace *trace);
+
+/**
+ * @return Current time, in nanoseconds, relative to an arbitrary starting
+ *         point. Use this to obtain the times passed to usb_trace_add().
+ */
+uint64_t usb_trace_now(void);
+
+/**
+ * Account for a transaction
+ *
+ * @param   trace       Trace to update
+ * @param   api_fn      API function on whose behalf the transaction was
+ *                      performed. May be NULL.
+ * @param   api_seq     Sequence number of the API call
+ * @param   type        Transaction type
+ * @param   id          Request, endpoint or peripheral, as per `type`
+ * @param   len         Number of bytes transferred
+ * @param   t_start     Start time, from usb_trace_now()
+ * @param   t_end       End time, from usb_trace_now()
+ * @param   status      Status of the transaction
+ */
+void usb_trace_add(struct usb_trace *trace, const char *api_fn,
+                   unsigned int api_seq, usb_trace_type type, uint8_t id,
+                   uint32_t len, uint64_t t_start, uint64_t t_end,
+                   int status);
+
+/**
+ * Retrieve per-API-function statistics
+ *
+ * @param   trace       Trace to query
+ * @param   stats       Array to fill. May be NULL if `count` is 0.
+ * @param   count       Number of elements in `stats`
+ *
+ * @return The number of API functions for which statistics are available.
+ *         This may exceed `count`.
+ */
+int usb_trace_get_stats(struct usb_trace *trace,
+                        struct bladerf_usb_stats *stats, unsigned int count);
+
+/**
+ * Write logged events to a file in the Chrome trace event JSON format
+ *
+ * @return 0 on success, BLADERF_ERR_IO on failure
+ */
+int usb_trace_write(struct usb_trace *trace, const char *filename);
+
+#endif
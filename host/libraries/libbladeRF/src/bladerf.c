@@ -30,9 +30,11 @@
 #include "sync.h"
 #include "tuning.h"
 #include "gain.h"
+#include "agc.h"
 #include "lms.h"
 #include "xb.h"
 #include "si5338.h"
+#include "reconfig.h"
 #include "file_ops.h"
 #include "log.h"
 #include "backend/backend.h"
@@ -47,6 +49,19 @@
 #include "backend/usb/usb.h"
 #include "fx3_fw.h"
 
+/* Acquire and release the control lock, noting the API function holding it
+ * so that backend transactions may be attributed to it when tracing */
+#define CTRL_LOCK(dev) do { \
+    MUTEX_LOCK(&(dev)->ctrl_lock); \
+    (dev)->api_fn = __FUNCTION__; \
+    (dev)->api_seq++; \
+} while (0)
+
+#define CTRL_UNLOCK(dev) do { \
+    (dev)->api_fn = NULL; \
+    MUTEX_UNLOCK(&(dev)->ctrl_lock); \
+} while (0)
+
 static int probe(backend_probe_target target_device,
                  struct bladerf_devinfo **devices)
 {
@@ -72,6 +87,16 @@ static int probe(backend_probe_target target_device,
  * Device discovery & initialization/deinitialization
  *----------------------------------------------------------------------------*/
 
+/* See bladerf_set_lazy_open() */
+static bool lazy_open = false;
+
+/* A device being opened by bladerf_open_multiple() */
+struct open_job {
+    struct bladerf **device;
+    struct bladerf_devinfo *devinfo;
+    int status;
+};
+
 int bladerf_get_device_list(struct bladerf_devinfo **devices)
 {
     return probe(BACKEND_PROBE_BLADERF, devices);
@@ -108,6 +133,9 @@ int bladerf_open_with_devinfo(struct bladerf **opened_device,
     MUTEX_INIT(&dev->sync_lock[BLADERF_MODULE_RX]);
     MUTEX_INIT(&dev->sync_lock[BLADERF_MODULE_TX]);
 
+    dev->gain_sched_next[BLADERF_MODULE_RX] = UINT64_MAX;
+    dev->gain_sched_next[BLADERF_MODULE_TX] = UINT64_MAX;
+
     dev->fpga_version.describe = calloc(1, BLADERF_VERSION_STR_MAX + 1);
     if (dev->fpga_version.describe == NULL) {
         free(dev);
@@ -179,19 +207,11 @@ int bladerf_open_with_devinfo(struct bladerf **opened_device,
         goto error;
     }
 
-    /* VCTCXO trim and FPGA size are non-fatal indicators that we've
-     * trashed the calibration region of flash. If these were made fatal,
-     * we wouldn't be able to open the device to restore them. */
-    status = get_and_cache_vctcxo_trim(dev);
-    if (status < 0) {
-        log_warning("Failed to get VCTCXO trim value: %s\n",
-                    bladerf_strerror(status));
-    }
-
-    status = get_and_cache_fpga_size(dev);
-    if (status < 0) {
-        log_warning("Failed to get FPGA size %s\n",
-                    bladerf_strerror(status));
+    /* Failures here are non-fatal, and logged as warnings */
+    if (lazy_open) {
+        dev->cal_fields_pending = true;
+    } else {
+        get_and_cache_cal_fields(dev);
     }
 
     dev->rx_filter = -1;
@@ -200,13 +220,27 @@ int bladerf_open_with_devinfo(struct bladerf **opened_device,
     dev->module_format[BLADERF_MODULE_RX] = -1;
     dev->module_format[BLADERF_MODULE_TX] = -1;
 
-    /* Load any available calibration tables so that the LMS DC register
-     * configurations may be loaded in init_device */
-    status = config_load_dc_cals(dev);
+    status = gain_init(dev);
+    if (status != 0) {
+        goto error;
+    }
+
+    status = si5338_init(dev);
     if (status != 0) {
         goto error;
     }
 
+    /* Load any available calibration tables so that the LMS DC register
+     * configurations may be loaded in init_device */
+    if (lazy_open) {
+        dev->dc_cals_pending = true;
+    } else {
+        status = config_load_dc_cals(dev);
+        if (status != 0) {
+            goto error;
+        }
+    }
+
     status = FPGA_IS_CONFIGURED(dev);
     if (status > 0) {
         /* If the FPGA version check fails, just warn, but don't error out.
@@ -235,6 +269,73 @@ error:
     return status;
 }
 
+static void *open_thread(void *arg)
+{
+    struct open_job *job = (struct open_job *) arg;
+
+    job->status = bladerf_open_with_devinfo(job->device, job->devinfo);
+    return NULL;
+}
+
+int bladerf_open_multiple(struct bladerf **devices,
+                          struct bladerf_devinfo *devinfo,
+                          int *status, unsigned int n)
+{
+    struct open_job *jobs;
+    pthread_t *threads;
+    bool *started;
+    unsigned int i;
+    int ret = 0;
+
+    if (devices == NULL || (devinfo == NULL && n != 0)) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    jobs = calloc(n + 1, sizeof(jobs[0]));
+    threads = calloc(n + 1, sizeof(threads[0]));
+    started = calloc(n + 1, sizeof(started[0]));
+
+    if (jobs == NULL || threads == NULL || started == NULL) {
+        ret = BLADERF_ERR_MEM;
+        goto out;
+    }
+
+    /* Each device is opened from its own thread, so that the control
+     * transfers performed by each open overlap */
+    for (i = 0; i < n; i++) {
+        jobs[i].device = &devices[i];
+        jobs[i].devinfo = &devinfo[i];
+        started[i] = pthread_create(&threads[i], NULL,
+                                    open_thread, &jobs[i]) == 0;
+
+        if (!started[i]) {
+            log_debug("Failed to create open thread. Opening device %u "
+                      "in the calling thread.\n", i);
+            open_thread(&jobs[i]);
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+
+        if (status != NULL) {
+            status[i] = jobs[i].status;
+        }
+
+        if (ret == 0 && jobs[i].status != 0) {
+            ret = jobs[i].status;
+        }
+    }
+
+out:
+    free(started);
+    free(threads);
+    free(jobs);
+    return ret;
+}
+
 /* dev path becomes device specifier string (osmosdr-like) */
 int bladerf_open(struct bladerf **device, const char *dev_id)
 {
@@ -257,7 +358,7 @@ void bladerf_close(struct bladerf *dev)
 {
     if (dev) {
 
-        MUTEX_LOCK(&dev->ctrl_lock);
+        CTRL_LOCK(dev);
         sync_deinit(dev->sync[BLADERF_MODULE_RX]);
         sync_deinit(dev->sync[BLADERF_MODULE_TX]);
 
@@ -268,8 +369,13 @@ void bladerf_close(struct bladerf *dev)
 
         dc_cal_tbl_free(&dev->cal.dc_rx);
         dc_cal_tbl_free(&dev->cal.dc_tx);
+        dc_cal_tbl_free(&dev->cal.iq_rx);
+        dc_cal_tbl_free(&dev->cal.iq_tx);
+        gain_deinit(dev);
+        free(dev->agc);
+        si5338_deinit(dev);
 
-        MUTEX_UNLOCK(&dev->ctrl_lock);
+        CTRL_UNLOCK(dev);
         free(dev);
     }
 }
@@ -287,6 +393,13 @@ void bladerf_set_usb_reset_on_open(bool enabled)
 #   endif
 }
 
+void bladerf_set_lazy_open(bool enabled)
+{
+    lazy_open = enabled;
+
+    log_verbose("Lazy open %s\n", enabled ? "enabled" : "disabled");
+}
+
 int bladerf_enable_module(struct bladerf *dev,
                             bladerf_module m, bool enable)
 {
@@ -300,25 +413,31 @@ int bladerf_enable_module(struct bladerf *dev,
                 (m == BLADERF_MODULE_RX) ? "RX" : "TX",
                 enable ? "True" : "False") ;
 
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     if (enable == false) {
         sync_deinit(dev->sync[m]);
         dev->sync[m] = NULL;
         perform_format_deconfig(dev, m);
+    } else {
+        status = load_deferred_dc_cals(dev);
+        if (status != 0) {
+            CTRL_UNLOCK(dev);
+            return status;
+        }
     }
 
     lms_enable_rffe(dev, m, enable);
     status = dev->fn->enable_module(dev, m, enable);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
 int bladerf_set_loopback(struct bladerf *dev, bladerf_loopback l)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     if (l == BLADERF_LB_FIRMWARE) {
         /* Firmware loopback was fully implemented in FW v1.7.1
@@ -370,7 +489,7 @@ int bladerf_set_loopback(struct bladerf *dev, bladerf_loopback l)
     }
 
 out:
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -379,7 +498,7 @@ int bladerf_get_loopback(struct bladerf *dev, bladerf_loopback *l)
     int status = BLADERF_ERR_UNEXPECTED;
     *l = BLADERF_LB_NONE;
 
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     if (version_greater_or_equal(&dev->fw_version, 1, 7, 1)) {
         bool fw_lb_enabled;
@@ -393,7 +512,7 @@ int bladerf_get_loopback(struct bladerf *dev, bladerf_loopback *l)
         status = lms_get_loopback_mode(dev, l);
     }
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -402,11 +521,11 @@ int bladerf_set_rational_sample_rate(struct bladerf *dev, bladerf_module module,
                                      struct bladerf_rational_rate *actual)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = si5338_set_rational_sample_rate(dev, module, rate, actual);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -414,11 +533,11 @@ int bladerf_set_sample_rate(struct bladerf *dev, bladerf_module module,
                             uint32_t rate, uint32_t *actual)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = si5338_set_sample_rate(dev, module, rate, actual);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -426,11 +545,11 @@ int bladerf_get_rational_sample_rate(struct bladerf *dev, bladerf_module module,
                                      struct bladerf_rational_rate *rate)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = si5338_get_rational_sample_rate(dev, module, rate);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -438,77 +557,77 @@ int bladerf_get_sample_rate(struct bladerf *dev, bladerf_module module,
                             unsigned int *rate)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = si5338_get_sample_rate(dev, module, rate);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
 int bladerf_get_sampling(struct bladerf *dev, bladerf_sampling *sampling)
 {
     int status = 0;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = lms_get_sampling(dev, sampling);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
 int bladerf_set_sampling(struct bladerf *dev, bladerf_sampling sampling)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = lms_select_sampling(dev, sampling);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
 int bladerf_set_txvga2(struct bladerf *dev, int gain)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = lms_txvga2_set_gain(dev, gain);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
 int bladerf_get_txvga2(struct bladerf *dev, int *gain)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = lms_txvga2_get_gain(dev, gain);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
 int bladerf_set_txvga1(struct bladerf *dev, int gain)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = lms_txvga1_set_gain(dev, gain);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
 int bladerf_get_txvga1(struct bladerf *dev, int *gain)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = lms_txvga1_get_gain(dev, gain);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -516,77 +635,176 @@ int bladerf_get_txvga1(struct bladerf *dev, int *gain)
 int bladerf_set_lna_gain(struct bladerf *dev, bladerf_lna_gain gain)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = lms_lna_set_gain(dev, gain);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
 int bladerf_get_lna_gain(struct bladerf *dev, bladerf_lna_gain *gain)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = lms_lna_get_gain(dev, gain);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
 int bladerf_set_rxvga1(struct bladerf *dev, int gain)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = lms_rxvga1_set_gain(dev, gain);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
 int bladerf_get_rxvga1(struct bladerf *dev, int *gain)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = lms_rxvga1_get_gain(dev, gain);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
 int bladerf_set_rxvga2(struct bladerf *dev, int gain)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = lms_rxvga2_set_gain(dev, gain);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
 int bladerf_get_rxvga2(struct bladerf *dev, int *gain)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = lms_rxvga2_get_gain(dev, gain);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
 
 int bladerf_set_gain(struct bladerf *dev, bladerf_module mod, int gain) {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = gain_set(dev, mod, gain);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
+    return status;
+}
+
+int bladerf_set_gain_offsets(struct bladerf *dev, bladerf_module mod,
+                             const struct bladerf_gain_offset *offsets,
+                             unsigned int count)
+{
+    int status;
+    unsigned int frequency;
+
+    CTRL_LOCK(dev);
+
+    status = gain_set_offsets(dev, mod, offsets, count);
+    if (status == 0 && count != 0) {
+        status = tuning_get_freq(dev, mod, &frequency);
+        if (status == 0) {
+            gain_update_offset(dev, mod, frequency);
+        }
+    }
+
+    CTRL_UNLOCK(dev);
+    return status;
+}
+
+int bladerf_set_agc(struct bladerf *dev,
+                    const struct bladerf_agc_config *config)
+{
+    int status = 0;
+    struct agc *agc = NULL;
+    struct agc *prev;
+    struct bladerf_sync *s;
+
+    if (config != NULL) {
+        status = agc_validate(config);
+        if (status != 0) {
+            return status;
+        }
+
+        agc = malloc(sizeof(*agc));
+        if (agc == NULL) {
+            return BLADERF_ERR_MEM;
+        }
+
+        agc_init(agc, config);
+    }
+
+    CTRL_LOCK(dev);
+
+    if (agc != NULL) {
+        status = gain_set(dev, BLADERF_MODULE_RX, agc->gain);
+    }
+
+    if (status == 0) {
+        MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
+        s = dev->sync[BLADERF_MODULE_RX];
+        if (agc != NULL && s != NULL) {
+            agc_gain_applied(agc, agc->gain,
+                             s->buf_mgmt.num_buffers *
+                             s->stream_config.samples_per_buffer);
+        }
+
+        prev = dev->agc;
+        dev->agc = agc;
+        MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
+    } else {
+        prev = agc;
+    }
+
+    CTRL_UNLOCK(dev);
+
+    free(prev);
+    return status;
+}
+
+int bladerf_schedule_gain(struct bladerf *dev, bladerf_module mod,
+                          uint64_t timestamp, int gain)
+{
+    int status;
+
+    CTRL_LOCK(dev);
+
+    if (mod != BLADERF_MODULE_RX && mod != BLADERF_MODULE_TX) {
+        status = BLADERF_ERR_INVAL;
+    } else if (dev->module_format[mod] != BLADERF_FORMAT_SC16_Q11_META ||
+               dev->sync[mod] == NULL) {
+        log_debug("Scheduled gain changes require the sync interface to "
+                  "be configured for metadata.\n");
+        status = BLADERF_ERR_UNSUPPORTED;
+    } else {
+        status = gain_sched_add(dev, mod, timestamp, gain);
+
+        if (status == 0) {
+            MUTEX_LOCK(&dev->sync_lock[mod]);
+            dev->gain_sched_next[mod] = gain_sched_next(dev, mod);
+            MUTEX_UNLOCK(&dev->sync_lock[mod]);
+        }
+    }
+
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -597,7 +815,7 @@ int bladerf_set_bandwidth(struct bladerf *dev, bladerf_module module,
     int status;
     lms_bw bw;
 
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     if (bandwidth < BLADERF_BANDWIDTH_MIN) {
         bandwidth = BLADERF_BANDWIDTH_MIN;
@@ -624,7 +842,7 @@ int bladerf_set_bandwidth(struct bladerf *dev, bladerf_module module,
     }
 
 out:
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -634,7 +852,7 @@ int bladerf_get_bandwidth(struct bladerf *dev, bladerf_module module,
     int status;
     lms_bw bw;
 
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = lms_get_bandwidth( dev, module, &bw);
 
@@ -644,7 +862,7 @@ int bladerf_get_bandwidth(struct bladerf *dev, bladerf_module module,
         *bandwidth = 0;
     }
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -652,11 +870,11 @@ int bladerf_set_lpf_mode(struct bladerf *dev, bladerf_module module,
                          bladerf_lpf_mode mode)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = lms_lpf_set_mode(dev, module, mode);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -664,11 +882,11 @@ int bladerf_get_lpf_mode(struct bladerf *dev, bladerf_module module,
                          bladerf_lpf_mode *mode)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = lms_lpf_get_mode(dev, module, mode);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -676,11 +894,11 @@ int bladerf_select_band(struct bladerf *dev, bladerf_module module,
                         unsigned int frequency)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = tuning_select_band(dev, module, frequency);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -688,11 +906,14 @@ int bladerf_set_frequency(struct bladerf *dev,
                           bladerf_module module, unsigned int frequency)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
-    status = tuning_set_freq(dev, module, frequency);
+    status = load_deferred_dc_cals(dev);
+    if (status == 0) {
+        status = tuning_set_freq(dev, module, frequency);
+    }
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -700,11 +921,27 @@ int bladerf_get_frequency(struct bladerf *dev,
                             bladerf_module module, unsigned int *frequency)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = tuning_get_freq(dev, module, frequency);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
+    return status;
+}
+
+int bladerf_set_module_config(struct bladerf *dev, bladerf_module module,
+                              struct bladerf_module_config *config,
+                              uint64_t *timestamp)
+{
+    int status;
+    CTRL_LOCK(dev);
+
+    status = load_deferred_dc_cals(dev);
+    if (status == 0) {
+        status = reconfig_apply(dev, module, config, timestamp);
+    }
+
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -712,9 +949,9 @@ int bladerf_set_stream_timeout(struct bladerf *dev, bladerf_module module,
                                unsigned int timeout) {
 
     if (dev) {
-        MUTEX_LOCK(&dev->ctrl_lock);
+        CTRL_LOCK(dev);
         dev->transfer_timeout[module] = timeout;
-        MUTEX_UNLOCK(&dev->ctrl_lock);
+        CTRL_UNLOCK(dev);
         return 0;
 
     } else {
@@ -725,9 +962,9 @@ int bladerf_set_stream_timeout(struct bladerf *dev, bladerf_module module,
 int bladerf_get_stream_timeout(struct bladerf *dev, bladerf_module module,
                                unsigned int *timeout) {
     if (dev) {
-        MUTEX_LOCK(&dev->ctrl_lock);
+        CTRL_LOCK(dev);
         *timeout = dev->transfer_timeout[module];
-        MUTEX_UNLOCK(&dev->ctrl_lock);
+        CTRL_UNLOCK(dev);
         return 0;
     } else {
         return BLADERF_ERR_INVAL;
@@ -744,7 +981,7 @@ int bladerf_sync_config(struct bladerf *dev,
 {
     int status;
 
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = perform_format_config(dev, module, format);
     if (status == 0) {
@@ -755,6 +992,9 @@ int bladerf_sync_config(struct bladerf *dev,
         status = sync_init(dev, module, format, num_buffers, buffer_size,
                 num_transfers, stream_timeout);
 
+        gain_sched_clear(dev, module);
+        dev->gain_sched_next[module] = UINT64_MAX;
+
         if (status != 0) {
             perform_format_deconfig(dev, module);
         }
@@ -762,7 +1002,34 @@ int bladerf_sync_config(struct bladerf *dev,
         MUTEX_UNLOCK(&dev->sync_lock[module]);
     }
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
+    return status;
+}
+
+/* Check whether a scheduled gain change is due, using the copy of
+ * gain_sched_next() kept alongside the stream. The caller must hold the
+ * module's sync_lock. */
+static inline bool gain_sched_due(struct bladerf *dev, bladerf_module module,
+                                  uint64_t timestamp)
+{
+    return timestamp >= dev->gain_sched_next[module];
+}
+
+/* Apply any scheduled gain changes that a stream has reached. This must be
+ * called without holding the module's sync_lock. */
+static int service_gain_sched(struct bladerf *dev, bladerf_module module,
+                              uint64_t timestamp)
+{
+    int status;
+
+    CTRL_LOCK(dev);
+    status = gain_sched_service(dev, module, timestamp);
+
+    MUTEX_LOCK(&dev->sync_lock[module]);
+    dev->gain_sched_next[module] = gain_sched_next(dev, module);
+    MUTEX_UNLOCK(&dev->sync_lock[module]);
+
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -772,11 +1039,71 @@ int bladerf_sync_tx(struct bladerf *dev,
                     unsigned int timeout_ms)
 {
     int status;
+    bool gain_due = false;
+    uint64_t timestamp;
 
     MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
     status = sync_tx(dev, samples, num_samples, metadata, timeout_ms);
+    if (status == 0 &&
+        sync_get_timestamp(dev->sync[BLADERF_MODULE_TX], &timestamp)) {
+        gain_due = gain_sched_due(dev, BLADERF_MODULE_TX, timestamp);
+    }
     MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
 
+    if (gain_due) {
+        status = service_gain_sched(dev, BLADERF_MODULE_TX, timestamp);
+    }
+
+    return status;
+}
+
+/* Run the AGC on samples returned by sync_rx(). The caller must hold the RX
+ * sync_lock. Returns true if the gain should be changed via agc_apply(). */
+static bool agc_measure(struct bladerf *dev, void *samples,
+                        unsigned int num_samples,
+                        struct bladerf_metadata *metadata, bool meta_format,
+                        int *gain)
+{
+    bool change;
+    float power;
+
+    if (meta_format && metadata != NULL) {
+        num_samples = metadata->actual_count;
+    }
+
+    change = agc_update(dev->agc, (const int16_t *) samples, num_samples,
+                        &power, gain);
+
+    if (metadata != NULL) {
+        metadata->gain = dev->agc->gain;
+        metadata->power = power;
+    }
+
+    return change;
+}
+
+/* Apply an AGC gain change. This must be called without holding the RX
+ * sync_lock. */
+static int agc_apply(struct bladerf *dev, int gain)
+{
+    int status;
+    struct bladerf_sync *s;
+
+    CTRL_LOCK(dev);
+    status = gain_set(dev, BLADERF_MODULE_RX, gain);
+    CTRL_UNLOCK(dev);
+
+    if (status == 0) {
+        MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
+        s = dev->sync[BLADERF_MODULE_RX];
+        if (dev->agc != NULL && s != NULL) {
+            agc_gain_applied(dev->agc, gain,
+                             s->buf_mgmt.num_buffers *
+                             s->stream_config.samples_per_buffer);
+        }
+        MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
+    }
+
     return status;
 }
 
@@ -786,11 +1113,34 @@ int bladerf_sync_rx(struct bladerf *dev,
                     unsigned int timeout_ms)
 {
     int status;
+    bool have_timestamp = false;
+    uint64_t timestamp;
+    bool gain_due = false;
+    bool agc_change = false;
+    int agc_gain;
 
     MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
     status = sync_rx(dev, samples, num_samples, metadata, timeout_ms);
+    if (status == 0) {
+        have_timestamp = sync_get_timestamp(dev->sync[BLADERF_MODULE_RX],
+                                            &timestamp);
+        if (have_timestamp) {
+            gain_due = gain_sched_due(dev, BLADERF_MODULE_RX, timestamp);
+        }
+
+        if (dev->agc != NULL) {
+            agc_change = agc_measure(dev, samples, num_samples, metadata,
+                                     have_timestamp, &agc_gain);
+        }
+    }
     MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
 
+    if (agc_change) {
+        status = agc_apply(dev, agc_gain);
+    } else if (gain_due) {
+        status = service_gain_sched(dev, BLADERF_MODULE_RX, timestamp);
+    }
+
     return status;
 }
 
@@ -805,12 +1155,12 @@ int bladerf_init_stream(struct bladerf_stream **stream,
                         void *data)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = async_init_stream(stream, dev, callback, buffers, num_buffers,
                                format, samples_per_buffer, num_transfers, data);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -818,9 +1168,9 @@ int bladerf_stream(struct bladerf_stream *stream, bladerf_module module)
 {
     int stream_status, fmt_status;
 
-    MUTEX_LOCK(&stream->dev->ctrl_lock);
+    CTRL_LOCK(stream->dev);
     fmt_status = perform_format_config(stream->dev, module, stream->format);
-    MUTEX_UNLOCK(&stream->dev->ctrl_lock);
+    CTRL_UNLOCK(stream->dev);
 
     if (fmt_status != 0) {
         return fmt_status;
@@ -830,9 +1180,9 @@ int bladerf_stream(struct bladerf_stream *stream, bladerf_module module)
      * be made in asyn_run_stream down through the backend code */
     stream_status = async_run_stream(stream, module);
 
-    MUTEX_LOCK(&stream->dev->ctrl_lock);
+    CTRL_LOCK(stream->dev);
     fmt_status = perform_format_deconfig(stream->dev, module);
-    MUTEX_UNLOCK(&stream->dev->ctrl_lock);
+    CTRL_UNLOCK(stream->dev);
 
     return stream_status == 0 ? fmt_status : stream_status;
 }
@@ -848,9 +1198,9 @@ void bladerf_deinit_stream(struct bladerf_stream *stream)
 {
     if (stream && stream->dev) {
         struct bladerf *dev = stream->dev;
-        MUTEX_LOCK(&dev->ctrl_lock);
+        CTRL_LOCK(dev);
         async_deinit_stream(stream);
-        MUTEX_UNLOCK(&dev->ctrl_lock);
+        CTRL_UNLOCK(dev);
     }
 }
 
@@ -861,61 +1211,63 @@ void bladerf_deinit_stream(struct bladerf_stream *stream)
 
 int bladerf_get_serial(struct bladerf *dev, char *serial)
 {
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
     strcpy(serial, dev->ident.serial);
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return 0;
 }
 
 int bladerf_get_vctcxo_trim(struct bladerf *dev, uint16_t *trim)
 {
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
+    load_deferred_cal_fields(dev);
     *trim = dev->dac_trim;
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return 0;
 }
 
 int bladerf_get_fpga_size(struct bladerf *dev, bladerf_fpga_size *size)
 {
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
+    load_deferred_cal_fields(dev);
     *size = dev->fpga_size;
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return 0;
 }
 
 int bladerf_fw_version(struct bladerf *dev, struct bladerf_version *version)
 {
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
     memcpy(version, &dev->fw_version, sizeof(*version));
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return 0;
 }
 
 int bladerf_is_fpga_configured(struct bladerf *dev)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = FPGA_IS_CONFIGURED(dev);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
 int bladerf_fpga_version(struct bladerf *dev, struct bladerf_version *version)
 {
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
     memcpy(version, &dev->fpga_version, sizeof(*version));
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return 0;
 }
 
 bladerf_dev_speed bladerf_device_speed(struct bladerf *dev)
 {
     bladerf_dev_speed speed;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
     speed = dev->usb_speed;
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return speed;
 }
 
@@ -927,11 +1279,11 @@ int bladerf_erase_flash(struct bladerf *dev,
                         uint32_t erase_block, uint32_t count)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = flash_erase(dev, erase_block, count);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -939,11 +1291,11 @@ int bladerf_read_flash(struct bladerf *dev, uint8_t *buf,
                        uint32_t page, uint32_t count)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = flash_read(dev, buf, page, count);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -951,22 +1303,34 @@ int bladerf_write_flash(struct bladerf *dev, const uint8_t *buf,
                         uint32_t page, uint32_t count)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = flash_write(dev, buf, page, count);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
+    return status;
+}
+
+int bladerf_verify_flash(struct bladerf *dev, const uint8_t *buf,
+                         uint32_t page, uint32_t count)
+{
+    int status;
+    CTRL_LOCK(dev);
+
+    status = flash_verify(dev, buf, page, count);
+
+    CTRL_UNLOCK(dev);
     return status;
 }
 
 int bladerf_device_reset(struct bladerf *dev)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = dev->fn->device_reset(dev);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -978,9 +1342,9 @@ int bladerf_jump_to_bootloader(struct bladerf *dev)
         return BLADERF_ERR_UNSUPPORTED;
     }
 
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
     status = dev->fn->jump_to_bootloader(dev);
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -1003,7 +1367,7 @@ int bladerf_flash_firmware(struct bladerf *dev, const char *firmware_file)
     size_t buf_size;
     const char env_override[] = "BLADERF_SKIP_FW_SIZE_CHECK";
 
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = file_read_buffer(firmware_file, &buf, &buf_size);
     if (status != 0) {
@@ -1026,7 +1390,7 @@ int bladerf_flash_firmware(struct bladerf *dev, const char *firmware_file)
     }
 
 out:
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     free(buf);
     return status;
 }
@@ -1034,11 +1398,11 @@ out:
 int bladerf_load_fpga(struct bladerf *dev, const char *fpga_file)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = fpga_load_from_file(dev, fpga_file);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -1046,25 +1410,38 @@ int bladerf_load_fpga(struct bladerf *dev, const char *fpga_file)
 int bladerf_flash_fpga(struct bladerf *dev, const char *fpga_file)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = fpga_write_to_flash(dev, fpga_file);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
 int bladerf_erase_stored_fpga(struct bladerf *dev)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = flash_erase_fpga(dev);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
+int bladerf_set_flash_mode(struct bladerf *dev, bladerf_flash_mode mode)
+{
+    if (mode != BLADERF_FLASH_MODE_FULL && mode != BLADERF_FLASH_MODE_DELTA) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    CTRL_LOCK(dev);
+    dev->flash_mode = mode;
+    CTRL_UNLOCK(dev);
+
+    return 0;
+}
+
 
 /*------------------------------------------------------------------------------
  * Misc.
@@ -1143,9 +1520,9 @@ void bladerf_init_devinfo(struct bladerf_devinfo *info)
 int bladerf_get_devinfo(struct bladerf *dev, struct bladerf_devinfo *info)
 {
     if (dev) {
-        MUTEX_LOCK(&dev->ctrl_lock);
+        CTRL_LOCK(dev);
         memcpy(info, &dev->ident, sizeof(struct bladerf_devinfo));
-        MUTEX_UNLOCK(&dev->ctrl_lock);
+        CTRL_UNLOCK(dev);
         return 0;
     } else {
         return BLADERF_ERR_INVAL;
@@ -1198,22 +1575,34 @@ const char * bladerf_backend_str(bladerf_backend backend)
 int bladerf_si5338_read(struct bladerf *dev, uint8_t address, uint8_t *val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = dev->fn->si5338_read(dev,address,val);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
 int bladerf_si5338_write(struct bladerf *dev, uint8_t address, uint8_t val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = dev->fn->si5338_write(dev,address,val);
+    si5338_invalidate(dev);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
+    return status;
+}
+
+int bladerf_set_mimo_mode(struct bladerf *dev, bladerf_mimo_mode mode)
+{
+    int status;
+    CTRL_LOCK(dev);
+
+    status = si5338_set_mimo_mode(dev, mode);
+
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -1224,22 +1613,22 @@ int bladerf_si5338_write(struct bladerf *dev, uint8_t address, uint8_t val)
 int bladerf_lms_read(struct bladerf *dev, uint8_t address, uint8_t *val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = dev->fn->lms_read(dev,address,val);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
 int bladerf_lms_write(struct bladerf *dev, uint8_t address, uint8_t val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = dev->fn->lms_write(dev,address,val);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -1247,11 +1636,11 @@ int bladerf_lms_set_dc_cals(struct bladerf *dev,
                             const struct bladerf_lms_dc_cals *dc_cals)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = lms_set_dc_cals(dev, dc_cals);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -1259,11 +1648,11 @@ int bladerf_lms_get_dc_cals(struct bladerf *dev,
                             struct bladerf_lms_dc_cals *dc_cals)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = lms_get_dc_cals(dev, dc_cals);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -1274,22 +1663,22 @@ int bladerf_lms_get_dc_cals(struct bladerf *dev,
 int bladerf_config_gpio_read(struct bladerf *dev, uint32_t *val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = CONFIG_GPIO_READ(dev, val);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
 int bladerf_config_gpio_write(struct bladerf *dev, uint32_t val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = CONFIG_GPIO_WRITE(dev, val);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 
 }
@@ -1300,22 +1689,22 @@ int bladerf_config_gpio_write(struct bladerf *dev, uint32_t val)
 int bladerf_expansion_attach(struct bladerf *dev, bladerf_xb xb)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = xb_attach(dev, xb);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
 int bladerf_expansion_get_attached(struct bladerf *dev, bladerf_xb *xb)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = xb_get_attached(dev, xb);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -1324,11 +1713,11 @@ int bladerf_xb200_set_filterbank(struct bladerf *dev,
                                  bladerf_xb200_filter filter)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = xb200_set_filterbank(dev, mod, filter);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -1337,11 +1726,11 @@ int bladerf_xb200_get_filterbank(struct bladerf *dev,
                                  bladerf_xb200_filter *filter)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = xb200_get_filterbank(dev, module, filter);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -1350,11 +1739,11 @@ int bladerf_xb200_set_path(struct bladerf *dev,
                            bladerf_xb200_path path)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = xb200_set_path(dev, module, path);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -1363,11 +1752,11 @@ int bladerf_xb200_get_path(struct bladerf *dev,
                                      bladerf_xb200_path *path)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = xb200_get_path(dev, module, path);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -1379,22 +1768,22 @@ int bladerf_xb200_get_path(struct bladerf *dev,
 int bladerf_expansion_gpio_read(struct bladerf *dev, uint32_t *val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = XB_GPIO_READ(dev, val);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
 int bladerf_expansion_gpio_write(struct bladerf *dev, uint32_t val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = XB_GPIO_WRITE(dev, val);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -1405,22 +1794,22 @@ int bladerf_expansion_gpio_write(struct bladerf *dev, uint32_t val)
 int bladerf_expansion_gpio_dir_read(struct bladerf *dev, uint32_t *val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = XB_GPIO_DIR_READ(dev, val);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
 int bladerf_expansion_gpio_dir_write(struct bladerf *dev, uint32_t val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = XB_GPIO_DIR_WRITE(dev, val);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -1431,11 +1820,11 @@ int bladerf_set_correction(struct bladerf *dev, bladerf_module module,
                            bladerf_correction corr, int16_t value)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = dev->fn->set_correction(dev, module, corr, value);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -1443,11 +1832,108 @@ int bladerf_get_correction(struct bladerf *dev, bladerf_module module,
                            bladerf_correction corr, int16_t *value)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = dev->fn->get_correction(dev, module, corr, value);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
+    return status;
+}
+
+/*------------------------------------------------------------------------------
+ * DC calibration table interpolation and precomputed frequencies
+ *----------------------------------------------------------------------------*/
+static struct dc_cal_tbl *get_dc_cal_tbl(struct bladerf *dev,
+                                         bladerf_module module)
+{
+    if (load_deferred_dc_cals(dev) != 0) {
+        log_debug("Failed to load deferred DC calibration tables.\n");
+    }
+
+    switch (module) {
+        case BLADERF_MODULE_RX:
+            return dev->cal.dc_rx;
+
+        case BLADERF_MODULE_TX:
+            return dev->cal.dc_tx;
+
+        default:
+            return NULL;
+    }
+}
+
+int bladerf_set_dc_cal_interp(struct bladerf *dev, bladerf_module module,
+                              bladerf_dc_cal_interp interp)
+{
+    int status = 0;
+    struct dc_cal_tbl *tbl;
+
+    if (interp != BLADERF_DC_CAL_INTERP_LINEAR &&
+        interp != BLADERF_DC_CAL_INTERP_CUBIC) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    CTRL_LOCK(dev);
+
+    tbl = get_dc_cal_tbl(dev, module);
+    if (tbl == NULL) {
+        log_debug("No %s DC calibration table is loaded.\n",
+                  module == BLADERF_MODULE_RX ? "RX" : "TX");
+        status = BLADERF_ERR_UNSUPPORTED;
+    } else {
+        dc_cal_tbl_set_interp(tbl, interp);
+    }
+
+    CTRL_UNLOCK(dev);
+    return status;
+}
+
+int bladerf_set_dc_cal_freqs(struct bladerf *dev, bladerf_module module,
+                             const unsigned int *freqs, unsigned int n)
+{
+    int status = 0;
+    struct dc_cal_tbl *tbl;
+    unsigned int *lms_freqs = NULL;
+    unsigned int i;
+    bladerf_xb attached;
+
+    if (n != 0 && freqs == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    CTRL_LOCK(dev);
+
+    tbl = get_dc_cal_tbl(dev, module);
+    if (tbl == NULL) {
+        log_debug("No %s DC calibration table is loaded.\n",
+                  module == BLADERF_MODULE_RX ? "RX" : "TX");
+        status = BLADERF_ERR_UNSUPPORTED;
+        goto out;
+    }
+
+    /* The table is indexed by the LMS6002D frequency */
+    if (n != 0) {
+        status = xb_get_attached(dev, &attached);
+        if (status != 0) {
+            goto out;
+        }
+
+        lms_freqs = malloc(n * sizeof(lms_freqs[0]));
+        if (lms_freqs == NULL) {
+            status = BLADERF_ERR_MEM;
+            goto out;
+        }
+
+        for (i = 0; i < n; i++) {
+            lms_freqs[i] = tuning_lms_freq(attached, freqs[i]);
+        }
+    }
+
+    status = dc_cal_tbl_set_lut(tbl, lms_freqs, n);
+
+out:
+    CTRL_UNLOCK(dev);
+    free(lms_freqs);
     return status;
 }
 
@@ -1457,11 +1943,74 @@ int bladerf_get_correction(struct bladerf *dev, bladerf_module module,
 int bladerf_get_timestamp(struct bladerf *dev, bladerf_module module, uint64_t *value)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = dev->fn->get_timestamp(dev,module,value);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
+    return status;
+}
+
+/*------------------------------------------------------------------------------
+ * Get control-path round trip counts
+ *----------------------------------------------------------------------------*/
+int bladerf_get_round_trips(struct bladerf *dev,
+                            struct bladerf_round_trips *counts)
+{
+    CTRL_LOCK(dev);
+    *counts = dev->round_trips;
+    CTRL_UNLOCK(dev);
+
+    return 0;
+}
+
+int bladerf_enable_usb_trace(struct bladerf *dev, bool enable)
+{
+    int status;
+
+    if (dev->fn->enable_trace == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    CTRL_LOCK(dev);
+    status = dev->fn->enable_trace(dev, enable);
+    CTRL_UNLOCK(dev);
+
+    return status;
+}
+
+int bladerf_get_usb_stats(struct bladerf *dev,
+                          struct bladerf_usb_stats *stats, unsigned int count)
+{
+    int status;
+
+    if (stats == NULL && count != 0) {
+        return BLADERF_ERR_INVAL;
+    } else if (dev->fn->get_trace_stats == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    CTRL_LOCK(dev);
+    status = dev->fn->get_trace_stats(dev, stats, count);
+    CTRL_UNLOCK(dev);
+
+    return status;
+}
+
+int bladerf_write_usb_trace(struct bladerf *dev, const char *filename)
+{
+    int status;
+
+    if (filename == NULL) {
+        return BLADERF_ERR_INVAL;
+    } else if (dev->fn->write_trace == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    CTRL_LOCK(dev);
+    status = dev->fn->write_trace(dev, filename);
+    CTRL_UNLOCK(dev);
+
     return status;
 }
 
@@ -1472,11 +2021,11 @@ int bladerf_get_timestamp(struct bladerf *dev, bladerf_module module, uint64_t *
 int bladerf_dac_write(struct bladerf *dev, uint16_t val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = DAC_WRITE(dev, val);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -1488,11 +2037,11 @@ int bladerf_dac_write(struct bladerf *dev, uint16_t val)
 int bladerf_xb_spi_write(struct bladerf *dev, uint32_t val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = XB_SPI_WRITE(dev, val);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -1502,11 +2051,11 @@ int bladerf_xb_spi_write(struct bladerf *dev, uint32_t val)
 int bladerf_calibrate_dc(struct bladerf *dev, bladerf_cal_module module)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev);
 
     status = lms_calibrate_dc(dev, module);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev);
     return status;
 }
 
@@ -32,6 +32,9 @@
 #include "dc_cal_table.h"
 #include "xb.h"
 #include "version_compat.h"
+#include "flash_fields.h"
+#include "config.h"
+#include "fpga.h"
 
 static inline int apply_lms_dc_cals(struct bladerf *dev)
 {
@@ -239,6 +242,11 @@ int init_device(struct bladerf *dev)
         }
 
         /* Set the calibrated VCTCXO DAC value */
+        status = load_deferred_cal_fields(dev);
+        if (status != 0) {
+            log_debug("Using default VCTCXO trim value\n");
+        }
+
         status = DAC_WRITE(dev, dev->dac_trim);
         if (status != 0) {
             return status;
@@ -258,6 +266,32 @@ int init_device(struct bladerf *dev)
     return status;
 }
 
+int load_deferred_dc_cals(struct bladerf *dev)
+{
+    int status;
+
+    if (!dev->dc_cals_pending) {
+        return 0;
+    }
+
+    dev->dc_cals_pending = false;
+    log_verbose("Loading deferred DC calibration tables.\n");
+
+    status = config_load_dc_cals(dev);
+    if (status != 0) {
+        return status;
+    }
+
+    /* Without an FPGA, the LMS settings are applied by init_device() once
+     * one has been loaded */
+    status = FPGA_IS_CONFIGURED(dev);
+    if (status > 0) {
+        status = apply_lms_dc_cals(dev);
+    }
+
+    return status < 0 ? status : 0;
+}
+
 int populate_abs_timeout(struct timespec *t, unsigned int timeout_ms)
 {
     static const int nsec_per_sec = 1000 * 1000 * 1000;
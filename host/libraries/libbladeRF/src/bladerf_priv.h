@@ -77,10 +77,20 @@ struct bladerf;
 #define BLADERF_HAS_CAL_(dev, name)  (dev->cal.name != NULL)
 #define BLADERF_HAS_RX_DC_CAL(dev)   (BLADERF_HAS_CAL_(dev, dc_rx))
 #define BLADERF_HAS_TX_DC_CAL(dev)   (BLADERF_HAS_CAL_(dev, dc_tx))
+#define BLADERF_HAS_RX_IQ_CAL(dev)   (BLADERF_HAS_CAL_(dev, iq_rx))
+#define BLADERF_HAS_TX_IQ_CAL(dev)   (BLADERF_HAS_CAL_(dev, iq_tx))
+
+struct gain_state;
+struct agc;
+struct si5338_state;
 
 struct calibrations {
     struct dc_cal_tbl *dc_rx;
     struct dc_cal_tbl *dc_tx;
+
+    /* IQ imbalance tables. See iq_cal_tbl_load(). */
+    struct dc_cal_tbl *iq_rx;
+    struct dc_cal_tbl *iq_tx;
 };
 
 struct bladerf {
@@ -99,6 +109,12 @@ struct bladerf {
     uint16_t dac_trim;
     bladerf_fpga_size fpga_size;
 
+    /* Set when a lazy open has deferred reading dac_trim and fpga_size, or
+     * loading and applying DC calibration tables, until first use.
+     * See bladerf_set_lazy_open() */
+    bool cal_fields_pending;
+    bool dc_cals_pending;
+
     struct bladerf_version fpga_version;
     struct bladerf_version fw_version;
     int legacy;
@@ -113,6 +129,19 @@ struct bladerf {
     /* Driver-sppecific implementations */
     const struct backend_fns *fn;
 
+    /* Traffic recorder wrapping the backend, when recording is enabled.
+     * See backend/replay/replay.h */
+    struct trace_recorder *recorder;
+
+    /* Control-path round trips performed by the backend */
+    struct bladerf_round_trips round_trips;
+
+    /* API function currently holding ctrl_lock, or NULL, and the sequence
+     * number of that call. Backends use these to attribute transactions
+     * to API calls when tracing. See CTRL_LOCK() in bladerf.c. */
+    const char *api_fn;
+    unsigned int api_seq;
+
     /* Stream transfer timeouts for RX and TX */
     int transfer_timeout[NUM_MODULES];
 
@@ -122,6 +151,26 @@ struct bladerf {
     /* Calibration data */
     struct calibrations cal;
 
+    /* Gain tables, offsets and scheduled gain changes. See gain.h */
+    struct gain_state *gain[NUM_MODULES];
+
+    /* Copy of gain_sched_next() for each module, protected by the relevant
+     * sync_lock, so that sync calls only take ctrl_lock when a scheduled
+     * gain change is due */
+    uint64_t gain_sched_next[NUM_MODULES];
+
+    /* RX AGC state, or NULL when the AGC is disabled. Protected by the RX
+     * sync_lock. See agc.h */
+    struct agc *agc;
+
+    /* Si5338 register shadows and computed sample rate configurations.
+     * See si5338.c */
+    struct si5338_state *si5338;
+
+    /* How flash_write_fx3_fw() and flash_write_fpga_bitstream() program
+     * their regions. See bladerf_set_flash_mode() */
+    bladerf_flash_mode flash_mode;
+
     /* Track filterbank selection for RX autoselection */
     bladerf_xb200_filter rx_filter;
 
@@ -186,6 +235,18 @@ static inline size_t bytes_to_samples(bladerf_format format, size_t n)
  */
 int init_device(struct bladerf *dev);
 
+/**
+ * Load any DC calibration tables available in the config search path and
+ * apply their LMS register settings, if a lazy open deferred doing so.
+ * This must be called with the control lock held, before the device's
+ * DC calibration tables are used.
+ *
+ * @param   dev     Device handle
+ *
+ * @return 0 on success, BLADERF_ERR_* on failure
+ */
+int load_deferred_dc_cals(struct bladerf *dev);
+
 /**
  * Populate the provided timeval structure for the specified timeout
  *
@@ -25,6 +25,7 @@
 #include "file_ops.h"
 #include "log.h"
 #include "config.h"
+#include "flash_fields.h"
 
 static inline void load_dc_cal(struct bladerf *dev, const char *file)
 {
@@ -54,8 +55,18 @@ static inline void load_dc_cal(struct bladerf *dev, const char *file)
             dev->cal.dc_tx = dc_cal_tbl_load(img->data, img->length);
             break;
 
+        case BLADERF_IMAGE_TYPE_RX_IQ_CAL:
+            dc_cal_tbl_free(&dev->cal.iq_rx);
+            dev->cal.iq_rx = iq_cal_tbl_load(img->data, img->length);
+            break;
+
+        case BLADERF_IMAGE_TYPE_TX_IQ_CAL:
+            dc_cal_tbl_free(&dev->cal.iq_tx);
+            dev->cal.iq_tx = iq_cal_tbl_load(img->data, img->length);
+            break;
+
         default:
-            log_debug("%s is not an RX DC calibration table.\n", file);
+            log_debug("%s is not a calibration table.\n", file);
     }
 
 out:
@@ -67,6 +78,8 @@ int config_load_fpga(struct bladerf *dev)
     int status = 0;
     char *filename = NULL;
 
+    load_deferred_cal_fields(dev);
+
     if (dev->fpga_size == BLADERF_FPGA_40KLE) {
         filename = file_find("hostedx40.rbf");
     } else if (dev->fpga_size == BLADERF_FPGA_115KLE) {
@@ -89,29 +102,29 @@ int config_load_dc_cals(struct bladerf *dev)
 {
     char *filename;
     char *full_path;
+    size_t i;
+
+    static const char *suffixes[] = {
+        "_dc_rx.tbl", "_dc_tx.tbl", "_iq_rx.tbl", "_iq_tx.tbl"
+    };
 
     filename = calloc(1, FILENAME_MAX + 1);
     if (filename == NULL) {
         return BLADERF_ERR_MEM;
     }
 
-    strncat(filename, dev->ident.serial, FILENAME_MAX);
-    strncat(filename, "_dc_rx.tbl", FILENAME_MAX - BLADERF_SERIAL_LENGTH);
-    full_path = file_find(filename);
-    if (full_path != NULL) {
-        log_debug("Loading %s\n", full_path);
-        load_dc_cal(dev, full_path);
-        free(full_path);
-    }
-
-    memset(filename, 0, FILENAME_MAX + 1);
-    strncat(filename, dev->ident.serial, FILENAME_MAX);
-    strncat(filename, "_dc_tx.tbl", FILENAME_MAX - BLADERF_SERIAL_LENGTH);
-    full_path = file_find(filename);
-    if (full_path != NULL) {
-        log_debug("Loading %s\n", full_path);
-        load_dc_cal(dev, full_path);
-        free(full_path);
+    for (i = 0; i < ARRAY_SIZE(suffixes); i++) {
+        memset(filename, 0, FILENAME_MAX + 1);
+        strncat(filename, dev->ident.serial, FILENAME_MAX);
+        strncat(filename, suffixes[i],
+                FILENAME_MAX - BLADERF_SERIAL_LENGTH);
+
+        full_path = file_find(filename);
+        if (full_path != NULL) {
+            log_debug("Loading %s\n", full_path);
+            load_dc_cal(dev, full_path);
+            free(full_path);
+        }
     }
 
     free(filename);
@@ -26,11 +26,13 @@
 #define BLADERF_CONFIG_H_
 
 /**
- * Load DC calibration tables from their associated files, if available.
+ * Load DC and IQ imbalance calibration tables from their associated files,
+ * if available.
  *
  * Note that successful return value doesn't imply that tables were found and
- * loaded. Use the BLADERF_HAS_RX_DC_CAL() and BLADERF_HAS_TX_DC_CAL() macros to
- * ensure the device has calibration tables before attempting to use thea
+ * loaded. Use the BLADERF_HAS_RX_DC_CAL() and BLADERF_HAS_TX_DC_CAL() macros
+ * (or their IQ counterparts) to ensure the device has calibration tables
+ * before attempting to use thea
  *
  * @return  0 on success, BLADERF_ERR_MEM on memory allocation error.  *
  */
@@ -0,0 +1,624 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* DC offset correction searches
+ *
+ * RX: The average of the I (Q) samples is, to a good approximation, a linear
+ * function of the I (Q) correction value. Its root is found via the secant
+ * method, starting from a pair of probes. With a linear response, the first
+ * secant step lands on the root, and a second step confirms that no
+ * neighboring register value is better.
+ *
+ * TX: The LO leakage is a phasor L, to which the correction values add a
+ * phasor proportional to (dc_i + j dc_q). The power received via loopback
+ * is therefore |L + k (dc_i + j dc_q)|^2 plus a noise floor -- a paraboloid
+ * in (dc_i, dc_q). Allowing for I/Q gain imbalance, this is modeled as:
+ *
+ *      p = A u^2 + B v^2 + C u + D v + E
+ *
+ * where u and v are the correction values relative to a center point. Five
+ * probes, at the center and a step away along each axis, determine the model
+ * exactly. The minimum is then measured, and the model is refit to all of
+ * the measurements to confirm it. If the measurement at a predicted minimum
+ * is worse than that at the center, the model is refit to closer probes.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "libbladeRF.h"
+#include "log.h"
+
+#define DC_SOLVER_RANGE_MIN     (-2048)
+#define DC_SOLVER_RANGE_MAX     2048
+
+/* Registers provide 6 bits of RX magnitude and 7 bits of TX scale */
+#define DC_SOLVER_RX_QUANTUM    32
+#define DC_SOLVER_TX_QUANTUM    16
+
+#define DC_SOLVER_STEP          512
+#define DC_SOLVER_MAX_MEAS      16
+
+/* Returned internally when the measurement budget is exhausted */
+#define OUT_OF_MEASUREMENTS     1
+
+/* Number of TX model coefficients */
+#define TX_MODEL_N              5
+
+/* Once the probe spacing has been reduced, only TX measurements this far from
+ * the center point, in units of the current spacing, are included in a fit.
+ * Until then, all measurements are used. */
+#define TX_FIT_RADIUS           2
+
+void bladerf_dc_solver_defaults(bladerf_module module,
+                                struct bladerf_dc_solver_config *c)
+{
+    c->min = DC_SOLVER_RANGE_MIN;
+    c->max = DC_SOLVER_RANGE_MAX;
+    c->step = DC_SOLVER_STEP;
+    c->threshold = 0.0f;
+    c->max_measurements = DC_SOLVER_MAX_MEAS;
+
+    if (module == BLADERF_MODULE_RX) {
+        c->quantum = DC_SOLVER_RX_QUANTUM;
+    } else {
+        c->quantum = DC_SOLVER_TX_QUANTUM;
+    }
+}
+
+static int check_config(const struct bladerf_dc_solver_config *c)
+{
+    if (c->min >= c->max || c->quantum <= 0 ||
+        c->step < c->quantum || c->step > (c->max - c->min) / 2 ||
+        c->threshold < 0.0f || c->max_measurements < 2) {
+
+        log_debug("Invalid DC solver configuration\n");
+        return BLADERF_ERR_INVAL;
+    }
+
+    return 0;
+}
+
+/* Round a candidate value to the register resolution, within range */
+static int16_t quantize(const struct bladerf_dc_solver_config *c, double value)
+{
+    double q = floor(value / c->quantum + 0.5) * c->quantum;
+
+    if (q > c->max) {
+        q = c->max;
+    } else if (q < c->min) {
+        q = c->min;
+    }
+
+    return (int16_t) q;
+}
+
+/*******************************************************************************
+ * RX
+ ******************************************************************************/
+
+/* Secant method state for one channel */
+struct rx_channel {
+    int16_t x0, x1;     /* Previous and latest correction values */
+    float y0, y1;       /* Measured averages at x0 and x1 */
+
+    int16_t best_x;
+    float best_y;
+
+    int16_t next;       /* Correction value to measure next */
+    bool done;
+};
+
+static void rx_update(struct rx_channel *ch, int16_t x, float y)
+{
+    ch->x0 = ch->x1;
+    ch->y0 = ch->y1;
+    ch->x1 = x;
+    ch->y1 = y;
+
+    if (fabsf(y) < fabsf(ch->best_y)) {
+        ch->best_x = x;
+        ch->best_y = y;
+    }
+}
+
+/* Determine the next value to measure, or whether the search of this channel
+ * is complete. Returns BLADERF_ERR_UNEXPECTED if the latest two measurements
+ * do not differ, and no better value can be predicted. */
+static int rx_step(const struct bladerf_dc_solver_config *c,
+                   struct rx_channel *ch)
+{
+    double root;
+
+    if (fabsf(ch->best_y) <= c->threshold) {
+        ch->done = true;
+        return 0;
+    }
+
+    if (ch->y1 == ch->y0) {
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    root = ch->x1 - (double) ch->y1 * (ch->x1 - ch->x0) / (ch->y1 - ch->y0);
+    ch->next = quantize(c, root);
+
+    /* The root is nearest to the best value measured, or lies in a direction
+     * that has already been measured and found to be worse */
+    if (ch->next == ch->best_x || ch->next == ch->x0 || ch->next == ch->x1) {
+        ch->done = true;
+    }
+
+    return 0;
+}
+
+int bladerf_dc_solve_rx(const struct bladerf_dc_solver_config *config,
+                        bladerf_dc_rx_measure measure, void *arg,
+                        struct bladerf_dc_solution *solution)
+{
+    int status;
+    struct bladerf_dc_solver_config defaults;
+    struct rx_channel i, q;
+    float mean_i, mean_q;
+    unsigned int n;
+
+    if (config == NULL) {
+        bladerf_dc_solver_defaults(BLADERF_MODULE_RX, &defaults);
+        config = &defaults;
+    }
+
+    status = check_config(config);
+    if (status != 0) {
+        return status;
+    }
+
+    memset(solution, 0, sizeof(*solution));
+    memset(&i, 0, sizeof(i));
+    memset(&q, 0, sizeof(q));
+
+    /* Initial pair of probes, either side of 0 */
+    i.x1 = q.x1 = quantize(config, -config->step);
+    status = measure(arg, i.x1, q.x1, &i.y1, &q.y1);
+    if (status != 0) {
+        return status;
+    }
+
+    i.best_x = i.x1;
+    i.best_y = i.y1;
+    q.best_x = q.x1;
+    q.best_y = q.y1;
+
+    n = 1;
+
+    i.next = q.next = quantize(config, config->step);
+
+    do {
+        status = measure(arg, i.done ? i.best_x : i.next,
+                              q.done ? q.best_x : q.next,
+                              &mean_i, &mean_q);
+        if (status != 0) {
+            return status;
+        }
+
+        n++;
+
+        if (!i.done) {
+            rx_update(&i, i.next, mean_i);
+
+            status = rx_step(config, &i);
+            if (status != 0) {
+                log_debug("RX I values appear to be stuck @ %f\n", i.y1);
+                return status;
+            }
+        }
+
+        if (!q.done) {
+            rx_update(&q, q.next, mean_q);
+
+            status = rx_step(config, &q);
+            if (status != 0) {
+                log_debug("RX Q values appear to be stuck @ %f\n", q.y1);
+                return status;
+            }
+        }
+    } while (!(i.done && q.done) && n < config->max_measurements);
+
+    solution->dc_i = i.best_x;
+    solution->dc_q = q.best_x;
+    solution->residual_i = i.best_y;
+    solution->residual_q = q.best_y;
+    solution->measurements = n;
+    solution->converged = i.done && q.done;
+
+    log_verbose("RX DC search: I=%d (%f), Q=%d (%f) after %u measurements\n",
+                solution->dc_i, solution->residual_i,
+                solution->dc_q, solution->residual_q, n);
+
+    return 0;
+}
+
+/*******************************************************************************
+ * TX
+ ******************************************************************************/
+
+struct tx_point {
+    int16_t x, y;
+    double power;
+};
+
+struct tx_search {
+    const struct bladerf_dc_solver_config *c;
+    bladerf_dc_tx_measure measure;
+    void *arg;
+
+    struct tx_point *points;
+    unsigned int n;
+
+    unsigned int best;      /* Index of the lowest power measurement */
+};
+
+/* Measure at the specified point, reusing a previous measurement if there is
+ * one. Returns OUT_OF_MEASUREMENTS if the budget is exhausted. */
+static int tx_probe(struct tx_search *t, int16_t x, int16_t y, double *power)
+{
+    int status;
+    float magnitude;
+    unsigned int k;
+
+    for (k = 0; k < t->n; k++) {
+        if (t->points[k].x == x && t->points[k].y == y) {
+            if (power != NULL) {
+                *power = t->points[k].power;
+            }
+            return 0;
+        }
+    }
+
+    if (t->n == t->c->max_measurements) {
+        return OUT_OF_MEASUREMENTS;
+    }
+
+    status = t->measure(t->arg, x, y, &magnitude);
+    if (status != 0) {
+        return status;
+    }
+
+    t->points[t->n].x = x;
+    t->points[t->n].y = y;
+    t->points[t->n].power = (double) magnitude * magnitude;
+
+    if (t->points[t->n].power < t->points[t->best].power) {
+        t->best = t->n;
+    }
+
+    if (power != NULL) {
+        *power = t->points[t->n].power;
+    }
+
+    t->n++;
+    return 0;
+}
+
+/* Measure at a point and a step away from it along each axis. The probes are
+ * shifted inward as needed to remain in range. */
+static int tx_probe_cross(struct tx_search *t, int16_t x, int16_t y,
+                          int16_t h)
+{
+    int status;
+    const int16_t lo = t->c->min + h;
+    const int16_t hi = t->c->max - h;
+
+    x = x < lo ? lo : (x > hi ? hi : x);
+    y = y < lo ? lo : (y > hi ? hi : y);
+
+    status = tx_probe(t, x, y, NULL);
+    if (status == 0) {
+        status = tx_probe(t, x - h, y, NULL);
+    }
+
+    if (status == 0) {
+        status = tx_probe(t, x + h, y, NULL);
+    }
+
+    if (status == 0) {
+        status = tx_probe(t, x, y - h, NULL);
+    }
+
+    if (status == 0) {
+        status = tx_probe(t, x, y + h, NULL);
+    }
+
+    return status;
+}
+
+/* Solve the n x n system m * x = b in place, via Gaussian elimination with
+ * partial pivoting. Returns false if the system is singular. */
+static bool solve(double m[TX_MODEL_N][TX_MODEL_N], double b[TX_MODEL_N],
+                  double x[TX_MODEL_N])
+{
+    int r, c, k, pivot;
+    double tmp, f;
+
+    for (c = 0; c < TX_MODEL_N; c++) {
+        pivot = c;
+        for (r = c + 1; r < TX_MODEL_N; r++) {
+            if (fabs(m[r][c]) > fabs(m[pivot][c])) {
+                pivot = r;
+            }
+        }
+
+        if (fabs(m[pivot][c]) < 1e-12) {
+            return false;
+        }
+
+        if (pivot != c) {
+            for (k = 0; k < TX_MODEL_N; k++) {
+                tmp = m[c][k];
+                m[c][k] = m[pivot][k];
+                m[pivot][k] = tmp;
+            }
+
+            tmp = b[c];
+            b[c] = b[pivot];
+            b[pivot] = tmp;
+        }
+
+        for (r = c + 1; r < TX_MODEL_N; r++) {
+            f = m[r][c] / m[c][c];
+            for (k = c; k < TX_MODEL_N; k++) {
+                m[r][k] -= f * m[c][k];
+            }
+            b[r] -= f * b[c];
+        }
+    }
+
+    for (r = TX_MODEL_N - 1; r >= 0; r--) {
+        tmp = b[r];
+        for (k = r + 1; k < TX_MODEL_N; k++) {
+            tmp -= m[r][k] * x[k];
+        }
+        x[r] = tmp / m[r][r];
+    }
+
+    return true;
+}
+
+/* Fit the power model to the measurements about (x, y), and locate its
+ * minimum. Coordinates are scaled by the probe spacing, h, to keep the system
+ * well conditioned.
+ *
+ * Returns false if there are too few measurements nearby, or if the model
+ * does not have a minimum. */
+static bool tx_fit(const struct tx_search *t, int16_t x, int16_t y, int16_t h,
+                   double *min_x, double *min_y)
+{
+    double m[TX_MODEL_N][TX_MODEL_N];
+    double b[TX_MODEL_N];
+    double coeff[TX_MODEL_N];
+    double basis[TX_MODEL_N];
+    unsigned int k, used;
+    int r, c;
+
+    memset(m, 0, sizeof(m));
+    memset(b, 0, sizeof(b));
+    used = 0;
+
+    /* Accumulate the normal equations of the least squares fit */
+    for (k = 0; k < t->n; k++) {
+        const double u = (double) (t->points[k].x - x) / h;
+        const double v = (double) (t->points[k].y - y) / h;
+
+        if (h < t->c->step &&
+            (fabs(u) > TX_FIT_RADIUS || fabs(v) > TX_FIT_RADIUS)) {
+            continue;
+        }
+
+        basis[0] = u * u;
+        basis[1] = v * v;
+        basis[2] = u;
+        basis[3] = v;
+        basis[4] = 1.0;
+
+        for (r = 0; r < TX_MODEL_N; r++) {
+            for (c = 0; c < TX_MODEL_N; c++) {
+                m[r][c] += basis[r] * basis[c];
+            }
+            b[r] += basis[r] * t->points[k].power;
+        }
+
+        used++;
+    }
+
+    if (used < TX_MODEL_N || !solve(m, b, coeff)) {
+        return false;
+    }
+
+    if (coeff[0] <= 0.0 || coeff[1] <= 0.0) {
+        log_verbose("TX DC model has no minimum (%f, %f)\n",
+                    coeff[0], coeff[1]);
+        return false;
+    }
+
+    *min_x = x - h * coeff[2] / (2 * coeff[0]);
+    *min_y = y - h * coeff[3] / (2 * coeff[1]);
+
+    if (*min_x < t->c->min) {
+        *min_x = t->c->min;
+    } else if (*min_x > t->c->max) {
+        *min_x = t->c->max;
+    }
+
+    if (*min_y < t->c->min) {
+        *min_y = t->c->min;
+    } else if (*min_y > t->c->max) {
+        *min_y = t->c->max;
+    }
+
+    return true;
+}
+
+int bladerf_dc_solve_tx(const struct bladerf_dc_solver_config *config,
+                        bladerf_dc_tx_measure measure, void *arg,
+                        struct bladerf_dc_solution *solution)
+{
+    int status;
+    struct bladerf_dc_solver_config defaults;
+    struct tx_search t;
+    int16_t x, y, next_x, next_y, h;
+    double min_x, min_y, power, center_power;
+    bool probed_cross, fitted = false;
+
+    if (config == NULL) {
+        bladerf_dc_solver_defaults(BLADERF_MODULE_TX, &defaults);
+        config = &defaults;
+    }
+
+    status = check_config(config);
+    if (status != 0) {
+        return status;
+    }
+
+    if (config->max_measurements < TX_MODEL_N) {
+        log_debug("At least %d measurements are required\n", TX_MODEL_N);
+        return BLADERF_ERR_INVAL;
+    }
+
+    memset(solution, 0, sizeof(*solution));
+    memset(&t, 0, sizeof(t));
+
+    t.c = config;
+    t.measure = measure;
+    t.arg = arg;
+    t.points = (struct tx_point *) calloc(config->max_measurements,
+                                          sizeof(t.points[0]));
+    if (t.points == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    x = quantize(config, 0);
+    y = quantize(config, 0);
+    h = config->step;
+
+    status = tx_probe_cross(&t, x, y, h);
+    probed_cross = true;
+
+    while (status == 0) {
+        if (!tx_fit(&t, x, y, h, &min_x, &min_y)) {
+            if (!probed_cross) {
+                /* Too few nearby measurements; obtain some */
+                status = tx_probe_cross(&t, x, y, h);
+                probed_cross = true;
+                continue;
+            } else if (h > config->quantum) {
+                /* The model does not hold over this span */
+                h = h / 4 < config->quantum ? config->quantum : h / 4;
+                x = t.points[t.best].x;
+                y = t.points[t.best].y;
+                status = tx_probe_cross(&t, x, y, h);
+                continue;
+            } else {
+                log_debug("Failed to locate TX DC minimum.\n");
+                status = BLADERF_ERR_UNEXPECTED;
+                break;
+            }
+        }
+
+        fitted = true;
+        solution->residual_i = (float) fabs(min_x - x);
+        solution->residual_q = (float) fabs(min_y - y);
+
+        next_x = quantize(config, min_x);
+        next_y = quantize(config, min_y);
+
+        if ((solution->residual_i <= config->threshold &&
+             solution->residual_q <= config->threshold) ||
+            (next_x == x && next_y == y)) {
+            solution->converged = true;
+            break;
+        }
+
+        status = tx_probe(&t, x, y, &center_power);
+        if (status != 0) {
+            break;
+        }
+
+        status = tx_probe(&t, next_x, next_y, &power);
+        if (status != 0) {
+            break;
+        }
+
+        if (power < center_power) {
+            x = next_x;
+            y = next_y;
+            probed_cross = false;
+        } else if (h > config->quantum) {
+            /* The predicted minimum is worse; refine the model closer in */
+            h = h / 4 < config->quantum ? config->quantum : h / 4;
+            status = tx_probe_cross(&t, x, y, h);
+            probed_cross = true;
+        } else {
+            /* Differences are within the measurement noise */
+            solution->converged = true;
+            break;
+        }
+    }
+
+    if (status == OUT_OF_MEASUREMENTS) {
+        if (fitted) {
+            status = 0;
+        } else {
+            log_debug("Failed to locate TX DC minimum.\n");
+            status = BLADERF_ERR_UNEXPECTED;
+        }
+    }
+
+    if (status == 0) {
+        if (solution->converged) {
+            /* Ensure the reported magnitude is for the solution */
+            status = tx_probe(&t, x, y, &power);
+            if (status == OUT_OF_MEASUREMENTS) {
+                solution->converged = false;
+                status = 0;
+            }
+        }
+
+        if (!solution->converged) {
+            x = t.points[t.best].x;
+            y = t.points[t.best].y;
+        }
+    }
+
+    if (status == 0) {
+        tx_probe(&t, x, y, &power);
+
+        solution->dc_i = x;
+        solution->dc_q = y;
+        solution->magnitude = (float) sqrt(power);
+        solution->measurements = t.n;
+
+        log_verbose("TX DC search: I=%d, Q=%d (%f, residual %f, %f) after "
+                    "%u measurements\n", x, y, solution->magnitude,
+                    solution->residual_i, solution->residual_q, t.n);
+    }
+
+    free(t.points);
+    return status;
+}
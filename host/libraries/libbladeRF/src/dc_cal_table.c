@@ -42,28 +42,31 @@
  *        [uint32_t: Frequency]
  *        [int16_t:  DC I correction value]
  *        [int16_t:  DC Q correction value]
+ *
+ * IQ imbalance calibration tables share this format, with a fixed value of
+ * 0x1ab2 at 0x0000. Their entries hold the FPGA gain and phase correction
+ * values in place of the DC I and Q correction values. The LMS register
+ * values are those in effect when the table was generated, and are not
+ * applied when the table is loaded.
  */
 
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
-#include <float.h>
+#include <math.h>
 
 #include "dc_cal_table.h"
 #include "host_config.h"
-#include "minmax.h"
 
 #ifdef TEST_DC_CAL_TABLE
 #   include <stdio.h>
-#   define SHORT_SEARCH 4
-#   define WARN(str) fprintf(stderr, str)
+#   define log_debug(...) fprintf(stderr, __VA_ARGS__)
 #else
 #   include "log.h"
-#   define SHORT_SEARCH 10
-#   define WARN(str) log_warning(str)
 #endif
 
 #define DC_CAL_TBL_MAGIC        0x1ab1
+#define IQ_CAL_TBL_MAGIC        0x1ab2
 
 #define DC_CAL_TBL_META_SIZE    0x18
 #define DC_CAL_TBL_ENTRY_SIZE   (sizeof(uint32_t) + 2 * sizeof(int16_t))
@@ -80,69 +83,76 @@ static inline bool entry_matches(const struct dc_cal_tbl *tbl,
     }
 }
 
-static unsigned int find_entry(const struct dc_cal_tbl *tbl,
-                               unsigned int curr_idx,
-                               unsigned int min_idx, unsigned int max_idx,
-                               unsigned int freq, bool *hit_limit)
+unsigned int dc_cal_tbl_lookup(struct dc_cal_tbl *tbl, unsigned int freq)
 {
-    /* Converged to a single entry - this is the best we can do */
-    if ((max_idx < min_idx) || (max_idx == min_idx && max_idx == curr_idx)) {
-        *hit_limit = true;
-        return curr_idx;
-    }
+    unsigned int idx, lo, hi, mid;
+    const unsigned int last = tbl->n_entries - 1;
+
+    /* First check if we're at, or adjacent to, the entry used by the last
+     * lookup. This is generally the case when hopping between nearby
+     * frequencies, or stepping through a range of them. */
+    idx = tbl->curr_idx;
+
+    if (entry_matches(tbl, idx, freq)) {
+        return idx;
+    } else if (idx < last && entry_matches(tbl, idx + 1, freq)) {
+        idx++;
+    } else if (idx > 0 && entry_matches(tbl, idx - 1, freq)) {
+        idx--;
+    } else if (freq < tbl->entries[0].freq) {
+        /* Lower limit hit - use first entry */
+        idx = 0;
+    } else if (tbl->freq_step != 0) {
+        /* Entries are uniformly spaced, so the index may be computed */
+        idx = (freq - tbl->entries[0].freq) / tbl->freq_step;
+        if (idx > last) {
+            idx = last;
+        }
+    } else {
+        /* Search for the last entry at or below the desired frequency */
+        lo = 0;
+        hi = last;
 
-    if (!entry_matches(tbl, curr_idx, freq)) {
-        if (tbl->entries[curr_idx].freq > freq) {
-            if (curr_idx > 0) {
-                max_idx = (curr_idx - 1);
-            } else {
-                /* Lower limit hit - return first entry */
-                *hit_limit = true;
-                return 0;
-            }
-        } else {
-            if (curr_idx < (tbl->n_entries - 1)) {
-                min_idx = curr_idx + 1;
+        while (lo < hi) {
+            mid = lo + (hi - lo + 1) / 2;
+
+            if (tbl->entries[mid].freq <= freq) {
+                lo = mid;
             } else {
-                /* Upper limit hit - return last entry */
-                *hit_limit = true;
-                return tbl->n_entries - 1;
+                hi = mid - 1;
             }
         }
 
-        curr_idx = min_idx + (max_idx - min_idx) / 2;
-
-        return find_entry(tbl, curr_idx, min_idx, max_idx, freq, hit_limit);
-    } else {
-        return curr_idx;
+        idx = lo;
     }
-}
 
+    tbl->curr_idx = idx;
+    return idx;
+}
 
-unsigned int dc_cal_tbl_lookup(const struct dc_cal_tbl *tbl, unsigned int freq)
+/* Returns the spacing of the table's entries if they are uniformly spaced,
+ * and 0 otherwise */
+static unsigned int uniform_step(const struct dc_cal_tbl *tbl)
 {
-    unsigned int ret = 0;
-    bool limit = false; /* Hit a limit before finding a match */
+    unsigned int i, step;
 
-    /* First check if we're at a nearby change. This is generally the case
-     * when the frequecy change */
-    if (tbl->n_entries > SHORT_SEARCH) {
-        const unsigned int min_idx =
-            (unsigned int) i64_max(0, tbl->curr_idx - (int64_t)SHORT_SEARCH / 2);
+    if (tbl->n_entries < 2 || tbl->entries[1].freq <= tbl->entries[0].freq) {
+        return 0;
+    }
 
-        const unsigned int max_idx =
-            (unsigned int) i64_min(tbl->n_entries - 1, tbl->curr_idx + SHORT_SEARCH / 2);
+    step = tbl->entries[1].freq - tbl->entries[0].freq;
 
-        ret = find_entry(tbl, tbl->curr_idx, min_idx, max_idx, freq, &limit);
-        if (!limit) {
-            return ret;
+    for (i = 2; i < tbl->n_entries; i++) {
+        if (tbl->entries[i].freq - tbl->entries[i - 1].freq != step) {
+            return 0;
         }
     }
 
-    return find_entry(tbl, tbl->curr_idx, 0, tbl->n_entries - 1, freq, &limit);
+    return step;
 }
 
-struct dc_cal_tbl * dc_cal_tbl_load(uint8_t *buf, size_t buf_len)
+static struct dc_cal_tbl * tbl_load(uint8_t *buf, size_t buf_len,
+                                    uint16_t expected_magic)
 {
     struct dc_cal_tbl *ret;
     uint32_t i;
@@ -153,13 +163,13 @@ struct dc_cal_tbl * dc_cal_tbl_load(uint8_t *buf, size_t buf_len)
     }
 
     memcpy(&magic, buf, sizeof(magic));
-    if (LE16_TO_HOST(magic) != DC_CAL_TBL_MAGIC) {
+    if (LE16_TO_HOST(magic) != expected_magic) {
         log_debug("Invalid magic value in cal table: %d\n", magic);
         return NULL;
     }
     buf += sizeof(magic);
 
-    ret = malloc(sizeof(ret[0]));
+    ret = calloc(1, sizeof(ret[0]));
     if (ret == NULL) {
         return NULL;
     }
@@ -174,7 +184,7 @@ struct dc_cal_tbl * dc_cal_tbl_load(uint8_t *buf, size_t buf_len)
     ret->n_entries = LE32_TO_HOST(ret->n_entries);
     buf += sizeof(ret->n_entries);
 
-    if (buf_len <
+    if (ret->n_entries == 0 || buf_len <
          (DC_CAL_TBL_META_SIZE + DC_CAL_TBL_ENTRY_SIZE * ret->n_entries) ) {
 
         free(ret);
@@ -210,69 +220,214 @@ struct dc_cal_tbl * dc_cal_tbl_load(uint8_t *buf, size_t buf_len)
         buf += sizeof(int16_t);
 
         ret->entries[i].freq = LE32_TO_HOST(ret->entries[i].freq);
-        ret->entries[i].dc_i = LE32_TO_HOST(ret->entries[i].dc_i);
-        ret->entries[i].dc_q = LE32_TO_HOST(ret->entries[i].dc_q);
+        ret->entries[i].dc_i = LE16_TO_HOST(ret->entries[i].dc_i);
+        ret->entries[i].dc_q = LE16_TO_HOST(ret->entries[i].dc_q);
     }
 
+    ret->freq_step = uniform_step(ret);
+    ret->interp = BLADERF_DC_CAL_INTERP_LINEAR;
+
     return ret;
 }
 
-/* Interpolate a y value given two points and a desired x value
- *
- * y = interp( (x0, y0), (x1, y1), x )
- *
- * Returns
- */
-static inline unsigned int interp(unsigned int x0, unsigned int y0,
-                           unsigned int x1, unsigned int y1,
-                           unsigned int x)
+struct dc_cal_tbl * dc_cal_tbl_load(uint8_t *buf, size_t buf_len)
+{
+    return tbl_load(buf, buf_len, DC_CAL_TBL_MAGIC);
+}
+
+struct dc_cal_tbl * iq_cal_tbl_load(uint8_t *buf, size_t buf_len)
 {
-    const float num = (float) y1 - y0;
-    const float den = (float) x1 - x0;
-    const float m = den == 0 ? FLT_MAX : num / den;
-    const float y = (x - x0) * m + y0;
+    return tbl_load(buf, buf_len, IQ_CAL_TBL_MAGIC);
+}
 
-    return (unsigned int) y;
+static inline double entry_val(const struct dc_cal_entry *e, bool q)
+{
+    return q ? e->dc_q : e->dc_i;
 }
 
-static inline void dc_cal_interp(const struct dc_cal_tbl *tbl,
-                                 unsigned int idx_low,
-                                 unsigned int idx_high,
-                                 unsigned int freq,
-                                 int16_t *dc_i, int16_t *dc_q)
+static inline int16_t round_val(double val)
 {
-    const unsigned int f_low = tbl->entries[idx_low].freq;
-    const unsigned int f_high = tbl->entries[idx_high].freq;
+    return (int16_t) floor(val + 0.5);
+}
 
-    *dc_i = (int16_t) interp(f_low, tbl->entries[idx_low].dc_i,
-                             f_high, tbl->entries[idx_low].dc_i,
-                             freq);
+/* Slope (per Hz) of a component at entry k, for cubic interpolation. This is
+ * the slope between the adjacent entries, or of the single adjacent segment
+ * at either end of the table. */
+static double slope(const struct dc_cal_tbl *tbl, unsigned int k, bool q)
+{
+    const unsigned int lo = (k > 0) ? k - 1 : k;
+    const unsigned int hi = (k < tbl->n_entries - 1) ? k + 1 : k;
+    const struct dc_cal_entry *e0 = &tbl->entries[lo];
+    const struct dc_cal_entry *e1 = &tbl->entries[hi];
 
-    *dc_q = (int16_t) interp(f_low, tbl->entries[idx_low].dc_q,
-                             f_high, tbl->entries[idx_low].dc_q,
-                             freq);
+    return (entry_val(e1, q) - entry_val(e0, q)) /
+           ((double) e1->freq - e0->freq);
 }
 
-void dc_cal_tbl_vals(const struct dc_cal_tbl *tbl, unsigned int freq,
-                     int16_t *dc_i, int16_t *dc_q)
+/* Interpolate a component between entries k and k + 1 */
+static double interp(const struct dc_cal_tbl *tbl, bladerf_dc_cal_interp mode,
+                     unsigned int k, unsigned int freq, bool q)
+{
+    const struct dc_cal_entry *e0 = &tbl->entries[k];
+    const struct dc_cal_entry *e1 = &tbl->entries[k + 1];
+    const double h = (double) e1->freq - e0->freq;
+    const double t = (freq - e0->freq) / h;
+    const double y0 = entry_val(e0, q);
+    const double y1 = entry_val(e1, q);
+
+    if (mode == BLADERF_DC_CAL_INTERP_CUBIC) {
+        /* Cubic Hermite spline */
+        const double m0 = slope(tbl, k, q) * h;
+        const double m1 = slope(tbl, k + 1, q) * h;
+        const double t2 = t * t;
+        const double t3 = t2 * t;
+
+        return (2 * t3 - 3 * t2 + 1) * y0 + (t3 - 2 * t2 + t) * m0 +
+               (-2 * t3 + 3 * t2) * y1 + (t3 - t2) * m1;
+    } else {
+        return y0 + t * (y1 - y0);
+    }
+}
+
+/* Compute the DC calibration values for a frequency from the table entries */
+static void dc_cal_tbl_interp(struct dc_cal_tbl *tbl, unsigned int freq,
+                              int16_t *dc_i, int16_t *dc_q)
 {
     const unsigned int idx = dc_cal_tbl_lookup(tbl, freq);
+    const struct dc_cal_entry *e = &tbl->entries[idx];
 
-    if (tbl->entries[idx].freq == freq) {
-        /* Exact match */
-        *dc_i = tbl->entries[idx].dc_i;
-        *dc_q = tbl->entries[idx].dc_q;
-        return;
-    } else if (idx == (tbl->n_entries - 1)) {
-        dc_cal_interp(tbl, idx - 1, idx, freq, dc_i, dc_q);
+    if (e->freq == freq || freq < e->freq || idx == (tbl->n_entries - 1)) {
+        /* Exact match, or beyond the limits of the table */
+        *dc_i = e->dc_i;
+        *dc_q = e->dc_q;
     } else {
-        dc_cal_interp(tbl, idx, idx + 1, freq, dc_i, dc_q);
+        *dc_i = round_val(interp(tbl, tbl->interp, idx, freq, false));
+        *dc_q = round_val(interp(tbl, tbl->interp, idx, freq, true));
+    }
+}
+
+/* Search the precomputed values for an exact match */
+static const struct dc_cal_entry * lut_lookup(struct dc_cal_tbl *tbl,
+                                              unsigned int freq)
+{
+    unsigned int lo, hi, mid;
+    const unsigned int idx = tbl->lut_idx;
+
+    /* Check the last entry used and the one following it, as frequency
+     * lists are commonly stepped through in order */
+    if (tbl->lut[idx].freq == freq) {
+        return &tbl->lut[idx];
+    } else if (idx + 1 < tbl->lut_len && tbl->lut[idx + 1].freq == freq) {
+        tbl->lut_idx = idx + 1;
+        return &tbl->lut[idx + 1];
+    }
+
+    lo = 0;
+    hi = tbl->lut_len;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+
+        if (tbl->lut[mid].freq < freq) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (lo < tbl->lut_len && tbl->lut[lo].freq == freq) {
+        tbl->lut_idx = lo;
+        return &tbl->lut[lo];
+    }
+
+    return NULL;
+}
+
+void dc_cal_tbl_vals(struct dc_cal_tbl *tbl, unsigned int freq,
+                     int16_t *dc_i, int16_t *dc_q)
+{
+    const struct dc_cal_entry *e = NULL;
+
+    if (tbl->lut_len != 0) {
+        e = lut_lookup(tbl, freq);
+    }
+
+    if (e != NULL) {
+        *dc_i = e->dc_i;
+        *dc_q = e->dc_q;
+    } else {
+        dc_cal_tbl_interp(tbl, freq, dc_i, dc_q);
+    }
+}
+
+static void lut_compute(struct dc_cal_tbl *tbl)
+{
+    unsigned int i;
+
+    for (i = 0; i < tbl->lut_len; i++) {
+        dc_cal_tbl_interp(tbl, tbl->lut[i].freq,
+                          &tbl->lut[i].dc_i, &tbl->lut[i].dc_q);
+    }
+}
+
+static int compare_freq(const void *a, const void *b)
+{
+    const unsigned int fa = ((const struct dc_cal_entry *) a)->freq;
+    const unsigned int fb = ((const struct dc_cal_entry *) b)->freq;
+
+    return (fa > fb) - (fa < fb);
+}
+
+int dc_cal_tbl_set_lut(struct dc_cal_tbl *tbl,
+                       const unsigned int *freqs, unsigned int n)
+{
+    unsigned int i, len;
+    struct dc_cal_entry *lut = NULL;
+
+    if (n != 0) {
+        lut = malloc(n * sizeof(lut[0]));
+        if (lut == NULL) {
+            return BLADERF_ERR_MEM;
+        }
+
+        for (i = 0; i < n; i++) {
+            lut[i].freq = freqs[i];
+        }
+
+        /* Sort and remove duplicates */
+        qsort(lut, n, sizeof(lut[0]), compare_freq);
+
+        for (i = 1, len = 1; i < n; i++) {
+            if (lut[i].freq != lut[len - 1].freq) {
+                lut[len++] = lut[i];
+            }
+        }
+    } else {
+        len = 0;
+    }
+
+    free(tbl->lut);
+    tbl->lut = lut;
+    tbl->lut_len = len;
+    tbl->lut_idx = 0;
+
+    lut_compute(tbl);
+    return 0;
+}
+
+void dc_cal_tbl_set_interp(struct dc_cal_tbl *tbl,
+                           bladerf_dc_cal_interp interp)
+{
+    if (interp != tbl->interp) {
+        tbl->interp = interp;
+        lut_compute(tbl);
     }
 }
 
 void dc_cal_tbl_free(struct dc_cal_tbl **tbl)
 {
     if (*tbl != NULL) {
+        free((*tbl)->lut);
         free((*tbl)->entries);
         free(*tbl);
         *tbl = NULL;
@@ -283,9 +438,10 @@ void dc_cal_tbl_free(struct dc_cal_tbl **tbl)
 
 #define ENTRY(f) { f, 0, 0 }
 
-#define TBL(entries, curr_idx) { \
-    entries != NULL ? sizeof(entries) / sizeof(entries[0]) : 0, \
-    curr_idx, entries \
+#define TBL(entries_, curr_idx_) { \
+    .n_entries = sizeof(entries_) / sizeof(entries_[0]), \
+    .curr_idx = curr_idx_, \
+    .entries = entries_, \
 }
 
 #define TEST_CASE(exp_idx, entries, default_idx, freq) { \
@@ -319,7 +475,7 @@ struct dc_cal_entry entries[] = {
 };
 
 struct test {
-    const struct dc_cal_tbl tbl;
+    struct dc_cal_tbl tbl;
     unsigned int freq;
     int expected_idx;
     bool check_result;
@@ -434,25 +590,100 @@ static inline void print_entry(const struct dc_cal_tbl *t,
     }
 }
 
-int main(void)
+struct interp_test {
+    unsigned int freq;
+    bladerf_dc_cal_interp interp;
+    int16_t dc_i, dc_q;
+} interp_tests[] = {
+    /* Beyond the limits of the table */
+    { 200e6, BLADERF_DC_CAL_INTERP_LINEAR, 0, 100 },
+    { 1.1e9, BLADERF_DC_CAL_INTERP_CUBIC, 250, -150 },
+
+    /* Exact matches */
+    { 300e6, BLADERF_DC_CAL_INTERP_LINEAR, 0, 100 },
+    { 500e6, BLADERF_DC_CAL_INTERP_CUBIC, 40, 60 },
+
+    /* Between entries */
+    { 350e6, BLADERF_DC_CAL_INTERP_LINEAR, 5, 95 },
+    { 450e6, BLADERF_DC_CAL_INTERP_LINEAR, 25, 75 },
+    { 700e6, BLADERF_DC_CAL_INTERP_LINEAR, 170, -70 },
+
+    /* The I values lie on a parabola, which the cubic spline follows more
+     * closely (22.5 and 160, respectively) */
+    { 450e6, BLADERF_DC_CAL_INTERP_CUBIC, 23, 78 },
+    { 700e6, BLADERF_DC_CAL_INTERP_CUBIC, 168, -67 },
+};
+
+struct dc_cal_entry interp_entries[] = {
+    { 300e6, 0, 100 }, { 400e6, 10, 90 }, { 500e6, 40, 60 },
+    { 600e6, 90, 10 }, { 800e6, 250, -150 },
+};
+
+static unsigned int run_interp_tests(bool use_lut)
 {
     unsigned int i;
     unsigned int num_failures = 0;
+    int16_t dc_i, dc_q;
+    struct dc_cal_tbl tbl = TBL(interp_entries, 0);
 
-    for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
-        const int expected_idx = tests[i].expected_idx;
-        const int entry_idx = dc_cal_tbl_lookup(&tests[i].tbl, tests[i].freq);
+    for (i = 0; i < sizeof(interp_tests) / sizeof(interp_tests[0]); i++) {
+        dc_cal_tbl_set_interp(&tbl, interp_tests[i].interp);
 
-        if (tests[i].check_result && entry_idx != expected_idx) {
-            fprintf(stderr, "Test case %u: failed.\n", i);
-            print_entry(&tests[i].tbl, "  Got", entry_idx);
-            print_entry(&tests[i].tbl, "  Expected", expected_idx);
+        if (use_lut) {
+            dc_cal_tbl_set_lut(&tbl, &interp_tests[i].freq, 1);
+        }
+
+        dc_cal_tbl_vals(&tbl, interp_tests[i].freq, &dc_i, &dc_q);
+
+        if (dc_i != interp_tests[i].dc_i || dc_q != interp_tests[i].dc_q) {
+            fprintf(stderr, "Interpolation test case %u%s: failed.\n", i,
+                    use_lut ? " (LUT)" : "");
+            fprintf(stderr, "  Got: (%d, %d)\n", dc_i, dc_q);
+            fprintf(stderr, "  Expected: (%d, %d)\n",
+                    interp_tests[i].dc_i, interp_tests[i].dc_q);
             num_failures++;
         } else {
-            printf("Test case %u: passed.\n", i);
+            printf("Interpolation test case %u%s: passed.\n", i,
+                   use_lut ? " (LUT)" : "");
         }
     }
 
+    dc_cal_tbl_set_lut(&tbl, NULL, 0);
+    return num_failures;
+}
+
+int main(void)
+{
+    unsigned int i, pass;
+    unsigned int num_failures = 0;
+
+    /* Run each lookup test as-is, and then with the index computed directly
+     * for uniformly spaced tables */
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+            const int expected_idx = tests[i].expected_idx;
+            int entry_idx;
+
+            if (pass == 1) {
+                tests[i].tbl.freq_step = uniform_step(&tests[i].tbl);
+            }
+
+            entry_idx = dc_cal_tbl_lookup(&tests[i].tbl, tests[i].freq);
+
+            if (tests[i].check_result && entry_idx != expected_idx) {
+                fprintf(stderr, "Test case %u.%u: failed.\n", pass, i);
+                print_entry(&tests[i].tbl, "  Got", entry_idx);
+                print_entry(&tests[i].tbl, "  Expected", expected_idx);
+                num_failures++;
+            } else {
+                printf("Test case %u.%u: passed.\n", pass, i);
+            }
+        }
+    }
+
+    num_failures += run_interp_tests(false);
+    num_failures += run_interp_tests(true);
+
     return num_failures;
 }
 #endif
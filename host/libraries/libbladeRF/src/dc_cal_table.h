@@ -37,34 +37,75 @@ struct dc_cal_tbl {
     uint32_t n_entries;
     struct bladerf_lms_dc_cals reg_vals;
 
-    unsigned int curr_idx;
-    struct dc_cal_entry *entries;  /* Sorted (increasing) by freq */
+    unsigned int curr_idx;          /* Entry used by the last lookup */
+    struct dc_cal_entry *entries;   /* Sorted (increasing) by freq */
+
+    unsigned int freq_step;         /* Spacing of entries, if uniform. 0 if
+                                     * entries are not uniformly spaced. */
+
+    bladerf_dc_cal_interp interp;   /* Interpolation between entries */
+
+    /* Values precomputed for a list of frequencies, sorted by freq */
+    struct dc_cal_entry *lut;
+    unsigned int lut_len;
+    unsigned int lut_idx;           /* LUT entry used by the last lookup */
 };
 
 extern struct dc_cal_tbl rx_cal_test;
 
 /**
- * Get the index of an (approximate) match from the specific dc cal table
+ * Get the index of the last entry at or below the specified frequency, or 0
+ * if the frequency is below that of the first entry.
+ *
+ * The index is computed directly for tables with uniformly spaced entries.
+ * Otherwise, the entries adjacent to the one found by the previous lookup are
+ * checked before resorting to a binary search.
  *
  * @param   tbl     Table to search
  * @param   freq    Desired frequency
  *
- * @param   Index into tbl->entries[]
+ * @return  Index into tbl->entries[]
  */
-unsigned int dc_cal_tbl_lookup(const struct dc_cal_tbl *tbl, unsigned int freq);
+unsigned int dc_cal_tbl_lookup(struct dc_cal_tbl *tbl, unsigned int freq);
 
 /**
  * Get the DC cal values associated with the specified frequencies. If the
  * specified frequency is not in the table, the DC calibration values will
- * be interpolated from surrounding entries.
+ * be interpolated from surrounding entries, as per tbl->interp. Beyond the
+ * limits of the table, the values of the first or last entry are used.
+ *
+ * Values precomputed via dc_cal_tbl_set_lut() are used when available.
  *
  * @param[in]  tbl      Table to search
  * @param[in]  freq     Desired frequency
- * @param[out] vals     Found or interpolated DC calibration values
+ * @param[out] dc_i     Found or interpolated I calibration value
+ * @param[out] dc_q     Found or interpolated Q calibration value
  */
-void dc_cal_tbl_vals(const struct dc_cal_tbl *tbl, unsigned int freq,
+void dc_cal_tbl_vals(struct dc_cal_tbl *tbl, unsigned int freq,
                      int16_t *dc_i, int16_t *dc_q);
 
+/**
+ * Precompute the DC cal values for a list of frequencies. This replaces any
+ * previously precomputed values.
+ *
+ * @param   tbl     Table to update
+ * @param   freqs   Frequencies. Need not be sorted. May be NULL if n is 0.
+ * @param   n       Number of frequencies. 0 discards the precomputed values.
+ *
+ * @return 0 on success, BLADERF_ERR_MEM on allocation failure
+ */
+int dc_cal_tbl_set_lut(struct dc_cal_tbl *tbl,
+                       const unsigned int *freqs, unsigned int n);
+
+/**
+ * Select the interpolation method, updating any precomputed values
+ *
+ * @param   tbl     Table to update
+ * @param   interp  Interpolation method
+ */
+void dc_cal_tbl_set_interp(struct dc_cal_tbl *tbl,
+                           bladerf_dc_cal_interp interp);
+
 /**
  * Load a DC calibration table from the provided data
  *
@@ -75,6 +116,20 @@ void dc_cal_tbl_vals(const struct dc_cal_tbl *tbl, unsigned int freq,
  */
 struct dc_cal_tbl * dc_cal_tbl_load(uint8_t *buf, size_t buf_len);
 
+/**
+ * Load an IQ imbalance calibration table from the provided data
+ *
+ * IQ tables are accessed via the same functions as DC tables. The I and Q
+ * values of their entries are the FPGA gain and phase correction values,
+ * respectively.
+ *
+ * @param   buf   Packed table data
+ * @param   len   Length of packed data, in bytes
+ *
+ * @return Loaded table
+ */
+struct dc_cal_tbl * iq_cal_tbl_load(uint8_t *buf, size_t buf_len);
+
 /**
  * Free a DC calibration table
  *
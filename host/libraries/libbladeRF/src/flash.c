@@ -21,6 +21,7 @@
  */
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
@@ -30,6 +31,9 @@
 #include "flash.h"
 #include "flash_fields.h"
 #include "log.h"
+#include "sha256.h"
+
+#define FLASH_PAGES_PER_EB (BLADERF_FLASH_EB_SIZE / BLADERF_FLASH_PAGE_SIZE)
 
 static inline int check_eb_access(uint32_t erase_block, uint32_t count)
 {
@@ -100,8 +104,8 @@ int flash_write(struct bladerf *dev, const uint8_t *buf,
     return status;
 }
 
-static inline int verify_flash(struct bladerf *dev, uint8_t *readback_buf,
-                               uint8_t *image, uint32_t page, uint32_t count)
+static int verify_readback(struct bladerf *dev, uint8_t *readback_buf,
+                           const uint8_t *image, uint32_t page, uint32_t count)
 {
     int status = 0;
     size_t i;
@@ -128,6 +132,227 @@ static inline int verify_flash(struct bladerf *dev, uint8_t *readback_buf,
     return status;
 }
 
+/* Compare the SHA-256 of the image against one computed by the device.
+ * Returns 0 on a match, 1 on a mismatch, BLADERF_ERR_UNSUPPORTED if the
+ * device cannot compute a digest, and BLADERF_ERR_* on other failures. */
+static int verify_hash(struct bladerf *dev, const uint8_t *image,
+                       uint32_t page, uint32_t count)
+{
+    int status;
+    SHA256_CTX ctx;
+    uint8_t expected[SHA256_DIGEST_SIZE];
+    uint8_t actual[SHA256_DIGEST_SIZE];
+
+    if (count == 0) {
+        return 0;
+    } else if (dev->fn->flash_hash == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    status = dev->fn->flash_hash(dev, page, count, actual);
+    if (status != 0) {
+        return status;
+    }
+
+    SHA256_Init(&ctx);
+    SHA256_Update(&ctx, image, (size_t) count * BLADERF_FLASH_PAGE_SIZE);
+    SHA256_Final(expected, &ctx);
+
+    if (memcmp(expected, actual, SHA256_DIGEST_SIZE) != 0) {
+        log_debug("SHA-256 of %u pages at page %u does not match.\n",
+                  count, page);
+        return 1;
+    }
+
+    log_info("Verified %u pages, starting at page %u\n", count, page);
+    return 0;
+}
+
+/* Verify the specified pages, reading them back into readback_buf only if
+ * the device cannot compute a digest of them, or to locate a mismatch */
+static int verify_flash(struct bladerf *dev, uint8_t *readback_buf,
+                        const uint8_t *image, uint32_t page, uint32_t count)
+{
+    int status = verify_hash(dev, image, page, count);
+
+    if (status == 0) {
+        return 0;
+    } else if (status < 0 && status != BLADERF_ERR_UNSUPPORTED) {
+        log_debug("Failed to hash flash contents (%s); reading back "
+                  "instead.\n", bladerf_strerror(status));
+    }
+
+    return verify_readback(dev, readback_buf, image, page, count);
+}
+
+int flash_verify(struct bladerf *dev, const uint8_t *buf,
+                 uint32_t page, uint32_t count)
+{
+    int status;
+    uint8_t *readback_buf;
+
+    status = check_page_access(page, count);
+    if (status != 0) {
+        return status;
+    }
+
+    status = verify_hash(dev, buf, page, count);
+    if (status == 0) {
+        return 0;
+    } else if (status == 1) {
+        log_info("Flash verification failed: contents of %u pages at "
+                 "page %u differ.\n", count, page);
+        return BLADERF_ERR_UNEXPECTED;
+    } else if (status != BLADERF_ERR_UNSUPPORTED) {
+        log_debug("Failed to hash flash contents (%s); reading back "
+                  "instead.\n", bladerf_strerror(status));
+    }
+
+    readback_buf = malloc((size_t) count * BLADERF_FLASH_PAGE_SIZE);
+    if (readback_buf == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    status = verify_readback(dev, readback_buf, buf, page, count);
+    free(readback_buf);
+
+    return status;
+}
+
+/* Test whether an erase block read back from flash holds the data it should:
+ * the portion of the image at the block's offset, and erased (0xff) bytes
+ * past the end of the image. */
+static bool eb_matches(const uint8_t *readback, const uint8_t *image,
+                       size_t len, size_t offset)
+{
+    size_t i;
+
+    for (i = 0; i < BLADERF_FLASH_EB_SIZE; i++) {
+        const uint8_t expected = (offset + i) < len ? image[offset + i] : 0xff;
+        if (readback[i] != expected) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Erase, write, and verify the `count` erase blocks starting `first` blocks
+ * into a region beginning at erase block `eb` */
+static int program_ebs(struct bladerf *dev, uint8_t *readback_buf,
+                       const uint8_t *image, size_t len,
+                       uint32_t eb, uint32_t first, uint32_t count)
+{
+    int status;
+    const size_t offset = (size_t) first * BLADERF_FLASH_EB_SIZE;
+    const uint32_t page = (eb + first) * FLASH_PAGES_PER_EB;
+    size_t write_len = 0;
+
+    status = flash_erase(dev, eb + first, count);
+    if (status != 0) {
+        log_debug("Failed to erase blocks %u-%u: %s\n",
+                  eb + first, eb + first + count - 1,
+                  bladerf_strerror(status));
+        return status;
+    }
+
+    /* Blocks past the end of the image only need to be erased */
+    if (offset < len) {
+        write_len = len - offset;
+        if (write_len > (size_t) count * BLADERF_FLASH_EB_SIZE) {
+            write_len = (size_t) count * BLADERF_FLASH_EB_SIZE;
+        }
+    }
+
+    if (write_len == 0) {
+        return 0;
+    }
+
+    status = flash_write(dev, image + offset, page,
+                         (uint32_t) BLADERF_FLASH_TO_PAGES(write_len));
+    if (status != 0) {
+        log_debug("Failed to write pages: %s\n", bladerf_strerror(status));
+        return status;
+    }
+
+    return verify_flash(dev, readback_buf, image + offset, page,
+                        (uint32_t) BLADERF_FLASH_TO_PAGES(write_len));
+}
+
+/* Write a page-aligned image to the start of the `eb_count` erase block
+ * region beginning at erase block `eb`, leaving the remainder of the region
+ * erased. Only erase blocks whose contents differ are erased, written, and
+ * verified. */
+static int flash_write_delta(struct bladerf *dev, const uint8_t *image,
+                             size_t len, uint32_t eb, uint32_t eb_count)
+{
+    int status;
+    uint8_t *readback_buf;
+    bool changed[BLADERF_FLASH_NUM_EBS];
+    uint32_t i, run, num_changed;
+
+    status = check_eb_access(eb, eb_count);
+    if (status != 0) {
+        return status;
+    }
+
+    if (len > (size_t) eb_count * BLADERF_FLASH_EB_SIZE ||
+        (len % BLADERF_FLASH_PAGE_SIZE) != 0) {
+        log_debug("Image does not fit in the %u-block flash region\n",
+                  eb_count);
+        return BLADERF_ERR_INVAL;
+    }
+
+    readback_buf = (uint8_t *) malloc((size_t) eb_count * BLADERF_FLASH_EB_SIZE);
+    if (readback_buf == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    log_info("Comparing %u erase blocks, starting at block %u\n",
+             eb_count, eb);
+
+    num_changed = 0;
+    for (i = 0; i < eb_count; i++) {
+        uint8_t *eb_buf = readback_buf + (size_t) i * BLADERF_FLASH_EB_SIZE;
+
+        status = flash_read(dev, eb_buf, (eb + i) * FLASH_PAGES_PER_EB,
+                            FLASH_PAGES_PER_EB);
+        if (status != 0) {
+            log_debug("Failed to read erase block %u: %s\n",
+                      eb + i, bladerf_strerror(status));
+            goto out;
+        }
+
+        changed[i] = !eb_matches(eb_buf, image, len,
+                                 (size_t) i * BLADERF_FLASH_EB_SIZE);
+        if (changed[i]) {
+            num_changed++;
+        }
+    }
+
+    log_info("%u of %u erase blocks differ\n", num_changed, eb_count);
+
+    /* Program each run of consecutive changed blocks */
+    for (i = 0; i < eb_count; i += run) {
+        run = 1;
+
+        if (changed[i]) {
+            while ((i + run) < eb_count && changed[i + run]) {
+                run++;
+            }
+
+            status = program_ebs(dev, readback_buf, image, len, eb, i, run);
+            if (status != 0) {
+                goto out;
+            }
+        }
+    }
+
+out:
+    free(readback_buf);
+    return status;
+}
+
 int flash_write_fx3_fw(struct bladerf *dev, uint8_t **image, size_t len)
 {
     int status;
@@ -162,6 +387,13 @@ int flash_write_fx3_fw(struct bladerf *dev, uint8_t **image, size_t len)
     /* Clear the padded region */
     memset(padded_image + len, 0xFF, padded_image_len - len);
 
+    if (dev->flash_mode == BLADERF_FLASH_MODE_DELTA) {
+        status = flash_write_delta(dev, padded_image, padded_image_len,
+                                   BLADERF_FLASH_EB_FIRMWARE,
+                                   BLADERF_FLASH_EB_LEN_FIRMWARE);
+        goto error;
+    }
+
     /* Erase the entire firmware region */
     status = flash_erase(dev, BLADERF_FLASH_EB_FIRMWARE,
                          BLADERF_FLASH_EB_LEN_FIRMWARE);
@@ -213,6 +445,28 @@ static inline void fill_fpga_metadata_page(uint8_t *metadata,
                  &idx, "LEN", len_str);
 }
 
+/* Delta-write the metadata page, followed by the padded bitstream */
+static int flash_write_fpga_delta(struct bladerf *dev, const uint8_t *metadata,
+                                  const uint8_t *bitstream, size_t len)
+{
+    int status;
+    uint8_t *image = (uint8_t *) malloc(BLADERF_FLASH_PAGE_SIZE + len);
+
+    if (image == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    memcpy(image, metadata, BLADERF_FLASH_PAGE_SIZE);
+    memcpy(image + BLADERF_FLASH_PAGE_SIZE, bitstream, len);
+
+    status = flash_write_delta(dev, image, BLADERF_FLASH_PAGE_SIZE + len,
+                               BLADERF_FLASH_EB_FPGA,
+                               BLADERF_FLASH_EB_LEN_FPGA);
+
+    free(image);
+    return status;
+}
+
 int flash_write_fpga_bitstream(struct bladerf *dev,
                                uint8_t **bitstream, size_t len)
 {
@@ -252,6 +506,12 @@ int flash_write_fpga_bitstream(struct bladerf *dev,
     /* Clear the padded region */
     memset(padded_bitstream + len, 0xFF, padded_bitstream_len - len);
 
+    if (dev->flash_mode == BLADERF_FLASH_MODE_DELTA) {
+        status = flash_write_fpga_delta(dev, metadata, padded_bitstream,
+                                        padded_bitstream_len);
+        goto error;
+    }
+
     /* Erase FPGA metadata and bitstream region */
     status = flash_erase(dev, BLADERF_FLASH_EB_FPGA, BLADERF_FLASH_EB_LEN_FPGA);
     if (status != 0) {
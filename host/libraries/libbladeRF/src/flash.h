@@ -127,11 +127,30 @@ int flash_read(struct bladerf *dev, uint8_t *buf,
 int flash_write(struct bladerf *dev, const uint8_t *buf,
                 uint32_t page, uint32_t count);
 
+/**
+ * Verify flash contents, preferring a device-computed SHA-256 digest to
+ * reading back the data
+ *
+ * @param   dev   Device handle
+ * @param   buf   Expected flash contents
+ *
+ * @param   page  Page to begin verifying at
+ * @param   count Number of pages to verify
+ *
+ * @return 0 on a match, BLADERF_ERR_UNEXPECTED on a mismatch, or
+ *         BLADERF_ERR_* on other failures.
+ */
+int flash_verify(struct bladerf *dev, const uint8_t *buf,
+                 uint32_t page, uint32_t count);
+
 /**
  * Write the provided data to the FX3 Firmware region to flash.
  *
  * This function does no validation of the data (i.e., that it's valid FW).
  *
+ * In BLADERF_FLASH_MODE_DELTA, only the erase blocks whose contents differ
+ * are erased, written, and verified. See bladerf_set_flash_mode().
+ *
  * @param   dev             bladeRF handle
  * @param   image           Firmware image data. Buffer will be
  *                          realloc'd as needed to pad the image data.
@@ -145,6 +164,9 @@ int flash_write_fx3_fw(struct bladerf *dev, uint8_t **image, size_t len);
  * Write the provided FPGA bitstream to flash and enable autoloading via
  * writing the associated metadata.
  *
+ * In BLADERF_FLASH_MODE_DELTA, only the erase blocks whose contents differ
+ * are erased, written, and verified. See bladerf_set_flash_mode().
+ *
  * @param   dev             bladeRF handle
  * @param   bitstream       FPGA bitstream data. Buffer will be realloc'd as
  *                          needed to pad the image data.
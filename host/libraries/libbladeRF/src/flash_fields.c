@@ -144,19 +144,6 @@ int get_otp_field(struct bladerf *dev, char *field,
         return extract_field(otp, OTP_BUFFER_SIZE, field, data, data_size);
 }
 
-int get_cal_field(struct bladerf *dev, char *field,
-                  char *data, size_t data_size)
-{
-    int status;
-    char cal[CAL_BUFFER_SIZE];
-
-    status = dev->fn->get_cal(dev, cal);
-    if (status < 0)
-        return status;
-    else
-        return extract_field(cal, CAL_BUFFER_SIZE, field, data, data_size);
-}
-
 int read_serial(struct bladerf *dev, char *serial_buf)
 {
     int status;
@@ -176,14 +163,14 @@ int read_serial(struct bladerf *dev, char *serial_buf)
     return status;
 }
 
-int get_and_cache_vctcxo_trim(struct bladerf *dev)
+static int cache_vctcxo_trim(struct bladerf *dev, char *cal)
 {
     int status;
     bool ok;
     int16_t trim;
     char tmp[7] = { 0 };
 
-    status = get_cal_field(dev, "DAC", tmp, sizeof(tmp) - 1);
+    status = extract_field(cal, CAL_BUFFER_SIZE, "DAC", tmp, sizeof(tmp) - 1);
     if (!status) {
         trim = str2uint(tmp, 0, 0xffff, &ok);
     }
@@ -198,12 +185,12 @@ int get_and_cache_vctcxo_trim(struct bladerf *dev)
     return status;
 }
 
-int get_and_cache_fpga_size(struct bladerf *device)
+static int cache_fpga_size(struct bladerf *device, char *cal)
 {
     int status;
     char tmp[7] = { 0 };
 
-    status = get_cal_field(device, "B", tmp, sizeof(tmp) - 1);
+    status = extract_field(cal, CAL_BUFFER_SIZE, "B", tmp, sizeof(tmp) - 1);
 
     if (!strcmp("40", tmp)) {
         device->fpga_size = BLADERF_FPGA_40KLE;
@@ -215,3 +202,50 @@ int get_and_cache_fpga_size(struct bladerf *device)
 
     return status;
 }
+
+int get_and_cache_cal_fields(struct bladerf *dev)
+{
+    int status, trim_status, size_status;
+    char cal[CAL_BUFFER_SIZE];
+
+    dev->cal_fields_pending = false;
+
+    /* Both fields are read from a single copy of the cal region. If that
+     * can't be retrieved, they're extracted from a blank one to get their
+     * defaults. */
+    memset(cal, 0xff, CAL_BUFFER_SIZE);
+    status = dev->fn->get_cal(dev, cal);
+
+    trim_status = cache_vctcxo_trim(dev, cal);
+    size_status = cache_fpga_size(dev, cal);
+
+    if (status < 0) {
+        trim_status = status;
+        size_status = status;
+    }
+
+    /* VCTCXO trim and FPGA size are non-fatal indicators that we've
+     * trashed the calibration region of flash. If these were made fatal,
+     * we wouldn't be able to open the device to restore them. */
+    if (trim_status < 0) {
+        log_warning("Failed to get VCTCXO trim value: %s\n",
+                    bladerf_strerror(trim_status));
+    }
+
+    if (size_status < 0) {
+        log_warning("Failed to get FPGA size %s\n",
+                    bladerf_strerror(size_status));
+    }
+
+    return trim_status != 0 ? trim_status : size_status;
+}
+
+int load_deferred_cal_fields(struct bladerf *dev)
+{
+    if (!dev->cal_fields_pending) {
+        return 0;
+    }
+
+    log_verbose("Loading deferred calibration fields.\n");
+    return get_and_cache_cal_fields(dev);
+}
@@ -51,25 +51,30 @@ int get_otp_field(struct bladerf *device, char *field,
 int read_serial(struct bladerf *device, char *serial_buf);
 
 /**
- * Retrieve VCTCXO calibration value from flash and cache it in the
- * provided device structure
+ * Retrieve the VCTCXO calibration value and FPGA size variant from flash
+ * and cache them in the provided device structure. Both are read with a
+ * single access to the calibration region.
  *
- * @param[inout]   dev      Device handle. On success, trim field is updated
+ * Failures are logged as warnings. Fields that cannot be retrieved are set
+ * to defaults: a trim of 0x8000 and BLADERF_FPGA_UNKNOWN.
+ *
+ * @param[inout]   dev      Device handle. The dac_trim and fpga_size fields
+ *                          are updated.
  *
  * 0 on success, BLADERF_ERR_* on failure
  */
-int get_and_cache_vctcxo_trim(struct bladerf *device);
+int get_and_cache_cal_fields(struct bladerf *device);
 
 /**
- * Retrieve FPGA size variant from flash and cache it in the provided
- * device structure
+ * Perform get_and_cache_cal_fields() if it was deferred by a lazy open.
+ * This must be called before accessing the device's dac_trim or fpga_size
+ * fields.
  *
- * @param[inout]   dev      Device handle.
- *                          On success, fpga_size field  is updated
+ * @param[inout]   dev      Device handle
  *
  * 0 on success, BLADERF_ERR_* on failure
  */
-int get_and_cache_fpga_size(struct bladerf *device);
+int load_deferred_cal_fields(struct bladerf *device);
 
 /**
  * Create data that can be read by extract_field()
@@ -18,12 +18,77 @@
  * License along with this library; if not, write to the Free Software
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include "bladerf_priv.h"
 #include "fpga.h"
 #include "version_compat.h"
 #include "file_ops.h"
 #include "log.h"
 #include "flash.h"
+#include "sha256.h"
+
+/* Bitstreams are sent to the device in chunks of this size while the rest of
+ * the file is still being read. This is a multiple of the USB bulk max
+ * packet size, so only the final chunk may end in a short packet. */
+#define FPGA_CHUNK_SIZE (256 * 1024)
+
+/* Number of bitstreams retained by the process-wide bitstream cache. One
+ * per FPGA size is enough for the common case of repeatedly (re)opening
+ * devices with the same hosted bitstream. */
+#define FPGA_CACHE_ENTRIES 2
+
+/* Identity and version of a bitstream file. Bitstreams for a given FPGA size
+ * are all the same size, and a file may be replaced within a second, or
+ * copied with its modification time preserved. The file's device and inode,
+ * and the nanosecond modification and status change times, are therefore
+ * compared as well. Replacing or copying a file updates its status change
+ * time, which cannot be set by the user. */
+struct fpga_file_id {
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    time_t mtime, ctime;
+    long mtime_ns, ctime_ns;
+};
+
+/* A bitstream previously loaded in this process. Entries are identified by
+ * the SHA-256 digest of their contents; the path and fpga_file_id of the file
+ * they were last read from allow a later load of an unchanged file to skip
+ * reading it. */
+struct fpga_cache_entry {
+    char *path;
+    struct fpga_file_id id;
+
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    uint8_t *data;
+    size_t len;
+
+    unsigned int refs;      /* Loads currently using data */
+    uint64_t last_used;
+};
+
+static struct fpga_cache_entry fpga_cache[FPGA_CACHE_ENTRIES];
+static uint64_t fpga_cache_clock;
+static MUTEX fpga_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* State shared with the thread reading a bitstream from disk */
+struct fpga_reader {
+    FILE *f;
+    uint8_t *buf;
+    size_t len;
+
+    MUTEX lock;
+    pthread_cond_t avail_cond;
+    size_t avail;           /* Bytes read into buf so far */
+    int status;
+    bool abort;
+
+    SHA256_CTX sha;
+};
 
 int fpga_check_version(struct bladerf *dev)
 {
@@ -81,45 +146,346 @@ static inline bool valid_fpga_size(size_t len)
     }
 }
 
+static void fpga_file_id_init(struct fpga_file_id *id, const struct stat *st)
+{
+    memset(id, 0, sizeof(*id));
+    id->dev = st->st_dev;
+    id->ino = st->st_ino;
+    id->size = st->st_size;
+    id->mtime = st->st_mtime;
+    id->ctime = st->st_ctime;
+
+#if defined(__APPLE__)
+    id->mtime_ns = st->st_mtimespec.tv_nsec;
+    id->ctime_ns = st->st_ctimespec.tv_nsec;
+#elif !defined(WIN32) && !defined(__CYGWIN__)
+    id->mtime_ns = st->st_mtim.tv_nsec;
+    id->ctime_ns = st->st_ctim.tv_nsec;
+#endif
+}
+
+static inline bool fpga_file_id_equal(const struct fpga_file_id *a,
+                                      const struct fpga_file_id *b)
+{
+    return a->dev == b->dev && a->ino == b->ino && a->size == b->size &&
+           a->mtime == b->mtime && a->mtime_ns == b->mtime_ns &&
+           a->ctime == b->ctime && a->ctime_ns == b->ctime_ns;
+}
+
+static void fpga_cache_entry_free(struct fpga_cache_entry *e)
+{
+    free(e->path);
+    free(e->data);
+    memset(e, 0, sizeof(*e));
+}
+
+/* Find an entry loaded from an unchanged copy of the specified file. On
+ * success, the entry is referenced and must be released via
+ * fpga_cache_release(). */
+static struct fpga_cache_entry *fpga_cache_acquire(const char *path,
+                                                   const struct stat *st)
+{
+    struct fpga_cache_entry *ret = NULL;
+    struct fpga_file_id id;
+    size_t i;
+
+    fpga_file_id_init(&id, st);
+
+    MUTEX_LOCK(&fpga_cache_lock);
+
+    for (i = 0; i < FPGA_CACHE_ENTRIES && ret == NULL; i++) {
+        struct fpga_cache_entry *e = &fpga_cache[i];
+
+        if (e->data != NULL && !strcmp(e->path, path) &&
+            fpga_file_id_equal(&e->id, &id)) {
+            e->refs++;
+            e->last_used = ++fpga_cache_clock;
+            ret = e;
+        }
+    }
+
+    MUTEX_UNLOCK(&fpga_cache_lock);
+    return ret;
+}
+
+static void fpga_cache_release(struct fpga_cache_entry *e)
+{
+    MUTEX_LOCK(&fpga_cache_lock);
+    assert(e->refs > 0);
+    e->refs--;
+    MUTEX_UNLOCK(&fpga_cache_lock);
+}
+
+/* Add a bitstream read from the specified file to the cache. This takes
+ * ownership of data, which is freed if the contents are already cached or
+ * there is no room for them. */
+static void fpga_cache_insert(const char *path, const struct stat *st,
+                              const uint8_t *digest,
+                              uint8_t *data, size_t len)
+{
+    struct fpga_cache_entry *e = NULL;
+    char *path_copy;
+    size_t i;
+
+    path_copy = strdup(path);
+    if (path_copy == NULL) {
+        free(data);
+        return;
+    }
+
+    MUTEX_LOCK(&fpga_cache_lock);
+
+    /* The same bitstream may have been read from another file, or from an
+     * earlier copy of this one. Keep the existing data, but look it up via
+     * this file from now on. */
+    for (i = 0; i < FPGA_CACHE_ENTRIES && e == NULL; i++) {
+        if (fpga_cache[i].data != NULL && fpga_cache[i].len == len &&
+            !memcmp(fpga_cache[i].digest, digest, SHA256_DIGEST_SIZE)) {
+            e = &fpga_cache[i];
+        }
+    }
+
+    if (e != NULL) {
+        free(e->path);
+        free(data);
+    } else {
+        /* Replace a stale entry for this file, if there is one. Otherwise use
+         * a free slot, or evict the least recently used idle entry. */
+        for (i = 0; i < FPGA_CACHE_ENTRIES; i++) {
+            struct fpga_cache_entry *c = &fpga_cache[i];
+
+            if (c->refs != 0) {
+                continue;
+            }
+
+            if (c->data != NULL && !strcmp(c->path, path)) {
+                e = c;
+                break;
+            } else if (e == NULL || (e->data != NULL &&
+                       (c->data == NULL || c->last_used < e->last_used))) {
+                e = c;
+            }
+        }
+
+        if (e == NULL) {
+            MUTEX_UNLOCK(&fpga_cache_lock);
+            log_verbose("FPGA bitstream cache is busy; not caching %s\n",
+                        path);
+            free(path_copy);
+            free(data);
+            return;
+        }
+
+        fpga_cache_entry_free(e);
+        memcpy(e->digest, digest, SHA256_DIGEST_SIZE);
+        e->data = data;
+        e->len = len;
+    }
+
+    e->path = path_copy;
+    fpga_file_id_init(&e->id, st);
+    e->last_used = ++fpga_cache_clock;
+
+    MUTEX_UNLOCK(&fpga_cache_lock);
+}
+
+void fpga_cache_free(void)
+{
+    size_t i;
+
+    MUTEX_LOCK(&fpga_cache_lock);
+
+    for (i = 0; i < FPGA_CACHE_ENTRIES; i++) {
+        assert(fpga_cache[i].refs == 0);
+        fpga_cache_entry_free(&fpga_cache[i]);
+    }
+
+    MUTEX_UNLOCK(&fpga_cache_lock);
+}
+
+/* Read a bitstream into r->buf, a chunk at a time, publishing progress via
+ * r->avail so that chunks may be sent to the device as soon as they are
+ * available. The digest of the contents is computed along the way. */
+static void *fpga_reader_task(void *arg)
+{
+    struct fpga_reader *r = (struct fpga_reader *) arg;
+    size_t offset = 0;
+    size_t to_read;
+    int status = 0;
+    bool done = false;
+
+    while (!done) {
+        to_read = r->len - offset;
+        if (to_read > FPGA_CHUNK_SIZE) {
+            to_read = FPGA_CHUNK_SIZE;
+        }
+
+        status = file_read(r->f, (char *) r->buf + offset, to_read);
+        if (status == 0) {
+            SHA256_Update(&r->sha, r->buf + offset, to_read);
+            offset += to_read;
+        }
+
+        MUTEX_LOCK(&r->lock);
+        r->avail = offset;
+        r->status = status;
+        done = r->abort || status != 0 || offset == r->len;
+        pthread_cond_signal(&r->avail_cond);
+        MUTEX_UNLOCK(&r->lock);
+    }
+
+    return NULL;
+}
+
+/* Send the bitstream to the device as the reader thread makes it available */
+static int fpga_stream_to_device(struct bladerf *dev, struct fpga_reader *r)
+{
+    size_t sent = 0;
+    size_t avail;
+    int status;
+
+    status = dev->fn->load_fpga_begin(dev, r->len);
+
+    while (status == 0 && sent < r->len) {
+        MUTEX_LOCK(&r->lock);
+        while (r->avail == sent && r->status == 0) {
+            pthread_cond_wait(&r->avail_cond, &r->lock);
+        }
+        avail = r->avail;
+        status = r->status;
+        MUTEX_UNLOCK(&r->lock);
+
+        if (status == 0) {
+            status = dev->fn->load_fpga_write(dev, r->buf + sent,
+                                              avail - sent);
+            sent = avail;
+        }
+    }
+
+    if (status != 0) {
+        MUTEX_LOCK(&r->lock);
+        r->abort = true;
+        MUTEX_UNLOCK(&r->lock);
+        return status;
+    }
+
+    return dev->fn->load_fpga_end(dev);
+}
+
+/* Read the bitstream from disk and load it, overlapping the file read with
+ * the transfer to the device when the backend supports chunked loading. The
+ * bitstream is added to the cache on success. */
+static int fpga_load_from_disk(struct bladerf *dev, const char *fpga_file,
+                               const struct stat *st)
+{
+    struct fpga_reader r;
+    pthread_t reader_thread;
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    bool streaming;
+    int status;
+
+    memset(&r, 0, sizeof(r));
+    r.len = (size_t) st->st_size;
+
+    r.f = fopen(fpga_file, "rb");
+    if (r.f == NULL) {
+        return errno == ENOENT ? BLADERF_ERR_NO_FILE : BLADERF_ERR_IO;
+    }
+
+    r.buf = (uint8_t *) malloc(r.len);
+    if (r.buf == NULL) {
+        fclose(r.f);
+        return BLADERF_ERR_MEM;
+    }
+
+    MUTEX_INIT(&r.lock);
+    pthread_cond_init(&r.avail_cond, NULL);
+    SHA256_Init(&r.sha);
+
+    streaming = dev->fn->load_fpga_begin != NULL &&
+                dev->fn->load_fpga_write != NULL &&
+                dev->fn->load_fpga_end != NULL;
+
+    if (streaming &&
+        pthread_create(&reader_thread, NULL, fpga_reader_task, &r) == 0) {
+
+        status = fpga_stream_to_device(dev, &r);
+        pthread_join(reader_thread, NULL);
+    } else {
+        fpga_reader_task(&r);
+
+        status = r.status;
+        if (status == 0) {
+            status = dev->fn->load_fpga(dev, r.buf, r.len);
+        }
+    }
+
+    fclose(r.f);
+    pthread_cond_destroy(&r.avail_cond);
+    pthread_mutex_destroy(&r.lock);
+
+    if (status == 0) {
+        SHA256_Final(digest, &r.sha);
+
+#if LOGGING_ENABLED
+        {
+            char digest_str[2 * SHA256_DIGEST_SIZE + 1];
+            size_t i;
+
+            for (i = 0; i < SHA256_DIGEST_SIZE; i++) {
+                sprintf(&digest_str[2 * i], "%02x", digest[i]);
+            }
+
+            log_verbose("Loaded FPGA bitstream %s (SHA-256 %s)\n",
+                        fpga_file, digest_str);
+        }
+#endif
+
+        fpga_cache_insert(fpga_file, st, digest, r.buf, r.len);
+    } else {
+        free(r.buf);
+    }
+
+    return status;
+}
+
 int fpga_load_from_file(struct bladerf *dev, const char *fpga_file)
 {
-    uint8_t *buf = NULL;
-    size_t  buf_size;
+    struct fpga_cache_entry *cached;
+    struct stat st;
     int status;
 
     /* TODO sanity check FPGA:
      *  - Check for x40 vs x115 and verify FPGA image size
      *  - Known header/footer on images?
-     *  - Checksum/hash?
      */
-    status = file_read_buffer(fpga_file, &buf, &buf_size);
-    if (status != 0) {
-        goto error;
+    if (stat(fpga_file, &st) != 0) {
+        return errno == ENOENT ? BLADERF_ERR_NO_FILE : BLADERF_ERR_IO;
     }
 
-    if (!valid_fpga_size(buf_size)) {
-        status = BLADERF_ERR_INVAL;
-        goto error;
+    if (!valid_fpga_size((size_t) st.st_size)) {
+        return BLADERF_ERR_INVAL;
     }
 
-    status = dev->fn->load_fpga(dev, buf, buf_size);
-    if (status != 0) {
-        goto error;
+    cached = fpga_cache_acquire(fpga_file, &st);
+    if (cached != NULL) {
+        log_debug("Using cached FPGA bitstream for %s\n", fpga_file);
+        status = dev->fn->load_fpga(dev, cached->data, cached->len);
+        fpga_cache_release(cached);
+    } else {
+        status = fpga_load_from_disk(dev, fpga_file, &st);
     }
 
-    status = fpga_check_version(dev);
     if (status != 0) {
-        goto error;
+        return status;
     }
 
-    status = init_device(dev);
+    status = fpga_check_version(dev);
     if (status != 0) {
-        goto error;
+        return status;
     }
 
-error:
-    free(buf);
-    return status;
+    return init_device(dev);
 }
 
 int fpga_write_to_flash(struct bladerf *dev, const char *fpga_file)
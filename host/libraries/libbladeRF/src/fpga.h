@@ -43,6 +43,10 @@ int fpga_check_version(struct bladerf *dev);
 /**
  * Load an FPGA bitstream from the specified RBF
  *
+ * Bitstreams are kept in a process-wide cache, keyed by their SHA-256 digest,
+ * so that loading an unchanged file again does not re-read it. Otherwise, the
+ * file is streamed to the device as it is read, if the backend supports it.
+ *
  * @param   dev         Device handle
  * @param   fpga_file   Path to an RBF file
  *
@@ -65,4 +69,9 @@ int fpga_load_from_file(struct bladerf *dev, const char *fpga_file);
  */
 int fpga_write_to_flash(struct bladerf *dev, const char *fpga_file);
 
+/**
+ * Free all bitstreams held in the process-wide FPGA bitstream cache
+ */
+void fpga_cache_free(void);
+
 #endif
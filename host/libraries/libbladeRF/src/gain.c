@@ -18,107 +18,341 @@
  * License along with this library; if not, write to the Free Software
  */
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "gain.h"
 #include "lms.h"
+#include "bladerf_priv.h"
+#include "log.h"
 
-static inline int set_rx_gain_combo(struct bladerf *dev,
-                                     bladerf_lna_gain lnagain,
-                                     int rxvga1, int rxvga2)
+/* Decompose an RX gain into LNA, RXVGA1, and RXVGA2 gains */
+static void rx_gain_stages(int gain, bladerf_lna_gain *lna,
+                           int *rxvga1, int *rxvga2)
 {
-    int status;
-    status = lms_lna_set_gain(dev, lnagain);
-    if (status < 0) {
-        return status;
+    if (gain <= BLADERF_LNA_GAIN_MID_DB) {
+        *lna = BLADERF_LNA_GAIN_BYPASS;
+        *rxvga1 = BLADERF_RXVGA1_GAIN_MIN;
+        *rxvga2 = BLADERF_RXVGA2_GAIN_MIN;
+    } else if (gain <= BLADERF_LNA_GAIN_MID_DB + BLADERF_RXVGA1_GAIN_MIN) {
+        *lna = BLADERF_LNA_GAIN_MID;
+        *rxvga1 = BLADERF_RXVGA1_GAIN_MIN;
+        *rxvga2 = BLADERF_RXVGA2_GAIN_MIN;
+    } else if (gain <= (BLADERF_LNA_GAIN_MAX_DB + BLADERF_RXVGA1_GAIN_MAX)) {
+        *lna = BLADERF_LNA_GAIN_MID;
+        *rxvga1 = gain - BLADERF_LNA_GAIN_MID_DB;
+        *rxvga2 = BLADERF_RXVGA2_GAIN_MIN;
+    } else if (gain < (BLADERF_LNA_GAIN_MAX_DB + BLADERF_RXVGA1_GAIN_MAX + BLADERF_RXVGA2_GAIN_MAX)) {
+        *lna = BLADERF_LNA_GAIN_MAX;
+        *rxvga1 = BLADERF_RXVGA1_GAIN_MAX;
+        *rxvga2 = gain - (BLADERF_LNA_GAIN_MAX_DB + BLADERF_RXVGA1_GAIN_MAX);
+    } else {
+        *lna = BLADERF_LNA_GAIN_MAX;
+        *rxvga1 = BLADERF_RXVGA1_GAIN_MAX;
+        *rxvga2 = BLADERF_RXVGA2_GAIN_MAX;
     }
+}
 
-    status = lms_rxvga1_set_gain(dev, rxvga1);
-    if (status < 0) {
-        return status;
+/* Decompose a TX gain into TXVGA1 and TXVGA2 gains */
+static void tx_gain_stages(int gain, int *txvga1, int *txvga2)
+{
+    if (gain < 0) {
+        gain = 0;
     }
 
-    return lms_rxvga2_set_gain(dev, rxvga2);
+    if (gain <= BLADERF_TXVGA2_GAIN_MAX) {
+        *txvga1 = BLADERF_TXVGA1_GAIN_MIN;
+        *txvga2 = gain;
+    } else if (gain <= GAIN_TX_MAX) {
+        *txvga1 = BLADERF_TXVGA1_GAIN_MIN + gain - BLADERF_TXVGA2_GAIN_MAX;
+        *txvga2 = BLADERF_TXVGA2_GAIN_MAX;
+    } else {
+        *txvga1 = BLADERF_TXVGA1_GAIN_MAX;
+        *txvga2 = BLADERF_TXVGA2_GAIN_MAX;
+    }
 }
 
-static int set_rx_gain(struct bladerf *dev, int gain)
+static void build_tbl(struct gain_state *g, bladerf_module module)
 {
-    if (gain <= BLADERF_LNA_GAIN_MID_DB) {
-        return set_rx_gain_combo(dev,
-                                 BLADERF_LNA_GAIN_BYPASS,
-                                 BLADERF_RXVGA1_GAIN_MIN,
-                                 BLADERF_RXVGA2_GAIN_MIN);
-    } else if (gain <= BLADERF_LNA_GAIN_MID_DB + BLADERF_RXVGA1_GAIN_MIN) {
-        return set_rx_gain_combo(dev,
-                                 BLADERF_LNA_GAIN_MID_DB,
-                                 BLADERF_RXVGA1_GAIN_MIN,
-                                 BLADERF_RXVGA2_GAIN_MIN);
-    } else if (gain <= (BLADERF_LNA_GAIN_MAX_DB + BLADERF_RXVGA1_GAIN_MAX)) {
-        return set_rx_gain_combo(dev,
-                                 BLADERF_LNA_GAIN_MID,
-                                 gain - BLADERF_LNA_GAIN_MID_DB,
-                                 BLADERF_RXVGA2_GAIN_MIN);
-    } else if (gain < (BLADERF_LNA_GAIN_MAX_DB + BLADERF_RXVGA1_GAIN_MAX + BLADERF_RXVGA2_GAIN_MAX)) {
-        return set_rx_gain_combo(dev,
-                BLADERF_LNA_GAIN_MAX,
-                BLADERF_RXVGA1_GAIN_MAX,
-                gain - (BLADERF_LNA_GAIN_MAX_DB + BLADERF_RXVGA1_GAIN_MAX));
+    int gain;
+    struct gain_tbl_entry *e;
+    bladerf_lna_gain lna;
+    int vga1, vga2;
+
+    if (module == BLADERF_MODULE_RX) {
+        g->min = GAIN_RX_MIN;
+        g->max = GAIN_RX_MAX;
+        g->num_regs = 3;
+
+        for (gain = g->min; gain <= g->max; gain++) {
+            e = &g->tbl[gain - g->min];
+            rx_gain_stages(gain, &lna, &vga1, &vga2);
+            lms_lna_gain_image(lna, &e->regs[0]);
+            lms_rxvga1_gain_image(vga1, &e->regs[1]);
+            lms_rxvga2_gain_image(vga2, &e->regs[2]);
+        }
     } else {
-        return set_rx_gain_combo(dev,
-                                 BLADERF_LNA_GAIN_MAX,
-                                 BLADERF_RXVGA1_GAIN_MAX,
-                                 BLADERF_RXVGA2_GAIN_MAX);
+        g->min = GAIN_TX_MIN;
+        g->max = GAIN_TX_MAX;
+        g->num_regs = 2;
+
+        for (gain = g->min; gain <= g->max; gain++) {
+            e = &g->tbl[gain - g->min];
+            tx_gain_stages(gain, &vga1, &vga2);
+            lms_txvga1_gain_image(vga1, &e->regs[0]);
+            lms_txvga2_gain_image(vga2, &e->regs[1]);
+        }
     }
 }
 
-static inline int set_tx_gain_combo(struct bladerf *dev, int txvga1, int txvga2)
+int gain_init(struct bladerf *dev)
 {
-    int status;
+    unsigned int i;
+    const bladerf_module modules[NUM_MODULES] = {
+        BLADERF_MODULE_RX, BLADERF_MODULE_TX
+    };
+
+    for (i = 0; i < NUM_MODULES; i++) {
+        struct gain_state *g = calloc(1, sizeof(*g));
+        if (g == NULL) {
+            return BLADERF_ERR_MEM;
+        }
 
-    status = lms_txvga1_set_gain(dev, txvga1);
-    if (status == 0) {
-        status = lms_txvga2_set_gain(dev, txvga2);
+        build_tbl(g, modules[i]);
+        dev->gain[modules[i]] = g;
     }
 
-    return status;
+    return 0;
 }
 
-static int set_tx_gain(struct bladerf *dev, int gain)
+void gain_deinit(struct bladerf *dev)
 {
-    int status;
-    const int max_gain =
-        (BLADERF_TXVGA1_GAIN_MAX - BLADERF_TXVGA1_GAIN_MIN)
-            + BLADERF_TXVGA2_GAIN_MAX;
+    unsigned int i;
 
-    if (gain < 0) {
-        gain = 0;
+    for (i = 0; i < NUM_MODULES; i++) {
+        if (dev->gain[i] != NULL) {
+            free(dev->gain[i]->offsets);
+            free(dev->gain[i]);
+            dev->gain[i] = NULL;
+        }
     }
+}
 
-    if (gain <= BLADERF_TXVGA2_GAIN_MAX) {
-        status = set_tx_gain_combo(dev, BLADERF_TXVGA1_GAIN_MIN, gain);
-    } else if (gain <= max_gain) {
-        status = set_tx_gain_combo(dev,
-                    BLADERF_TXVGA1_GAIN_MIN + gain - BLADERF_TXVGA2_GAIN_MAX,
-                    BLADERF_TXVGA2_GAIN_MAX);
-    } else {
-        status = set_tx_gain_combo(dev,
-                                   BLADERF_TXVGA1_GAIN_MAX,
-                                   BLADERF_TXVGA2_GAIN_MAX);
+static inline struct gain_state *get_state(struct bladerf *dev,
+                                           bladerf_module module)
+{
+    if (module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) {
+        return NULL;
+    }
+
+    return dev->gain[module];
+}
+
+/* Offset that applies at the specified frequency */
+static int offset_at(const struct gain_state *g, unsigned int frequency)
+{
+    unsigned int i;
+
+    for (i = 0; i < g->num_offsets; i++) {
+        if (frequency >= g->offsets[i].freq_min &&
+            frequency <= g->offsets[i].freq_max) {
+            return g->offsets[i].offset;
+        }
+    }
+
+    return 0;
+}
+
+static void get_images(const struct gain_state *g, bladerf_module module,
+                       int gain, int offset,
+                       const struct lms_reg_image **img, unsigned int *n,
+                       int *actual)
+{
+    int idx;
+
+    idx = gain - offset;
+    if (idx < g->min) {
+        idx = g->min;
+    } else if (idx > g->max) {
+        idx = g->max;
+    }
+
+    log_verbose("Setting %s gain to %d dB (table entry %d)\n",
+                module == BLADERF_MODULE_RX ? "RX" : "TX", gain, idx);
+
+    *img = g->tbl[idx - g->min].regs;
+    *n = g->num_regs;
+
+    if (actual != NULL) {
+        *actual = idx + offset;
+    }
+}
+
+int gain_get_images(struct bladerf *dev, bladerf_module module, int gain,
+                    const struct lms_reg_image **img, unsigned int *n,
+                    int *actual)
+{
+    struct gain_state *g = get_state(dev, module);
+
+    if (g == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    get_images(g, module, gain, g->offset, img, n, actual);
+    return 0;
+}
+
+int gain_get_images_at(struct bladerf *dev, bladerf_module module, int gain,
+                       unsigned int frequency,
+                       const struct lms_reg_image **img, unsigned int *n,
+                       int *actual)
+{
+    struct gain_state *g = get_state(dev, module);
+
+    if (g == NULL) {
+        return BLADERF_ERR_INVAL;
     }
 
-    return status;
+    get_images(g, module, gain, offset_at(g, frequency), img, n, actual);
+    return 0;
 }
 
 int gain_set(struct bladerf *dev, bladerf_module module, int gain)
 {
+    const struct lms_reg_image *img;
+    unsigned int n;
     int status;
 
-    if (module == BLADERF_MODULE_TX) {
-        status = set_tx_gain(dev, gain);
-    } else if (module == BLADERF_MODULE_RX) {
-        status = set_rx_gain(dev, gain);
+    status = gain_get_images(dev, module, gain, &img, &n, NULL);
+    if (status != 0) {
+        return status;
+    }
+
+    return lms_write_images(dev, img, n);
+}
+
+int gain_set_offsets(struct bladerf *dev, bladerf_module module,
+                     const struct bladerf_gain_offset *offsets,
+                     unsigned int count)
+{
+    struct gain_state *g = get_state(dev, module);
+    struct bladerf_gain_offset *copy = NULL;
+
+    if (g == NULL || (offsets == NULL && count != 0)) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (offsets != NULL && count != 0) {
+        copy = malloc(count * sizeof(copy[0]));
+        if (copy == NULL) {
+            return BLADERF_ERR_MEM;
+        }
+
+        memcpy(copy, offsets, count * sizeof(copy[0]));
     } else {
-        status = BLADERF_ERR_INVAL;
+        count = 0;
     }
 
-    return status;
+    free(g->offsets);
+    g->offsets = copy;
+    g->num_offsets = count;
+    g->offset = 0;
+
+    return 0;
+}
+
+void gain_update_offset(struct bladerf *dev, bladerf_module module,
+                        unsigned int frequency)
+{
+    struct gain_state *g = get_state(dev, module);
+
+    if (g == NULL) {
+        return;
+    }
+
+    g->offset = offset_at(g, frequency);
+
+    if (g->num_offsets != 0) {
+        log_verbose("Using %s gain offset of %d dB at %u Hz\n",
+                    module == BLADERF_MODULE_RX ? "RX" : "TX",
+                    g->offset, frequency);
+    }
 }
 
+int gain_sched_add(struct bladerf *dev, bladerf_module module,
+                   uint64_t timestamp, int gain)
+{
+    struct gain_state *g = get_state(dev, module);
+    unsigned int i;
+
+    if (g == NULL) {
+        return BLADERF_ERR_INVAL;
+    } else if (g->num_sched >= GAIN_SCHED_LEN) {
+        return BLADERF_ERR_MEM;
+    }
+
+    /* Insert after any entries with the same or an earlier timestamp */
+    for (i = g->num_sched; i > 0 && g->sched[i - 1].timestamp > timestamp; i--) {
+        g->sched[i] = g->sched[i - 1];
+    }
+
+    g->sched[i].timestamp = timestamp;
+    g->sched[i].gain = gain;
+    g->num_sched++;
+
+    return 0;
+}
+
+void gain_sched_clear(struct bladerf *dev, bladerf_module module)
+{
+    struct gain_state *g = get_state(dev, module);
+
+    if (g != NULL) {
+        g->num_sched = 0;
+    }
+}
+
+uint64_t gain_sched_next(struct bladerf *dev, bladerf_module module)
+{
+    struct gain_state *g = get_state(dev, module);
+
+    if (g == NULL || g->num_sched == 0) {
+        return UINT64_MAX;
+    }
+
+    return g->sched[0].timestamp;
+}
+
+int gain_sched_service(struct bladerf *dev, bladerf_module module,
+                       uint64_t timestamp)
+{
+    struct gain_state *g = get_state(dev, module);
+    unsigned int due;
+    int gain;
+
+    if (g == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    for (due = 0; due < g->num_sched; due++) {
+        if (g->sched[due].timestamp > timestamp) {
+            break;
+        }
+    }
+
+    if (due == 0) {
+        return 0;
+    }
+
+    gain = g->sched[due - 1].gain;
+
+    log_verbose("Applying %s gain of %d dB scheduled for %llu at %llu\n",
+                module == BLADERF_MODULE_RX ? "RX" : "TX", gain,
+                (unsigned long long) g->sched[due - 1].timestamp,
+                (unsigned long long) timestamp);
+
+    g->num_sched -= due;
+    memmove(&g->sched[0], &g->sched[due], g->num_sched * sizeof(g->sched[0]));
+
+    return gain_set(dev, module, gain);
+}
@@ -25,7 +25,70 @@
 #ifndef BLADERF_GAIN_H_
 #define BLADERF_GAIN_H_
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "libbladeRF.h"
+#include "lms.h"
+
+/* Range of the gain tables, in dB. Requests outside of it are clamped. */
+#define GAIN_RX_MIN     0
+#define GAIN_RX_MAX     (BLADERF_LNA_GAIN_MAX_DB + BLADERF_RXVGA1_GAIN_MAX + \
+                         BLADERF_RXVGA2_GAIN_MAX)
+
+#define GAIN_TX_MIN     0
+#define GAIN_TX_MAX     ((BLADERF_TXVGA1_GAIN_MAX - BLADERF_TXVGA1_GAIN_MIN) + \
+                         BLADERF_TXVGA2_GAIN_MAX)
+
+#define GAIN_TBL_LEN    (GAIN_RX_MAX - GAIN_RX_MIN + 1)
+
+/* Register images per table entry: LNA, RXVGA1, RXVGA2 or TXVGA1, TXVGA2 */
+#define GAIN_TBL_MAX_REGS   3
+
+/* Maximum number of pending scheduled gain changes, per module */
+#define GAIN_SCHED_LEN  16
+
+/* Register images that realize a system gain */
+struct gain_tbl_entry {
+    struct lms_reg_image regs[GAIN_TBL_MAX_REGS];
+};
+
+struct gain_sched_entry {
+    uint64_t timestamp;
+    int gain;
+};
+
+/* Per-module gain table and state */
+struct gain_state {
+    struct gain_tbl_entry tbl[GAIN_TBL_LEN];
+    int min;                        /* Gain of tbl[0] */
+    int max;                        /* Gain of the last valid entry */
+    unsigned int num_regs;          /* Images per entry */
+
+    struct bladerf_gain_offset *offsets;
+    unsigned int num_offsets;
+    int offset;                     /* Offset at the current frequency */
+
+    /* Pending scheduled changes, sorted by timestamp */
+    struct gain_sched_entry sched[GAIN_SCHED_LEN];
+    unsigned int num_sched;
+};
+
+/**
+ * Allocate and precompute the RX and TX gain tables. This performs no
+ * device I/O.
+ *
+ * @param   dev     Device handle
+ *
+ * @return 0 on success, BLADERF_ERR_MEM on failure
+ */
+int gain_init(struct bladerf *dev);
+
+/**
+ * Free the gain tables and offsets
+ *
+ * @param   dev     Device handle
+ */
+void gain_deinit(struct bladerf *dev);
 
 /**
  * Set system gain for the specified module
@@ -38,6 +101,110 @@
  */
 int gain_set(struct bladerf *dev, bladerf_module module, int gain);
 
+/**
+ * Look up the register images that select the specified gain, without
+ * applying them
+ *
+ * @param[in]   dev     Device handle
+ * @param[in]   module  Module to configure
+ * @param[in]   gain    Desired gain
+ * @param[out]  img     Set to the table's register images
+ * @param[out]  n       Set to the number of images
+ * @param[out]  actual  If non-NULL, set to the gain the images select,
+ *                      after clamping to the supported range
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int gain_get_images(struct bladerf *dev, bladerf_module module, int gain,
+                    const struct lms_reg_image **img, unsigned int *n,
+                    int *actual);
+
+/**
+ * As gain_get_images(), but using the gain offset that applies at the
+ * specified frequency rather than the one currently in use. This does not
+ * change the offset in use; see gain_update_offset().
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   module      Module to configure
+ * @param[in]   gain        Desired gain
+ * @param[in]   frequency   Frequency the gain is specified at, in Hz
+ * @param[out]  img         Set to the table's register images
+ * @param[out]  n           Set to the number of images
+ * @param[out]  actual      If non-NULL, set to the gain the images select,
+ *                          after clamping to the supported range
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int gain_get_images_at(struct bladerf *dev, bladerf_module module, int gain,
+                       unsigned int frequency,
+                       const struct lms_reg_image **img, unsigned int *n,
+                       int *actual);
+
+/**
+ * Replace the gain offsets of the specified module
+ *
+ * @param   dev         Device handle
+ * @param   module      Module to configure
+ * @param   offsets     Offsets to copy, or NULL to clear them
+ * @param   count       Number of offsets
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int gain_set_offsets(struct bladerf *dev, bladerf_module module,
+                     const struct bladerf_gain_offset *offsets,
+                     unsigned int count);
+
+/**
+ * Select the gain offset to use at the specified frequency
+ *
+ * @param   dev         Device handle
+ * @param   module      Module being tuned
+ * @param   frequency   Frequency, in Hz
+ */
+void gain_update_offset(struct bladerf *dev, bladerf_module module,
+                        unsigned int frequency);
+
+/**
+ * Queue a gain change to be applied by gain_sched_service()
+ *
+ * @param   dev         Device handle
+ * @param   module      Module to configure
+ * @param   timestamp   Timestamp at which to apply the change
+ * @param   gain        Desired gain
+ *
+ * @return 0 on success, BLADERF_ERR_MEM if the queue is full
+ */
+int gain_sched_add(struct bladerf *dev, bladerf_module module,
+                   uint64_t timestamp, int gain);
+
+/**
+ * Discard the pending gain changes of the specified module
+ *
+ * @param   dev         Device handle
+ * @param   module      Module
+ */
+void gain_sched_clear(struct bladerf *dev, bladerf_module module);
+
+/**
+ * Apply the latest gain change due at the specified timestamp, discarding
+ * any earlier ones
+ *
+ * @param   dev         Device handle
+ * @param   module      Module
+ * @param   timestamp   Current stream timestamp
+ *
+ * @return 0 on success or if no changes are due, BLADERF_ERR_* value on
+ *         failure
+ */
+int gain_sched_service(struct bladerf *dev, bladerf_module module,
+                       uint64_t timestamp);
+
+/**
+ * @return the timestamp of the earliest pending change of the specified
+ *         module, or UINT64_MAX if none are pending
+ */
+uint64_t gain_sched_next(struct bladerf *dev, bladerf_module module);
+
 /* TODO gain_get() */
 
 #endif
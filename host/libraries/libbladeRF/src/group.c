@@ -0,0 +1,360 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Device groups
+ *
+ * A group reads from each device's synchronous RX interface in turn, from
+ * the caller's thread. The only threads involved are those the sync
+ * interface already uses to run each device's stream, so a group adds none
+ * of its own, regardless of its size.
+ *
+ * Samples are requested from each device at the group's next timestamp,
+ * translated to the device's timebase. When a device can no longer provide
+ * samples at that time (its stream has not started yet, or it overran),
+ * the group's next timestamp is advanced to the latest position of any
+ * device and all devices are read again from there.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "libbladeRF.h"
+#include "bladerf_priv.h"
+#include "sync.h"
+#include "log.h"
+
+/* Number of attempts made to read each device's timestamp counter between
+ * two reads of the reference device's counter. The attempt bracketed most
+ * tightly is used to estimate the offset. */
+#define GROUP_OFFSET_ROUNDS     8
+
+struct bladerf_group {
+    struct bladerf **devs;
+    unsigned int n;
+
+    /* Offset of each device's RX timestamp from the reference device's */
+    int64_t *offsets;
+
+    bool running;
+    bool streaming;     /* Samples have been returned since starting RX */
+
+    /* Reference device timestamp of the next samples to return */
+    uint64_t next;
+};
+
+static int estimate_offset(struct bladerf *ref, struct bladerf *dev,
+                           int64_t *offset)
+{
+    int status;
+    unsigned int i;
+    uint64_t before, t, after;
+    uint64_t best = UINT64_MAX;
+
+    for (i = 0; i < GROUP_OFFSET_ROUNDS; i++) {
+        status = bladerf_get_timestamp(ref, BLADERF_MODULE_RX, &before);
+        if (status == 0) {
+            status = bladerf_get_timestamp(dev, BLADERF_MODULE_RX, &t);
+        }
+
+        if (status == 0) {
+            status = bladerf_get_timestamp(ref, BLADERF_MODULE_RX, &after);
+        }
+
+        if (status != 0) {
+            return status;
+        }
+
+        if (after >= before && (after - before) < best) {
+            best = after - before;
+            *offset = (int64_t) (t - (before + best / 2));
+        }
+    }
+
+    if (best == UINT64_MAX) {
+        log_debug("Reference timestamp did not advance.\n");
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    log_verbose("Estimated offset %lld (+/- %llu samples).\n",
+                (long long) *offset, (unsigned long long) (best / 2 + 1));
+
+    return 0;
+}
+
+/* Current position of a device's RX stream, in the reference timebase */
+static uint64_t stream_position(struct bladerf_group *group, unsigned int i)
+{
+    struct bladerf *dev = group->devs[i];
+    uint64_t t = 0;
+
+    MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
+    sync_get_timestamp(dev->sync[BLADERF_MODULE_RX], &t);
+    MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
+
+    return t - (uint64_t) group->offsets[i];
+}
+
+int bladerf_group_open(struct bladerf_group **group,
+                       struct bladerf_devinfo *devinfo, unsigned int n)
+{
+    struct bladerf_group *g;
+    unsigned int i;
+    int status;
+
+    *group = NULL;
+
+    if (n == 0 || devinfo == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    g = calloc(1, sizeof(g[0]));
+    if (g == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    g->n = n;
+    g->devs = calloc(n, sizeof(g->devs[0]));
+    g->offsets = calloc(n, sizeof(g->offsets[0]));
+
+    if (g->devs == NULL || g->offsets == NULL) {
+        status = BLADERF_ERR_MEM;
+        goto error;
+    }
+
+    status = bladerf_open_multiple(g->devs, devinfo, NULL, n);
+    if (status != 0) {
+        goto error;
+    }
+
+    *group = g;
+    return 0;
+
+error:
+    if (g->devs != NULL) {
+        for (i = 0; i < n; i++) {
+            bladerf_close(g->devs[i]);
+        }
+    }
+
+    free(g->offsets);
+    free(g->devs);
+    free(g);
+    return status;
+}
+
+void bladerf_group_close(struct bladerf_group *group)
+{
+    unsigned int i;
+
+    if (group != NULL) {
+        if (group->running) {
+            bladerf_group_stop_rx(group);
+        }
+
+        for (i = 0; i < group->n; i++) {
+            bladerf_close(group->devs[i]);
+        }
+
+        free(group->offsets);
+        free(group->devs);
+        free(group);
+    }
+}
+
+struct bladerf *bladerf_group_get_device(struct bladerf_group *group,
+                                         unsigned int index)
+{
+    return index < group->n ? group->devs[index] : NULL;
+}
+
+int bladerf_group_share_clock(struct bladerf_group *group)
+{
+    int status;
+    unsigned int i;
+
+    status = bladerf_set_mimo_mode(group->devs[0], BLADERF_MIMO_MASTER);
+
+    for (i = 1; i < group->n && status == 0; i++) {
+        status = bladerf_set_mimo_mode(group->devs[i], BLADERF_MIMO_SLAVE);
+    }
+
+    return status;
+}
+
+int bladerf_group_start_rx(struct bladerf_group *group,
+                           unsigned int num_buffers, unsigned int buffer_size,
+                           unsigned int num_transfers,
+                           unsigned int stream_timeout)
+{
+    int status = 0;
+    unsigned int i;
+
+    if (group->running) {
+        bladerf_group_stop_rx(group);
+    }
+
+    for (i = 0; i < group->n && status == 0; i++) {
+        status = bladerf_sync_config(group->devs[i], BLADERF_MODULE_RX,
+                                     BLADERF_FORMAT_SC16_Q11_META,
+                                     num_buffers, buffer_size, num_transfers,
+                                     stream_timeout);
+
+        if (status == 0) {
+            status = bladerf_enable_module(group->devs[i],
+                                           BLADERF_MODULE_RX, true);
+        }
+    }
+
+    group->running = true;
+
+    group->offsets[0] = 0;
+    for (i = 1; i < group->n && status == 0; i++) {
+        status = estimate_offset(group->devs[0], group->devs[i],
+                                 &group->offsets[i]);
+    }
+
+    if (status == 0) {
+        status = bladerf_get_timestamp(group->devs[0], BLADERF_MODULE_RX,
+                                       &group->next);
+    }
+
+    if (status != 0) {
+        log_debug("Failed to start group RX: %s\n", bladerf_strerror(status));
+        bladerf_group_stop_rx(group);
+    } else {
+        group->streaming = false;
+    }
+
+    return status;
+}
+
+int bladerf_group_stop_rx(struct bladerf_group *group)
+{
+    int status = 0;
+    int dev_status;
+    unsigned int i;
+
+    for (i = 0; i < group->n; i++) {
+        dev_status = bladerf_enable_module(group->devs[i],
+                                           BLADERF_MODULE_RX, false);
+        if (status == 0) {
+            status = dev_status;
+        }
+    }
+
+    group->running = false;
+    return status;
+}
+
+int bladerf_group_rx(struct bladerf_group *group,
+                     int16_t *samples, unsigned int num_samples,
+                     struct bladerf_metadata *metadata,
+                     unsigned int timeout_ms)
+{
+    int status;
+    unsigned int i, attempt;
+    uint32_t meta_status = 0;
+    struct bladerf_metadata meta;
+
+    /* Each device may require the others to be read once more, as their
+     * streams start or recover from overruns */
+    const unsigned int max_attempts = 2 * group->n + 2;
+
+    if (!group->running || samples == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    for (attempt = 0; attempt < max_attempts; attempt++) {
+        uint64_t latest = group->next;
+        bool realign = false;
+
+        for (i = 0; i < group->n && !realign; i++) {
+            memset(&meta, 0, sizeof(meta));
+            meta.timestamp = group->next + (uint64_t) group->offsets[i];
+
+            status = bladerf_sync_rx(group->devs[i],
+                                     samples + 2 * (size_t) num_samples * i,
+                                     num_samples, &meta, timeout_ms);
+
+            if (status == BLADERF_ERR_TIME_PAST ||
+                (status == 0 && meta.actual_count < num_samples)) {
+
+                const uint64_t pos = stream_position(group, i);
+                if (pos > latest) {
+                    latest = pos;
+                }
+
+                realign = true;
+            } else if (status != 0) {
+                return status;
+            }
+        }
+
+        if (!realign) {
+            if (metadata != NULL) {
+                metadata->timestamp = group->next;
+                metadata->actual_count = num_samples;
+                metadata->status = meta_status;
+            }
+
+            group->next += num_samples;
+            group->streaming = true;
+            return 0;
+        }
+
+        log_debug("Realigning group: t=%llu -> t=%llu\n",
+                  (unsigned long long) group->next,
+                  (unsigned long long) latest);
+
+        /* Samples that have been returned are not contiguous with those
+         * that follow. This is expected as the streams start. */
+        if (group->streaming) {
+            meta_status |= BLADERF_META_STATUS_OVERRUN;
+        }
+
+        group->next = latest;
+    }
+
+    log_debug("Failed to align group after %u attempts.\n", max_attempts);
+    return BLADERF_ERR_TIME_PAST;
+}
+
+int bladerf_group_get_offset(struct bladerf_group *group,
+                             unsigned int index, int64_t *offset)
+{
+    if (index >= group->n) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    *offset = group->offsets[index];
+    return 0;
+}
+
+int bladerf_group_set_offset(struct bladerf_group *group,
+                             unsigned int index, int64_t offset)
+{
+    if (index >= group->n) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    group->offsets[index] = offset;
+    return 0;
+}
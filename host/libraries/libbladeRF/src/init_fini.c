@@ -28,6 +28,8 @@
 #include <syslog.h>
 #endif
 #include "log.h"
+#include "fpga.h"
+#include "backend/backend.h"
 
 #if !defined(WIN32) && !defined(__CYGWIN__)
 #if !defined(__clang__) && !defined(__GNUC__)
@@ -96,6 +98,8 @@ void __fini __bladerf_fini(void)
 
     bladerf_log_set_verbosity(log_level);
     log_debug("libbladeRF %s: deinitializing\n", LIBBLADERF_VERSION);
+    fpga_cache_free();
+    backend_fini();
     fflush(NULL);
 #if !defined(WIN32) && !defined(__CYGWIN__) && defined(LOG_SYSLOG_ENABLED)
     closelog();
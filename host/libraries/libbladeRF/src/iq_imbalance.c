@@ -0,0 +1,100 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* IQ imbalance estimation
+ *
+ * A received signal free of IQ imbalance is "proper": its complex samples r
+ * satisfy E[r^2] = 0. Gain and phase imbalance mix the signal with its own
+ * image, r = a s + b s*, such that E[r^2] = 2ab E[|s|^2], while
+ * E[|r|^2] = (|a|^2 + |b|^2) E[|s|^2]. The ratio of these, k, therefore
+ * determines the image rejection ratio |a|^2 / |b|^2 without requiring a
+ * particular stimulus, or knowledge of its frequency.
+ *
+ * In terms of the I and Q (co)variances, E[r^2] = Cii - Cqq + 2j Ciq, from
+ * which the gain and phase imbalance follow directly.
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "libbladeRF.h"
+#include "log.h"
+#include "sample_sums.h"
+
+#ifndef M_PI
+#   define M_PI 3.14159265358979323846
+#endif
+
+/* Image rejection reported when no image is measurable */
+#define IQ_IRR_MAX_DB   100.0
+
+int bladerf_estimate_iq_imbalance(const int16_t *samples,
+                                  unsigned int num_samples,
+                                  struct bladerf_iq_imbalance *imbalance)
+{
+    struct sample_sums sums;
+    double n, mean_i, mean_q, c_ii, c_qq, c_iq;
+    double rho, k, x;
+
+    if (num_samples < 2) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    sample_sums(samples, num_samples, &sums);
+
+    n = num_samples;
+    mean_i = sums.i / n;
+    mean_q = sums.q / n;
+
+    /* Covariances, excluding any DC offset */
+    c_ii = sums.ii / n - mean_i * mean_i;
+    c_qq = sums.qq / n - mean_q * mean_q;
+    c_iq = sums.iq / n - mean_i * mean_q;
+
+    if (c_ii <= 0.0 || c_qq <= 0.0) {
+        log_debug("Cannot estimate IQ imbalance of a constant signal\n");
+        return BLADERF_ERR_INVAL;
+    }
+
+    /* Guard against rounding pushing the correlation beyond +/-1 */
+    rho = c_iq / sqrt(c_ii * c_qq);
+    rho = rho > 1.0 ? 1.0 : (rho < -1.0 ? -1.0 : rho);
+
+    imbalance->gain = (float) (sqrt(c_qq / c_ii) - 1.0);
+    imbalance->phase = (float) (asin(rho) * 180.0 / M_PI);
+
+    /* |k| = 2x / (1 + x^2), where x = |b| / |a| */
+    k = sqrt((c_ii - c_qq) * (c_ii - c_qq) + 4.0 * c_iq * c_iq) / (c_ii + c_qq);
+    if (k >= 1.0) {
+        imbalance->image_rejection = 0.0f;
+    } else if (k > 0.0) {
+        x = (1.0 - sqrt(1.0 - k * k)) / k;
+        imbalance->image_rejection = (float) (-20.0 * log10(x));
+    } else {
+        imbalance->image_rejection = (float) IQ_IRR_MAX_DB;
+    }
+
+    if (imbalance->image_rejection > IQ_IRR_MAX_DB) {
+        imbalance->image_rejection = (float) IQ_IRR_MAX_DB;
+    }
+
+    return 0;
+}
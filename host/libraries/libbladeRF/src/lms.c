@@ -39,6 +39,7 @@
  *  http://www.limemicro.com/download/FAQ_v1.0r10.pdf
  *
  */
+#include <string.h>
 #include <libbladeRF.h>
 #include "lms.h"
 #include "bladerf_priv.h"
@@ -49,21 +50,30 @@
 #define MHz(x) (x * 1000000)
 #define GHz(x) (x * 1000000000)
 
+/* Maximum number of LMS register writes queued during a DC calibration */
+#define DC_CAL_MAX_WRITES   24
+
 struct dc_cal_state {
+    uint8_t regs[0x80];             /* Shadow copy of registers in use */
+
     uint8_t clk_en;                 /* Backup of clock enables */
 
     uint8_t reg0x71;                /* Backup of registers */
     uint8_t reg0x7c;
 
-    bladerf_lna_gain lna_gain;      /* Backup of gain values */
-    int rxvga1_gain;
-    int rxvga2_gain;
+    uint8_t lna_reg;                /* Backup of gain registers */
+    uint8_t rxvga1_reg;
+    uint8_t rxvga2_reg;
 
     uint8_t base_addr;              /* Base address of DC cal regs */
     unsigned int num_submodules;    /* # of DC cal submodules to operate on */
 
     int rxvga1_curr_gain;           /* Current gains used in retry loops */
     int rxvga2_curr_gain;
+
+    uint8_t wr_addr[DC_CAL_MAX_WRITES]; /* Writes pending a dc_cal_flush() */
+    uint8_t wr_data[DC_CAL_MAX_WRITES];
+    unsigned int num_writes;
 };
 
 /* LPF conversion table */
@@ -270,43 +280,6 @@ static inline int is_loopback_enabled(struct bladerf *dev)
     return loopback != BLADERF_LB_NONE;
 }
 
-static int write_pll_config(struct bladerf *dev, bladerf_module module,
-                                     uint32_t frequency, uint8_t freqsel)
-{
-    int status;
-    uint8_t regval;
-    uint8_t selout;
-    uint8_t addr;
-
-    if (module == BLADERF_MODULE_TX) {
-        addr = 0x15;
-    } else {
-        addr = 0x25;
-    }
-
-    status = LMS_READ(dev, addr, &regval);
-    if (status != 0) {
-        return status;
-    }
-
-    status = is_loopback_enabled(dev);
-    if (status < 0) {
-        return status;
-    }
-
-    if (status == 0) {
-        /* Loopback not enabled - update the PLL output buffer. */
-        selout = (frequency < BLADERF_BAND_HIGH ? 1 : 2);
-        regval = (freqsel << 2) | selout;
-    } else {
-        /* Loopback is enabled - don't touch PLL output buffer. */
-        regval = (regval & ~0xfc) | (freqsel << 2);
-    }
-
-    return LMS_WRITE(dev, addr, regval);
-}
-
-
 int lms_lpf_enable(struct bladerf *dev, bladerf_module mod, bool enable)
 {
     int status;
@@ -443,6 +416,22 @@ int lms_set_bandwidth(struct bladerf *dev, bladerf_module mod, lms_bw bw)
 
 }
 
+void lms_lpf_bandwidth_images(bladerf_module mod, lms_bw bw,
+                              struct lms_reg_image *img)
+{
+    const uint8_t reg = (mod == BLADERF_MODULE_RX) ? 0x54 : 0x34;
+
+    /* Select the bandwidth and enable the LPF */
+    img[0].addr = reg;
+    img[0].mask = 0x3c | (1 << 1);
+    img[0].value = (bw << 2) | (1 << 1);
+
+    /* Disable the LPF bypass */
+    img[1].addr = reg + 1;
+    img[1].mask = (1 << 6);
+    img[1].value = 0;
+}
+
 
 int lms_get_bandwidth(struct bladerf *dev, bladerf_module mod, lms_bw *bw)
 {
@@ -550,6 +539,17 @@ int lms_soft_reset(struct bladerf *dev)
     return status;
 }
 
+static inline int clamp_gain(int gain, int min, int max)
+{
+    if (gain < min) {
+        return min;
+    } else if (gain > max) {
+        return max;
+    } else {
+        return gain;
+    }
+}
+
 /* Set the gain on the LNA */
 int lms_lna_set_gain(struct bladerf *dev, bladerf_lna_gain gain)
 {
@@ -573,6 +573,17 @@ int lms_lna_set_gain(struct bladerf *dev, bladerf_lna_gain gain)
     return status;
 }
 
+void lms_lna_gain_image(bladerf_lna_gain gain, struct lms_reg_image *img)
+{
+    if (gain != BLADERF_LNA_GAIN_BYPASS && gain != BLADERF_LNA_GAIN_MID) {
+        gain = BLADERF_LNA_GAIN_MAX;
+    }
+
+    img->addr = 0x75;
+    img->mask = (3 << 6);
+    img->value = (gain & 3) << 6;
+}
+
 int lms_lna_get_gain(struct bladerf *dev, bladerf_lna_gain *gain)
 {
     int status;
@@ -660,6 +671,15 @@ int lms_rxvga1_set_gain(struct bladerf *dev, int gain)
     return LMS_WRITE(dev, 0x76, rxvga1_lut_val2code[gain]);
 }
 
+void lms_rxvga1_gain_image(int gain, struct lms_reg_image *img)
+{
+    gain = clamp_gain(gain, BLADERF_RXVGA1_GAIN_MIN, BLADERF_RXVGA1_GAIN_MAX);
+
+    img->addr = 0x76;
+    img->mask = 0xff;
+    img->value = rxvga1_lut_val2code[gain];
+}
+
 /* Get the RFB_TIA_RXFE mixer gain */
 int lms_rxvga1_get_gain(struct bladerf *dev, int *gain)
 {
@@ -714,6 +734,16 @@ int lms_rxvga2_set_gain(struct bladerf *dev, int gain)
     return LMS_WRITE(dev, 0x65, gain / 3);
 }
 
+void lms_rxvga2_gain_image(int gain, struct lms_reg_image *img)
+{
+    gain = clamp_gain(gain, BLADERF_RXVGA2_GAIN_MIN, BLADERF_RXVGA2_GAIN_MAX);
+
+    /* 3 dB per register code */
+    img->addr = 0x65;
+    img->mask = 0xff;
+    img->value = gain / 3;
+}
+
 int lms_rxvga2_get_gain(struct bladerf *dev, int *gain)
 {
 
@@ -845,6 +875,15 @@ int lms_txvga2_set_gain(struct bladerf *dev, int gain_int)
     return status;
 }
 
+void lms_txvga2_gain_image(int gain, struct lms_reg_image *img)
+{
+    gain = clamp_gain(gain, BLADERF_TXVGA2_GAIN_MIN, BLADERF_TXVGA2_GAIN_MAX);
+
+    img->addr = 0x45;
+    img->mask = (0x1f << 3);
+    img->value = (gain & 0x1f) << 3;
+}
+
 int lms_txvga2_get_gain(struct bladerf *dev, int *gain)
 {
     int status;
@@ -885,6 +924,16 @@ int lms_txvga1_set_gain(struct bladerf *dev, int gain_int)
     return LMS_WRITE(dev, 0x41, gain);
 }
 
+void lms_txvga1_gain_image(int gain, struct lms_reg_image *img)
+{
+    gain = clamp_gain(gain, BLADERF_TXVGA1_GAIN_MIN, BLADERF_TXVGA1_GAIN_MAX);
+
+    /* Since 0x41 is only VGA1GAIN, we don't need to RMW */
+    img->addr = 0x41;
+    img->mask = 0xff;
+    img->value = gain + 35;
+}
+
 int lms_txvga1_get_gain(struct bladerf *dev, int *gain)
 {
     int status;
@@ -1652,13 +1701,31 @@ static inline int tune_vcocap(struct bladerf *dev, uint8_t base, uint8_t data)
     return status;
 }
 
+static inline void set_image(struct lms_reg_image *img, uint8_t addr,
+                             uint8_t mask, uint8_t value)
+{
+    img->addr = addr;
+    img->mask = mask;
+    img->value = value;
+}
+
 /* Set the frequency of a module */
 int lms_set_frequency(struct bladerf *dev, bladerf_module mod, uint32_t freq)
+{
+    return lms_set_frequency_images(dev, mod, freq, NULL, 0);
+}
+
+int lms_set_frequency_images(struct bladerf *dev, bladerf_module mod,
+                             uint32_t freq, const struct lms_reg_image *extra,
+                             unsigned int num_extra)
 {
     /* Select the base address based on which PLL we are configuring */
     const uint8_t base = (mod == BLADERF_MODULE_RX) ? 0x20 : 0x10;
     const uint64_t ref_clock = 38400000;
+    struct lms_reg_image img[LMS_MAX_IMAGES];
+    unsigned int n = 0;
     uint8_t freqsel = bands[0].value;
+    uint8_t selout;
     uint16_t nint;
     uint32_t nfrac;
     struct lms_freq f;
@@ -1668,6 +1735,8 @@ int lms_set_frequency(struct bladerf *dev, bladerf_module mod, uint32_t freq)
     int status, dsm_status;
     uint8_t i = 0;
 
+    assert(num_extra <= LMS_MAX_IMAGES - LMS_FREQ_NUM_IMAGES);
+
     /* Clamp out of range values */
     if (freq < BLADERF_FREQUENCY_MIN) {
         freq = BLADERF_FREQUENCY_MIN;
@@ -1708,88 +1777,49 @@ int lms_set_frequency(struct bladerf *dev, bladerf_module mod, uint32_t freq)
     f.reference = (uint32_t)ref_clock;
     lms_print_frequency(&f);
 
-    /* Turn on the DSMs */
-    status = LMS_READ(dev, 0x09, &data);
-    if (status == 0) {
-        data |= 0x05;
-        status = LMS_WRITE(dev, 0x09, data);
-    }
-
-    if (status != 0) {
-        log_debug("Failed to turn on DSMs\n");
+    status = is_loopback_enabled(dev);
+    if (status < 0) {
         return status;
     }
 
-    status = write_pll_config(dev, mod, freq, freqsel);
-    if (status != 0) {
-        goto lms_set_frequency_error;
-    }
-
-    data = nint >> 1;
-    status = LMS_WRITE(dev, base + 0, data);
-    if (status != 0) {
-        goto lms_set_frequency_error;
-    }
-
-    data = ((nint & 1) << 7) | ((nfrac >> 16) & 0x7f);
-    status = LMS_WRITE(dev, base + 1, data);
-    if (status != 0) {
-        goto lms_set_frequency_error;
-    }
+    /* Turn on the DSMs */
+    set_image(&img[n++], 0x09, 0x05, 0x05);
 
-    data = ((nfrac >> 8) & 0xff);
-    status = LMS_WRITE(dev, base + 2, data);
-    if (status != 0) {
-        goto lms_set_frequency_error;
+    /* Update the PLL output buffer selection, unless loopback is enabled */
+    if (status == 0) {
+        selout = (freq < BLADERF_BAND_HIGH ? 1 : 2);
+        set_image(&img[n++], base + 5, 0xff, (freqsel << 2) | selout);
+    } else {
+        set_image(&img[n++], base + 5, 0xfc, freqsel << 2);
     }
 
-    data = (nfrac & 0xff);
-    status = LMS_WRITE(dev, base + 3, data);
-    if (status != 0) {
-        goto lms_set_frequency_error;
-    }
+    set_image(&img[n++], base + 0, 0xff, nint >> 1);
+    set_image(&img[n++], base + 1, 0xff,
+              ((nint & 1) << 7) | ((nfrac >> 16) & 0x7f));
+    set_image(&img[n++], base + 2, 0xff, (nfrac >> 8) & 0xff);
+    set_image(&img[n++], base + 3, 0xff, nfrac & 0xff);
 
     /* Set the PLL Ichp, Iup and Idn currents */
-    status = LMS_READ(dev, base + 6, &data);
-    if (status != 0) {
-        goto lms_set_frequency_error;
-    }
+    set_image(&img[n++], base + 6, 0x1f, 0x0c);
+    set_image(&img[n++], base + 7, 0x1f, 0x00);
+    set_image(&img[n++], base + 8, 0x1f, 0x00);
 
-    data &= ~(0x1f);
-    data |= 0x0c;
+    assert(n == LMS_FREQ_NUM_IMAGES);
 
-    status = LMS_WRITE(dev, base + 6, data);
-    if (status != 0) {
-        goto lms_set_frequency_error;
+    /* Settings unrelated to the PLL may be applied in the same batch */
+    if (num_extra != 0) {
+        memcpy(&img[n], extra, num_extra * sizeof(img[0]));
+        n += num_extra;
     }
 
-    status = LMS_READ(dev, base + 7, &data);
-    if (status != 0) {
-        goto lms_set_frequency_error;
-    }
-
-    data &= ~(0x1f);
-    // data |= 3;
-
-    status = LMS_WRITE(dev, base + 7, data);
-    if (status != 0) {
-        goto lms_set_frequency_error;
-    }
-
-    status = LMS_READ(dev, base + 8, &data);
-    if (status != 0) {
-        goto lms_set_frequency_error;
-    }
-
-    data &= ~(0x1f);
-    // data |= 3;
-    status = LMS_WRITE(dev, base + 8, data);
+    status = lms_write_images(dev, img, n);
     if (status != 0) {
+        log_debug("Failed to write PLL configuration\n");
         goto lms_set_frequency_error;
     }
 
     /* Loop through the VCOCAP to figure out optimal values */
-    status = tune_vcocap(dev, base, data);
+    status = tune_vcocap(dev, base, 0);
 
 lms_set_frequency_error:
     /* Turn off the DSMs */
@@ -1821,81 +1851,200 @@ int lms_dump_registers(struct bladerf *dev)
     return status;
 }
 
-/* Reference LMS6002D calibration guide, section 4.1 flow chart */
-static int lms_dc_cal_loop(struct bladerf *dev, uint8_t base,
+int lms_write_regs(struct bladerf *dev, const uint8_t *addr,
+                   const uint8_t *data, unsigned int n)
+{
+    int status = BLADERF_ERR_UNSUPPORTED;
+    unsigned int i;
+
+    if (n == 0) {
+        return 0;
+    }
+
+    if (dev->fn->lms_write_regs != NULL) {
+        status = dev->fn->lms_write_regs(dev, addr, data, n);
+    }
+
+    if (status == BLADERF_ERR_UNSUPPORTED) {
+        for (i = 0, status = 0; i < n && status == 0; i++) {
+            status = LMS_WRITE(dev, addr[i], data[i]);
+        }
+    }
+
+    return status;
+}
+
+int lms_read_regs(struct bladerf *dev, const uint8_t *addr,
+                  uint8_t *data, unsigned int n)
+{
+    int status = BLADERF_ERR_UNSUPPORTED;
+    unsigned int i;
+
+    if (n == 0) {
+        return 0;
+    }
+
+    if (dev->fn->lms_read_regs != NULL) {
+        status = dev->fn->lms_read_regs(dev, addr, data, n);
+    }
+
+    if (status == BLADERF_ERR_UNSUPPORTED) {
+        for (i = 0, status = 0; i < n && status == 0; i++) {
+            status = LMS_READ(dev, addr[i], &data[i]);
+        }
+    }
+
+    return status;
+}
+
+int lms_write_images(struct bladerf *dev, const struct lms_reg_image *img,
+                     unsigned int n)
+{
+    int status;
+    unsigned int i, num_reads;
+    uint8_t rd_addr[LMS_MAX_IMAGES], rd_data[LMS_MAX_IMAGES];
+    uint8_t wr_addr[LMS_MAX_IMAGES], wr_data[LMS_MAX_IMAGES];
+
+    assert(n <= LMS_MAX_IMAGES);
+
+    for (i = num_reads = 0; i < n; i++) {
+        if (img[i].mask != 0xff) {
+            rd_addr[num_reads++] = img[i].addr;
+        }
+    }
+
+    status = lms_read_regs(dev, rd_addr, rd_data, num_reads);
+    if (status != 0) {
+        return status;
+    }
+
+    for (i = num_reads = 0; i < n; i++) {
+        wr_addr[i] = img[i].addr;
+        wr_data[i] = img[i].value;
+
+        if (img[i].mask != 0xff) {
+            wr_data[i] |= rd_data[num_reads++] & ~img[i].mask;
+        }
+    }
+
+    return lms_write_regs(dev, wr_addr, wr_data, n);
+}
+
+/* Queue a register write, updating the shadow copy of the register. Queued
+ * writes are issued as a batch by dc_cal_flush() */
+static inline void dc_cal_write(struct dc_cal_state *state,
+                                uint8_t addr, uint8_t data)
+{
+    assert(state->num_writes < DC_CAL_MAX_WRITES);
+    assert(addr < ARRAY_SIZE(state->regs));
+
+    state->regs[addr] = data;
+    state->wr_addr[state->num_writes] = addr;
+    state->wr_data[state->num_writes] = data;
+    state->num_writes++;
+}
+
+static inline void dc_cal_set(struct dc_cal_state *state,
+                              uint8_t addr, uint8_t mask)
+{
+    dc_cal_write(state, addr, state->regs[addr] | mask);
+}
+
+static inline void dc_cal_clear(struct dc_cal_state *state,
+                                uint8_t addr, uint8_t mask)
+{
+    dc_cal_write(state, addr, state->regs[addr] & ~mask);
+}
+
+static inline int dc_cal_flush(struct bladerf *dev, struct dc_cal_state *state)
+{
+    const unsigned int n = state->num_writes;
+
+    state->num_writes = 0;
+    return lms_write_regs(dev, state->wr_addr, state->wr_data, n);
+}
+
+/* Reference LMS6002D calibration guide, section 4.1 flow chart.
+ *
+ * Devices that can run the entire loop on the FPGA's NIOS II do so in a single
+ * round trip. Otherwise, or if the NIOS times out, the calibration is started
+ * with a single batch of writes, and DC_REG_VAL is read back alongside each
+ * poll of DC_CLBR_DONE. */
+static int lms_dc_cal_loop(struct bladerf *dev, struct dc_cal_state *state,
                            uint8_t cal_address, uint8_t dc_cntval,
                            uint8_t *dc_regval)
 {
     int status;
-    uint8_t i, val;
+    unsigned int i;
     bool done = false;
     const unsigned int max_cal_count = 25;
+    const uint8_t base = state->base_addr;
+    const uint8_t poll_addr[2] = { base + 0x01, base };
+    uint8_t poll_data[2];
+    uint8_t val;
 
     log_debug("Calibrating module %2.2x:%2.2x\n", base, cal_address);
 
-    /* Set the calibration address for the block, and start it up */
-    status = LMS_READ(dev, base + 0x03, &val);
-    if (status != 0) {
-        return status;
-    }
-
+    val = state->regs[base + 0x03];
     val &= ~(0x07);
     val |= cal_address&0x07;
 
-    status = LMS_WRITE(dev, base + 0x03, val);
-    if (status != 0) {
-        return status;
-    }
+    if (dev->fn->lms_dc_cal_loop != NULL) {
+        status = dc_cal_flush(dev, state);
+        if (status != 0) {
+            return status;
+        }
 
-    /* Set and latch the DC_CNTVAL  */
-    status = LMS_WRITE(dev, base + 0x02, dc_cntval);
-    if (status != 0) {
-        return status;
-    }
+        status = dev->fn->lms_dc_cal_loop(dev, base, cal_address,
+                                          dc_cntval, dc_regval);
 
-    val |= (1 << 4);
-    status = LMS_WRITE(dev, base + 0x03, val);
-    if (status != 0) {
-        return status;
-    }
+        if (status == BLADERF_ERR_UNEXPECTED) {
+            /* The FPGA timed out waiting for DC_CLBR_DONE. Rerun the loop
+             * from the host, which polls at its own, slower, pace. */
+            log_debug("FPGA DC cal loop timed out; retrying from host\n");
+            state->regs[base + 0x03] = val;
+        } else if (status != BLADERF_ERR_UNSUPPORTED) {
+            state->regs[base + 0x03] = val;
 
-    val &= ~(1 << 4);
-    status = LMS_WRITE(dev, base + 0x03, val);
-    if (status != 0) {
-        return status;
+            if (status == 0) {
+                log_debug("DC_REGVAL: %d\n", *dc_regval);
+            }
+
+            return status;
+        }
     }
 
+    /* Set the calibration address for the block */
+    dc_cal_write(state, base + 0x03, val);
+
+    /* Set and latch the DC_CNTVAL  */
+    dc_cal_write(state, base + 0x02, dc_cntval);
+    dc_cal_write(state, base + 0x03, val | (1 << 4));
+    dc_cal_write(state, base + 0x03, val);
 
     /* Start the calibration by toggling DC_START_CLBR */
-    val |= (1 << 5);
-    status = LMS_WRITE(dev, base + 0x03, val);
-    if (status != 0) {
-        return status;
-    }
+    dc_cal_write(state, base + 0x03, val | (1 << 5));
+    dc_cal_write(state, base + 0x03, val);
 
-    val &= ~(1 << 5);
-    status = LMS_WRITE(dev, base + 0x03, val);
+    status = dc_cal_flush(dev, state);
     if (status != 0) {
         return status;
     }
 
     /* Main loop checking the calibration */
     for (i = 0 ; i < max_cal_count && !done; i++) {
-        /* Read active low DC_CLBR_DONE */
-        status = LMS_READ(dev, base + 0x01, &val);
+        /* Read active low DC_CLBR_DONE, followed by DC_REG_VAL. Per LMS FAQ
+         * item 4.7, we should check DC_REG_VAL, as DC_LOCK is not a reliable
+         * indicator */
+        status = lms_read_regs(dev, poll_addr, poll_data, 2);
         if (status != 0) {
             return status;
         }
 
         /* Check if calibration is done */
-        if (((val >> 1) & 1) == 0) {
+        if (((poll_data[0] >> 1) & 1) == 0) {
             done = true;
-            /* Per LMS FAQ item 4.7, we should check DC_REG_VAL, as
-             * DC_LOCK is not a reliable indicator */
-            status = LMS_READ(dev, base, dc_regval);
-            if (status == 0) {
-                *dc_regval &= 0x3f;
-            }
+            *dc_regval = poll_data[1] & 0x3f;
         }
     }
 
@@ -1909,44 +2058,78 @@ static int lms_dc_cal_loop(struct bladerf *dev, uint8_t base,
     return status;
 }
 
+/* Registers read into the shadow copy prior to calibrating each module:
+ * the clock enables, the DC calibration control register, and everything
+ * modified via dc_cal_set() or dc_cal_clear() */
+static const uint8_t dc_cal_regs_lpf_tuning[] = {
+    0x09, 0x03, 0x35, 0x55
+};
+
+static const uint8_t dc_cal_regs_tx_lpf[] = {
+    0x09, 0x33, 0x36, 0x3f
+};
+
+static const uint8_t dc_cal_regs_rx_lpf[] = {
+    0x09, 0x53, 0x5f, 0x71, 0x7c, 0x75, 0x76, 0x65
+};
+
+static const uint8_t dc_cal_regs_rxvga2[] = {
+    0x09, 0x63, 0x64, 0x6e, 0x71, 0x7c, 0x75, 0x76, 0x65
+};
+
 static inline int dc_cal_backup(struct bladerf *dev,
                                 bladerf_cal_module module,
                                 struct dc_cal_state *state)
 {
     int status;
+    unsigned int i, n;
+    const uint8_t *addr;
+    uint8_t data[ARRAY_SIZE(dc_cal_regs_rxvga2)];
 
     memset(state, 0, sizeof(state[0]));
 
-    status = LMS_READ(dev, 0x09, &state->clk_en);
+    switch (module) {
+        case BLADERF_DC_CAL_LPF_TUNING:
+            addr = dc_cal_regs_lpf_tuning;
+            n = ARRAY_SIZE(dc_cal_regs_lpf_tuning);
+            break;
+
+        case BLADERF_DC_CAL_TX_LPF:
+            addr = dc_cal_regs_tx_lpf;
+            n = ARRAY_SIZE(dc_cal_regs_tx_lpf);
+            break;
+
+        case BLADERF_DC_CAL_RX_LPF:
+            addr = dc_cal_regs_rx_lpf;
+            n = ARRAY_SIZE(dc_cal_regs_rx_lpf);
+            break;
+
+        case BLADERF_DC_CAL_RXVGA2:
+            addr = dc_cal_regs_rxvga2;
+            n = ARRAY_SIZE(dc_cal_regs_rxvga2);
+            break;
+
+        default:
+            return BLADERF_ERR_INVAL;
+    }
+
+    status = lms_read_regs(dev, addr, data, n);
     if (status != 0) {
         return status;
     }
 
-    if (module == BLADERF_DC_CAL_RX_LPF || module == BLADERF_DC_CAL_RXVGA2) {
-        status = LMS_READ(dev, 0x71, &state->reg0x71);
-        if (status != 0) {
-            return status;
-        }
-
-        status = LMS_READ(dev, 0x7c, &state->reg0x7c);
-        if (status != 0) {
-            return status;
-        }
-
-        status = lms_lna_get_gain(dev, &state->lna_gain);
-        if (status != 0) {
-            return status;
-        }
+    for (i = 0; i < n; i++) {
+        state->regs[addr[i]] = data[i];
+    }
 
-        status = lms_rxvga1_get_gain(dev, &state->rxvga1_gain);
-        if (status != 0) {
-            return status;
-        }
+    state->clk_en = state->regs[0x09];
 
-        status = lms_rxvga2_get_gain(dev, &state->rxvga2_gain);
-        if (status != 0) {
-            return status;
-        }
+    if (module == BLADERF_DC_CAL_RX_LPF || module == BLADERF_DC_CAL_RXVGA2) {
+        state->reg0x71 = state->regs[0x71];
+        state->reg0x7c = state->regs[0x7c];
+        state->lna_reg = state->regs[0x75];
+        state->rxvga1_reg = state->regs[0x76];
+        state->rxvga2_reg = state->regs[0x65];
     }
 
     return 0;
@@ -1956,7 +2139,6 @@ static inline int dc_cal_module_init(struct bladerf *dev,
                                      bladerf_cal_module module,
                                      struct dc_cal_state *state)
 {
-    int status;
     uint8_t cal_clock;
     uint8_t val;
 
@@ -1990,10 +2172,7 @@ static inline int dc_cal_module_init(struct bladerf *dev,
     }
 
     /* Enable the appropriate clock based on the module */
-    status = LMS_WRITE(dev, 0x09, state->clk_en | cal_clock);
-    if (status != 0) {
-        return status;
-    }
+    dc_cal_write(state, 0x09, state->clk_en | cal_clock);
 
     switch (module) {
 
@@ -2007,73 +2186,46 @@ static inline int dc_cal_module_init(struct bladerf *dev,
              * powered up when performing DC calibration, and then powered down
              * afterwards to improve receiver linearity */
             if (module == BLADERF_DC_CAL_RXVGA2) {
-                status = lms_clear(dev, 0x6e, (3 << 6));
-                if (status != 0) {
-                    return status;
-                }
+                dc_cal_clear(state, 0x6e, (3 << 6));
             } else {
                 /* Power up RX LPF DC calibration comparator */
-                status = lms_clear(dev, 0x5f, (1 << 7));
-                if (status != 0) {
-                    return status;
-                }
+                dc_cal_clear(state, 0x5f, (1 << 7));
             }
 
             /* Connect LNA to the external pads and internally terminate */
-            val = state->reg0x71 & ~(1 << 7);
-            status = LMS_WRITE(dev, 0x71, val);
-            if (status != 0) {
-                return status;
-            }
-
-            val = state->reg0x7c | (1 << 2);
-            status = LMS_WRITE(dev, 0x7c, val);
-            if (status != 0) {
-                return status;
-            }
+            dc_cal_write(state, 0x71, state->reg0x71 & ~(1 << 7));
+            dc_cal_write(state, 0x7c, state->reg0x7c | (1 << 2));
 
             /* Attempt to calibrate at max gain. */
-            status = lms_lna_set_gain(dev, BLADERF_LNA_GAIN_MAX);
-            if (status != 0) {
-                return status;
-            }
+            val = state->lna_reg & ~(3 << 6);
+            val |= (BLADERF_LNA_GAIN_MAX & 3) << 6;
+            dc_cal_write(state, 0x75, val);
 
             state->rxvga1_curr_gain = BLADERF_RXVGA1_GAIN_MAX;
-            status = lms_rxvga1_set_gain(dev, state->rxvga1_curr_gain);
-            if (status != 0) {
-                return status;
-            }
+            dc_cal_write(state, 0x76,
+                         rxvga1_lut_val2code[state->rxvga1_curr_gain]);
 
             state->rxvga2_curr_gain = BLADERF_RXVGA2_GAIN_MAX;
-            status = lms_rxvga2_set_gain(dev, state->rxvga2_curr_gain);
-            if (status != 0) {
-                return status;
-            }
-
+            dc_cal_write(state, 0x65, state->rxvga2_curr_gain / 3);
             break;
 
 
         case BLADERF_DC_CAL_TX_LPF:
             /* FAQ item 4.1 notes that the DAC should be turned off or set
              * to generate minimum DC */
-            status = lms_set(dev, 0x36, (1 << 7));
-            if (status != 0) {
-                return status;
-            }
+            dc_cal_set(state, 0x36, (1 << 7));
 
             /* Ensure TX LPF DC calibration comparator is powered up */
-            status = lms_clear(dev, 0x3f, (1 << 7));
-            if (status != 0) {
-                return status;
-            }
+            dc_cal_clear(state, 0x3f, (1 << 7));
             break;
 
         default:
             assert(!"Invalid module");
-            status = BLADERF_ERR_INVAL;
+            return BLADERF_ERR_INVAL;
     }
 
-    return status;
+    /* These writes are issued along with the first calibration loop */
+    return 0;
 }
 
 /* The RXVGA2 items here are based upon Lime Microsystems' recommendations
@@ -2090,7 +2242,7 @@ static inline int dc_cal_submodule(struct bladerf *dev,
                                    bool *converged)
 {
     int status;
-    uint8_t val, dc_regval;
+    uint8_t dc_regval;
 
     *converged = false;
 
@@ -2104,33 +2256,20 @@ static inline int dc_cal_submodule(struct bladerf *dev,
                  */
 
                 /* Disable RXVGA2 DECODE */
-                status = lms_clear(dev, 0x64, (1 << 0));
-                if (status != 0) {
-                    return status;
-                }
+                dc_cal_clear(state, 0x64, (1 << 0));
 
                 /* VGA2GAINA = 0, VGA2GAINB = 0 */
-                status = LMS_WRITE(dev, 0x68, 0x01);
-                if (status != 0) {
-                    return status;
-                }
+                dc_cal_write(state, 0x68, 0x01);
                 break;
 
             case 1:
                 /* Setup for Stage 1 I and Q channels (submodules 1 and 2) */
 
                 /* Set to direct control signals: RXVGA2 Decode = 1 */
-                status = lms_set(dev, 0x64, (1 << 0));
-                if (status != 0) {
-                    return status;
-                }
+                dc_cal_set(state, 0x64, (1 << 0));
 
                 /* VGA2GAINA = 0110, VGA2GAINB = 0 */
-                val = 0x06;
-                status = LMS_WRITE(dev, 0x68, val);
-                if (status != 0) {
-                    return status;
-                }
+                dc_cal_write(state, 0x68, 0x06);
                 break;
 
             case 2:
@@ -2142,11 +2281,7 @@ static inline int dc_cal_submodule(struct bladerf *dev,
                 /* Setup for Stage 2 I and Q channels (submodules 3 and 4) */
 
                 /* VGA2GAINA = 0, VGA2GAINB = 0110 */
-                val = 0x60;
-                status = LMS_WRITE(dev, 0x68, val);
-                if (status != 0) {
-                    return status;
-                }
+                dc_cal_write(state, 0x68, 0x60);
                 break;
 
             case 4:
@@ -2160,7 +2295,7 @@ static inline int dc_cal_submodule(struct bladerf *dev,
         }
     }
 
-    status = lms_dc_cal_loop(dev, state->base_addr, submodule, 31, &dc_regval);
+    status = lms_dc_cal_loop(dev, state, submodule, 31, &dc_regval);
     if (status != 0) {
         return status;
     }
@@ -2169,7 +2304,7 @@ static inline int dc_cal_submodule(struct bladerf *dev,
         log_debug("DC_REGVAL suboptimal value - retrying DC cal loop.\n");
 
         /* FAQ item 4.7 indcates that can retry with DC_CNTVAL reset */
-        status = lms_dc_cal_loop(dev, state->base_addr, submodule, 0, &dc_regval);
+        status = lms_dc_cal_loop(dev, state, submodule, 0, &dc_regval);
         if (status != 0) {
             return status;
         } else if (dc_regval == 0) {
@@ -2183,24 +2318,10 @@ static inline int dc_cal_submodule(struct bladerf *dev,
          * written to TX/RX LPF DCCAL */
 
         /* Set the DC level to RX and TX DCCAL modules */
-        status = LMS_READ(dev, 0x35, &val);
-        if (status == 0) {
-            val &= ~(0x3f);
-            val |= dc_regval;
-            status = LMS_WRITE(dev, 0x35, val);
-        }
-
-        if (status != 0) {
-            return status;
-        }
-
-        status = LMS_READ(dev, 0x55, &val);
-        if (status == 0) {
-            val &= ~(0x3f);
-            val |= dc_regval;
-            status = LMS_WRITE(dev, 0x55, val);
-        }
+        dc_cal_write(state, 0x35, (state->regs[0x35] & ~(0x3f)) | dc_regval);
+        dc_cal_write(state, 0x55, (state->regs[0x55] & ~(0x3f)) | dc_regval);
 
+        status = dc_cal_flush(dev, state);
         if (status != 0) {
             return status;
         }
@@ -2229,7 +2350,8 @@ static inline int dc_cal_retry_adjustment(struct bladerf *dev,
                 state->rxvga1_curr_gain -= 1;
                 log_debug("Retrying DC cal with RXVGA1=%d\n",
                           state->rxvga1_curr_gain);
-                status = lms_rxvga1_set_gain(dev, state->rxvga1_curr_gain);
+                dc_cal_write(state, 0x76,
+                             rxvga1_lut_val2code[state->rxvga1_curr_gain]);
             } else {
                 *limit_reached = true;
             }
@@ -2240,12 +2362,13 @@ static inline int dc_cal_retry_adjustment(struct bladerf *dev,
                 state->rxvga1_curr_gain -= 1;
                 log_debug("Retrying DC cal with RXVGA1=%d\n",
                           state->rxvga1_curr_gain);
-                status = lms_rxvga1_set_gain(dev, state->rxvga1_curr_gain);
+                dc_cal_write(state, 0x76,
+                             rxvga1_lut_val2code[state->rxvga1_curr_gain]);
             } else if (state->rxvga2_curr_gain > BLADERF_RXVGA2_GAIN_MIN) {
                 state->rxvga2_curr_gain -= 3;
                 log_debug("Retrying DC cal with RXVGA2=%d\n",
                           state->rxvga2_curr_gain);
-                status = lms_rxvga2_set_gain(dev, state->rxvga2_curr_gain);
+                dc_cal_write(state, 0x65, state->rxvga2_curr_gain / 3);
             } else {
                 *limit_reached = true;
             }
@@ -2276,44 +2399,26 @@ static inline int dc_cal_module_deinit(struct bladerf *dev,
 
         case BLADERF_DC_CAL_RX_LPF:
             /* Power down RX LPF calibration comparator */
-            status = lms_set(dev, 0x5f, (1 << 7));
-            if (status != 0) {
-                return status;
-            }
+            dc_cal_set(state, 0x5f, (1 << 7));
             break;
 
         case BLADERF_DC_CAL_RXVGA2:
             /* Restore defaults: VGA2GAINA = 1, VGA2GAINB = 0 */
-            status = LMS_WRITE(dev, 0x68, 0x01);
-            if (status != 0) {
-                return status;
-            }
+            dc_cal_write(state, 0x68, 0x01);
 
             /* Disable decode control signals: RXVGA2 Decode = 0 */
-            status = lms_clear(dev, 0x64, (1 << 0));
-            if (status != 0) {
-                return status;
-            }
+            dc_cal_clear(state, 0x64, (1 << 0));
 
             /* Power DC comparitors down, per FAQ 5.26 (rev 1.0r10) */
-            status = lms_set(dev, 0x6e, (3 << 6));
-            if (status != 0) {
-                return status;
-            }
+            dc_cal_set(state, 0x6e, (3 << 6));
             break;
 
         case BLADERF_DC_CAL_TX_LPF:
             /* Power down TX LPF DC calibration comparator */
-            status = lms_set(dev, 0x3f, (1 << 7));
-            if (status != 0) {
-                return status;
-            }
+            dc_cal_set(state, 0x3f, (1 << 7));
 
             /* Re-enable the DACs */
-            status = lms_clear(dev, 0x36, (1 << 7));
-            if (status != 0) {
-                return status;
-            }
+            dc_cal_clear(state, 0x36, (1 << 7));
             break;
 
         default:
@@ -2321,6 +2426,7 @@ static inline int dc_cal_module_deinit(struct bladerf *dev,
             status = BLADERF_ERR_INVAL;
     }
 
+    /* These writes are issued along with those of dc_cal_restore() */
     return status;
 }
 
@@ -2328,42 +2434,17 @@ static inline int dc_cal_restore(struct bladerf *dev,
                                  bladerf_cal_module module,
                                  struct dc_cal_state *state)
 {
-    int status, ret;
-    ret = 0;
-
-    status = LMS_WRITE(dev, 0x09, state->clk_en);
-    if (status != 0) {
-        ret = status;
-    }
+    dc_cal_write(state, 0x09, state->clk_en);
 
     if (module == BLADERF_DC_CAL_RX_LPF || module == BLADERF_DC_CAL_RXVGA2) {
-        status = LMS_WRITE(dev, 0x71, state->reg0x71);
-        if (status != 0 && ret == 0) {
-            ret = status;
-        }
-
-        status = LMS_WRITE(dev, 0x7c, state->reg0x7c);
-        if (status != 0 && ret == 0) {
-            ret = status;
-        }
-
-        status = lms_lna_set_gain(dev, state->lna_gain);
-        if (status != 0 && ret == 0) {
-            ret = status;
-        }
-
-        status = lms_rxvga1_set_gain(dev, state->rxvga1_gain);
-        if (status != 0 && ret == 0) {
-            ret = status;
-        }
-
-        status = lms_rxvga2_set_gain(dev, state->rxvga2_gain);
-        if (status != 0) {
-            ret = status;
-        }
+        dc_cal_write(state, 0x71, state->reg0x71);
+        dc_cal_write(state, 0x7c, state->reg0x7c);
+        dc_cal_write(state, 0x75, state->lna_reg);
+        dc_cal_write(state, 0x76, state->rxvga1_reg);
+        dc_cal_write(state, 0x65, state->rxvga2_reg);
     }
 
-    return ret;
+    return dc_cal_flush(dev, state);
 }
 
 static inline int dc_cal_module(struct bladerf *dev,
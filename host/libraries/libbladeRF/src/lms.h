@@ -132,6 +132,80 @@ lms_bw lms_uint2bw(unsigned int req);
  */
 unsigned int lms_bw2uint(lms_bw bw);
 
+/**
+ * Write a list of LMS6002D registers, in order, using as few device round
+ * trips as the backend supports
+ *
+ * @param   dev         Device to operate on
+ * @param   addr        Register addresses
+ * @param   data        Values to write
+ * @param   n           Number of registers to write
+ *
+ * @return BLADERF_ERR_* value
+ */
+int lms_write_regs(struct bladerf *dev, const uint8_t *addr,
+                   const uint8_t *data, unsigned int n);
+
+/**
+ * Read a list of LMS6002D registers, in order, using as few device round
+ * trips as the backend supports
+ *
+ * @param   dev         Device to operate on
+ * @param   addr        Register addresses
+ * @param   data        Values read
+ * @param   n           Number of registers to read
+ *
+ * @return BLADERF_ERR_* value
+ */
+int lms_read_regs(struct bladerf *dev, const uint8_t *addr,
+                  uint8_t *data, unsigned int n);
+
+/**
+ * Image of (a portion of) an LMS6002D register. Applying it writes
+ * `(current & ~mask) | value` to the register, which only requires reading
+ * the register if mask is not 0xff.
+ */
+struct lms_reg_image {
+    uint8_t addr;
+    uint8_t mask;
+    uint8_t value;
+};
+
+/** Maximum number of images accepted by lms_write_images() */
+#define LMS_MAX_IMAGES  16
+
+/** Number of images written by lms_set_frequency_images() to program a PLL */
+#define LMS_FREQ_NUM_IMAGES 9
+
+/** Number of images filled in by lms_lpf_bandwidth_images() */
+#define LMS_LPF_NUM_IMAGES  2
+
+/**
+ * Apply a set of register images, in order, with one batched read of the
+ * registers requiring a RMW and one batched write
+ *
+ * @param   dev         Device to operate on
+ * @param   img         Images to apply. Each register may appear only once.
+ * @param   n           Number of images (<= LMS_MAX_IMAGES)
+ *
+ * @return BLADERF_ERR_* value
+ */
+int lms_write_images(struct bladerf *dev, const struct lms_reg_image *img,
+                     unsigned int n);
+
+/**
+ * Fill in the register images that select the specified gain. Out of range
+ * gains are silently clamped.
+ *
+ * @param[in]   gain    Gain setting
+ * @param[out]  img     Register image
+ */
+void lms_lna_gain_image(bladerf_lna_gain gain, struct lms_reg_image *img);
+void lms_rxvga1_gain_image(int gain, struct lms_reg_image *img);
+void lms_rxvga2_gain_image(int gain, struct lms_reg_image *img);
+void lms_txvga1_gain_image(int gain, struct lms_reg_image *img);
+void lms_txvga2_gain_image(int gain, struct lms_reg_image *img);
+
 /**
  * Wrapper for setting bits in an LMS6002 register via a RMW operation
  *
@@ -225,6 +299,18 @@ int lms_lpf_get_mode(struct bladerf *dev, bladerf_module mod,
  */
 int lms_set_bandwidth(struct bladerf *dev, bladerf_module mod, lms_bw bw);
 
+/**
+ * Fill in the LMS_LPF_NUM_IMAGES register images that enable the LPF of
+ * the specified module with the specified bandwidth. This is equivalent to
+ * lms_lpf_enable() followed by lms_set_bandwidth().
+ *
+ * @param[in]   mod     Module to set bandwidth for
+ * @param[in]   bw      Desired bandwidth
+ * @param[out]  img     Register images
+ */
+void lms_lpf_bandwidth_images(bladerf_module mod, lms_bw bw,
+                              struct lms_reg_image *img);
+
 /**
  * Get the bandwidth for the specified module
  *
@@ -562,6 +648,27 @@ int lms_get_frequency(struct bladerf *dev, bladerf_module mod,
 int lms_set_frequency(struct bladerf *dev,
                       bladerf_module mod, uint32_t freq);
 
+/**
+ * Set the frequency of a module in Hz, applying additional register images
+ * in the same batch as the PLL configuration. This allows settings that do
+ * not depend upon the PLL (e.g., gain and bandwidth) to be changed without
+ * additional device round trips.
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   mod         Module to change
+ * @param[in]   freq        Frequency in Hz to tune
+ * @param[in]   extra       Additional images, which must not overlap with
+ *                          the PLL, DSM, or VCOCAP registers. May be NULL
+ *                          if num_extra is 0.
+ * @param[in]   num_extra   Number of additional images
+ *                          (<= LMS_MAX_IMAGES - LMS_FREQ_NUM_IMAGES)
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int lms_set_frequency_images(struct bladerf *dev, bladerf_module mod,
+                             uint32_t freq, const struct lms_reg_image *extra,
+                             unsigned int num_extra);
+
 /**
  * Read back every register from the LMS6002D device.
  *
@@ -0,0 +1,131 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "reconfig.h"
+#include "gain.h"
+#include "lms.h"
+#include "si5338.h"
+#include "tuning.h"
+#include "log.h"
+#include "rel_assert.h"
+
+#define CONFIG_FIELDS_ALL (BLADERF_CONFIG_SAMPLERATE | \
+                           BLADERF_CONFIG_FREQUENCY  | \
+                           BLADERF_CONFIG_BANDWIDTH  | \
+                           BLADERF_CONFIG_GAIN)
+
+/* Images applied alongside the PLL configuration: the LPF bandwidth and
+ * the gain table entry */
+#define RECONFIG_MAX_IMAGES (LMS_MAX_IMAGES - LMS_FREQ_NUM_IMAGES)
+
+int reconfig_apply(struct bladerf *dev, bladerf_module module,
+                   struct bladerf_module_config *config, uint64_t *timestamp)
+{
+    const unsigned int fields = config->fields;
+    struct lms_reg_image img[RECONFIG_MAX_IMAGES];
+    const struct lms_reg_image *gain_img;
+    unsigned int num_gain_img;
+    unsigned int n = 0;
+    struct bladerf_rational_rate rate;
+    lms_bw bw = BW_28MHz;
+    int gain = 0;
+    int status;
+
+    if ((fields & ~CONFIG_FIELDS_ALL) != 0) {
+        log_debug("Invalid configuration fields: 0x%x\n", fields);
+        return BLADERF_ERR_INVAL;
+    }
+
+    /* Validate the settings and compute their register values before
+     * modifying the device */
+    if (fields & BLADERF_CONFIG_SAMPLERATE) {
+        rate = config->samplerate;
+        status = si5338_calculate_rational_sample_rate(dev, &rate, NULL);
+        if (status != 0) {
+            return status;
+        }
+    }
+
+    if (fields & BLADERF_CONFIG_BANDWIDTH) {
+        bw = lms_uint2bw(config->bandwidth);
+        lms_lpf_bandwidth_images(module, bw, &img[n]);
+        n += LMS_LPF_NUM_IMAGES;
+    }
+
+    if (fields & BLADERF_CONFIG_GAIN) {
+        /* The gain offset is specified in terms of the new frequency. It is
+         * only put in use once the device has been retuned, by
+         * tuning_set_freq_images(). */
+        if (fields & BLADERF_CONFIG_FREQUENCY) {
+            status = gain_get_images_at(dev, module, config->gain,
+                                        config->frequency, &gain_img,
+                                        &num_gain_img, &gain);
+        } else {
+            status = gain_get_images(dev, module, config->gain,
+                                     &gain_img, &num_gain_img, &gain);
+        }
+
+        if (status != 0) {
+            return status;
+        }
+
+        assert(n + num_gain_img <= RECONFIG_MAX_IMAGES);
+        memcpy(&img[n], gain_img, num_gain_img * sizeof(img[0]));
+        n += num_gain_img;
+    }
+
+    /* Apply the changes. The Si5338 is configured first, such that the
+     * LMS6002D is clocked at the new rate once it has been retuned. */
+    if (fields & BLADERF_CONFIG_SAMPLERATE) {
+        status = si5338_set_rational_sample_rate(dev, module, &rate,
+                                                 &config->samplerate);
+        if (status != 0) {
+            return status;
+        }
+    }
+
+    if (fields & BLADERF_CONFIG_FREQUENCY) {
+        status = tuning_set_freq_images(dev, module, config->frequency,
+                                        img, n);
+    } else {
+        status = lms_write_images(dev, img, n);
+    }
+
+    if (status != 0) {
+        return status;
+    }
+
+    if (fields & BLADERF_CONFIG_BANDWIDTH) {
+        config->bandwidth = lms_bw2uint(bw);
+    }
+
+    if (fields & BLADERF_CONFIG_GAIN) {
+        config->gain = gain;
+    }
+
+    if (timestamp != NULL) {
+        status = dev->fn->get_timestamp(dev, module, timestamp);
+    }
+
+    return status;
+}
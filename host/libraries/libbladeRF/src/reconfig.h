@@ -0,0 +1,49 @@
+/**
+ * @file reconfig.h
+ *
+ * @brief Changes to multiple module settings as a single operation
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef BLADERF_RECONFIG_H_
+#define BLADERF_RECONFIG_H_
+
+#include <stdint.h>
+#include "libbladeRF.h"
+#include "bladerf_priv.h"
+
+/**
+ * Apply a module configuration. See bladerf_set_module_config().
+ *
+ * @pre The caller holds the device's control lock
+ *
+ * @param[in]       dev         Device handle
+ * @param[in]       module      Module to configure
+ * @param[inout]    config      Settings to apply, updated with actual values
+ * @param[out]      timestamp   If non-NULL, updated with the timestamp
+ *                              counter value read after the changes were
+ *                              made
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int reconfig_apply(struct bladerf *dev, bladerf_module module,
+                   struct bladerf_module_config *config, uint64_t *timestamp);
+
+#endif
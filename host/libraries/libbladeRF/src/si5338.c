@@ -18,6 +18,7 @@
  * License along with this library; if not, write to the Free Software
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
+#include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
 #include "rel_assert.h"
@@ -27,12 +28,20 @@
 #include "host_config.h"
 #include "bladerf_priv.h"
 #include "log.h"
+#include "backend/backend.h"
 
 #define SI5338_EN_A     0x01
 #define SI5338_EN_B     0x02
 
 #define SI5338_F_VCO    (38400000UL * 66UL)
 
+/* Number of computed multisynth configurations retained per device */
+#define SI5338_CACHE_LEN    8
+
+/* Registers associated with a multisynth: the R divider, the output
+ * enables, and the 10 multisynth parameter registers */
+#define SI5338_MS_NUM_REGS  12
+
 /**
  * This is used set or recreate the si5338 frequency
  * Each si5338 multisynth module can be set independently
@@ -61,6 +70,24 @@ struct si5338_multisynth {
     uint8_t regs[10];
 };
 
+/* Last known contents of a multisynth's registers, in the order returned
+ * by ms_reg_addrs() */
+struct si5338_shadow {
+    bool valid;
+    uint8_t regs[SI5338_MS_NUM_REGS];
+};
+
+struct si5338_state {
+    /* Register shadows, indexed by module */
+    struct si5338_shadow shadow[NUM_MODULES];
+
+    /* Computed configurations, keyed by their (reduced) requested rate.
+     * Entries are replaced in round-robin order. */
+    struct si5338_multisynth cache[SI5338_CACHE_LEN];
+    unsigned int cache_count;
+    unsigned int cache_next;
+};
+
 void si5338_read_error(int error, const char *s)
 {
     log_debug("Could not read from si5338 (%d): %s\n", error, s);
@@ -216,38 +243,129 @@ static void si5338_pack_regs(struct si5338_multisynth *ms)
     return ;
 }
 
-static int si5338_write_multisynth(struct bladerf *dev,
-                                   struct si5338_multisynth *ms)
+/* Access a list of registers, in order, using as few device round trips as
+ * the backend supports */
+static int si5338_write_regs(struct bladerf *dev, const uint8_t *addr,
+                             const uint8_t *data, unsigned int n)
 {
-    int i, status;
-    uint8_t r_power, r_count, val;
+    int status = BLADERF_ERR_UNSUPPORTED;
+    unsigned int i;
 
-    log_verbose("Writing MS%d\n", ms->index);
+    if (n == 0) {
+        return 0;
+    }
+
+    if (dev->fn->si5338_write_regs != NULL) {
+        status = dev->fn->si5338_write_regs(dev, addr, data, n);
+    }
+
+    if (status == BLADERF_ERR_UNSUPPORTED) {
+        for (i = 0, status = 0; i < n && status == 0; i++) {
+            status = SI5338_WRITE(dev, addr[i], data[i]);
+        }
+    }
+
+    return status;
+}
+
+static int si5338_read_regs(struct bladerf *dev, const uint8_t *addr,
+                            uint8_t *data, unsigned int n)
+{
+    int status = BLADERF_ERR_UNSUPPORTED;
+    unsigned int i;
 
-    /* Write out the enables */
-    status = SI5338_READ(dev, 36 + ms->index, &val);
+    if (n == 0) {
+        return 0;
+    }
+
+    if (dev->fn->si5338_read_regs != NULL) {
+        status = dev->fn->si5338_read_regs(dev, addr, data, n);
+    }
+
+    if (status == BLADERF_ERR_UNSUPPORTED) {
+        for (i = 0, status = 0; i < n && status == 0; i++) {
+            status = SI5338_READ(dev, addr[i], &data[i]);
+        }
+    }
+
+    return status;
+}
+
+/**
+ * Get the addresses of a multisynth's registers, in the order in which
+ * they are written: the output enables, the multisynth parameters, and
+ * the R divider.
+ */
+static void si5338_ms_reg_addrs(const struct si5338_multisynth *ms,
+                                uint8_t *addr)
+{
+    unsigned int i;
+
+    addr[0] = 36 + ms->index;
+    for (i = 0; i < 10; i++) {
+        addr[1 + i] = ms->base + i;
+    }
+    addr[11] = 31 + ms->index;
+}
+
+static struct si5338_shadow *si5338_get_shadow(struct bladerf *dev,
+                                               struct si5338_multisynth *ms)
+{
+    const bladerf_module module =
+        (ms->index == 1) ? BLADERF_MODULE_RX : BLADERF_MODULE_TX;
+
+    return &dev->si5338->shadow[module];
+}
+
+/* Read the multisynth's registers into its shadow, if the shadow is not
+ * already valid */
+static int si5338_load_shadow(struct bladerf *dev,
+                              struct si5338_multisynth *ms,
+                              struct si5338_shadow *shadow)
+{
+    uint8_t addr[SI5338_MS_NUM_REGS];
+    int status;
+
+    if (shadow->valid) {
+        return 0;
+    }
+
+    si5338_ms_reg_addrs(ms, addr);
+
+    status = si5338_read_regs(dev, addr, shadow->regs, SI5338_MS_NUM_REGS);
     if (status < 0) {
         si5338_read_error(status, bladerf_strerror(status));
         return status;
     }
-    val &= ~(7);
-    val |= ms->enable;
-    log_verbose("Wrote enable register: 0x%2.2x\n", val);
-    status = SI5338_WRITE(dev, 36 + ms->index, val);
+
+    shadow->valid = true;
+    return 0;
+}
+
+static int si5338_write_multisynth(struct bladerf *dev,
+                                   struct si5338_multisynth *ms)
+{
+    struct si5338_shadow *shadow = si5338_get_shadow(dev, ms);
+    uint8_t addr[SI5338_MS_NUM_REGS];
+    uint8_t regs[SI5338_MS_NUM_REGS];
+    uint8_t wr_addr[SI5338_MS_NUM_REGS];
+    uint8_t wr_data[SI5338_MS_NUM_REGS];
+    unsigned int i, n;
+    uint8_t r_power, r_count;
+    int status;
+
+    log_verbose("Writing MS%d\n", ms->index);
+
+    /* The output enable register is updated via a read-modify-write */
+    status = si5338_load_shadow(dev, ms, shadow);
     if (status < 0) {
-        si5338_write_error(status, bladerf_strerror(status));
         return status;
     }
 
-    /* Write out the registers */
-    for (i = 0 ; i < 10 ; i++) {
-        status = SI5338_WRITE(dev, ms->base + i, *(ms->regs+i));
-        if (status < 0) {
-            si5338_write_error(status, bladerf_strerror(status));
-            return status;
-        }
-        log_verbose("Wrote regs[%d]: 0x%2.2x\n", i, *(ms->regs+i));
-    }
+    si5338_ms_reg_addrs(ms, addr);
+
+    regs[0] = (shadow->regs[0] & ~7) | ms->enable;
+    memcpy(&regs[1], ms->regs, sizeof(ms->regs));
 
     /* Calculate r_power from c_count */
     r_power = 0;
@@ -258,55 +376,58 @@ static int si5338_write_multisynth(struct bladerf *dev,
     }
 
     /* Set the r value to the log2(r_count) to match Figure 18 */
-    val = 0xc0;
-    val |= (r_power<<2);
+    regs[11] = 0xc0 | (r_power << 2);
+
+    /* Only write the registers that differ from their current values */
+    for (i = n = 0; i < SI5338_MS_NUM_REGS; i++) {
+        if (regs[i] != shadow->regs[i]) {
+            wr_addr[n] = addr[i];
+            wr_data[n] = regs[i];
+            n++;
+
+            log_verbose("Writing reg %u: 0x%2.2x\n", addr[i], regs[i]);
+        }
+    }
 
-    log_verbose("Wrote r register: 0x%2.2x\n", val);
+    log_verbose("Writing %u of %u MS%d registers\n",
+                n, SI5338_MS_NUM_REGS, ms->index);
 
-    status = SI5338_WRITE(dev, 31 + ms->index, val);
+    status = si5338_write_regs(dev, wr_addr, wr_data, n);
     if (status < 0) {
+        /* The device state is unknown if a write failed part way through */
+        shadow->valid = false;
         si5338_write_error(status, bladerf_strerror(status));
+        return status;
     }
 
-    return status ;
+    memcpy(shadow->regs, regs, sizeof(regs));
+    return 0;
 }
 
 static int si5338_read_multisynth(struct bladerf *dev,
                                   struct si5338_multisynth *ms)
 {
-    int i, status;
+    struct si5338_shadow *shadow = si5338_get_shadow(dev, ms);
     uint8_t val;
+    int status;
 
     log_verbose("Reading MS%d\n", ms->index);
 
-    /* Read the enable bits */
-    status = SI5338_READ(dev, 36 + ms->index, &val);
+    status = si5338_load_shadow(dev, ms, shadow);
     if (status < 0) {
-        si5338_read_error(status, bladerf_strerror(status));
-        return status ;
+        return status;
     }
-    ms->enable = val&7;
-    log_verbose("Read enable register: 0x%2.2x\n", val);
+
+    /* Read the enable bits */
+    ms->enable = shadow->regs[0] & 7;
+    log_verbose("Read enable register: 0x%2.2x\n", shadow->regs[0]);
 
     /* Read all of the multisynth registers */
-    for (i = 0; i < 10; i++) {
-        status = SI5338_READ(dev, ms->base + i, ms->regs+i);
-        if (status < 0) {
-            si5338_read_error(status, bladerf_strerror(status));
-            return status;
-        }
-        log_verbose("Read regs[%d]: 0x%2.2x\n", i, *(ms->regs+i));
-    }
+    memcpy(ms->regs, &shadow->regs[1], sizeof(ms->regs));
 
-    /* Populate the RxDIV value from the register */
-    status = SI5338_READ(dev, 31 + ms->index, &val);
-    if (status < 0) {
-        si5338_read_error(status, bladerf_strerror(status));
-        return status;
-    }
     /* RxDIV is stored as a power of 2, so restore it on readback */
-    log_verbose("Read r register: 0x%2.2x\n", val);
-    val = (val>>2)&7;
+    log_verbose("Read r register: 0x%2.2x\n", shadow->regs[11]);
+    val = (shadow->regs[11] >> 2) & 7;
     ms->r = (1<<val);
 
     /* Unpack the regs into appropriate values */
@@ -315,6 +436,40 @@ static int si5338_read_multisynth(struct bladerf *dev,
     return 0;
 }
 
+static inline bool si5338_rate_equal(const struct bladerf_rational_rate *a,
+                                     const struct bladerf_rational_rate *b)
+{
+    return a->integer == b->integer && a->num == b->num && a->den == b->den;
+}
+
+/* Look up a previously computed configuration for a reduced rate */
+static bool si5338_cache_lookup(struct si5338_state *state,
+                                const struct bladerf_rational_rate *rate,
+                                struct si5338_multisynth *ms)
+{
+    unsigned int i;
+
+    for (i = 0; i < state->cache_count; i++) {
+        if (si5338_rate_equal(&state->cache[i].requested, rate)) {
+            *ms = state->cache[i];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void si5338_cache_insert(struct si5338_state *state,
+                                const struct si5338_multisynth *ms)
+{
+    state->cache[state->cache_next] = *ms;
+    state->cache_next = (state->cache_next + 1) % SI5338_CACHE_LEN;
+
+    if (state->cache_count < SI5338_CACHE_LEN) {
+        state->cache_count++;
+    }
+}
+
 static void si5338_calculate_samplerate(struct si5338_multisynth *ms,
                                         struct bladerf_rational_rate *rate)
 {
@@ -417,13 +572,13 @@ static int si5338_calculate_multisynth(struct si5338_multisynth *ms,
     return 0;
 }
 
-int si5338_set_rational_sample_rate(struct bladerf *dev, bladerf_module module,
-                                    struct bladerf_rational_rate *rate,
-                                    struct bladerf_rational_rate *actual_ret)
+/* Reduce and validate a requested rate, and look up or calculate the
+ * associated multisynth configuration. No device I/O is performed. */
+static int si5338_prepare_multisynth(struct bladerf *dev,
+                                     struct bladerf_rational_rate *rate,
+                                     struct si5338_multisynth *ms)
 {
-    struct si5338_multisynth ms;
     struct bladerf_rational_rate req;
-    struct bladerf_rational_rate actual;
     int status;
 
     /* Enforce minimum sample rate */
@@ -436,7 +591,55 @@ int si5338_set_rational_sample_rate(struct bladerf *dev, bladerf_module module,
     /* Save off the value */
     req = *rate;
 
-    /* Setup the multisynth enables and index */
+    /* Calculate multisynth values, or reuse those computed previously */
+    if (si5338_cache_lookup(dev->si5338, &req, ms)) {
+        log_verbose("Using cached MS configuration for %"PRIu64" + "
+                    "%"PRIu64"/%"PRIu64"\n", req.integer, req.num, req.den);
+        return 0;
+    }
+
+    status = si5338_calculate_multisynth(ms, &req);
+    if(status != 0) {
+        return status;
+    }
+
+    /* Get the actual rate */
+    si5338_calculate_samplerate(ms, &ms->actual);
+    ms->requested = req;
+    si5338_cache_insert(dev->si5338, ms);
+
+    return 0;
+}
+
+int si5338_calculate_rational_sample_rate(struct bladerf *dev,
+                                          struct bladerf_rational_rate *rate,
+                                          struct bladerf_rational_rate *actual)
+{
+    struct si5338_multisynth ms;
+    int status;
+
+    status = si5338_prepare_multisynth(dev, rate, &ms);
+    if (status == 0 && actual != NULL) {
+        memcpy(actual, &ms.actual, sizeof(*actual));
+    }
+
+    return status;
+}
+
+int si5338_set_rational_sample_rate(struct bladerf *dev, bladerf_module module,
+                                    struct bladerf_rational_rate *rate,
+                                    struct bladerf_rational_rate *actual_ret)
+{
+    struct si5338_multisynth ms;
+    int status;
+
+    status = si5338_prepare_multisynth(dev, rate, &ms);
+    if (status != 0) {
+        return status;
+    }
+
+    /* Setup the multisynth enables and index. The configuration may have
+     * been computed and cached for the other module. */
     ms.enable = SI5338_EN_A;
     if (module == BLADERF_MODULE_TX) {
         ms.enable |= SI5338_EN_B;
@@ -448,16 +651,8 @@ int si5338_set_rational_sample_rate(struct bladerf *dev, bladerf_module module,
     /* Update the base address register */
     si5338_update_base(&ms);
 
-    /* Calculate multisynth values */
-    status = si5338_calculate_multisynth(&ms, &req);
-    if(status != 0) {
-        return status;
-    }
-
-    /* Get the actual rate */
-    si5338_calculate_samplerate(&ms, &actual);
     if (actual_ret) {
-        memcpy(actual_ret, &actual, sizeof(*actual_ret));
+        memcpy(actual_ret, &ms.actual, sizeof(*actual_ret));
     }
 
     /* Program it to the part */
@@ -546,3 +741,74 @@ int si5338_get_sample_rate(struct bladerf *dev, bladerf_module module,
     return 0;
 }
 
+
+int si5338_init(struct bladerf *dev)
+{
+    dev->si5338 = calloc(1, sizeof(*dev->si5338));
+    if (dev->si5338 == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    return 0;
+}
+
+void si5338_deinit(struct bladerf *dev)
+{
+    free(dev->si5338);
+    dev->si5338 = NULL;
+}
+
+void si5338_invalidate(struct bladerf *dev)
+{
+    unsigned int i;
+
+    if (dev->si5338 != NULL) {
+        for (i = 0; i < NUM_MODULES; i++) {
+            dev->si5338->shadow[i].valid = false;
+        }
+    }
+}
+
+int si5338_set_mimo_mode(struct bladerf *dev, bladerf_mimo_mode mode)
+{
+    struct si5338_reg {
+        uint8_t addr;
+        uint8_t val;
+    };
+
+    /* Enable the output that drives the MIMO connector's clock */
+    static const struct si5338_reg master[] = {
+        { 39, 0x01 }, { 34, 0x22 },
+    };
+
+    /* Select the MIMO connector's clock input as the reference */
+    static const struct si5338_reg slave[] = {
+        { 6, 0x04 }, { 28, 0x2b }, { 29, 0x28 }, { 30, 0xa8 },
+    };
+
+    const struct si5338_reg *regs;
+    size_t i, n;
+    int status = 0;
+
+    switch (mode) {
+        case BLADERF_MIMO_MASTER:
+            regs = master;
+            n = ARRAY_SIZE(master);
+            break;
+
+        case BLADERF_MIMO_SLAVE:
+            regs = slave;
+            n = ARRAY_SIZE(slave);
+            break;
+
+        default:
+            return BLADERF_ERR_INVAL;
+    }
+
+    for (i = 0; i < n && status == 0; i++) {
+        status = SI5338_WRITE(dev, regs[i].addr, regs[i].val);
+    }
+
+    si5338_invalidate(dev);
+    return status;
+}
@@ -40,4 +40,57 @@ int si5338_get_sample_rate(struct bladerf *dev, bladerf_module module, unsigned
 int si5338_set_rational_sample_rate(struct bladerf *dev, bladerf_module module, struct bladerf_rational_rate *rate, struct bladerf_rational_rate *actual);
 int si5338_get_rational_sample_rate(struct bladerf *dev, bladerf_module module, struct bladerf_rational_rate *rate);
 
+/**
+ * Validate a rational sample rate and compute the resulting actual rate,
+ * without performing any device I/O. The computed configuration is cached,
+ * such that a subsequent si5338_set_rational_sample_rate() call for the
+ * same rate need not recompute it.
+ *
+ * @param[in]       dev     Device handle
+ * @param[inout]    rate    Requested rate. This is reduced in place.
+ * @param[out]      actual  If non-NULL, updated with the actual rate
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL for an unsupported rate
+ */
+int si5338_calculate_rational_sample_rate(struct bladerf *dev,
+                                          struct bladerf_rational_rate *rate,
+                                          struct bladerf_rational_rate *actual);
+
+/**
+ * Allocate the Si5338 register shadows and the cache of computed multisynth
+ * configurations. This performs no device I/O.
+ *
+ * @param   dev     Device handle
+ *
+ * @return 0 on success, BLADERF_ERR_MEM on failure
+ */
+int si5338_init(struct bladerf *dev);
+
+/**
+ * Free the state allocated by si5338_init()
+ *
+ * @param   dev     Device handle
+ */
+void si5338_deinit(struct bladerf *dev);
+
+/**
+ * Discard the register shadows, forcing the multisynth registers to be read
+ * from the device on their next access. This must be called when Si5338
+ * registers are written by other means, such as bladerf_si5338_write().
+ *
+ * @param   dev     Device handle
+ */
+void si5338_invalidate(struct bladerf *dev);
+
+/**
+ * Configure the Si5338 to drive, or use as its reference, the clock on the
+ * MIMO connector
+ *
+ * @param   dev     Device handle
+ * @param   mode    MIMO clock mode
+ *
+ * @return 0 on success, BLADERF_ERR_* on failure
+ */
+int si5338_set_mimo_mode(struct bladerf *dev, bladerf_mimo_mode mode);
+
 #endif
@@ -1043,6 +1043,17 @@ int sync_tx(struct bladerf *dev, void *samples, unsigned int num_samples,
     return status;
 }
 
+bool sync_get_timestamp(struct bladerf_sync *sync, uint64_t *timestamp)
+{
+    if (sync == NULL ||
+        sync->stream_config.format != BLADERF_FORMAT_SC16_Q11_META) {
+        return false;
+    }
+
+    *timestamp = sync->meta.curr_timestamp;
+    return true;
+}
+
 unsigned int sync_buf2idx(struct buffer_mgmt *b, void *addr)
 {
     unsigned int i;
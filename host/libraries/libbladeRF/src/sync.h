@@ -155,6 +155,19 @@ int sync_rx(struct bladerf *dev, void *samples, unsigned int num_samples,
 int sync_tx(struct bladerf *dev, void *samples, unsigned int num_samples,
              struct bladerf_metadata *metadata, unsigned int timeout_ms);
 
+/**
+ * Get the stream timestamp the synchronous interface has consumed (RX) or
+ * produced (TX) samples up to. This is only tracked when using the
+ * BLADERF_FORMAT_SC16_Q11_META format. The caller must hold the associated
+ * sync_lock.
+ *
+ * @param[in]   sync        Sync handle
+ * @param[out]  timestamp   Current timestamp
+ *
+ * @return true if the timestamp is valid, false otherwise
+ */
+bool sync_get_timestamp(struct bladerf_sync *sync, uint64_t *timestamp);
+
 unsigned int sync_buf2idx(struct buffer_mgmt *b, void *addr);
 
 void * sync_idx2buf(struct buffer_mgmt *b, unsigned int idx);
@@ -22,6 +22,7 @@
 #include "lms.h"
 #include "xb.h"
 #include "dc_cal_table.h"
+#include "gain.h"
 #include "log.h"
 
 
@@ -61,11 +62,23 @@ int tuning_select_band(struct bladerf *dev, bladerf_module module,
 int tuning_set_freq(struct bladerf *dev, bladerf_module module,
                     unsigned int frequency)
 {
+    return tuning_set_freq_images(dev, module, frequency, NULL, 0);
+}
+
+int tuning_set_freq_images(struct bladerf *dev, bladerf_module module,
+                           unsigned int frequency,
+                           const struct lms_reg_image *extra,
+                           unsigned int num_extra)
+{
+    const unsigned int rf_frequency = frequency;
     int status;
     bladerf_xb attached;
     int16_t dc_i, dc_q;
-    const struct dc_cal_tbl *dc_cal =
+    int16_t gain, phase;
+    struct dc_cal_tbl *dc_cal =
         (module == BLADERF_MODULE_RX) ? dev->cal.dc_rx : dev->cal.dc_tx;
+    struct dc_cal_tbl *iq_cal =
+        (module == BLADERF_MODULE_RX) ? dev->cal.iq_rx : dev->cal.iq_tx;
 
     status = xb_get_attached(dev, &attached);
     if (status) {
@@ -86,7 +99,7 @@ int tuning_set_freq(struct bladerf *dev, bladerf_module module,
                 return status;
             }
 
-            frequency = 1248000000 - frequency;
+            frequency = tuning_lms_freq(attached, frequency);
 
         } else {
             status = xb200_set_path(dev, module, BLADERF_XB200_BYPASS);
@@ -95,7 +108,8 @@ int tuning_set_freq(struct bladerf *dev, bladerf_module module,
         }
     }
 
-    status = lms_set_frequency(dev, module, frequency);
+    status = lms_set_frequency_images(dev, module, frequency,
+                                      extra, num_extra);
     if (status != 0) {
         return status;
     }
@@ -124,9 +138,42 @@ int tuning_set_freq(struct bladerf *dev, bladerf_module module,
                     (module == BLADERF_MODULE_RX) ? "RX" : "TX", dc_i, dc_q);
     }
 
+    if (iq_cal != NULL) {
+        dc_cal_tbl_vals(iq_cal, frequency, &gain, &phase);
+
+        status = dev->fn->set_correction(dev, module,
+                                         BLADERF_CORR_FPGA_GAIN, gain);
+        if (status != 0) {
+            return status;
+        }
+
+        status = dev->fn->set_correction(dev, module,
+                                         BLADERF_CORR_FPGA_PHASE, phase);
+        if (status != 0) {
+            return status;
+        }
+
+        log_verbose("Set %s IQ imbalance cal (gain, phase) to: (%d, %d)\n",
+                    (module == BLADERF_MODULE_RX) ? "RX" : "TX", gain, phase);
+    }
+
+    /* Gain offsets are specified in terms of the RF frequency. The offset in
+     * use is only changed once the device has been retuned, so that it
+     * continues to match the hardware on failure. */
+    gain_update_offset(dev, module, rf_frequency);
+
     return status;
 }
 
+unsigned int tuning_lms_freq(bladerf_xb attached, unsigned int frequency)
+{
+    if (attached == BLADERF_XB_200 && frequency < BLADERF_FREQUENCY_MIN) {
+        return 1248000000 - frequency;
+    } else {
+        return frequency;
+    }
+}
+
 int tuning_get_freq(struct bladerf *dev, bladerf_module module,
                     unsigned int *frequency)
 {
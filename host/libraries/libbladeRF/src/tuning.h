@@ -25,6 +25,8 @@
 #ifndef BLADERF_TUNING_H_
 #define BLADERF_TUNING_H_
 
+#include "lms.h"
+
 /**
  * Configure the device for operation in the high or low band, based
  * upon the provided frequency
@@ -49,6 +51,26 @@ int tuning_select_band(struct bladerf *dev, bladerf_module module,
  */
 int tuning_set_freq(struct bladerf *dev, bladerf_module module,
                     unsigned int frequency);
+
+/**
+ * Tune to the specified frequency, applying additional LMS6002D register
+ * images in the same batch as the PLL configuration.
+ * See lms_set_frequency_images().
+ *
+ * @param   dev         Device handle
+ * @param   module      Module to configure
+ * @param   frequency   Desired frequency
+ * @param   extra       Additional register images. May be NULL if
+ *                      num_extra is 0.
+ * @param   num_extra   Number of additional register images
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int tuning_set_freq_images(struct bladerf *dev, bladerf_module module,
+                           unsigned int frequency,
+                           const struct lms_reg_image *extra,
+                           unsigned int num_extra);
+
 /**
  * Get the current frequency that the specified module is tuned to
  *
@@ -61,5 +83,17 @@ int tuning_set_freq(struct bladerf *dev, bladerf_module module,
 int tuning_get_freq(struct bladerf *dev, bladerf_module module,
                     unsigned int *frequency);
 
+/**
+ * Get the frequency to which the LMS6002D is tuned in order to tune the
+ * specified module to the desired frequency. This differs from the desired
+ * frequency when the XB-200 mixer path is used.
+ *
+ * @param   attached    Attached expansion board
+ * @param   frequency   Desired frequency
+ *
+ * @return LMS6002D frequency
+ */
+unsigned int tuning_lms_freq(bladerf_xb attached, unsigned int frequency);
+
 
 #endif
@@ -40,6 +40,7 @@ struct compat {
 
 static const struct compat fw_compat_tbl[] = {
     /*   Firmware       requires  >=        FPGA */
+    { VERSION(1, 9, 0),                 VERSION(0, 0, 2) },
     { VERSION(1, 8, 0),                 VERSION(0, 0, 2) },
     { VERSION(1, 7, 1),                 VERSION(0, 0, 2) },
     { VERSION(1, 7, 0),                 VERSION(0, 0, 2) },
@@ -49,6 +50,7 @@ static const struct compat fw_compat_tbl[] = {
 
 static const struct compat fpga_compat_tbl[] = {
     /*    FPGA          requires >=        Firmware */
+    { VERSION(0, 1, 3),                 VERSION(1, 6, 1) },
     { VERSION(0, 1, 2),                 VERSION(1, 6, 1) },
     { VERSION(0, 1, 1),                 VERSION(1, 6, 1) },
     { VERSION(0, 1, 0),                 VERSION(1, 6, 1) },
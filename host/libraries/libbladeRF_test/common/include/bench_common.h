@@ -0,0 +1,120 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef BENCH_COMMON_H_
+#define BENCH_COMMON_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <libbladeRF.h>
+
+/**
+ * Collection of latency measurements
+ */
+struct bench_latency {
+    uint64_t *ns;
+    size_t count;
+    size_t capacity;
+};
+
+/**
+ * Summary of a bench_latency collection, in microseconds
+ */
+struct bench_summary {
+    size_t count;
+    double mean_us;
+    double p50_us;
+    double p99_us;
+    double p999_us;
+    double max_us;
+};
+
+/**
+ * Initialize a latency collection
+ *
+ * @param   l           Collection to initialize
+ * @param   capacity    Number of measurements to preallocate space for. The
+ *                      collection grows as needed, but preallocating avoids
+ *                      doing so while measuring.
+ *
+ * @return 0 on success, -1 on allocation failure
+ */
+int bench_latency_init(struct bench_latency *l, size_t capacity);
+
+/**
+ * Free memory associated with a latency collection
+ */
+void bench_latency_deinit(struct bench_latency *l);
+
+/**
+ * Discard all measurements in a collection, retaining its allocation
+ */
+static inline void bench_latency_reset(struct bench_latency *l)
+{
+    l->count = 0;
+}
+
+/**
+ * Add a measurement to a collection. If the collection cannot be grown,
+ * the measurement is dropped.
+ */
+void bench_latency_add(struct bench_latency *l, uint64_t ns);
+
+/**
+ * Summarize the measurements in a collection. Note that this reorders the
+ * collection's measurements.
+ */
+void bench_latency_summarize(struct bench_latency *l, struct bench_summary *s);
+
+/**
+ * @return Monotonic time, in nanoseconds, from an arbitrary starting point
+ */
+uint64_t bench_time_ns(void);
+
+/**
+ * @return CPU time (user + system) consumed by this process, in seconds
+ */
+double bench_cpu_time_s(void);
+
+/**
+ * Write a string to a JSON document as a quoted, escaped JSON string
+ */
+void bench_json_string(FILE *f, const char *str);
+
+/**
+ * Write a latency summary to a JSON document, as an object member named
+ * `name`. The member is not followed by a comma.
+ */
+void bench_json_summary(FILE *f, const char *name,
+                        const struct bench_summary *s);
+
+/**
+ * Write "library" and "device" object members describing the library
+ * version and the specified device to a JSON document. Both members are
+ * followed by a comma.
+ */
+void bench_json_device_info(FILE *f, struct bladerf *dev);
+
+#endif
@@ -0,0 +1,251 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_config.h"
+
+#if BLADERF_OS_WINDOWS || BLADERF_OS_OSX
+#include "clock_gettime.h"
+#else
+#include <time.h>
+#endif
+
+#include "conversions.h"
+#include "bench_common.h"
+
+#if BLADERF_OS_WINDOWS
+#   include <windows.h>
+#else
+#   include <sys/time.h>
+#   include <sys/resource.h>
+#endif
+
+/* clock_gettime() shims on some platforms only support CLOCK_REALTIME */
+#if BLADERF_OS_LINUX
+#   define BENCH_CLOCK CLOCK_MONOTONIC
+#else
+#   define BENCH_CLOCK CLOCK_REALTIME
+#endif
+
+int bench_latency_init(struct bench_latency *l, size_t capacity)
+{
+    l->count = 0;
+    l->capacity = capacity == 0 ? 1024 : capacity;
+    l->ns = malloc(l->capacity * sizeof(l->ns[0]));
+
+    if (l->ns == NULL) {
+        l->capacity = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+void bench_latency_deinit(struct bench_latency *l)
+{
+    free(l->ns);
+    l->ns = NULL;
+    l->count = 0;
+    l->capacity = 0;
+}
+
+void bench_latency_add(struct bench_latency *l, uint64_t ns)
+{
+    uint64_t *tmp;
+
+    if (l->count == l->capacity) {
+        tmp = realloc(l->ns, 2 * l->capacity * sizeof(l->ns[0]));
+        if (tmp == NULL) {
+            return;
+        }
+
+        l->ns = tmp;
+        l->capacity *= 2;
+    }
+
+    l->ns[l->count++] = ns;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    const uint64_t x = *(const uint64_t *) a;
+    const uint64_t y = *(const uint64_t *) b;
+
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of a sorted collection */
+static double percentile_us(const struct bench_latency *l, double p)
+{
+    size_t rank = (size_t) (p * l->count + 0.5);
+
+    if (rank == 0) {
+        rank = 1;
+    } else if (rank > l->count) {
+        rank = l->count;
+    }
+
+    return l->ns[rank - 1] / 1000.0;
+}
+
+void bench_latency_summarize(struct bench_latency *l, struct bench_summary *s)
+{
+    size_t i;
+    double sum = 0;
+
+    memset(s, 0, sizeof(*s));
+    s->count = l->count;
+
+    if (l->count == 0) {
+        return;
+    }
+
+    qsort(l->ns, l->count, sizeof(l->ns[0]), compare_u64);
+
+    for (i = 0; i < l->count; i++) {
+        sum += l->ns[i];
+    }
+
+    s->mean_us = sum / l->count / 1000.0;
+    s->p50_us = percentile_us(l, 0.50);
+    s->p99_us = percentile_us(l, 0.99);
+    s->p999_us = percentile_us(l, 0.999);
+    s->max_us = l->ns[l->count - 1] / 1000.0;
+}
+
+uint64_t bench_time_ns(void)
+{
+    struct timespec t;
+    clock_gettime(BENCH_CLOCK, &t);
+    return (uint64_t) t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+double bench_cpu_time_s(void)
+{
+#if BLADERF_OS_WINDOWS
+    FILETIME create, exit, kernel, user;
+    ULARGE_INTEGER k, u;
+
+    if (!GetProcessTimes(GetCurrentProcess(), &create, &exit, &kernel, &user)) {
+        return 0;
+    }
+
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+
+    /* FILETIME values are in units of 100 ns */
+    return (k.QuadPart + u.QuadPart) * 100e-9;
+#else
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+#endif
+}
+
+void bench_json_string(FILE *f, const char *str)
+{
+    fputc('"', f);
+
+    for (; str != NULL && *str != '\0'; str++) {
+        switch (*str) {
+            case '"':
+                fputs("\\\"", f);
+                break;
+
+            case '\\':
+                fputs("\\\\", f);
+                break;
+
+            case '\n':
+                fputs("\\n", f);
+                break;
+
+            default:
+                if ((unsigned char) *str < 0x20) {
+                    fprintf(f, "\\u%04x", (unsigned char) *str);
+                } else {
+                    fputc(*str, f);
+                }
+                break;
+        }
+    }
+
+    fputc('"', f);
+}
+
+void bench_json_summary(FILE *f, const char *name,
+                        const struct bench_summary *s)
+{
+    fprintf(f, "\"%s\": { \"count\": %lu, \"mean\": %.3f, \"p50\": %.3f, "
+               "\"p99\": %.3f, \"p999\": %.3f, \"max\": %.3f }",
+            name, (unsigned long) s->count, s->mean_us,
+            s->p50_us, s->p99_us, s->p999_us, s->max_us);
+}
+
+void bench_json_device_info(FILE *f, struct bladerf *dev)
+{
+    struct bladerf_version lib_version, fw_version, fpga_version;
+    struct bladerf_devinfo info;
+
+    bladerf_version(&lib_version);
+
+    fprintf(f, "  \"library\": ");
+    bench_json_string(f, lib_version.describe);
+    fprintf(f, ",\n");
+
+    fprintf(f, "  \"device\": {\n");
+
+    if (bladerf_get_devinfo(dev, &info) == 0) {
+        fprintf(f, "    \"backend\": ");
+        bench_json_string(f, backend_description(info.backend));
+        fprintf(f, ",\n    \"serial\": ");
+        bench_json_string(f, info.serial);
+        fprintf(f, ",\n");
+    }
+
+    if (bladerf_fw_version(dev, &fw_version) == 0) {
+        fprintf(f, "    \"firmware\": ");
+        bench_json_string(f, fw_version.describe);
+        fprintf(f, ",\n");
+    }
+
+    if (bladerf_fpga_version(dev, &fpga_version) == 0) {
+        fprintf(f, "    \"fpga\": ");
+        bench_json_string(f, fpga_version.describe);
+        fprintf(f, ",\n");
+    }
+
+    fprintf(f, "    \"usb_speed\": ");
+    bench_json_string(f, devspeed2str(bladerf_device_speed(dev)));
+    fprintf(f, "\n  },\n");
+}
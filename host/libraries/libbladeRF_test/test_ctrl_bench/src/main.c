@@ -0,0 +1,529 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* This program measures the latency of control-path API calls, along with
+ * the number of device round trips each requires, to help identify which
+ * calls are worth optimizing. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+
+#include <libbladeRF.h>
+#include <getopt.h>
+
+#include "conversions.h"
+#include "log.h"
+#include "bench_common.h"
+
+#ifndef ARRAY_SIZE
+#   define ARRAY_SIZE(x) (sizeof(x) / sizeof(x[0]))
+#endif
+
+#define DEFAULT_ITERATIONS  100
+
+/* Values cycled through by each test. Consecutive values differ so that
+ * each call results in a change to the device's configuration. */
+static const unsigned int frequencies[] = {
+    300000000, 915000000, 1575420000, 2400000000u, 3500000000u
+};
+
+static const int rx_gains[] = { 5, 15, 25, 35 };
+static const int tx_gains[] = { -20, -10, 0, 10 };
+
+static const unsigned int samplerates[] = {
+    2000000, 10000000, 20000000, 40000000
+};
+
+static const unsigned int bandwidths[] = {
+    1500000, 5000000, 10000000, 28000000
+};
+
+static const int16_t corrections[] = { -1024, 512, 0, 1024 };
+
+typedef int (*test_fn)(struct bladerf *dev, bladerf_module module,
+                       bladerf_correction corr, unsigned int i);
+
+static int test_frequency(struct bladerf *dev, bladerf_module module,
+                          bladerf_correction corr, unsigned int i)
+{
+    return bladerf_set_frequency(dev, module,
+                                 frequencies[i % ARRAY_SIZE(frequencies)]);
+}
+
+static int test_gain(struct bladerf *dev, bladerf_module module,
+                     bladerf_correction corr, unsigned int i)
+{
+    if (module == BLADERF_MODULE_RX) {
+        return bladerf_set_gain(dev, module,
+                                rx_gains[i % ARRAY_SIZE(rx_gains)]);
+    } else {
+        return bladerf_set_gain(dev, module,
+                                tx_gains[i % ARRAY_SIZE(tx_gains)]);
+    }
+}
+
+static int test_samplerate(struct bladerf *dev, bladerf_module module,
+                           bladerf_correction corr, unsigned int i)
+{
+    return bladerf_set_sample_rate(dev, module,
+                                   samplerates[i % ARRAY_SIZE(samplerates)],
+                                   NULL);
+}
+
+static int test_bandwidth(struct bladerf *dev, bladerf_module module,
+                          bladerf_correction corr, unsigned int i)
+{
+    return bladerf_set_bandwidth(dev, module,
+                                 bandwidths[i % ARRAY_SIZE(bandwidths)],
+                                 NULL);
+}
+
+static int test_timestamp(struct bladerf *dev, bladerf_module module,
+                          bladerf_correction corr, unsigned int i)
+{
+    uint64_t timestamp;
+    return bladerf_get_timestamp(dev, module, &timestamp);
+}
+
+static int test_correction(struct bladerf *dev, bladerf_module module,
+                           bladerf_correction corr, unsigned int i)
+{
+    return bladerf_set_correction(dev, module, corr,
+                                  corrections[i % ARRAY_SIZE(corrections)]);
+}
+
+struct test {
+    const char *name;       /* Name used to select the test */
+    const char *function;   /* API function being measured */
+    test_fn fn;
+    bool per_correction;    /* Run once for each correction type */
+};
+
+static const struct test tests[] = {
+    { "frequency",  "bladerf_set_frequency",    test_frequency,   false },
+    { "gain",       "bladerf_set_gain",         test_gain,        false },
+    { "samplerate", "bladerf_set_sample_rate",  test_samplerate,  false },
+    { "bandwidth",  "bladerf_set_bandwidth",    test_bandwidth,   false },
+    { "timestamp",  "bladerf_get_timestamp",    test_timestamp,   false },
+    { "correction", "bladerf_set_correction",   test_correction,  true  },
+};
+
+static const struct {
+    bladerf_correction corr;
+    const char *name;
+} correction_types[] = {
+    { BLADERF_CORR_LMS_DCOFF_I, "dcoff_i" },
+    { BLADERF_CORR_LMS_DCOFF_Q, "dcoff_q" },
+    { BLADERF_CORR_FPGA_PHASE,  "phase"   },
+    { BLADERF_CORR_FPGA_GAIN,   "gain"    },
+};
+
+struct params {
+    char *device_str;
+    FILE *out;
+    unsigned int iterations;
+    bool tests[ARRAY_SIZE(tests)];
+    bool modules[2];
+};
+
+#define OPTSTR "hd:o:i:t:m:"
+const struct option long_options[] = {
+    { "help",           no_argument,        0,  'h' },
+    { "device",         required_argument,  0,  'd' },
+    { "output",         required_argument,  0,  'o' },
+    { "iterations",     required_argument,  0,  'i' },
+    { "tests",          required_argument,  0,  't' },
+    { "modules",        required_argument,  0,  'm' },
+
+    /* Verbosity options */
+    { "verbosity",      required_argument,  0,  1,  },
+    { "lib-verbosity",  required_argument,  0,  2,  },
+    { 0,                0,                  0,  0   },
+};
+
+const struct numeric_suffix count_suffixes[] = {
+    { "K", 1000 },
+    { "M", 1000000 },
+};
+
+const unsigned int num_count_suffixes = sizeof(count_suffixes) / sizeof(count_suffixes[0]);
+
+static void print_usage(const char *argv0)
+{
+    size_t i;
+
+    printf("Usage: %s [options]\n", argv0);
+    printf("Measure the latency of control-path API calls and the number of device\n");
+    printf("round trips each requires. Results are written as JSON.\n");
+    printf("\n");
+
+    printf("Options:\n");
+    printf("    -d, --device <device>       Use the specified device. By default,\n");
+    printf("                                any device found will be used.\n");
+    printf("    -o, --output <file>         Write results to the specified file.\n");
+    printf("                                Default = stdout.\n");
+    printf("    -i, --iterations <n>        Calls to make per test. Default = %u.\n", DEFAULT_ITERATIONS);
+    printf("    -t, --tests <list>          Comma-separated list of tests to run.\n");
+    printf("                                Default = all. Available tests:\n");
+    for (i = 0; i < ARRAY_SIZE(tests); i++) {
+        printf("                                  %-12s %s()\n",
+               tests[i].name, tests[i].function);
+    }
+    printf("    -m, --modules <list>        Modules to test: rx, tx, or rx,tx.\n");
+    printf("                                Default = rx,tx.\n");
+    printf("    -h, --help                  Show this help text\n");
+    printf("    --verbosity <level>         Set test verbosity (Default: warning)\n");
+    printf("    --lib-verbosity <level>     Set libbladeRF verbosity (Default: warning)\n");
+    printf("\n");
+
+    printf("Notes:\n");
+    printf("    Round trips are reported per call, grouped by the device peripheral\n");
+    printf("    accessed. See bladerf_get_round_trips().\n");
+    printf("\n");
+}
+
+/* Parse a comma-separated list of names, setting selected[i] for each
+ * name matching names[i] */
+static int parse_names(const char *str, const char *desc,
+                       const char * const *names, size_t num_names,
+                       bool *selected)
+{
+    char *copy, *token, *comma;
+    size_t i;
+    bool found;
+    int status = 0;
+
+    copy = strdup(str);
+    if (copy == NULL) {
+        perror("strdup");
+        return -1;
+    }
+
+    memset(selected, 0, num_names * sizeof(selected[0]));
+
+    for (token = copy; token != NULL && status == 0; ) {
+        comma = strchr(token, ',');
+        if (comma != NULL) {
+            *comma = '\0';
+        }
+
+        found = false;
+        for (i = 0; i < num_names; i++) {
+            if (!strcasecmp(token, names[i]) || !strcasecmp(token, "all")) {
+                selected[i] = true;
+                found = true;
+            }
+        }
+
+        if (!found) {
+            log_error("Invalid %s: %s\n", desc, token);
+            status = -1;
+        }
+
+        token = (comma != NULL) ? comma + 1 : NULL;
+    }
+
+    free(copy);
+    return status;
+}
+
+static int handle_cmdline(int argc, char *argv[], struct params *p)
+{
+    int c;
+    size_t i;
+    bool ok;
+    bladerf_log_level level;
+    const char *test_names[ARRAY_SIZE(tests)];
+    const char * const module_names[] = { "rx", "tx" };
+    int status = 0;
+
+    memset(p, 0, sizeof(*p));
+    p->out = stdout;
+    p->iterations = DEFAULT_ITERATIONS;
+
+    for (i = 0; i < ARRAY_SIZE(tests); i++) {
+        test_names[i] = tests[i].name;
+        p->tests[i] = true;
+    }
+
+    p->modules[BLADERF_MODULE_RX] = true;
+    p->modules[BLADERF_MODULE_TX] = true;
+
+    while (status == 0 &&
+           (c = getopt_long(argc, argv, OPTSTR, long_options, NULL)) >= 0) {
+        switch (c) {
+            case 1:
+                level = str2loglevel(optarg, &ok);
+                if (!ok) {
+                    log_error("Invalid log level provided: %s\n", optarg);
+                    return -1;
+                } else {
+                    log_set_verbosity(level);
+                }
+                break;
+
+            case 2:
+                level = str2loglevel(optarg, &ok);
+                if (!ok) {
+                    log_error("Invalid log level provided: %s\n", optarg);
+                    return -1;
+                } else {
+                    bladerf_log_set_verbosity(level);
+                }
+                break;
+
+            case 'h':
+                return 1;
+
+            case 'd':
+                if (p->device_str != NULL) {
+                    log_error("Device was already specified.\n");
+                    return -1;
+                }
+
+                p->device_str = strdup(optarg);
+                if (p->device_str == NULL) {
+                    perror("strdup");
+                    return -1;
+                }
+                break;
+
+            case 'o':
+                if (p->out != stdout) {
+                    log_error("Output file already provided.\n");
+                    return -1;
+                }
+
+                p->out = fopen(optarg, "w");
+                if (p->out == NULL) {
+                    log_error("Failed to open output file - %s\n",
+                              strerror(errno));
+                    return -1;
+                }
+                break;
+
+            case 'i':
+                p->iterations = str2uint_suffix(optarg, 1, UINT_MAX,
+                                                count_suffixes,
+                                                num_count_suffixes,
+                                                &ok);
+                if (!ok) {
+                    log_error("Invalid iteration count: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 't':
+                status = parse_names(optarg, "test", test_names,
+                                     ARRAY_SIZE(tests), p->tests);
+                break;
+
+            case 'm':
+                status = parse_names(optarg, "module", module_names,
+                                     ARRAY_SIZE(module_names), p->modules);
+                break;
+
+            default:
+                return -1;
+        }
+    }
+
+    return status;
+}
+
+static inline uint64_t round_trip_total(const struct bladerf_round_trips *rt)
+{
+    return rt->lms + rt->si5338 + rt->fpga + rt->other;
+}
+
+static void print_result(FILE *f, bool first, const struct test *t,
+                         bladerf_module module, const char *corr_name,
+                         int status, struct bench_summary *latency,
+                         const struct bladerf_round_trips *before,
+                         const struct bladerf_round_trips *after,
+                         unsigned int calls)
+{
+    fprintf(f, "%s    {\n", first ? "" : ",\n");
+    fprintf(f, "      \"test\": \"%s\",\n", t->name);
+    fprintf(f, "      \"function\": \"%s\",\n", t->function);
+    fprintf(f, "      \"module\": \"%s\",\n",
+            module == BLADERF_MODULE_RX ? "rx" : "tx");
+
+    if (corr_name != NULL) {
+        fprintf(f, "      \"correction\": \"%s\",\n", corr_name);
+    }
+
+    fprintf(f, "      \"status\": ");
+    bench_json_string(f, status == 0 ? "ok" : bladerf_strerror(status));
+    fprintf(f, ",\n");
+    fprintf(f, "      \"calls\": %u,\n", calls);
+
+    fprintf(f, "      ");
+    bench_json_summary(f, "latency_us", latency);
+    fprintf(f, ",\n");
+
+    fprintf(f, "      \"round_trips_per_call\": { ");
+    if (calls > 0) {
+        fprintf(f, "\"total\": %.2f, \"lms\": %.2f, \"si5338\": %.2f, "
+                   "\"fpga\": %.2f, \"other\": %.2f",
+                (double) (round_trip_total(after) -
+                          round_trip_total(before)) / calls,
+                (double) (after->lms - before->lms) / calls,
+                (double) (after->si5338 - before->si5338) / calls,
+                (double) (after->fpga - before->fpga) / calls,
+                (double) (after->other - before->other) / calls);
+    }
+    fprintf(f, " }\n");
+
+    fprintf(f, "    }");
+}
+
+/* Run a test, returning 0 on success or the first failure's status */
+static int run_test(struct bladerf *dev, const struct params *p,
+                    const struct test *t, bladerf_module module,
+                    bladerf_correction corr, const char *corr_name,
+                    struct bench_latency *lat, bool first)
+{
+    int status = 0;
+    unsigned int i;
+    uint64_t t0;
+    struct bladerf_round_trips before, after;
+    struct bench_summary summary;
+
+    log_info("Running %s() on %s%s%s...\n", t->function,
+             module == BLADERF_MODULE_RX ? "RX" : "TX",
+             corr_name ? ", correction=" : "", corr_name ? corr_name : "");
+
+    bench_latency_reset(lat);
+
+    bladerf_get_round_trips(dev, &before);
+
+    for (i = 0; i < p->iterations && status == 0; i++) {
+        t0 = bench_time_ns();
+        status = t->fn(dev, module, corr, i);
+        bench_latency_add(lat, bench_time_ns() - t0);
+    }
+
+    bladerf_get_round_trips(dev, &after);
+
+    if (status != 0) {
+        log_error("%s() failed on call %u: %s\n", t->function, i,
+                  bladerf_strerror(status));
+    }
+
+    bench_latency_summarize(lat, &summary);
+    print_result(p->out, first, t, module, corr_name, status, &summary,
+                 &before, &after, i);
+    fflush(p->out);
+
+    return status;
+}
+
+static int run_tests(struct bladerf *dev, const struct params *p)
+{
+    size_t t, c;
+    bladerf_module m;
+    struct bench_latency lat;
+    bool first = true;
+    int status = 0;
+
+    if (bench_latency_init(&lat, p->iterations) != 0) {
+        log_error("Failed to allocate latency measurements.\n");
+        return BLADERF_ERR_MEM;
+    }
+
+    fprintf(p->out, "{\n");
+    fprintf(p->out, "  \"benchmark\": \"control\",\n");
+    bench_json_device_info(p->out, dev);
+    fprintf(p->out, "  \"iterations\": %u,\n", p->iterations);
+    fprintf(p->out, "  \"results\": [\n");
+
+    for (t = 0; t < ARRAY_SIZE(tests); t++) {
+        if (!p->tests[t]) {
+            continue;
+        }
+
+        for (m = BLADERF_MODULE_RX; m <= BLADERF_MODULE_TX; m++) {
+            if (!p->modules[m]) {
+                continue;
+            }
+
+            if (tests[t].per_correction) {
+                for (c = 0; c < ARRAY_SIZE(correction_types); c++) {
+                    status |= run_test(dev, p, &tests[t], m,
+                                       correction_types[c].corr,
+                                       correction_types[c].name,
+                                       &lat, first);
+                    first = false;
+                }
+            } else {
+                status |= run_test(dev, p, &tests[t], m,
+                                   BLADERF_CORR_LMS_DCOFF_I, NULL,
+                                   &lat, first);
+                first = false;
+            }
+        }
+    }
+
+    fprintf(p->out, "\n  ]\n}\n");
+
+    bench_latency_deinit(&lat);
+    return status;
+}
+
+int main(int argc, char *argv[])
+{
+    int status;
+    struct params p;
+    struct bladerf *dev = NULL;
+
+    log_set_verbosity(BLADERF_LOG_LEVEL_WARNING);
+
+    status = handle_cmdline(argc, argv, &p);
+
+    if (status == 0) {
+        status = bladerf_open(&dev, p.device_str);
+        if (status != 0) {
+            log_error("Failed to open device: %s\n",
+                      bladerf_strerror(status));
+        } else {
+            status = run_tests(dev, &p);
+            bladerf_close(dev);
+        }
+    } else if (status > 0) {
+        print_usage(argv[0]);
+        status = 0;
+    }
+
+    if (p.out != NULL && p.out != stdout) {
+        fclose(p.out);
+    }
+
+    free(p.device_str);
+    return status == 0 ? 0 : 1;
+}
@@ -0,0 +1,404 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <libbladeRF.h>
+
+#include "bench.h"
+#include "log.h"
+
+/* Metadata header layout, as per the FPGA's sample message format */
+#define META_HEADER_SIZE        16
+#define META_TIMESTAMP_OFFSET   4
+
+/* Message sizes, in bytes, for each USB speed */
+#define MSG_SIZE_SS             2048
+#define MSG_SIZE_HS             1024
+
+struct async_ctx {
+    bladerf_module module;
+
+    void **buffers;
+    unsigned int num_buffers;
+    unsigned int buf_idx;
+
+    /* Samples (including metadata headers) per buffer, and the number of
+     * those which are payload */
+    unsigned int buffer_size;
+    unsigned int payload_size;
+
+    /* Samples per message, and the number of those which are payload */
+    unsigned int msg_samples;
+    unsigned int msg_payload;
+
+    uint64_t t_warm_end;
+    uint64_t t_end;
+    uint64_t t_prev;
+    uint64_t t_start;
+    uint64_t t_stop;
+    double cpu_start;
+    double cpu_stop;
+    bool measuring;
+
+    bool ts_valid;
+    uint64_t ts_expected;
+
+    struct bench_latency *lat;
+    struct bench_result *r;
+};
+
+static const char *mode_strs[BENCH_NUM_MODES] = {
+    "sync_rx", "sync_tx", "async_rx", "async_tx"
+};
+
+const char *bench_mode_str(enum bench_mode mode)
+{
+    if (mode < BENCH_NUM_MODES) {
+        return mode_strs[mode];
+    }
+
+    return "unknown";
+}
+
+void bench_init_params(struct bench_params *p)
+{
+    memset(p, 0, sizeof(*p));
+
+    p->out = stdout;
+    p->duration_s = DEFAULT_DURATION_S;
+    p->warmup_s = DEFAULT_WARMUP_S;
+    p->timeout_ms = DEFAULT_TIMEOUT_MS;
+}
+
+static inline bool is_rx(enum bench_mode mode)
+{
+    return mode == BENCH_SYNC_RX || mode == BENCH_ASYNC_RX;
+}
+
+static inline uint64_t s_to_ns(double s)
+{
+    return (uint64_t) (s * 1e9);
+}
+
+static inline uint64_t read_timestamp(const uint8_t *msg)
+{
+    uint64_t ts = 0;
+    int i;
+
+    for (i = 7; i >= 0; i--) {
+        ts = (ts << 8) | msg[META_TIMESTAMP_OFFSET + i];
+    }
+
+    return ts;
+}
+
+/* Account for a block of RX samples starting at the specified timestamp.
+ * Discontinuities are only recorded if r is non-NULL. */
+static void check_timestamp(bool *valid, uint64_t *expected, uint64_t ts,
+                            unsigned int count, struct bench_result *r)
+{
+    if (r != NULL && *valid && ts != *expected) {
+        r->overruns++;
+
+        if (ts > *expected) {
+            r->samples_dropped += ts - *expected;
+        }
+
+        log_verbose("%s: Discontinuity at t=0x%016llx (expected 0x%016llx)\n",
+                    __FUNCTION__, (unsigned long long) ts,
+                    (unsigned long long) *expected);
+    }
+
+    *expected = ts + count;
+    *valid = true;
+}
+
+static int run_sync(struct bladerf *dev, const struct bench_params *p,
+                    const struct bench_point *pt, struct bench_latency *lat,
+                    struct bench_result *r)
+{
+    int status;
+    const bool rx = is_rx(pt->mode);
+    const bladerf_module module = rx ? BLADERF_MODULE_RX : BLADERF_MODULE_TX;
+    struct bladerf_metadata meta;
+    int16_t *samples;
+    uint64_t t0, t_warm_end, t_end;
+    uint64_t t1 = 0;
+    uint64_t t_start = 0;
+    bool measuring = false;
+    bool ts_valid = false;
+    uint64_t ts_expected = 0;
+
+    samples = calloc(pt->block_size, 2 * sizeof(int16_t));
+    if (samples == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    status = bladerf_sync_config(dev, module,
+                                 rx ? BLADERF_FORMAT_SC16_Q11_META :
+                                      BLADERF_FORMAT_SC16_Q11,
+                                 pt->num_buffers, pt->buffer_size,
+                                 pt->num_xfers, p->timeout_ms);
+    if (status != 0) {
+        log_error("Failed to configure %s sync interface: %s\n",
+                  rx ? "RX" : "TX", bladerf_strerror(status));
+        goto out;
+    }
+
+    status = bladerf_enable_module(dev, module, true);
+    if (status != 0) {
+        log_error("Failed to enable %s module: %s\n",
+                  rx ? "RX" : "TX", bladerf_strerror(status));
+        goto out;
+    }
+
+    t_warm_end = bench_time_ns() + s_to_ns(p->warmup_s);
+    t_end = t_warm_end + s_to_ns(p->duration_s);
+
+    while (status == 0) {
+        t0 = bench_time_ns();
+
+        if (rx) {
+            memset(&meta, 0, sizeof(meta));
+            meta.flags = BLADERF_META_FLAG_RX_NOW;
+            status = bladerf_sync_rx(dev, samples, pt->block_size,
+                                     &meta, p->timeout_ms);
+        } else {
+            status = bladerf_sync_tx(dev, samples, pt->block_size,
+                                     NULL, p->timeout_ms);
+        }
+
+        t1 = bench_time_ns();
+
+        if (status != 0) {
+            log_error("%s failed: %s\n", rx ? "RX" : "TX",
+                      bladerf_strerror(status));
+            break;
+        }
+
+        if (measuring) {
+            bench_latency_add(lat, t1 - t0);
+            r->samples += rx ? meta.actual_count : pt->block_size;
+
+            if (rx) {
+                check_timestamp(&ts_valid, &ts_expected, meta.timestamp,
+                                meta.actual_count, r);
+            }
+
+            if (t1 >= t_end) {
+                break;
+            }
+        } else {
+            if (rx) {
+                check_timestamp(&ts_valid, &ts_expected, meta.timestamp,
+                                meta.actual_count, NULL);
+            }
+
+            /* Measurement begins with the next call */
+            if (t1 >= t_warm_end) {
+                measuring = true;
+                t_start = t1;
+                r->cpu_s = bench_cpu_time_s();
+            }
+        }
+    }
+
+    if (status == 0) {
+        r->elapsed_s = (t1 - t_start) * 1e-9;
+        r->cpu_s = bench_cpu_time_s() - r->cpu_s;
+    }
+
+    bladerf_enable_module(dev, module, false);
+
+out:
+    free(samples);
+    return status;
+}
+
+static void *async_callback(struct bladerf *dev, struct bladerf_stream *stream,
+                            struct bladerf_metadata *meta, void *samples,
+                            size_t num_samples, void *user_data)
+{
+    struct async_ctx *ctx = (struct async_ctx *) user_data;
+    const uint64_t now = bench_time_ns();
+    const uint8_t *msg;
+    unsigned int i;
+    void *next;
+    struct bench_result *r = ctx->measuring ? ctx->r : NULL;
+
+    if (samples != NULL) {
+        if (ctx->measuring) {
+            bench_latency_add(ctx->lat, now - ctx->t_prev);
+            ctx->r->samples += ctx->payload_size;
+        } else if (now >= ctx->t_warm_end) {
+            /* Measurement begins with the next callback */
+            ctx->measuring = true;
+            ctx->t_start = now;
+            ctx->cpu_start = bench_cpu_time_s();
+        }
+
+        if (ctx->module == BLADERF_MODULE_RX) {
+            msg = (const uint8_t *) samples;
+            for (i = 0; i < ctx->buffer_size; i += ctx->msg_samples) {
+                check_timestamp(&ctx->ts_valid, &ctx->ts_expected,
+                                read_timestamp(msg), ctx->msg_payload, r);
+                msg += ctx->msg_samples * 2 * sizeof(int16_t);
+            }
+        }
+
+        if (ctx->measuring && now >= ctx->t_end) {
+            ctx->t_stop = now;
+            ctx->cpu_stop = bench_cpu_time_s();
+            return BLADERF_STREAM_SHUTDOWN;
+        }
+    }
+
+    ctx->t_prev = now;
+
+    next = ctx->buffers[ctx->buf_idx];
+    ctx->buf_idx = (ctx->buf_idx + 1) % ctx->num_buffers;
+
+    return next;
+}
+
+static int run_async(struct bladerf *dev, const struct bench_params *p,
+                     const struct bench_point *pt, struct bench_latency *lat,
+                     struct bench_result *r)
+{
+    int status;
+    const bool rx = is_rx(pt->mode);
+    struct async_ctx ctx;
+    struct bladerf_stream *stream;
+    unsigned int i;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.module = rx ? BLADERF_MODULE_RX : BLADERF_MODULE_TX;
+    ctx.num_buffers = pt->num_buffers;
+    ctx.buffer_size = pt->buffer_size;
+    ctx.lat = lat;
+    ctx.r = r;
+
+    if (bladerf_device_speed(dev) == BLADERF_DEVICE_SPEED_HIGH) {
+        ctx.msg_samples = MSG_SIZE_HS / (2 * sizeof(int16_t));
+    } else {
+        ctx.msg_samples = MSG_SIZE_SS / (2 * sizeof(int16_t));
+    }
+
+    if (rx) {
+        ctx.msg_payload = ctx.msg_samples -
+                          META_HEADER_SIZE / (2 * sizeof(int16_t));
+        ctx.payload_size = ctx.buffer_size / ctx.msg_samples * ctx.msg_payload;
+    } else {
+        ctx.payload_size = ctx.buffer_size;
+    }
+
+    status = bladerf_init_stream(&stream, dev, async_callback, &ctx.buffers,
+                                 pt->num_buffers,
+                                 rx ? BLADERF_FORMAT_SC16_Q11_META :
+                                      BLADERF_FORMAT_SC16_Q11,
+                                 pt->buffer_size, pt->num_xfers, &ctx);
+    if (status != 0) {
+        log_error("Failed to initialize %s stream: %s\n",
+                  rx ? "RX" : "TX", bladerf_strerror(status));
+        return status;
+    }
+
+    for (i = 0; i < pt->num_buffers; i++) {
+        memset(ctx.buffers[i], 0, pt->buffer_size * 2 * sizeof(int16_t));
+    }
+
+    status = bladerf_set_stream_timeout(dev, ctx.module, p->timeout_ms);
+    if (status != 0) {
+        log_error("Failed to set stream timeout: %s\n",
+                  bladerf_strerror(status));
+        goto out;
+    }
+
+    status = bladerf_enable_module(dev, ctx.module, true);
+    if (status != 0) {
+        log_error("Failed to enable %s module: %s\n",
+                  rx ? "RX" : "TX", bladerf_strerror(status));
+        goto out;
+    }
+
+    ctx.t_warm_end = bench_time_ns() + s_to_ns(p->warmup_s);
+    ctx.t_end = ctx.t_warm_end + s_to_ns(p->duration_s);
+
+    status = bladerf_stream(stream, ctx.module);
+    if (status != 0) {
+        log_error("%s stream failed: %s\n", rx ? "RX" : "TX",
+                  bladerf_strerror(status));
+    } else {
+        r->elapsed_s = (ctx.t_stop - ctx.t_start) * 1e-9;
+        r->cpu_s = ctx.cpu_stop - ctx.cpu_start;
+    }
+
+    bladerf_enable_module(dev, ctx.module, false);
+
+out:
+    bladerf_deinit_stream(stream);
+    return status;
+}
+
+int bench_run_point(struct bladerf *dev, const struct bench_params *p,
+                    const struct bench_point *pt, struct bench_latency *lat,
+                    struct bench_result *r)
+{
+    int status;
+    const bladerf_module module =
+        is_rx(pt->mode) ? BLADERF_MODULE_RX : BLADERF_MODULE_TX;
+
+    memset(r, 0, sizeof(*r));
+    bench_latency_reset(lat);
+
+    status = bladerf_set_sample_rate(dev, module, pt->samplerate,
+                                     &r->samplerate_actual);
+    if (status != 0) {
+        log_error("Failed to set sample rate to %u: %s\n",
+                  pt->samplerate, bladerf_strerror(status));
+        goto out;
+    }
+
+    switch (pt->mode) {
+        case BENCH_SYNC_RX:
+        case BENCH_SYNC_TX:
+            status = run_sync(dev, p, pt, lat, r);
+            break;
+
+        case BENCH_ASYNC_RX:
+        case BENCH_ASYNC_TX:
+            status = run_async(dev, p, pt, lat, r);
+            break;
+
+        default:
+            status = BLADERF_ERR_INVAL;
+    }
+
+    bench_latency_summarize(lat, &r->latency);
+
+out:
+    r->status = status;
+    return status;
+}
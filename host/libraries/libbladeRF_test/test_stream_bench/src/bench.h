@@ -0,0 +1,136 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef STREAM_BENCH_H_
+#define STREAM_BENCH_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <libbladeRF.h>
+#include "bench_common.h"
+
+/* Sweep defaults */
+#define DEFAULT_SAMPLERATES     "2M,10M,40M"
+#define DEFAULT_BUFFER_SIZES    "8192"
+#define DEFAULT_BUFFER_COUNTS   "32"
+#define DEFAULT_XFER_COUNTS     "16"
+
+/* Measurement defaults */
+#define DEFAULT_DURATION_S      1.0
+#define DEFAULT_WARMUP_S        0.25
+#define DEFAULT_TIMEOUT_MS      1000
+
+/* Maximum number of values in each swept parameter's list */
+#define MAX_SWEEP_VALUES        16
+
+enum bench_mode {
+    BENCH_SYNC_RX,
+    BENCH_SYNC_TX,
+    BENCH_ASYNC_RX,
+    BENCH_ASYNC_TX,
+
+    BENCH_NUM_MODES
+};
+
+struct bench_params {
+    char *device_str;
+    FILE *out;
+
+    bool modes[BENCH_NUM_MODES];
+
+    unsigned int samplerates[MAX_SWEEP_VALUES];
+    unsigned int num_samplerates;
+
+    unsigned int buffer_sizes[MAX_SWEEP_VALUES];    /* Units of samples */
+    unsigned int num_buffer_sizes;
+
+    unsigned int buffer_counts[MAX_SWEEP_VALUES];
+    unsigned int num_buffer_counts;
+
+    unsigned int xfer_counts[MAX_SWEEP_VALUES];
+    unsigned int num_xfer_counts;
+
+    /* Samples per sync call. 0 implies the stream buffer size. */
+    unsigned int block_size;
+
+    double duration_s;
+    double warmup_s;
+    unsigned int timeout_ms;
+};
+
+/**
+ * A single point in the parameter sweep
+ */
+struct bench_point {
+    enum bench_mode mode;
+    unsigned int samplerate;
+    unsigned int buffer_size;
+    unsigned int num_buffers;
+    unsigned int num_xfers;
+    unsigned int block_size;
+};
+
+/**
+ * Measurements taken at a single point in the parameter sweep
+ */
+struct bench_result {
+    int status;
+    unsigned int samplerate_actual;
+
+    uint64_t samples;
+    double elapsed_s;
+    double cpu_s;
+
+    /* For sync modes, this is the duration of each bladerf_sync_rx/tx()
+     * call. For async modes, this is the time between callbacks. */
+    struct bench_summary latency;
+
+    /* Discontinuities observed in RX timestamps, and the total number of
+     * samples missing across them. TX underruns are not reported by the
+     * device, so these are always 0 for TX modes. */
+    unsigned int overruns;
+    uint64_t samples_dropped;
+};
+
+const char *bench_mode_str(enum bench_mode mode);
+
+void bench_init_params(struct bench_params *p);
+
+/**
+ * Measure stream performance at the specified point
+ *
+ * @param   dev     Device handle
+ * @param   p       Benchmark parameters
+ * @param   pt      Point to measure
+ * @param   lat     Latency collection to use while measuring
+ * @param   r       Results
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure. The failure is
+ *         also recorded in r->status.
+ */
+int bench_run_point(struct bladerf *dev, const struct bench_params *p,
+                    const struct bench_point *pt, struct bench_latency *lat,
+                    struct bench_result *r);
+
+#endif
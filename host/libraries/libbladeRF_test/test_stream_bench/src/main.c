@@ -0,0 +1,604 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+
+#include <libbladeRF.h>
+#include <getopt.h>
+
+#include "conversions.h"
+#include "log.h"
+#include "bench.h"
+
+/* FIXME these should be provided in libbladeRF.h */
+#define SAMPLERATE_MIN          160000u
+#define SAMPLERATE_MAX          40000000u
+
+/* Stream buffers must be a multiple of this many samples */
+#define BUFFER_SIZE_MULTIPLE    1024
+
+#define OPTSTR "hd:o:m:s:B:C:X:b:t:w:T:"
+const struct option long_options[] = {
+    { "help",           no_argument,        0,  'h' },
+
+    /* Device configuration */
+    { "device",         required_argument,  0,  'd' },
+
+    /* Benchmark configuration */
+    { "output",         required_argument,  0,  'o' },
+    { "modes",          required_argument,  0,  'm' },
+    { "duration",       required_argument,  0,  't' },
+    { "warmup",         required_argument,  0,  'w' },
+    { "block-size",     required_argument,  0,  'b' },
+
+    /* Swept stream configuration */
+    { "samplerates",    required_argument,  0,  's' },
+    { "buffer-sizes",   required_argument,  0,  'B' },
+    { "buffer-counts",  required_argument,  0,  'C' },
+    { "num-xfers",      required_argument,  0,  'X' },
+    { "timeout",        required_argument,  0,  'T' },
+
+    /* Verbosity options */
+    { "verbosity",      required_argument,  0,  1,  },
+    { "lib-verbosity",  required_argument,  0,  2,  },
+    { 0,                0,                  0,  0   },
+};
+
+const struct numeric_suffix freq_suffixes[] = {
+    { "K",   1000 },
+    { "kHz", 1000 },
+    { "M",   1000000 },
+    { "MHz", 1000000 },
+};
+
+const unsigned int num_freq_suffixes = sizeof(freq_suffixes) / sizeof(freq_suffixes[0]);
+
+const struct numeric_suffix size_suffixes[] = {
+    { "K",  1024 },
+    { "M",  1024 * 1024 },
+};
+
+const unsigned int num_size_suffixes = sizeof(size_suffixes) / sizeof(size_suffixes[0]);
+
+static void print_usage(const char *argv0)
+{
+    printf("Usage: %s [options]\n", argv0);
+    printf("Measure stream throughput, CPU usage, and latency over a sweep of\n");
+    printf("stream configurations. Results are written as JSON.\n");
+    printf("\n");
+
+    printf("Device configuration options:\n");
+    printf("    -d, --device <device>       Use the specified device. By default,\n");
+    printf("                                any device found will be used.\n");
+    printf("\n");
+
+    printf("Benchmark configuration options:\n");
+    printf("    -o, --output <file>         Write results to the specified file.\n");
+    printf("                                Default = stdout.\n");
+    printf("    -m, --modes <list>          Stream modes to benchmark. Options are:\n");
+    printf("                                  sync_rx, sync_tx, async_rx, async_tx\n");
+    printf("                                Default = all.\n");
+    printf("    -t, --duration <seconds>    Measurement duration per configuration.\n");
+    printf("                                Default = %.2f.\n", DEFAULT_DURATION_S);
+    printf("    -w, --warmup <seconds>      Time to stream before measuring.\n");
+    printf("                                Default = %.2f.\n", DEFAULT_WARMUP_S);
+    printf("    -b, --block-size <n>        # samples to RX/TX per sync call.\n");
+    printf("                                Default = stream buffer size.\n");
+    printf("\n");
+
+    printf("Stream configuration options (each accepts a comma-separated list):\n");
+    printf("    -s, --samplerates <list>    Sample rates. Default = %s.\n", DEFAULT_SAMPLERATES);
+    printf("    -B, --buffer-sizes <list>   # samples per stream buffer. Default = %s.\n", DEFAULT_BUFFER_SIZES);
+    printf("    -C, --buffer-counts <list>  # of stream buffers. Default = %s.\n", DEFAULT_BUFFER_COUNTS);
+    printf("    -X, --num-xfers <list>      # in-flight transfers. Default = %s.\n", DEFAULT_XFER_COUNTS);
+    printf("    -T, --timeout <n>           Stream timeout, in ms. Default = %u.\n", DEFAULT_TIMEOUT_MS);
+    printf("\n");
+
+    printf("Misc options:\n");
+    printf("    -h, --help                  Show this help text\n");
+    printf("    --verbosity <level>         Set test verbosity (Default: warning)\n");
+    printf("    --lib-verbosity <level>     Set libbladeRF verbosity (Default: warning)\n");
+    printf("\n");
+
+    printf("Notes:\n");
+    printf("    Every combination of the stream configuration values is measured.\n");
+    printf("    Combinations that are not valid for a mode are reported with a\n");
+    printf("    status of \"skipped\".\n");
+    printf("\n");
+    printf("    Latency is the duration of each bladerf_sync_rx/tx() call for sync\n");
+    printf("    modes, and the time between stream callbacks for async modes.\n");
+    printf("\n");
+    printf("    RX overruns are detected via discontinuities in sample timestamps.\n");
+    printf("    TX underruns are not reported by the device, and are shown as null.\n");
+    printf("\n");
+}
+
+/* Split off the next token of a comma-separated list, advancing *str past it.
+ * Returns NULL when no tokens remain. */
+static char *next_token(char **str)
+{
+    char *token = *str;
+    char *comma;
+
+    if (token == NULL || *token == '\0') {
+        return NULL;
+    }
+
+    comma = strchr(token, ',');
+    if (comma != NULL) {
+        *comma = '\0';
+        *str = comma + 1;
+    } else {
+        *str = NULL;
+    }
+
+    return token;
+}
+
+/* Parse a comma-separated list of unsigned integers */
+static int parse_list(const char *str, const char *desc,
+                      unsigned int min, unsigned int max,
+                      const struct numeric_suffix *suffixes, int num_suffixes,
+                      unsigned int *values, unsigned int *count)
+{
+    char *copy, *token, *rest;
+    bool ok = true;
+
+    copy = strdup(str);
+    if (copy == NULL) {
+        perror("strdup");
+        return -1;
+    }
+
+    *count = 0;
+
+    rest = copy;
+    while (ok && (token = next_token(&rest)) != NULL) {
+        if (*count >= MAX_SWEEP_VALUES) {
+            log_error("Too many %s values (max %d).\n",
+                      desc, MAX_SWEEP_VALUES);
+            ok = false;
+            break;
+        }
+
+        values[*count] = str2uint_suffix(token, min, max,
+                                         suffixes, num_suffixes, &ok);
+        if (!ok) {
+            log_error("Invalid %s: %s\n", desc, token);
+        } else {
+            (*count)++;
+        }
+    }
+
+    free(copy);
+
+    if (ok && *count == 0) {
+        log_error("No %s values provided.\n", desc);
+        ok = false;
+    }
+
+    return ok ? 0 : -1;
+}
+
+static int parse_modes(const char *str, struct bench_params *p)
+{
+    char *copy, *token, *rest;
+    int i;
+    bool found;
+    int status = 0;
+
+    copy = strdup(str);
+    if (copy == NULL) {
+        perror("strdup");
+        return -1;
+    }
+
+    memset(p->modes, 0, sizeof(p->modes));
+
+    rest = copy;
+    while (status == 0 && (token = next_token(&rest)) != NULL) {
+        found = false;
+
+        for (i = 0; i < BENCH_NUM_MODES; i++) {
+            if (!strcasecmp(token, bench_mode_str(i))) {
+                p->modes[i] = true;
+                found = true;
+            } else if (!strcasecmp(token, "all")) {
+                p->modes[i] = true;
+                found = true;
+            }
+        }
+
+        if (!found) {
+            log_error("Invalid mode: %s\n", token);
+            status = -1;
+        }
+    }
+
+    free(copy);
+    return status;
+}
+
+int handle_cmdline(int argc, char *argv[], struct bench_params *p)
+{
+    int c;
+    int i;
+    bool ok;
+    bool modes_set = false;
+    bladerf_log_level level;
+    int status = 0;
+
+    bench_init_params(p);
+
+    while (status == 0 &&
+           (c = getopt_long(argc, argv, OPTSTR, long_options, &i)) >= 0) {
+        switch (c) {
+
+            case 1:
+                level = str2loglevel(optarg, &ok);
+                if (!ok) {
+                    log_error("Invalid log level provided: %s\n", optarg);
+                    return -1;
+                } else {
+                    log_set_verbosity(level);
+                }
+                break;
+
+            case 2:
+                level = str2loglevel(optarg, &ok);
+                if (!ok) {
+                    log_error("Invalid log level provided: %s\n", optarg);
+                    return -1;
+                } else {
+                    bladerf_log_set_verbosity(level);
+                }
+                break;
+
+            case 'h':
+                return 1;
+
+            case 'd':
+                if (p->device_str != NULL) {
+                    log_error("Device was already specified.\n");
+                    return -1;
+                }
+
+                p->device_str = strdup(optarg);
+                if (p->device_str == NULL) {
+                    perror("strdup");
+                    return -1;
+                }
+                break;
+
+            case 'o':
+                if (p->out != stdout) {
+                    log_error("Output file already provided.\n");
+                    return -1;
+                }
+
+                p->out = fopen(optarg, "w");
+                if (p->out == NULL) {
+                    log_error("Failed to open output file - %s\n",
+                              strerror(errno));
+                    return -1;
+                }
+                break;
+
+            case 'm':
+                status = parse_modes(optarg, p);
+                modes_set = true;
+                break;
+
+            case 't':
+                p->duration_s = str2double(optarg, 0.001, 3600.0, &ok);
+                if (!ok) {
+                    log_error("Invalid duration: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 'w':
+                p->warmup_s = str2double(optarg, 0.0, 3600.0, &ok);
+                if (!ok) {
+                    log_error("Invalid warmup time: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 'b':
+                p->block_size = str2uint_suffix(optarg, 1, UINT_MAX,
+                                                size_suffixes,
+                                                num_size_suffixes,
+                                                &ok);
+                if (!ok) {
+                    log_error("Invalid block size: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 's':
+                status = parse_list(optarg, "sample rate",
+                                    SAMPLERATE_MIN, SAMPLERATE_MAX,
+                                    freq_suffixes, num_freq_suffixes,
+                                    p->samplerates, &p->num_samplerates);
+                break;
+
+            case 'B':
+                status = parse_list(optarg, "buffer size", 1, UINT_MAX,
+                                    size_suffixes, num_size_suffixes,
+                                    p->buffer_sizes, &p->num_buffer_sizes);
+                break;
+
+            case 'C':
+                status = parse_list(optarg, "buffer count", 1, UINT_MAX,
+                                    NULL, 0,
+                                    p->buffer_counts, &p->num_buffer_counts);
+                break;
+
+            case 'X':
+                status = parse_list(optarg, "transfer count", 1, UINT_MAX,
+                                    NULL, 0,
+                                    p->xfer_counts, &p->num_xfer_counts);
+                break;
+
+            case 'T':
+                p->timeout_ms = str2uint(optarg, 1, UINT_MAX, &ok);
+                if (!ok) {
+                    log_error("Invalid stream timeout: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            default:
+                return -1;
+        }
+    }
+
+    if (status != 0) {
+        return status;
+    }
+
+    if (!modes_set) {
+        for (i = 0; i < BENCH_NUM_MODES; i++) {
+            p->modes[i] = true;
+        }
+    }
+
+    if (p->num_samplerates == 0) {
+        status = parse_list(DEFAULT_SAMPLERATES, "sample rate",
+                            SAMPLERATE_MIN, SAMPLERATE_MAX,
+                            freq_suffixes, num_freq_suffixes,
+                            p->samplerates, &p->num_samplerates);
+    }
+
+    if (status == 0 && p->num_buffer_sizes == 0) {
+        status = parse_list(DEFAULT_BUFFER_SIZES, "buffer size", 1, UINT_MAX,
+                            size_suffixes, num_size_suffixes,
+                            p->buffer_sizes, &p->num_buffer_sizes);
+    }
+
+    if (status == 0 && p->num_buffer_counts == 0) {
+        status = parse_list(DEFAULT_BUFFER_COUNTS, "buffer count", 1, UINT_MAX,
+                            NULL, 0,
+                            p->buffer_counts, &p->num_buffer_counts);
+    }
+
+    if (status == 0 && p->num_xfer_counts == 0) {
+        status = parse_list(DEFAULT_XFER_COUNTS, "transfer count", 1, UINT_MAX,
+                            NULL, 0,
+                            p->xfer_counts, &p->num_xfer_counts);
+    }
+
+    return status;
+}
+
+/* Returns a description of why a point cannot be measured, or NULL if it
+ * is valid */
+static const char *check_point(const struct bench_point *pt)
+{
+    const bool sync = pt->mode == BENCH_SYNC_RX || pt->mode == BENCH_SYNC_TX;
+
+    if (pt->buffer_size % BUFFER_SIZE_MULTIPLE != 0) {
+        return "buffer size is not a multiple of 1024";
+    }
+
+    if (sync && pt->num_xfers >= pt->num_buffers) {
+        return "sync interface requires fewer transfers than buffers";
+    }
+
+    if (!sync && pt->num_xfers > pt->num_buffers) {
+        return "stream requires no more transfers than buffers";
+    }
+
+    return NULL;
+}
+
+static void print_result(FILE *f, bool first, const struct bench_point *pt,
+                         const struct bench_result *r, const char *skip)
+{
+    const bool rx = pt->mode == BENCH_SYNC_RX || pt->mode == BENCH_ASYNC_RX;
+    const bool sync = pt->mode == BENCH_SYNC_RX || pt->mode == BENCH_SYNC_TX;
+
+    fprintf(f, "%s    {\n", first ? "" : ",\n");
+    fprintf(f, "      \"mode\": \"%s\",\n", bench_mode_str(pt->mode));
+    fprintf(f, "      \"samplerate\": %u,\n", pt->samplerate);
+    fprintf(f, "      \"buffer_size\": %u,\n", pt->buffer_size);
+    fprintf(f, "      \"num_buffers\": %u,\n", pt->num_buffers);
+    fprintf(f, "      \"num_transfers\": %u,\n", pt->num_xfers);
+
+    if (sync) {
+        fprintf(f, "      \"block_size\": %u,\n", pt->block_size);
+    }
+
+    fprintf(f, "      \"status\": ");
+
+    if (skip != NULL) {
+        fprintf(f, "\"skipped\",\n      \"reason\": ");
+        bench_json_string(f, skip);
+        fprintf(f, "\n    }");
+        return;
+    } else if (r->status != 0) {
+        bench_json_string(f, bladerf_strerror(r->status));
+        fprintf(f, "\n    }");
+        return;
+    }
+
+    fprintf(f, "\"ok\",\n");
+    fprintf(f, "      \"samplerate_actual\": %u,\n", r->samplerate_actual);
+    fprintf(f, "      \"samples\": %llu,\n", (unsigned long long) r->samples);
+    fprintf(f, "      \"elapsed_s\": %.6f,\n", r->elapsed_s);
+
+    if (r->elapsed_s > 0) {
+        fprintf(f, "      \"msps\": %.6f,\n",
+                r->samples / r->elapsed_s / 1e6);
+    } else {
+        fprintf(f, "      \"msps\": null,\n");
+    }
+
+    if (r->samples > 0) {
+        fprintf(f, "      \"cpu_ns_per_sample\": %.3f,\n",
+                r->cpu_s * 1e9 / r->samples);
+    } else {
+        fprintf(f, "      \"cpu_ns_per_sample\": null,\n");
+    }
+
+    fprintf(f, "      ");
+    bench_json_summary(f, "latency_us", &r->latency);
+    fprintf(f, ",\n");
+
+    if (rx) {
+        fprintf(f, "      \"overruns\": %u,\n", r->overruns);
+        fprintf(f, "      \"samples_dropped\": %llu\n",
+                (unsigned long long) r->samples_dropped);
+    } else {
+        fprintf(f, "      \"overruns\": null,\n");
+        fprintf(f, "      \"samples_dropped\": null\n");
+    }
+
+    fprintf(f, "    }");
+}
+
+static int run_sweep(struct bladerf *dev, const struct bench_params *p)
+{
+    unsigned int m, s, b, c, x;
+    struct bench_point pt;
+    struct bench_result r;
+    struct bench_latency lat;
+    const char *skip;
+    bool first = true;
+    unsigned int failures = 0;
+
+    if (bench_latency_init(&lat, 64 * 1024) != 0) {
+        log_error("Failed to allocate latency measurements.\n");
+        return BLADERF_ERR_MEM;
+    }
+
+    fprintf(p->out, "{\n");
+    fprintf(p->out, "  \"benchmark\": \"stream\",\n");
+    bench_json_device_info(p->out, dev);
+    fprintf(p->out, "  \"duration_s\": %.3f,\n", p->duration_s);
+    fprintf(p->out, "  \"warmup_s\": %.3f,\n", p->warmup_s);
+    fprintf(p->out, "  \"timeout_ms\": %u,\n", p->timeout_ms);
+    fprintf(p->out, "  \"results\": [\n");
+
+    for (m = 0; m < BENCH_NUM_MODES; m++) {
+        if (!p->modes[m]) {
+            continue;
+        }
+
+        for (s = 0; s < p->num_samplerates; s++) {
+        for (b = 0; b < p->num_buffer_sizes; b++) {
+        for (c = 0; c < p->num_buffer_counts; c++) {
+        for (x = 0; x < p->num_xfer_counts; x++) {
+            pt.mode = (enum bench_mode) m;
+            pt.samplerate = p->samplerates[s];
+            pt.buffer_size = p->buffer_sizes[b];
+            pt.num_buffers = p->buffer_counts[c];
+            pt.num_xfers = p->xfer_counts[x];
+            pt.block_size = p->block_size != 0 ? p->block_size :
+                                                 pt.buffer_size;
+
+            log_info("%s: samplerate=%u buffer_size=%u num_buffers=%u "
+                     "num_xfers=%u\n", bench_mode_str(pt.mode),
+                     pt.samplerate, pt.buffer_size, pt.num_buffers,
+                     pt.num_xfers);
+
+            skip = check_point(&pt);
+            if (skip != NULL) {
+                log_info("  Skipping: %s\n", skip);
+            } else if (bench_run_point(dev, p, &pt, &lat, &r) != 0) {
+                failures++;
+            }
+
+            print_result(p->out, first, &pt, &r, skip);
+            fflush(p->out);
+            first = false;
+        }
+        }
+        }
+        }
+    }
+
+    fprintf(p->out, "\n  ]\n}\n");
+
+    bench_latency_deinit(&lat);
+    return failures == 0 ? 0 : BLADERF_ERR_UNEXPECTED;
+}
+
+int main(int argc, char *argv[])
+{
+    int status;
+    struct bench_params p;
+    struct bladerf *dev = NULL;
+
+    log_set_verbosity(BLADERF_LOG_LEVEL_WARNING);
+
+    status = handle_cmdline(argc, argv, &p);
+
+    if (status == 0) {
+        status = bladerf_open(&dev, p.device_str);
+        if (status != 0) {
+            log_error("Failed to open device: %s\n",
+                      bladerf_strerror(status));
+        } else {
+            status = run_sweep(dev, &p);
+            bladerf_close(dev);
+        }
+    } else if (status > 0) {
+        print_usage(argv[0]);
+        status = 0;
+    }
+
+    if (p.out != NULL && p.out != stdout) {
+        fclose(p.out);
+    }
+
+    free(p.device_str);
+    return status == 0 ? 0 : 1;
+}
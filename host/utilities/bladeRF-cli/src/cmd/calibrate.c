@@ -257,7 +257,7 @@ static int cal_iq_correction_params(struct cli_state *s, int argc , char **argv)
     bool ok;
     int16_t value;
 
-    if (argc != 5) {
+    if (argc != 3 && argc != 5) {
         return CLI_RET_NARGS;
     }
 
@@ -270,6 +270,16 @@ static int cal_iq_correction_params(struct cli_state *s, int argc , char **argv)
         return CLI_RET_INVPARAM;
     }
 
+    if (argc == 3) {
+        status = calibrate_iq(s, module);
+        if (status != 0) {
+            s->last_lib_error = status;
+            return CLI_RET_LIBBLADERF;
+        }
+
+        return 0;
+    }
+
     if (!strcasecmp(argv[3], "phase")) {
        value = str2int(argv[4], MIN_PHASE, MAX_PHASE, &ok);
        if (ok) {
@@ -308,6 +318,7 @@ static int cal_table(struct cli_state *s, int argc, char **argv)
     int status;
     bool ok;
     bladerf_module module;
+    bool iq;
     char *filename = NULL;
     size_t filename_len = 1024;
 
@@ -317,9 +328,11 @@ static int cal_table(struct cli_state *s, int argc, char **argv)
     unsigned int f_max = BLADERF_FREQUENCY_MAX;
 
     if (argc == 4 || argc == 6 || argc == 7) {
-        /* Only DC tables are currently supported.
-         * IQ tables may be added in the future */
-        if (strcasecmp(argv[2], "dc")) {
+        if (!strcasecmp(argv[2], "dc")) {
+            iq = false;
+        } else if (!strcasecmp(argv[2], "iq")) {
+            iq = true;
+        } else {
             cli_err(s, argv[0], "Invalid table type: %s\n", argv[2]);
             return CLI_RET_INVPARAM;
         }
@@ -391,13 +404,19 @@ static int cal_table(struct cli_state *s, int argc, char **argv)
     }
 
     filename_len -= strlen(filename);
-    if (module == BLADERF_MODULE_RX) {
-        strncat(filename, "_dc_rx.tbl", filename_len);
+    if (iq) {
+        strncat(filename, (module == BLADERF_MODULE_RX) ?
+                            "_iq_rx.tbl" : "_iq_tx.tbl", filename_len);
+
+        status = calibrate_iq_gen_tbl(s, module, filename,
+                                      f_min, f_inc, f_max);
     } else {
-        strncat(filename, "_dc_tx.tbl", filename_len);
-    }
+        strncat(filename, (module == BLADERF_MODULE_RX) ?
+                            "_dc_rx.tbl" : "_dc_tx.tbl", filename_len);
 
-    status = calibrate_dc_gen_tbl(s, module, filename, f_min, f_inc, f_max);
+        status = calibrate_dc_gen_tbl(s, module, filename,
+                                      f_min, f_inc, f_max);
+    }
 
 out:
     if (status != 0) {
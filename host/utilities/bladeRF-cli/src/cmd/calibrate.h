@@ -75,6 +75,33 @@ int calibrate_dc_gen_tbl(struct cli_state *state, bladerf_module module,
                          const char *filename, unsigned int f_low,
                          unsigned f_inc, unsigned int f_high);
 
+/**
+ * Perform an IQ imbalance calibration at the current frequency, via an RF
+ * loopback, and apply the resulting FPGA gain and phase corrections
+ *
+ * @param   state   CLI state handle
+ * @param   module  Module to calibrate
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int calibrate_iq(struct cli_state *state, bladerf_module module);
+
+/**
+ * Generate an IQ imbalance calibration table
+ *
+ * @param   state       CLI state handle
+ * @param   module      Module to calibrate
+ * @param   filename    Output filename for table file
+ * @param   f_low       Lowest frequency in the table to start at
+ * @param   f_inc       Frequency to increment by at each calibration step
+ * @param   f_high      Max frequency in the calibration table
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int calibrate_iq_gen_tbl(struct cli_state *state, bladerf_module module,
+                         const char *filename, unsigned int f_low,
+                         unsigned f_inc, unsigned int f_high);
+
 
 #endif
 
@@ -26,6 +26,7 @@
 #include "common.h"
 #include "rel_assert.h"
 #include "thread.h"
+#include "sample_sums.h"
 
 #define CAL_SAMPLERATE  3000000u
 #define CAL_BANDWIDTH   BLADERF_BANDWIDTH_MIN
@@ -35,15 +36,16 @@
 #define CAL_BUF_LEN     (16 * 1024) /* In samples (where a sample is (I, Q) */
 #define CAL_TIMEOUT     1000
 
-#define CAL_DC_MIN      -2048
-#define CAL_DC_MAX      2048
-
 #define UPPER_BAND      15000000u
 
+/* Amplitude of the TX stimulus used for IQ imbalance calibrations */
+#define CAL_IQ_STIMULUS 1024
+
 struct cal_tx_task {
     struct cli_state *s;
     int16_t *samples;
     bool started;
+    bool meta;      /* Stream is using the SC16 Q11 metadata format */
 
     pthread_t thread;
     MUTEX lock;
@@ -51,10 +53,6 @@ struct cal_tx_task {
     bool run;
 };
 
-struct point {
-    float x, y;
-};
-
 /* Settings that need to be backed up and restored during DC cal */
 struct settings {
     unsigned int bandwidth;
@@ -98,77 +96,36 @@ static inline int set_tx_dc(struct bladerf *dev, int16_t dc_i, int16_t dc_q)
     return set_dc(dev, BLADERF_MODULE_TX, dc_i, dc_q);
 }
 
-/* Interpolate to find the point (x_result, 0) */
-static inline int interpolate(int16_t x0, int16_t x1,
-                              int16_t y0, int16_t y1,
-                              int16_t *x_result)
+static void variance(int16_t *samples, float *var_i, float *var_q)
 {
-    const int32_t denom = y1 - y0;
-    const int32_t num   = (int32_t)y0 * (x1 - x0);
-
-    if (denom == 0) {
-        return BLADERF_ERR_UNEXPECTED;
-    }
+    struct sample_sums sums;
+    double n, mean_i, mean_q;
 
-    *x_result = x0 - (int16_t)((num + (denom / 2)) / denom);
-    return 0;
-}
-
-/* Find the intersection point the lines p0p1 and p2p3 */
-static inline int intersection(struct cli_state *s,
-                               struct point *p0, struct point *p1,
-                               struct point *p2, struct point *p3,
-                               struct point *result)
-{
-    const float m01 = (p0->y - p1->y) / (p0->x - p1->x);
-    const float m23 = (p2->y - p3->y) / (p2->x - p3->x);
-    const float b01 = p0->y - (m01 * p0->x);
-    const float b23 = p2->y - (m23 * p2->x);
-
-    if (m01 >= 0 || m23 <= 0) {
-        cli_err(s, "Error",
-                "Invalid m01 (%f) or m23 (%f) encountered.\n", m01, m23);
-        return BLADERF_ERR_UNEXPECTED;
-    }
+    sample_sums(samples, CAL_BUF_LEN, &sums);
 
-    result->x = (b23 - b01) / (m01 - m23);
-    result->y = m01 * result->x + b01;
+    n = CAL_BUF_LEN;
+    mean_i = sums.i / n;
+    mean_q = sums.q / n;
 
-    return 0;
+    *var_i = (float) ((sums.ii - n * mean_i * mean_i) / (n - 1));
+    *var_q = (float) ((sums.qq - n * mean_q * mean_q) / (n - 1));
 }
 
-/* Compute variance via incremental Online algorithm */
-static void variance(int16_t *samples, float *var_i, float *var_q)
+/* Average the samples in a buffer */
+static void average(int16_t *samples, float *avg_i, float *avg_q)
 {
-    unsigned int i;
-
-    float n;
-    float mean_i, delta_i, m2_i;
-    float mean_q, delta_q, m2_q;
-
-    n = mean_i = mean_q = delta_i = delta_q = m2_i = m2_q = 0.0f;
-
-    for (i = 0; i < 2 * CAL_BUF_LEN; i += 2) {
-        n += 1;
+    struct sample_sums sums;
 
-        delta_i = samples[i] - mean_i;
-        mean_i = mean_i + delta_i / n;
-        m2_i = m2_i + delta_i * (samples[i] - mean_i);
+    sample_sums(samples, CAL_BUF_LEN, &sums);
 
-        delta_q = samples[i + 1] - mean_q;
-        mean_q = mean_q + delta_q / n;
-        m2_q = m2_q + delta_q * (samples[i + 1] - mean_q);
-    }
-
-    *var_i = m2_i / (n - 1);
-    *var_q = m2_q / (n - 1);
+    *avg_i = (float) sums.i / CAL_BUF_LEN;
+    *avg_q = (float) sums.q / CAL_BUF_LEN;
 }
 
 static int rx_avg(struct bladerf *dev, int16_t *samples,
-                  int16_t *avg_i, int16_t *avg_q)
+                  float *avg_i, float *avg_q)
 {
     int status;
-    int64_t accum_i, accum_q;
     unsigned int i;
 
     /* Flush out samples and read a buffer's worth of data */
@@ -179,35 +136,55 @@ static int rx_avg(struct bladerf *dev, int16_t *samples,
         }
     }
 
-    for (i = 0, accum_i = accum_q = 0; i < 2 * CAL_BUF_LEN; i += 2) {
-        accum_i += samples[i];
-        accum_q += samples[i + 1];
+    average(samples, avg_i, avg_q);
+    return 0;
+}
+
+/* Measurements are performed for libbladeRF's DC offset search either by
+ * flushing the stream after each change, or from a stream that is kept
+ * running throughout a calibration sweep. */
+
+/* Context for measurements made by flushing a running stream */
+struct flush_measure {
+    struct bladerf *dev;
+    int16_t *samples;
+};
+
+static int measure_rx_dc_flush(void *arg, int16_t dc_i, int16_t dc_q,
+                               float *avg_i, float *avg_q)
+{
+    int status;
+    struct flush_measure *m = (struct flush_measure *) arg;
+
+    status = set_rx_dc(m->dev, dc_i, dc_q);
+    if (status != 0) {
+        return status;
     }
 
-    accum_i /= CAL_BUF_LEN;
-    accum_q /= CAL_BUF_LEN;
+    return rx_avg(m->dev, m->samples, avg_i, avg_q);
+}
 
-    assert(accum_i < (1 << 12) && accum_i >= (-(1 << 12)) );
-    assert(accum_q < (1 << 12) && accum_i >= (-(1 << 12)) );
+/* Search for the RX DC offset correction values yielding the smallest
+ * average I and Q values */
+static int search_rx_dc(struct cli_state *s, bladerf_dc_rx_measure measure,
+                        void *arg, struct bladerf_dc_solution *solution)
+{
+    int status = bladerf_dc_solve_rx(NULL, measure, arg, solution);
 
-    *avg_i = (int16_t) accum_i;
-    *avg_q = (int16_t) accum_q;
+    if (status == BLADERF_ERR_UNEXPECTED) {
+        cli_err(s, "Error", "RX DC offset does not respond to correction.\n");
+    } else if (status == 0 && !solution->converged) {
+        printf("  Warning: RX DC offset search did not converge.\n");
+    }
 
-    return 0;
+    return status;
 }
 
-int calibrate_dc_rx(struct cli_state *s,
-                    int16_t *dc_i, int16_t *dc_q,
-                    int16_t *avg_i, int16_t *avg_q)
+int calibrate_dc_rx(struct cli_state *s, struct bladerf_dc_solution *solution)
 {
     int status;
     int16_t *samples = NULL;
-    int16_t dc_i0, dc_q0, dc_i1, dc_q1;
-    int16_t avg_i0, avg_q0, avg_i1, avg_q1;
-
-    int16_t test_i[7], test_q[7];
-    int16_t tmp_i, tmp_q, min_i, min_q;
-    unsigned int min_i_idx, min_q_idx, n;
+    struct flush_measure measure;
 
     samples = (int16_t*) malloc(CAL_BUF_LEN * 2 * sizeof(samples[0]));
     if (samples == NULL) {
@@ -235,109 +212,15 @@ int calibrate_dc_rx(struct cli_state *s,
         goto out;
     }
 
-    dc_i0 = dc_q0 = -512;
-    dc_i1 = dc_q1 = 512;
-
-    /* Get an initial set of sample points */
-    status = set_rx_dc(s->dev, dc_i0, dc_q0);
-    if (status != 0) {
-        goto out;
-    }
-
-    status = rx_avg(s->dev, samples, &avg_i0, &avg_q0);
-    if (status != 0) {
-        goto out;
-    }
-
-    status = set_rx_dc(s->dev, dc_i1, dc_q1);
-    if (status != 0) {
-        goto out;
-    }
-
-    status = rx_avg(s->dev, samples, &avg_i1, &avg_q1);
-    if (status != 0) {
-        goto out;
-    }
-
-    status = interpolate(dc_i0, dc_i1, avg_i0, avg_i1, dc_i);
-    if (status != 0) {
-        cli_err(s, "Error", "RX I values appear to be stuck @ %d\n", avg_i0);
-        goto out;
-    }
+    measure.dev = s->dev;
+    measure.samples = samples;
 
-    status = interpolate(dc_q0, dc_q1, avg_q0, avg_q1, dc_q);
+    status = search_rx_dc(s, measure_rx_dc_flush, &measure, solution);
     if (status != 0) {
-        cli_err(s, "Error", "RX Q values appear to be stuck @ %d\n", avg_q0);
         goto out;
     }
 
-    test_i[0] = *dc_i;
-    test_i[1] = test_i[0] + 96;
-    test_i[2] = test_i[0] + 64;
-    test_i[3] = test_i[0] + 32;
-    test_i[4] = test_i[0] - 32;
-    test_i[5] = test_i[0] - 64;
-    test_i[6] = test_i[0] - 96;
-
-    test_q[0] = *dc_q;
-    test_q[1] = test_q[0] + 96;
-    test_q[2] = test_q[0] + 64;
-    test_q[3] = test_q[0] + 32;
-    test_q[4] = test_q[0] - 32;
-    test_q[5] = test_q[0] - 64;
-    test_q[6] = test_q[0] - 96;
-
-    min_i_idx = min_q_idx = 0;
-    min_i = min_q = INT16_MAX;
-
-    for (n = 0; n < 7; n++) {
-
-        if (test_i[n] > CAL_DC_MAX) {
-            test_i[n] = CAL_DC_MAX;
-        } else if (test_i[n] < CAL_DC_MIN) {
-            test_i[n] = CAL_DC_MIN;
-        }
-
-        if (test_q[n] > CAL_DC_MAX) {
-            test_q[n] = CAL_DC_MAX;
-        } else if (test_q[n] < CAL_DC_MIN) {
-            test_q[n] = CAL_DC_MIN;
-        }
-
-        /* See where we're at now... */
-        status = set_rx_dc(s->dev, test_i[n], test_q[n]);
-        if (status != 0) {
-            goto out;
-        }
-
-        status = rx_avg(s->dev, samples, &tmp_i, &tmp_q);
-        if (status != 0) {
-            goto out;
-        }
-
-        if (abs(tmp_i) < abs(min_i)) {
-            min_i = tmp_i;
-            min_i_idx = n;
-        }
-
-        if (abs(tmp_q) < abs(min_q)) {
-            min_q = tmp_q;
-            min_q_idx = n;
-        }
-    }
-
-    *dc_i = test_i[min_i_idx];
-    *dc_q = test_q[min_q_idx];
-
-    if (avg_i) {
-        *avg_i = min_i;
-    }
-
-    if (avg_q) {
-        *avg_q = min_q;
-    }
-
-    status = set_rx_dc(s->dev, *dc_i, *dc_q);
+    status = set_rx_dc(s->dev, solution->dc_i, solution->dc_q);
     if (status != 0) {
         goto out;
     }
@@ -352,6 +235,11 @@ static void * exec_tx_task(void *args)
     bool run;
     int status = 0;
     struct cal_tx_task *task = (struct cal_tx_task*) args;
+    struct bladerf_metadata meta;
+
+    /* With metadata, transmit a single burst for the duration of the task */
+    memset(&meta, 0, sizeof(meta));
+    meta.flags = BLADERF_META_FLAG_TX_BURST_START | BLADERF_META_FLAG_TX_NOW;
 
     MUTEX_LOCK(&task->lock);
     run = task->run;
@@ -359,14 +247,21 @@ static void * exec_tx_task(void *args)
 
     while (run && status == 0) {
         status = bladerf_sync_tx(task->s->dev, task->samples, CAL_BUF_LEN,
-                                 NULL, CAL_TIMEOUT);
+                                 task->meta ? &meta : NULL, CAL_TIMEOUT);
 
+        meta.flags = 0;
 
         MUTEX_LOCK(&task->lock);
         run = task->run;
         MUTEX_UNLOCK(&task->lock);
     }
 
+    if (task->meta && status == 0) {
+        meta.flags = BLADERF_META_FLAG_TX_BURST_END;
+        status = bladerf_sync_tx(task->s->dev, task->samples, CAL_BUF_LEN,
+                                 &meta, CAL_TIMEOUT);
+    }
+
     MUTEX_LOCK(&task->lock);
     task->status = status;
     MUTEX_UNLOCK(&task->lock);
@@ -444,17 +339,36 @@ int rx_avg_magnitude(struct bladerf *dev, int16_t *samples,
     return status;
 }
 
-int calibrate_dc_tx(struct cli_state *s,
-                    int16_t *dc_i, int16_t *dc_q,
-                    float *error_i, float *error_q)
+static int measure_tx_dc_flush(void *arg, int16_t dc_i, int16_t dc_q,
+                               float *magnitude)
+{
+    struct flush_measure *m = (struct flush_measure *) arg;
+    return rx_avg_magnitude(m->dev, m->samples, dc_i, dc_q, magnitude);
+}
+
+/* Search for the TX DC offset correction values yielding the smallest
+ * magnitude of the TX LO leakage */
+static int search_tx_dc(struct cli_state *s, bladerf_dc_tx_measure measure,
+                        void *arg, struct bladerf_dc_solution *solution)
+{
+    int status = bladerf_dc_solve_tx(NULL, measure, arg, solution);
+
+    if (status == BLADERF_ERR_UNEXPECTED) {
+        cli_err(s, "Error", "Failed to locate the TX LO leakage minimum.\n");
+    } else if (status == 0 && !solution->converged) {
+        printf("  Warning: TX DC offset search did not converge.\n");
+    }
+
+    return status;
+}
+
+int calibrate_dc_tx(struct cli_state *s, struct bladerf_dc_solution *solution)
 {
     int retval, status;
     unsigned int rx_freq, tx_freq;
     int16_t *rx_samples = NULL;
     struct cal_tx_task tx_task;
-
-    struct point p0, p1, p2, p3;
-    struct point result;
+    struct flush_measure measure;
 
     status = bladerf_get_frequency(s->dev, BLADERF_MODULE_RX, &rx_freq);
     if (status != 0) {
@@ -535,83 +449,15 @@ int calibrate_dc_tx(struct cli_state *s,
         goto out;
     }
 
-    /* Sample the results of 4 points, which should yield 2 intersecting lines,
-     * for 4 different DC offset settings of the I channel */
-    p0.x = -2048;
-    p1.x = -512;
-    p2.x = 512;
-    p3.x = 2048;
-
-    status = rx_avg_magnitude(s->dev, rx_samples, (int16_t) p0.x, 0, &p0.y);
-    if (status != 0) {
-        goto out;
-    }
-
-    status = rx_avg_magnitude(s->dev, rx_samples, (int16_t) p1.x, 0, &p1.y);
-    if (status != 0) {
-        goto out;
-    }
-
-    status = rx_avg_magnitude(s->dev, rx_samples, (int16_t) p2.x, 0, &p2.y);
-    if (status != 0) {
-        goto out;
-    }
-
-    status = rx_avg_magnitude(s->dev, rx_samples, (int16_t) p3.x, 0, &p3.y);
-    if (status != 0) {
-        goto out;
-    }
-
-    status = intersection(s, &p0, &p1, &p2, &p3, &result);
-    if (status != 0) {
-        goto out;
-    }
-
-    if (result.x < CAL_DC_MIN || result.x > CAL_DC_MAX) {
-        cli_err(s, "Error", "Obtained out-of-range TX I DC cal value (%f).\n",
-                result.x);
-        status = BLADERF_ERR_UNEXPECTED;
-        goto out;
-    }
-
-    *dc_i = (int16_t) (result.x + 0.5);
-    *error_i = result.y;
-
-    status = set_tx_dc(s->dev, *dc_i, 0);
-    if (status != 0) {
-        goto out;
-    }
-
-    /* Repeat for the Q channel */
-    status = rx_avg_magnitude(s->dev, rx_samples, *dc_i, (int16_t) p0.x, &p0.y);
-    if (status != 0) {
-        goto out;
-    }
-
-    status = rx_avg_magnitude(s->dev, rx_samples, *dc_i, (int16_t) p1.x, &p1.y);
-    if (status != 0) {
-        goto out;
-    }
-
-    status = rx_avg_magnitude(s->dev, rx_samples, *dc_i, (int16_t) p2.x, &p2.y);
-    if (status != 0) {
-        goto out;
-    }
-
-    status = rx_avg_magnitude(s->dev, rx_samples, *dc_i, (int16_t) p3.x, &p3.y);
-    if (status != 0) {
-        goto out;
-    }
+    measure.dev = s->dev;
+    measure.samples = rx_samples;
 
-    status = intersection(s, &p0, &p1, &p2, &p3, &result);
+    status = search_tx_dc(s, measure_tx_dc_flush, &measure, solution);
     if (status != 0) {
         goto out;
     }
 
-    *dc_q = (int16_t) (result.x + 0.5);
-    *error_q = result.y;
-
-    status = set_tx_dc(s->dev, *dc_i, *dc_q);
+    status = set_tx_dc(s->dev, solution->dc_i, solution->dc_q);
 
 out:
     retval = status;
@@ -632,109 +478,685 @@ out:
     return retval;
 }
 
-static inline int dummy_tx(struct bladerf *dev)
+/*
+ * DC calibration table sweeps
+ *
+ * Rather than reconfiguring and flushing the stream for each measurement, a
+ * sweep keeps a single RX stream (and for TX calibrations, a TX stream)
+ * running for its duration. Samples are received in the SC16 Q11 metadata
+ * format, and each measurement requests a block of samples beginning a short
+ * settling period after the last change to the device. The library discards
+ * the stale samples received in the meantime without copying them. Retuning
+ * and applying the first DC offset setting at the new frequency share a
+ * single settling period.
+ *
+ * DC offset corrections are written directly to the LMS6002D from cached
+ * register values, so that an update requires no register reads, and only
+ * registers whose values change are written.
+ */
+
+#define CAL_SWEEP_NUM_BUFS      16
+#define CAL_SWEEP_NUM_XFERS     8
+#define CAL_SWEEP_BUF_LEN       8192    /* In samples */
+
+/* Samples to skip after changing a DC offset setting or frequency */
+#define CAL_SWEEP_SETTLE_DC     1024
+#define CAL_SWEEP_SETTLE_TUNE   (8 * 1024)
+
+/* Attempts to capture a block of samples without a discontinuity */
+#define CAL_SWEEP_CAPTURE_TRIES 3
+
+/* LMS6002D DC offset correction registers. Q follows I. */
+#define LMS_RX_DCOFF_I          0x71
+#define LMS_TX_DCOFF_I          0x42
+
+struct dc_sweep {
+    struct cli_state *s;
+    bladerf_module module;      /* Module being calibrated */
+    bool iq;                    /* Calibrating IQ imbalance, not DC offset */
+    int16_t *samples;
+
+    uint8_t dc_addr;            /* DC offset I register address */
+    uint8_t dc_regs[2];         /* Cached I and Q DC offset register values */
+    int16_t iq_vals[2];         /* Cached FPGA gain and phase corrections */
+    bladerf_loopback loopback;  /* Current loopback mode, for loopback sweeps */
+
+    unsigned int settle;        /* Samples to skip before the next capture */
+
+    struct cal_tx_task tx_task;
+};
+
+/* Convert a DC offset correction value to an LMS6002D register value, as per
+ * bladerf_set_correction(). `prev` is the register's current value. */
+static uint8_t dc_reg_value(bladerf_module module, uint8_t prev, int16_t value)
 {
-    int status;
-    const unsigned int buf_len = CAL_BUF_LEN;
-    uint16_t *buf = (uint16_t*) calloc(2 * buf_len, sizeof(buf[0]));
+    uint8_t ret;
 
-    if (buf == NULL) {
-        return BLADERF_ERR_MEM;
-    }
+    if (module == BLADERF_MODULE_RX) {
+        /* RX has 6 bits of magnitude and a sign bit */
+        value >>= 5;
 
-    status = bladerf_sync_config(dev, BLADERF_MODULE_TX,
-                                 BLADERF_FORMAT_SC16_Q11,
-                                 CAL_NUM_BUFS, buf_len,
-                                 CAL_NUM_XFERS, CAL_TIMEOUT);
+        if (value < 0) {
+            ret = (value <= -64) ? 0x3f : (abs(value) & 0x3f);
+            ret |= (1 << 6);
+        } else {
+            ret = (value >= 64) ? 0x3f : (value & 0x3f);
+        }
 
-    if (status != 0) {
-        goto error;
-    }
+        /* Bit 7 is unrelated to the DC offset correction */
+        ret |= prev & (1 << 7);
+    } else {
+        /* TX has 7 bits of scale, offset by 0x80 */
+        value >>= 4;
 
-    status = bladerf_sync_tx(dev, buf, buf_len, NULL, CAL_TIMEOUT);
+        if (value >= 0) {
+            ret = (1 << 7) | ((value >= 128) ? 0x7f : (value & 0x7f));
+        } else {
+            ret = (value <= -128) ? 0x00 : (value & 0x7f);
+        }
+    }
 
-error:
-    free(buf);
-    return status;
+    return ret;
 }
 
-static inline int backup_and_update_settings(struct bladerf *dev,
-                                            bladerf_module module,
-                                            struct settings *settings)
+static int sweep_set_dc(struct dc_sweep *sweep, int16_t dc_i, int16_t dc_q)
 {
     int status;
+    unsigned int i;
+    const int16_t values[2] = { dc_i, dc_q };
 
-    status = bladerf_get_bandwidth(dev, module, &settings->bandwidth);
-    if (status != 0) {
-        return status;
-    }
+    for (i = 0; i < 2; i++) {
+        const uint8_t reg = dc_reg_value(sweep->module, sweep->dc_regs[i],
+                                         values[i]);
 
-    status = bladerf_get_frequency(dev, module, &settings->frequency);
-    if (status != 0) {
-        return status;
-    }
+        if (reg != sweep->dc_regs[i]) {
+            status = bladerf_lms_write(sweep->s->dev, sweep->dc_addr + i, reg);
+            if (status != 0) {
+                return status;
+            }
 
-    status = bladerf_get_rational_sample_rate(dev, module,
-                                              &settings->samplerate);
-    if (status != 0) {
-        return status;
-    }
+            sweep->dc_regs[i] = reg;
 
-    status = bladerf_set_bandwidth(dev, module, CAL_BANDWIDTH, NULL);
-    if (status != 0) {
-        return status;
+            if (sweep->settle < CAL_SWEEP_SETTLE_DC) {
+                sweep->settle = CAL_SWEEP_SETTLE_DC;
+            }
+        }
     }
 
-    status = bladerf_set_sample_rate(dev, module, CAL_SAMPLERATE, NULL);
-
-    return status;
+    return 0;
 }
 
-static inline int restore_settings(struct bladerf *dev, bladerf_module module,
-                                   struct settings *settings)
+static int sweep_set_iq(struct dc_sweep *sweep, int16_t gain, int16_t phase)
 {
     int status;
+    unsigned int i;
+    const int16_t values[2] = { gain, phase };
+    const bladerf_correction corr[2] = {
+        BLADERF_CORR_FPGA_GAIN, BLADERF_CORR_FPGA_PHASE
+    };
+
+    for (i = 0; i < 2; i++) {
+        if (values[i] != sweep->iq_vals[i]) {
+            status = bladerf_set_correction(sweep->s->dev, sweep->module,
+                                            corr[i], values[i]);
+            if (status != 0) {
+                return status;
+            }
 
-    status = bladerf_set_bandwidth(dev, module, settings->bandwidth, NULL);
-    if (status != 0) {
-        return status;
-    }
+            sweep->iq_vals[i] = values[i];
 
-    status = bladerf_set_frequency(dev, module, settings->frequency);
-    if (status != 0) {
-        return status;
+            if (sweep->settle < CAL_SWEEP_SETTLE_DC) {
+                sweep->settle = CAL_SWEEP_SETTLE_DC;
+            }
+        }
     }
 
-    status = bladerf_set_rational_sample_rate(dev, module,
-                                              &settings->samplerate, NULL);
-
-    return status;
+    return 0;
 }
 
-/* See libbladeRF's dc_cal_table.c for the packed table data format */
-int calibrate_dc_gen_tbl(struct cli_state *s, bladerf_module module,
-                         const char *filename, unsigned int f_low,
-                         unsigned f_inc, unsigned int f_high)
+/* Read back the corrections cached by the sweep, which retuning may have
+ * changed by applying a calibration table */
+static int sweep_read_corrections(struct dc_sweep *sweep)
 {
-    int retval, status;
-    size_t off;
-    struct bladerf_lms_dc_cals lms_dc_cals;
-    unsigned int f;
-    struct settings settings;
-    bladerf_loopback loopback_backup;
-    struct bladerf_image *image = NULL;
-
-    const uint16_t magic = HOST_TO_LE16(0x1ab1);
-    const uint32_t reserved = HOST_TO_LE32(0x00000000);
-    const uint32_t tbl_version = HOST_TO_LE32(0x00000001);
+    int status;
+    unsigned int i;
+    struct bladerf *dev = sweep->s->dev;
 
-    const size_t lms_data_size = 10; /* 10 uint8_t register values */
+    if (sweep->iq) {
+        status = bladerf_get_correction(dev, sweep->module,
+                                        BLADERF_CORR_FPGA_GAIN,
+                                        &sweep->iq_vals[0]);
+        if (status != 0) {
+            return status;
+        }
 
-    const uint32_t n_frequencies = (f_high - f_low) / f_inc + 1;
-    const uint32_t n_frequencies_le = HOST_TO_LE32(n_frequencies);
+        return bladerf_get_correction(dev, sweep->module,
+                                      BLADERF_CORR_FPGA_PHASE,
+                                      &sweep->iq_vals[1]);
+    }
+
+    for (i = 0; i < 2; i++) {
+        status = bladerf_lms_read(dev, sweep->dc_addr + i, &sweep->dc_regs[i]);
+        if (status != 0) {
+            return status;
+        }
+    }
+
+    return 0;
+}
+
+/* Receive a block of samples, starting after the settling period */
+static int sweep_capture(struct dc_sweep *sweep)
+{
+    int status;
+    unsigned int i;
+    uint64_t now;
+    struct bladerf_metadata meta;
+
+    for (i = 0; i < CAL_SWEEP_CAPTURE_TRIES; i++) {
+        status = bladerf_get_timestamp(sweep->s->dev, BLADERF_MODULE_RX, &now);
+        if (status != 0) {
+            return status;
+        }
+
+        memset(&meta, 0, sizeof(meta));
+        meta.timestamp = now + sweep->settle;
+
+        status = bladerf_sync_rx(sweep->s->dev, sweep->samples, CAL_BUF_LEN,
+                                 &meta, CAL_TIMEOUT);
+
+        /* The stream has already progressed beyond the settling period
+         * (e.g., due to dropped samples), so any samples will do */
+        if (status == BLADERF_ERR_TIME_PAST) {
+            meta.flags = BLADERF_META_FLAG_RX_NOW;
+            status = bladerf_sync_rx(sweep->s->dev, sweep->samples,
+                                     CAL_BUF_LEN, &meta, CAL_TIMEOUT);
+        }
+
+        if (status != 0) {
+            return status;
+        }
+
+        /* A discontinuity yields a short read. Try again. */
+        if (meta.actual_count == CAL_BUF_LEN) {
+            sweep->settle = 0;
+            return 0;
+        }
+    }
+
+    cli_err(sweep->s, "Error", "Failed to receive a contiguous block of "
+                               "samples.\n");
+
+    return BLADERF_ERR_UNEXPECTED;
+}
+
+static int measure_rx_dc_sweep(void *arg, int16_t dc_i, int16_t dc_q,
+                               float *avg_i, float *avg_q)
+{
+    int status;
+    struct dc_sweep *sweep = (struct dc_sweep *) arg;
+
+    status = sweep_set_dc(sweep, dc_i, dc_q);
+    if (status != 0) {
+        return status;
+    }
+
+    status = sweep_capture(sweep);
+    if (status != 0) {
+        return status;
+    }
+
+    average(sweep->samples, avg_i, avg_q);
+    return 0;
+}
+
+static int measure_tx_dc_sweep(void *arg, int16_t dc_i, int16_t dc_q,
+                               float *magnitude)
+{
+    int status;
+    float var_i, var_q;
+    struct dc_sweep *sweep = (struct dc_sweep *) arg;
+
+    status = sweep_set_dc(sweep, dc_i, dc_q);
+    if (status != 0) {
+        return status;
+    }
+
+    status = sweep_capture(sweep);
+    if (status != 0) {
+        return status;
+    }
+
+    variance(sweep->samples, &var_i, &var_q);
+    *magnitude = (float) sqrt(var_i + var_q);
+    return 0;
+}
+
+/* Measure the residual RX IQ imbalance, scaled to FPGA correction units */
+static int measure_rx_iq_sweep(void *arg, int16_t gain, int16_t phase,
+                               float *gain_err, float *phase_err)
+{
+    int status;
+    struct bladerf_iq_imbalance imbalance;
+    struct dc_sweep *sweep = (struct dc_sweep *) arg;
+
+    status = sweep_set_iq(sweep, gain, phase);
+    if (status != 0) {
+        return status;
+    }
+
+    status = sweep_capture(sweep);
+    if (status != 0) {
+        return status;
+    }
+
+    status = bladerf_estimate_iq_imbalance(sweep->samples, CAL_BUF_LEN,
+                                           &imbalance);
+    if (status != 0) {
+        return status;
+    }
+
+    *gain_err = imbalance.gain * 4096.0f;
+    *phase_err = imbalance.phase * 4096.0f / 10.0f;
+    return 0;
+}
+
+/* Measure the relative amplitude of the image of the TX stimulus */
+static int measure_tx_iq_sweep(void *arg, int16_t gain, int16_t phase,
+                               float *magnitude)
+{
+    int status;
+    struct bladerf_iq_imbalance imbalance;
+    struct dc_sweep *sweep = (struct dc_sweep *) arg;
+
+    status = sweep_set_iq(sweep, gain, phase);
+    if (status != 0) {
+        return status;
+    }
+
+    status = sweep_capture(sweep);
+    if (status != 0) {
+        return status;
+    }
+
+    status = bladerf_estimate_iq_imbalance(sweep->samples, CAL_BUF_LEN,
+                                           &imbalance);
+    if (status != 0) {
+        return status;
+    }
+
+    *magnitude = 4096.0f * powf(10.0f, -imbalance.image_rejection / 20.0f);
+    return 0;
+}
+
+/* Tune the sweep to the specified frequency.
+ *
+ * For TX DC offset sweeps and RX IQ imbalance sweeps, the modules are tuned
+ * 1/4 of the sample rate apart, such that the TX LO leakage or stimulus does
+ * not have an image of its own in the RX samples. For TX IQ imbalance sweeps,
+ * both modules are tuned to the same frequency, such that the image of the
+ * TX stimulus coincides with that which RX IQ imbalance would produce. */
+static int sweep_tune(struct dc_sweep *sweep, unsigned int frequency)
+{
+    int status;
+    unsigned int other_freq;
+    bladerf_loopback loopback;
+    struct bladerf *dev = sweep->s->dev;
+    const bladerf_module other = (sweep->module == BLADERF_MODULE_RX) ?
+                                    BLADERF_MODULE_TX : BLADERF_MODULE_RX;
+
+    status = bladerf_set_frequency(dev, sweep->module, frequency);
+    if (status != 0) {
+        return status;
+    }
+
+    if (sweep->module == BLADERF_MODULE_TX || sweep->iq) {
+        if (sweep->iq && sweep->module == BLADERF_MODULE_TX) {
+            other_freq = frequency;
+        } else if (frequency >= BLADERF_FREQUENCY_MIN + CAL_SAMPLERATE / 4) {
+            other_freq = frequency - CAL_SAMPLERATE / 4;
+        } else {
+            other_freq = frequency + CAL_SAMPLERATE / 4;
+        }
+
+        status = bladerf_set_frequency(dev, other, other_freq);
+        if (status != 0) {
+            return status;
+        }
+
+        if (frequency < UPPER_BAND) {
+            loopback = BLADERF_LB_RF_LNA1;
+        } else {
+            loopback = BLADERF_LB_RF_LNA2;
+        }
+
+        if (loopback != sweep->loopback) {
+            status = bladerf_set_loopback(dev, loopback);
+            if (status != 0) {
+                return status;
+            }
+
+            sweep->loopback = loopback;
+        }
+    }
+
+    sweep->settle = CAL_SWEEP_SETTLE_TUNE;
+    return sweep_read_corrections(sweep);
+}
+
+static void sweep_deinit(struct dc_sweep *sweep)
+{
+    int status;
+
+    if (sweep->module == BLADERF_MODULE_TX || sweep->iq) {
+        status = stop_tx_task(&sweep->tx_task);
+        if (status != 0) {
+            cli_err(sweep->s, "Error", "Calibration TX task failed: %s\n",
+                    bladerf_strerror(status));
+        }
+
+        free(sweep->tx_task.samples);
+    }
+
+    free(sweep->samples);
+}
+
+/* Fill the TX buffer with the stimulus for an IQ imbalance sweep.
+ *
+ * For RX sweeps, this is a constant, which yields a tone at the TX
+ * frequency. For TX sweeps, this is a tone at 1/8 of the sample rate, whose
+ * image is measured. The buffer holds a whole number of periods. */
+static void sweep_iq_stimulus(struct dc_sweep *sweep)
+{
+    unsigned int i;
+    int16_t *samples = sweep->tx_task.samples;
+
+    /* cos(2 pi n / 8), sin(2 pi n / 8) */
+    static const float tone[8][2] = {
+        {  1.0f,      0.0f      }, {  0.707107f,  0.707107f },
+        {  0.0f,      1.0f      }, { -0.707107f,  0.707107f },
+        { -1.0f,      0.0f      }, { -0.707107f, -0.707107f },
+        {  0.0f,     -1.0f      }, {  0.707107f, -0.707107f },
+    };
+
+    for (i = 0; i < CAL_BUF_LEN; i++) {
+        if (sweep->module == BLADERF_MODULE_RX) {
+            samples[2 * i]     = CAL_IQ_STIMULUS;
+            samples[2 * i + 1] = 0;
+        } else {
+            samples[2 * i]     = (int16_t) (CAL_IQ_STIMULUS * tone[i % 8][0]);
+            samples[2 * i + 1] = (int16_t) (CAL_IQ_STIMULUS * tone[i % 8][1]);
+        }
+    }
+}
+
+static int sweep_init(struct dc_sweep *sweep, struct cli_state *s,
+                      bladerf_module module, bool iq)
+{
+    int status;
+    struct bladerf *dev = s->dev;
+
+    memset(sweep, 0, sizeof(*sweep));
+    sweep->s = s;
+    sweep->module = module;
+    sweep->iq = iq;
+    sweep->loopback = BLADERF_LB_NONE;
+
+    if (module == BLADERF_MODULE_RX) {
+        sweep->dc_addr = LMS_RX_DCOFF_I;
+    } else {
+        sweep->dc_addr = LMS_TX_DCOFF_I;
+    }
+
+    if (module == BLADERF_MODULE_TX || iq) {
+        status = init_tx_task(s, &sweep->tx_task);
+        if (status != 0) {
+            free(sweep->tx_task.samples);
+            return status;
+        }
+
+        sweep->tx_task.meta = true;
+
+        if (iq) {
+            sweep_iq_stimulus(sweep);
+        }
+    }
+
+    sweep->samples = (int16_t*) malloc(CAL_BUF_LEN * 2 *
+                                       sizeof(sweep->samples[0]));
+    if (sweep->samples == NULL) {
+        status = BLADERF_ERR_MEM;
+        goto error;
+    }
+
+    status = sweep_read_corrections(sweep);
+    if (status != 0) {
+        goto error;
+    }
+
+    /* Both modules must use the same format, so ensure neither retains an
+     * old configuration */
+    status = bladerf_enable_module(dev, BLADERF_MODULE_RX, false);
+    if (status != 0) {
+        goto error;
+    }
+
+    status = bladerf_enable_module(dev, BLADERF_MODULE_TX, false);
+    if (status != 0) {
+        goto error;
+    }
+
+    status = bladerf_sync_config(dev, BLADERF_MODULE_RX,
+                                 BLADERF_FORMAT_SC16_Q11_META,
+                                 CAL_SWEEP_NUM_BUFS, CAL_SWEEP_BUF_LEN,
+                                 CAL_SWEEP_NUM_XFERS, CAL_TIMEOUT);
+    if (status != 0) {
+        goto error;
+    }
+
+    if (module == BLADERF_MODULE_TX || iq) {
+        status = bladerf_sync_config(dev, BLADERF_MODULE_TX,
+                                     BLADERF_FORMAT_SC16_Q11_META,
+                                     CAL_SWEEP_NUM_BUFS, CAL_SWEEP_BUF_LEN,
+                                     CAL_SWEEP_NUM_XFERS, CAL_TIMEOUT);
+        if (status != 0) {
+            goto error;
+        }
+    }
+
+    status = bladerf_enable_module(dev, BLADERF_MODULE_RX, true);
+    if (status != 0) {
+        goto error;
+    }
+
+    if (module == BLADERF_MODULE_TX || iq) {
+        status = bladerf_enable_module(dev, BLADERF_MODULE_TX, true);
+        if (status != 0) {
+            goto error;
+        }
+
+        status = start_tx_task(&sweep->tx_task);
+        if (status != 0) {
+            goto error;
+        }
+    }
+
+    return 0;
+
+error:
+    sweep_deinit(sweep);
+    return status;
+}
+
+static inline int dummy_tx(struct bladerf *dev)
+{
+    int status;
+    const unsigned int buf_len = CAL_BUF_LEN;
+    uint16_t *buf = (uint16_t*) calloc(2 * buf_len, sizeof(buf[0]));
+
+    if (buf == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    status = bladerf_sync_config(dev, BLADERF_MODULE_TX,
+                                 BLADERF_FORMAT_SC16_Q11,
+                                 CAL_NUM_BUFS, buf_len,
+                                 CAL_NUM_XFERS, CAL_TIMEOUT);
+
+    if (status != 0) {
+        goto error;
+    }
+
+    status = bladerf_sync_tx(dev, buf, buf_len, NULL, CAL_TIMEOUT);
+
+error:
+    free(buf);
+    return status;
+}
+
+static inline int backup_and_update_settings(struct bladerf *dev,
+                                            bladerf_module module,
+                                            struct settings *settings)
+{
+    int status;
+
+    status = bladerf_get_bandwidth(dev, module, &settings->bandwidth);
+    if (status != 0) {
+        return status;
+    }
+
+    status = bladerf_get_frequency(dev, module, &settings->frequency);
+    if (status != 0) {
+        return status;
+    }
+
+    status = bladerf_get_rational_sample_rate(dev, module,
+                                              &settings->samplerate);
+    if (status != 0) {
+        return status;
+    }
+
+    status = bladerf_set_bandwidth(dev, module, CAL_BANDWIDTH, NULL);
+    if (status != 0) {
+        return status;
+    }
+
+    status = bladerf_set_sample_rate(dev, module, CAL_SAMPLERATE, NULL);
+
+    return status;
+}
+
+static inline int restore_settings(struct bladerf *dev, bladerf_module module,
+                                   struct settings *settings)
+{
+    int status;
+
+    status = bladerf_set_bandwidth(dev, module, settings->bandwidth, NULL);
+    if (status != 0) {
+        return status;
+    }
+
+    status = bladerf_set_frequency(dev, module, settings->frequency);
+    if (status != 0) {
+        return status;
+    }
+
+    status = bladerf_set_rational_sample_rate(dev, module,
+                                              &settings->samplerate, NULL);
+
+    return status;
+}
+
+/* Search for the FPGA gain and phase corrections that null the residual RX
+ * IQ imbalance. The gain and phase errors are scaled such that each responds
+ * to its correction with a slope of roughly +/- 1. */
+static int search_rx_iq(struct cli_state *s, void *arg,
+                        struct bladerf_dc_solution *solution)
+{
+    int status;
+    struct bladerf_dc_solver_config config;
+
+    bladerf_dc_solver_defaults(BLADERF_MODULE_RX, &config);
+    config.min = -2048;
+    config.max = 2048;
+    config.quantum = 1;
+    config.step = 256;
+    config.threshold = 0.5f;
+
+    status = bladerf_dc_solve_rx(&config, measure_rx_iq_sweep, arg, solution);
+
+    if (status == BLADERF_ERR_UNEXPECTED) {
+        cli_err(s, "Error", "RX IQ imbalance does not respond to correction.\n");
+    } else if (status == 0 && !solution->converged) {
+        printf("  Warning: RX IQ imbalance search did not converge.\n");
+    }
+
+    return status;
+}
+
+/* Search for the FPGA gain and phase corrections that minimize the image of
+ * the TX stimulus. The image is a phasor to which the gain and phase
+ * corrections add orthogonal components, as is the case for TX LO leakage
+ * and the DC offset corrections. */
+static int search_tx_iq(struct cli_state *s, void *arg,
+                        struct bladerf_dc_solution *solution)
+{
+    int status;
+    struct bladerf_dc_solver_config config;
+
+    bladerf_dc_solver_defaults(BLADERF_MODULE_TX, &config);
+    config.min = -2048;
+    config.max = 2048;
+    config.quantum = 2;
+    config.step = 256;
+    config.max_measurements = 24;
+
+    status = bladerf_dc_solve_tx(&config, measure_tx_iq_sweep, arg, solution);
+
+    if (status == BLADERF_ERR_UNEXPECTED) {
+        cli_err(s, "Error", "Failed to locate the TX image minimum.\n");
+    } else if (status == 0 && !solution->converged) {
+        printf("  Warning: TX IQ imbalance search did not converge.\n");
+    }
+
+    return status;
+}
+
+/* See libbladeRF's dc_cal_table.c for the packed table data format, which is
+ * shared by DC offset and IQ imbalance tables */
+static int gen_tbl(struct cli_state *s, bladerf_module module, bool iq,
+                   const char *filename, unsigned int f_low,
+                   unsigned f_inc, unsigned int f_high)
+{
+    int retval, status;
+    size_t off;
+    struct bladerf_lms_dc_cals lms_dc_cals;
+    unsigned int f;
+    struct settings settings, other_settings;
+    bladerf_loopback loopback_backup;
+    struct bladerf_image *image = NULL;
+    struct dc_sweep sweep;
+    bool sweep_started = false;
+    bladerf_image_type type;
+
+    /* The other module provides the measurements for TX calibrations, and
+     * the stimulus for IQ calibrations */
+    const bool use_other = (module == BLADERF_MODULE_TX) || iq;
+    const bladerf_module other = (module == BLADERF_MODULE_RX) ?
+                                    BLADERF_MODULE_TX : BLADERF_MODULE_RX;
+
+    const uint16_t magic = HOST_TO_LE16(iq ? 0x1ab2 : 0x1ab1);
+    const uint32_t reserved = HOST_TO_LE32(0x00000000);
+    const uint32_t tbl_version = HOST_TO_LE32(0x00000001);
+
+    const size_t lms_data_size = 10; /* 10 uint8_t register values */
+
+    const uint32_t n_frequencies = (f_high - f_low) / f_inc + 1;
+    const uint32_t n_frequencies_le = HOST_TO_LE32(n_frequencies);
 
     const size_t entry_size = sizeof(uint32_t) +   /* Frequency */
-                              2 * sizeof(int16_t); /* DC I and Q valus */
+                              2 * sizeof(int16_t); /* I and Q (or gain and
+                                                    * phase) values */
 
     const size_t table_size = n_frequencies * entry_size;
 
@@ -749,6 +1171,13 @@ int calibrate_dc_gen_tbl(struct cli_state *s, bladerf_module module,
         return status;
     }
 
+    if (use_other) {
+        status = backup_and_update_settings(s->dev, other, &other_settings);
+        if (status != 0) {
+            return status;
+        }
+    }
+
     status = bladerf_get_loopback(s->dev, &loopback_backup);
     if (status != 0) {
         return status;
@@ -760,13 +1189,13 @@ int calibrate_dc_gen_tbl(struct cli_state *s, bladerf_module module,
     }
 
     if (module == BLADERF_MODULE_RX) {
-        image = bladerf_alloc_image(BLADERF_IMAGE_TYPE_RX_DC_CAL,
-                                    0xffffffff, (unsigned int) data_size);
+        type = iq ? BLADERF_IMAGE_TYPE_RX_IQ_CAL : BLADERF_IMAGE_TYPE_RX_DC_CAL;
     } else {
-        image = bladerf_alloc_image(BLADERF_IMAGE_TYPE_TX_DC_CAL,
-                                    0xffffffff, (unsigned int) data_size);
+        type = iq ? BLADERF_IMAGE_TYPE_TX_IQ_CAL : BLADERF_IMAGE_TYPE_TX_DC_CAL;
     }
 
+    image = bladerf_alloc_image(type, 0xffffffff, (unsigned int) data_size);
+
     if (image == NULL) {
         status = BLADERF_ERR_MEM;
         goto out;
@@ -777,7 +1206,7 @@ int calibrate_dc_gen_tbl(struct cli_state *s, bladerf_module module,
         goto out;
     }
 
-    if (module == BLADERF_MODULE_RX) {
+    if (module == BLADERF_MODULE_RX && !iq) {
         status = bladerf_set_loopback(s->dev, BLADERF_LB_NONE);
         if (status != 0) {
             goto out;
@@ -809,35 +1238,68 @@ int calibrate_dc_gen_tbl(struct cli_state *s, bladerf_module module,
     image->data[off++] = (uint8_t)lms_dc_cals.rxvga2b_i;
     image->data[off++] = (uint8_t)lms_dc_cals.rxvga2b_q;
 
+    status = sweep_init(&sweep, s, module, iq);
+    if (status != 0) {
+        goto out;
+    }
+
+    sweep_started = true;
+
     putchar('\n');
 
     for (f = f_low; f <= f_high; f += f_inc) {
         const uint32_t frequency = HOST_TO_LE32((uint32_t)f);
+        struct bladerf_dc_solution solution;
         int16_t dc_i, dc_q;
 
         printf("  Calibrating @ %u Hz...", f);
 
-        status = bladerf_set_frequency(s->dev, module, f);
+        status = sweep_tune(&sweep, f);
         if (status != 0) {
             goto out;
         }
 
-        if (module == BLADERF_MODULE_RX) {
-            int16_t error_i, error_q;
-            status = calibrate_dc_rx(s, &dc_i, &dc_q, &error_i, &error_q);
-            printf("    I=%-4d (avg: %-4d), Q=%-4d (avg: %-4d)\r",
-                    dc_i, error_i, dc_q, error_q);
-        } else {
-            float error_i, error_q;
-            status = calibrate_dc_tx(s, &dc_i, &dc_q, &error_i, &error_q);
+        if (iq && module == BLADERF_MODULE_RX) {
+            status = search_rx_iq(s, &sweep, &solution);
+            if (status != 0) {
+                goto out;
+            }
+
+            printf("    Gain=%-5d (err: %3.3f), Phase=%-5d (err: %3.3f)\r",
+                    solution.dc_i, solution.residual_i,
+                    solution.dc_q, solution.residual_q);
+        } else if (iq) {
+            status = search_tx_iq(s, &sweep, &solution);
+            if (status != 0) {
+                goto out;
+            }
+
+            printf("    Gain=%-5d, Phase=%-5d (image: %3.1f dBc)\r",
+                    solution.dc_i, solution.dc_q,
+                    20.0 * log10(solution.magnitude / 4096.0));
+        } else if (module == BLADERF_MODULE_RX) {
+            status = search_rx_dc(s, measure_rx_dc_sweep, &sweep, &solution);
+            if (status != 0) {
+                goto out;
+            }
+
             printf("    I=%-4d (avg: %3.3f), Q=%-4d (avg: %3.3f)\r",
-                    dc_i, error_i, dc_q, error_q);
-        }
+                    solution.dc_i, solution.residual_i,
+                    solution.dc_q, solution.residual_q);
+        } else {
+            status = search_tx_dc(s, measure_tx_dc_sweep, &sweep, &solution);
+            if (status != 0) {
+                goto out;
+            }
 
-        if (status != 0) {
-            goto out;
+            printf("    I=%-4d, Q=%-4d (mag: %3.3f, residual: %3.1f, %3.1f)\r",
+                    solution.dc_i, solution.dc_q, solution.magnitude,
+                    solution.residual_i, solution.residual_q);
         }
 
+        dc_i = solution.dc_i;
+        dc_q = solution.dc_q;
+
         fflush(stdout);
 
         dc_i = HOST_TO_LE16(dc_i);
@@ -860,28 +1322,155 @@ int calibrate_dc_gen_tbl(struct cli_state *s, bladerf_module module,
 out:
     retval = status;
 
-    if (module == BLADERF_MODULE_RX) {
-        status = bladerf_set_loopback(s->dev, loopback_backup);
-        retval = first_error(retval, status);
+    if (sweep_started) {
+        sweep_deinit(&sweep);
     }
 
+    status = bladerf_set_loopback(s->dev, loopback_backup);
+    retval = first_error(retval, status);
+
     status = bladerf_enable_module(s->dev, BLADERF_MODULE_RX, false);
     retval = first_error(retval, status);
 
+    status = bladerf_enable_module(s->dev, BLADERF_MODULE_TX, false);
+    retval = first_error(retval, status);
+
     status = restore_settings(s->dev, module, &settings);
     retval = first_error(retval, status);
 
+    if (use_other) {
+        status = restore_settings(s->dev, other, &other_settings);
+        retval = first_error(retval, status);
+    }
+
     bladerf_free_image(image);
     return retval;
 }
 
+int calibrate_dc_gen_tbl(struct cli_state *s, bladerf_module module,
+                         const char *filename, unsigned int f_low,
+                         unsigned f_inc, unsigned int f_high)
+{
+    return gen_tbl(s, module, false, filename, f_low, f_inc, f_high);
+}
+
+int calibrate_iq_gen_tbl(struct cli_state *s, bladerf_module module,
+                         const char *filename, unsigned int f_low,
+                         unsigned f_inc, unsigned int f_high)
+{
+    return gen_tbl(s, module, true, filename, f_low, f_inc, f_high);
+}
+
+int calibrate_iq(struct cli_state *s, bladerf_module module)
+{
+    int retval, status;
+    unsigned int frequency;
+    struct settings settings, other_settings;
+    bladerf_loopback loopback_backup;
+    struct dc_sweep sweep;
+    struct bladerf_dc_solution solution;
+    bool sweep_started = false;
+    const bladerf_module other = (module == BLADERF_MODULE_RX) ?
+                                    BLADERF_MODULE_TX : BLADERF_MODULE_RX;
+
+    status = backup_and_update_settings(s->dev, module, &settings);
+    if (status != 0) {
+        return status;
+    }
+
+    status = backup_and_update_settings(s->dev, other, &other_settings);
+    if (status != 0) {
+        return status;
+    }
+
+    status = bladerf_get_loopback(s->dev, &loopback_backup);
+    if (status != 0) {
+        return status;
+    }
+
+    frequency = settings.frequency;
+
+    status = sweep_init(&sweep, s, module, true);
+    if (status != 0) {
+        goto out;
+    }
+
+    sweep_started = true;
+
+    status = sweep_tune(&sweep, frequency);
+    if (status != 0) {
+        goto out;
+    }
+
+    putchar('\n');
+
+    if (module == BLADERF_MODULE_RX) {
+        status = search_rx_iq(s, &sweep, &solution);
+        if (status != 0) {
+            goto out;
+        }
+
+        printf("  RX IQ Gain Setting = %d, error ~= %f\n",
+               solution.dc_i, solution.residual_i);
+        printf("  RX IQ Phase Setting = %d, error ~= %f\n",
+               solution.dc_q, solution.residual_q);
+        printf("  (%u measurements)\n\n", solution.measurements);
+    } else {
+        status = search_tx_iq(s, &sweep, &solution);
+        if (status != 0) {
+            goto out;
+        }
+
+        printf("  TX IQ Gain Setting = %d\n", solution.dc_i);
+        printf("  TX IQ Phase Setting = %d\n", solution.dc_q);
+        printf("  (image %3.1f dBc, %u measurements)\n\n",
+               20.0 * log10(solution.magnitude / 4096.0),
+               solution.measurements);
+    }
+
+out:
+    retval = status;
+
+    if (sweep_started) {
+        sweep_deinit(&sweep);
+    }
+
+    status = bladerf_set_loopback(s->dev, loopback_backup);
+    retval = first_error(retval, status);
+
+    status = bladerf_enable_module(s->dev, BLADERF_MODULE_RX, false);
+    retval = first_error(retval, status);
+
+    status = bladerf_enable_module(s->dev, BLADERF_MODULE_TX, false);
+    retval = first_error(retval, status);
+
+    status = restore_settings(s->dev, module, &settings);
+    retval = first_error(retval, status);
+
+    status = restore_settings(s->dev, other, &other_settings);
+    retval = first_error(retval, status);
+
+    /* Restoring the frequency may have applied values from a calibration
+     * table, so apply the solution last */
+    if (retval == 0) {
+        status = bladerf_set_correction(s->dev, module,
+                                        BLADERF_CORR_FPGA_GAIN, solution.dc_i);
+        retval = first_error(retval, status);
+
+        status = bladerf_set_correction(s->dev, module,
+                                        BLADERF_CORR_FPGA_PHASE, solution.dc_q);
+        retval = first_error(retval, status);
+    }
+
+    return retval;
+}
+
 int calibrate_dc(struct cli_state *s, unsigned int ops)
 {
     int retval = 0;
     int status = BLADERF_ERR_UNEXPECTED;
     struct settings rx_settings, tx_settings;
     bladerf_loopback loopback;
-    int16_t dc_i, dc_q;
 
     if (IS_RX_CAL(ops)) {
         status = backup_and_update_settings(s->dev, BLADERF_MODULE_RX,
@@ -1025,24 +1614,31 @@ int calibrate_dc(struct cli_state *s, unsigned int ops)
 
 
     if (IS_CAL(CAL_DC_AUTO_RX, ops)) {
-        int16_t avg_i, avg_q;
-        status = calibrate_dc_rx(s, &dc_i, &dc_q, &avg_i, &avg_q);
+        struct bladerf_dc_solution solution;
+        status = calibrate_dc_rx(s, &solution);
         if (status != 0) {
             goto error;
         } else {
-            printf("  RX DC I Setting = %d, error ~= %d\n", dc_i, avg_i);
-            printf("  RX DC Q Setting = %d, error ~= %d\n\n", dc_q, avg_q);
+            printf("  RX DC I Setting = %d, error ~= %f\n",
+                   solution.dc_i, solution.residual_i);
+            printf("  RX DC Q Setting = %d, error ~= %f\n",
+                   solution.dc_q, solution.residual_q);
+            printf("  (%u measurements)\n\n", solution.measurements);
         }
     }
 
     if (IS_CAL(CAL_DC_AUTO_TX, ops)) {
-        float error_i, error_q;
-        status = calibrate_dc_tx(s, &dc_i, &dc_q, &error_i, &error_q);
+        struct bladerf_dc_solution solution;
+        status = calibrate_dc_tx(s, &solution);
         if (status != 0) {
             goto error;
         } else {
-            printf("  TX DC I Setting = %d, error ~= %f\n", dc_i, error_i);
-            printf("  TX DC Q Setting = %d, error ~= %f\n\n", dc_q, error_q);
+            printf("  TX DC I Setting = %d, error ~= %f\n",
+                   solution.dc_i, solution.residual_i);
+            printf("  TX DC Q Setting = %d, error ~= %f\n",
+                   solution.dc_q, solution.residual_q);
+            printf("  (magnitude %f, %u measurements)\n\n",
+                   solution.magnitude, solution.measurements);
         }
     }
 
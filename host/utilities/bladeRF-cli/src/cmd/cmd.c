@@ -202,7 +202,7 @@ static const struct cmd cmd_table[] = {
         FIELD_INIT(.exec, cmd_load),
         FIELD_INIT(.desc, "Load FPGA or FX3"),
         FIELD_INIT(.help, CLI_CMD_HELPTEXT_load),
-        FIELD_INIT(.requires_device, true),
+        FIELD_INIT(.requires_device, false),
         FIELD_INIT(.requires_fpga, false),
         FIELD_INIT(.allow_while_streaming, false),
     },
@@ -18,31 +18,370 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include "host_config.h"
+
+#if BLADERF_OS_WINDOWS || BLADERF_OS_OSX
+#include "clock_gettime.h"
+#else
+#include <time.h>
+#endif
+
 #include "cmd.h"
 #include "input.h"
+#include "thread.h"
+
+/* Maximum number of devices programmed concurrently */
+#define LOAD_MAX_THREADS 8
+
+typedef enum {
+    LOAD_FPGA,          /* Load an FPGA bitstream */
+    LOAD_FX3,           /* Write FX3 firmware to flash */
+    LOAD_FLASH_FPGA,    /* Write an FPGA bitstream to flash for autoloading */
+} load_op;
+
+/* A device to be programmed by a multi-device load */
+struct load_target {
+    char label[BLADERF_SERIAL_LENGTH + 32];
+
+    /* Device string to open, for devices that could not be found via
+     * bladerf_get_device_list(). Otherwise, info is used. */
+    const char *devstr;
+    struct bladerf_devinfo info;
+
+    /* The CLI's device handle, if this is the currently opened device */
+    struct bladerf *dev;
+
+    int status;
+    double duration;
+};
+
+struct load_job {
+    load_op op;
+    const char *file;
+
+    struct load_target *targets;
+    size_t n_targets;
+
+    MUTEX lock;         /* Protects next and serializes output */
+    size_t next;        /* Index of the next target to program */
+};
+
+static const char *op2str(load_op op)
+{
+    switch (op) {
+        case LOAD_FPGA:
+            return "Loading FPGA";
+
+        case LOAD_FX3:
+            return "Flashing firmware";
+
+        default:
+            return "Flashing FPGA";
+    }
+}
+
+static int str2op(const char *str, load_op *op)
+{
+    if (!strcasecmp(str, "fpga")) {
+        *op = LOAD_FPGA;
+    } else if (!strcasecmp(str, "fx3")) {
+        *op = LOAD_FX3;
+    } else if (!strcasecmp(str, "flash_fpga")) {
+        *op = LOAD_FLASH_FPGA;
+    } else {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int perform_op(struct bladerf *dev, load_op op, const char *file)
+{
+    switch (op) {
+        case LOAD_FPGA:
+            return bladerf_load_fpga(dev, file);
+
+        case LOAD_FX3:
+            return bladerf_flash_firmware(dev, file);
+
+        default:
+            return bladerf_flash_fpga(dev, file);
+    }
+}
+
+static inline double elapsed(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    return (now.tv_sec - start->tv_sec) +
+           (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+static void *load_worker(void *arg)
+{
+    struct load_job *job = (struct load_job *) arg;
+    struct load_target *t;
+    struct bladerf *dev;
+    struct timespec start;
+
+    while (1) {
+        MUTEX_LOCK(&job->lock);
+        if (job->next >= job->n_targets) {
+            MUTEX_UNLOCK(&job->lock);
+            break;
+        }
+
+        t = &job->targets[job->next++];
+        printf("  [%s] %s...\n", t->label, op2str(job->op));
+        MUTEX_UNLOCK(&job->lock);
+
+        clock_gettime(CLOCK_REALTIME, &start);
+
+        if (t->dev != NULL) {
+            dev = t->dev;
+            t->status = 0;
+        } else if (t->devstr != NULL) {
+            t->status = bladerf_open(&dev, t->devstr);
+        } else {
+            t->status = bladerf_open_with_devinfo(&dev, &t->info);
+        }
+
+        if (t->status == 0) {
+            t->status = perform_op(dev, job->op, job->file);
+
+            if (dev != t->dev) {
+                bladerf_close(dev);
+            }
+        }
+
+        t->duration = elapsed(&start);
+
+        MUTEX_LOCK(&job->lock);
+        if (t->status == 0) {
+            printf("  [%s] Done (%.1f s).\n", t->label, t->duration);
+        } else {
+            printf("  [%s] Failed: %s\n", t->label,
+                   bladerf_strerror(t->status));
+        }
+        MUTEX_UNLOCK(&job->lock);
+    }
+
+    return NULL;
+}
+
+/* Test whether the CLI's device handle is already in the target list */
+static bool have_cur_target(struct cli_state *state,
+                            const struct load_target *targets, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        if (targets[i].dev == state->dev) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Add each enumerated device matching a device string to the target list,
+ * once. Device strings that match no enumerated device (e.g., those for
+ * backends that cannot be probed) are opened as-is. */
+static void add_targets(struct cli_state *state, struct load_target *targets,
+                        size_t *n_targets, const char *devstr,
+                        struct bladerf_devinfo *list, int n_list)
+{
+    int i;
+    size_t j;
+    bool found = false;
+    struct bladerf_devinfo cur;
+    const bool have_cur = cli_device_is_opened(state) &&
+                          bladerf_get_devinfo(state->dev, &cur) == 0;
+
+    for (i = 0; i < n_list; i++) {
+        if (!bladerf_devstr_matches(devstr, &list[i])) {
+            continue;
+        }
+
+        found = true;
+
+        for (j = 0; j < *n_targets; j++) {
+            if (targets[j].devstr == NULL &&
+                bladerf_devinfo_matches(&targets[j].info, &list[i])) {
+                break;
+            }
+        }
+
+        if (j == *n_targets) {
+            struct load_target *t;
+            const bool is_cur = have_cur &&
+                                bladerf_devinfo_matches(&cur, &list[i]);
+
+            if (is_cur && have_cur_target(state, targets, *n_targets)) {
+                continue;
+            }
+
+            t = &targets[(*n_targets)++];
+            t->info = list[i];
+            t->dev = is_cur ? state->dev : NULL;
+            snprintf(t->label, sizeof(t->label), "%s", list[i].serial);
+        }
+    }
+
+    if (!found) {
+        struct load_target *t;
+        const bool is_cur = have_cur && bladerf_devstr_matches(devstr, &cur);
+
+        if (is_cur && have_cur_target(state, targets, *n_targets)) {
+            return;
+        }
+
+        for (j = 0; j < *n_targets; j++) {
+            if (targets[j].devstr != NULL &&
+                !strcmp(targets[j].devstr, devstr)) {
+                return;
+            }
+        }
+
+        t = &targets[(*n_targets)++];
+        t->devstr = devstr;
+        t->dev = is_cur ? state->dev : NULL;
+        snprintf(t->label, sizeof(t->label), "%s", devstr);
+    }
+}
+
+/* Program each device described by the provided device strings, using a
+ * pool of up to LOAD_MAX_THREADS threads. All threads share the image file;
+ * for FPGA loads, libbladeRF reads it from disk only once. */
+static int load_multi(struct cli_state *state, load_op op, const char *file,
+                      int n_devstrs, char **devstrs)
+{
+    struct load_job job;
+    struct bladerf_devinfo *list = NULL;
+    pthread_t threads[LOAD_MAX_THREADS];
+    size_t n_threads, i;
+    size_t n_failed = 0;
+    int n_list, status;
+
+    n_list = bladerf_get_device_list(&list);
+    if (n_list < 0) {
+        if (n_list != BLADERF_ERR_NODEV) {
+            state->last_lib_error = n_list;
+            return CLI_RET_LIBBLADERF;
+        }
+
+        n_list = 0;
+    }
+
+    memset(&job, 0, sizeof(job));
+    job.op = op;
+    job.file = file;
+    job.targets = calloc((size_t) (n_list + n_devstrs), sizeof(job.targets[0]));
+    if (job.targets == NULL) {
+        bladerf_free_device_list(list);
+        return CLI_RET_MEM;
+    }
+
+    for (i = 0; i < (size_t) n_devstrs; i++) {
+        add_targets(state, job.targets, &job.n_targets, devstrs[i],
+                    list, n_list);
+    }
+
+    MUTEX_INIT(&job.lock);
+
+    n_threads = job.n_targets < LOAD_MAX_THREADS ?
+                    job.n_targets : LOAD_MAX_THREADS;
+
+    printf("\n  %s from %s on %u device(s)...\n\n", op2str(op), file,
+           (unsigned int) job.n_targets);
+
+    for (i = 0; i < n_threads; i++) {
+        status = pthread_create(&threads[i], NULL, load_worker, &job);
+        if (status != 0) {
+            break;
+        }
+    }
+
+    /* If no threads could be created, program the devices from this one */
+    if (i == 0) {
+        load_worker(&job);
+    }
+
+    n_threads = i;
+    for (i = 0; i < n_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    printf("\n  Summary:\n");
+    for (i = 0; i < job.n_targets; i++) {
+        const struct load_target *t = &job.targets[i];
+
+        if (t->status == 0) {
+            printf("    %-34s OK      %6.1f s\n", t->label, t->duration);
+        } else {
+            printf("    %-34s FAILED  %6.1f s  %s\n", t->label, t->duration,
+                   bladerf_strerror(t->status));
+            n_failed++;
+        }
+    }
+    printf("\n");
+
+    if (op == LOAD_FX3 && n_failed != job.n_targets) {
+        printf("  Cycle power on the updated device(s).\n\n");
+    }
+
+    pthread_mutex_destroy(&job.lock);
+    free(job.targets);
+    bladerf_free_device_list(list);
+
+    if (n_failed != 0) {
+        cli_err(state, "load", "%u of %u device(s) failed.\n",
+                (unsigned int) n_failed, (unsigned int) job.n_targets);
+        return CLI_RET_CMD_HANDLED;
+    }
+
+    return CLI_RET_OK;
+}
 
 int cmd_load(struct cli_state *state, int argc, char **argv)
 {
     /* Valid commands:
-        load fpga <filename>
-        load fx3 <filename>
-        load cal[ibration] <filename>
+        load fpga <filename> [<device> ...]
+        load fx3 <filename> [<device> ...]
+        load flash_fpga <filename> [<device> ...]
     */
     int rv = CLI_RET_OK;
+    load_op op;
 
-    if ( argc == 3 ) {
+    if ( argc >= 3 ) {
         int lib_status = 0;
         struct bladerf *dev = state->dev;
-        char *expanded_path = input_expand_path(argv[2]);
+        char *expanded_path;
+
+        if (str2op(argv[1], &op) != 0) {
+            cli_err(state, argv[0], "  Invalid type: %s\n", argv[1]);
+            return CLI_RET_INVPARAM;
+        }
+
+        if (argc == 3 && !cli_device_is_opened(state)) {
+            return CLI_RET_NODEV;
+        }
 
+        expanded_path = input_expand_path(argv[2]);
         if (expanded_path == NULL) {
             cli_err(state, NULL,
                     "Unable to expand file path: \"%s\"\n", argv[2]);
             return CLI_RET_INVPARAM;
         }
 
-        if (!strcasecmp(argv[1], "fpga")) {
+        if (argc > 3) {
+            rv = load_multi(state, op, expanded_path, argc - 3, &argv[3]);
+
+        } else if (op == LOAD_FPGA) {
 
             printf("\n  Loading fpga from %s...\n", expanded_path);
             lib_status = bladerf_load_fpga(dev, expanded_path);
@@ -50,7 +389,7 @@ int cmd_load(struct cli_state *state, int argc, char **argv)
                 printf("  Done.\n\n");
             }
 
-        } else if (!strcasecmp(argv[1], "fx3")) {
+        } else if (op == LOAD_FX3) {
 
             printf("\n  Flashing firmware from %s...\n", expanded_path);
             lib_status = bladerf_flash_firmware(dev, expanded_path);
@@ -59,8 +398,12 @@ int cmd_load(struct cli_state *state, int argc, char **argv)
             }
 
         } else {
-            cli_err(state, argv[0], "  Invalid type: %s\n", argv[1]);
-            rv = CLI_RET_INVPARAM;
+
+            printf("\n  Writing FPGA to flash from %s...\n", expanded_path);
+            lib_status = bladerf_flash_fpga(dev, expanded_path);
+            if (lib_status == 0) {
+                printf("  Done.\n\n");
+            }
         }
 
         free(expanded_path);
@@ -75,4 +418,3 @@ int cmd_load(struct cli_state *state, int argc, char **argv)
 
     return rv;
 }
-
@@ -50,6 +50,7 @@ static const struct option longopts[] = {
     { "version",            no_argument,        0,  2  },
     { "help",               no_argument,        0, 'h' },
     { "help-interactive",   no_argument,        0,  3  },
+    { "flash-delta",        no_argument,        0,  4  },
     { 0,                    0,                  0,  0  },
 };
 
@@ -58,6 +59,7 @@ struct rc_config {
     bool interactive_mode;
     bool flash_fw;
     bool flash_fpga;
+    bool flash_delta;
     bool load_fpga;
     bool probe;
     bool show_help;
@@ -79,6 +81,7 @@ static void init_rc_config(struct rc_config *rc)
     rc->interactive_mode = false;
     rc->flash_fw = false;
     rc->flash_fpga = false;
+    rc->flash_delta = false;
     rc->load_fpga = false;
     rc->probe = false;
     rc->show_help = false;
@@ -234,6 +237,10 @@ int get_rc_config(int argc, char *argv[], struct rc_config *rc,
                 rc->show_help_interactive = true;
                 break;
 
+            case 4:
+                rc->flash_delta = true;
+                break;
+
             default:
                 return -1;
         }
@@ -255,6 +262,8 @@ void usage(const char *argv0)
     printf("  -L, --flash-fpga <file>          Write the provided FPGA image to flash for\n");
     printf("                                   autoloading. Use -L X or --flash-fpga X to\n");
     printf("                                   disable FPGA autoloading.\n");
+    printf("      --flash-delta                With -f or -L, only erase and write the flash\n");
+    printf("                                   blocks that differ from the provided file.\n");
     printf("  -p, --probe                      Probe for devices, print results, then exit.\n");
     printf("                                    A non-zero return status will be returned if no\n");
     printf("                                    devices are found.\n");
@@ -318,6 +327,13 @@ static int open_device(struct rc_config *rc, struct cli_state *state, int status
     return status;
 }
 
+static int set_flash_mode(struct rc_config *rc, struct cli_state *state)
+{
+    return bladerf_set_flash_mode(state->dev, rc->flash_delta ?
+                                  BLADERF_FLASH_MODE_DELTA :
+                                  BLADERF_FLASH_MODE_FULL);
+}
+
 static int flash_fw(struct rc_config *rc, struct cli_state *state, int status)
 {
     if (!status && rc->fw_file) {
@@ -326,7 +342,10 @@ static int flash_fw(struct rc_config *rc, struct cli_state *state, int status)
             status = -1;
         } else {
             printf("Flashing firmware...\n");
-            status = bladerf_flash_firmware(state->dev, rc->fw_file);
+            status = set_flash_mode(rc, state);
+            if (!status) {
+                status = bladerf_flash_firmware(state->dev, rc->fw_file);
+            }
             if (status) {
                 fprintf(stderr, "Error: failed to flash firmware: %s\n",
                         bladerf_strerror(status));
@@ -354,7 +373,11 @@ static int flash_fpga(struct rc_config *rc, struct cli_state *state, int status)
                 status = bladerf_erase_stored_fpga(state->dev);
             } else {
                 printf("Writing FPGA to flash for autoloading...\n");
-                status = bladerf_flash_fpga(state->dev, rc->flash_fpga_file);
+                status = set_flash_mode(rc, state);
+                if (!status) {
+                    status = bladerf_flash_fpga(state->dev,
+                                                rc->flash_fpga_file);
+                }
             }
 
             if (status) {